@@ -15,14 +15,20 @@ LOCAL_CFLAGS :=
 
 LOCAL_SRC_FILES := $(LOCAL_PATH)/src/SDL_sound.c \
 				$(LOCAL_PATH)/src/SDL_sound_aiff.c \
+				$(LOCAL_PATH)/src/SDL_sound_alloc.c \
 				$(LOCAL_PATH)/src/SDL_sound_au.c \
+				$(LOCAL_PATH)/src/SDL_sound_cache.c \
+				$(LOCAL_PATH)/src/SDL_sound_convert.c \
 				$(LOCAL_PATH)/src/SDL_sound_coreaudio.c \
 				$(LOCAL_PATH)/src/SDL_sound_flac.c \
 				$(LOCAL_PATH)/src/SDL_sound_mp3.c \
 				$(LOCAL_PATH)/src/SDL_sound_midi.c \
 				$(LOCAL_PATH)/src/SDL_sound_modplug.c \
+				$(LOCAL_PATH)/src/SDL_sound_push.c \
 				$(LOCAL_PATH)/src/SDL_sound_raw.c \
+				$(LOCAL_PATH)/src/SDL_sound_resample.c \
 				$(LOCAL_PATH)/src/SDL_sound_shn.c \
+				$(LOCAL_PATH)/src/SDL_sound_trace.c \
 				$(LOCAL_PATH)/src/SDL_sound_voc.c \
 				$(LOCAL_PATH)/src/SDL_sound_vorbis.c \
 				$(LOCAL_PATH)/src/SDL_sound_wav.c 
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+
+# This regenerates the small fixtures that sdlsound-bench uses for the
+#  formats it can't easily synthesize itself. You don't need to run this
+#  to build or run the benchmark; the output is checked in. It's here so
+#  the fixtures can be rebuilt from the same signal if we ever have to
+#  change them (Ogg streams get a random serial number, so that one won't
+#  be bit-for-bit identical).
+#
+# FLAC, Ogg Vorbis and MP3 are encoded with libsndfile through the Python
+#  "soundfile" module (pip install soundfile numpy). The MOD and MIDI files
+#  are written by hand below.
+
+import math
+import os
+import struct
+
+import numpy
+import soundfile
+
+RATE = 44100
+SECONDS = 2.0
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+
+def signal():
+    # Two tones on the left and a slow sweep on the right. No noise, so
+    #  FLAC stays small enough to check in.
+    t = numpy.arange(int(RATE * SECONDS)) / RATE
+    left = 0.4 * numpy.sin(2 * math.pi * 440 * t) + 0.2 * numpy.sin(2 * math.pi * 1250 * t)
+    sweep = 200 + 1800 * t / SECONDS
+    right = 0.5 * numpy.sin(2 * math.pi * numpy.cumsum(sweep) / RATE)
+    return numpy.stack([left, right], axis=1).astype(numpy.float32)
+
+
+def write_encoded():
+    data = signal()
+    soundfile.write(os.path.join(here, 'bench.flac'), data, RATE, format='FLAC', subtype='PCM_16')
+    soundfile.write(os.path.join(here, 'bench.ogg'), data, RATE, format='OGG', subtype='VORBIS')
+    soundfile.write(os.path.join(here, 'bench.mp3'), data, RATE, format='MP3', subtype='MPEG_LAYER_III')
+
+
+def write_mod():
+    # 4-channel ProTracker module: one looping sine cycle, one noise hit.
+    name = b'sdlsound-bench'.ljust(20, b'\0')
+    tone = bytes((int(round(100 * math.sin(2 * math.pi * i / 32))) & 0xFF) for i in range(32))
+    seed = 1
+    hit = bytearray()
+    for i in range(2048):
+        seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF
+        hit.append(((((seed >> 16) & 0xFF) - 128) * (2048 - i) // 2048) & 0xFF)
+    hit = bytes(hit)
+
+    headers = b''
+    headers += b'tone'.ljust(22, b'\0') + struct.pack('>HBBHH', len(tone) // 2, 0, 64, 0, len(tone) // 2)
+    headers += b'hit'.ljust(22, b'\0') + struct.pack('>HBBHH', len(hit) // 2, 0, 48, 0, 1)
+    for i in range(29):
+        headers += b'\0' * 22 + struct.pack('>HBBHH', 0, 0, 0, 0, 1)
+
+    periods = [428, 381, 339, 320, 285, 254, 226, 214]
+    pattern = b''
+    for row in range(64):
+        cells = []
+        for chan in range(4):
+            smp, period = 0, 0
+            if chan < 2 and row % 4 == 0:
+                smp, period = 1, periods[(row // 4 + chan * 2) % len(periods)]
+            elif chan == 2 and row % 8 == 4:
+                smp, period = 2, 428
+            cells.append(struct.pack('>BBBB', (smp & 0xF0) | (period >> 8), period & 0xFF, (smp & 0x0F) << 4, 0))
+        pattern += b''.join(cells)
+
+    order = bytes([0, 0]) + b'\0' * 126
+    mod = name + headers + bytes([2, 127]) + order + b'M.K.' + pattern + tone + hit
+    with open(os.path.join(here, 'bench.mod'), 'wb') as f:
+        f.write(mod)
+
+
+def write_mid():
+    # Format 0 SMF, a simple arpeggio on the default piano patch.
+    def varlen(value):
+        out = [value & 0x7F]
+        value >>= 7
+        while value:
+            out.insert(0, (value & 0x7F) | 0x80)
+            value >>= 7
+        return bytes(out)
+
+    events = b''
+    for i, note in enumerate([60, 64, 67, 72, 67, 64] * 2):
+        events += varlen(0) + bytes([0x90, note, 100])
+        events += varlen(48) + bytes([0x80, note, 0])
+    events += varlen(0) + b'\xFF\x2F\x00'
+    mid = b'MThd' + struct.pack('>IHHH', 6, 0, 1, 96) + b'MTrk' + struct.pack('>I', len(events)) + events
+    with open(os.path.join(here, 'bench.mid'), 'wb') as f:
+        f.write(mid)
+
+
+if __name__ == '__main__':
+    write_encoded()
+    write_mod()
+    write_mid()
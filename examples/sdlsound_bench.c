@@ -0,0 +1,1492 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+/**
+ * Decode throughput benchmark.
+ *
+ * For every decoder compiled into SDL_sound, this opens a known asset,
+ *  decodes all of it through Sound_Decode(), seeks around in it, and
+ *  reports what that cost as JSON, so two builds can be diffed.
+ *
+ * The uncompressed formats (WAV PCM/MS ADPCM/float, AIFF, AU u-law, VOC and
+ *  RAW) are synthesized here, from the same deterministic signal, at the
+ *  length given with --seconds. Compressed formats come from the small
+ *  fixtures in examples/bench_assets (see make_assets.py in there).
+ *
+ * Everything is decoded from memory, so disk speed doesn't factor in. Each
+ *  asset is run through each output format once untimed, to warm caches and
+ *  SDL_sound's sample pool, then --iterations times; the best time is kept
+ *  and allocation numbers are the worst seen. Reported per run:
+ *
+ *   open_ns           Sound_NewSample() wall time.
+ *   decode_ns         Sound_Decode() until EOF, all calls summed.
+ *   frames_per_sec,   Output frames over decode_ns.
+ *   ns_per_frame
+ *   seek_ns           Average of a Sound_Seek() plus the first Sound_Decode()
+ *                     after it (time to first audio), or null if the sample
+ *                     can't seek.
+ *   decode_all_ns     Sound_Rewind() and one Sound_DecodeAll().
+ *   peak_alloc_bytes  Most bytes live at once between open and free,
+ *                     counting everything that went through SDL_malloc.
+ *   alloc_count       malloc/calloc/realloc calls between open and free.
+ *
+ * If SDL_sound was built with SDLSOUND_ALLOC_STATS, it can tell which of
+ *  those allocations its decoder made, and when, so there's also (from
+ *  Sound_GetSampleStats(), null otherwise):
+ *
+ *   decoder_open_allocs,   What the decoder allocated while opening.
+ *   decoder_open_bytes
+ *   allocs_per_read        Decoder allocations per call to its read method,
+ *                          over the Sound_Decode() loop; anything but zero
+ *                          means it allocates on the hot path.
+ *   decoder_steady_bytes   What the decoder holds once it's decoded it all.
+ *   decoder_peak_bytes     The most it held at once, seeks included.
+ *
+ * With --baseline, the run is also checked against a baseline file (see
+ *  examples/bench_assets/baseline.txt), and the exit code is nonzero if
+ *  anything got slower than the tolerance allows or allocates more than it
+ *  used to (a case that looks slower is measured again a few times before
+ *  it counts). This is what "ctest -L perf" runs, in a build configured
+ *  with -DSDLSOUND_PERF_TEST=ON. Times in the baseline are divided by how
+ *  long a fixed loop of plain integer math takes on this machine, so a
+ *  baseline from one box is roughly usable on another, but regenerate it
+ *  with --write-baseline on whatever machine does the gating (and whenever
+ *  SDL itself changes, since its allocations count too).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define SDL_MAIN_HANDLED /* this is a console-only app */
+#endif
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_main.h>
+#include <SDL3_sound/SDL_sound.h>
+
+#ifndef SDLSOUND_BENCH_ASSETS
+#define SDLSOUND_BENCH_ASSETS "bench_assets"
+#endif
+
+#define BENCH_RATE 44100
+#define BENCH_PI 3.14159265358979323846
+
+/* timings shorter than this are too noisy to fail a baseline check over. */
+#define BASELINE_NOISE_FLOOR_NS 20000
+
+/* a case that looks slower gets measured again this many times first. */
+#define BASELINE_RETRIES 3
+
+/* peak footprint may wobble this much (percent) before the gate cares. */
+#define BASELINE_PEAK_SLACK 10
+
+
+/*
+ * Allocation tracking. We put ourselves in front of SDL's allocator before
+ *  anything else runs, and stash each block's size in front of it so free()
+ *  knows how much went away. The header is 16 bytes to keep the alignment
+ *  malloc() gave us.
+ */
+
+#define ALLOC_HEADER 16
+
+static SDL_malloc_func real_malloc;
+static SDL_calloc_func real_calloc;
+static SDL_realloc_func real_realloc;
+static SDL_free_func real_free;
+
+static SDL_SpinLock alloc_lock;
+static Uint64 alloc_live = 0;
+static Uint64 alloc_peak = 0;
+static Uint64 alloc_calls = 0;
+
+static void track_alloc(size_t oldlen, size_t newlen)
+{
+    SDL_LockSpinlock(&alloc_lock);
+    alloc_live = (alloc_live - oldlen) + newlen;
+    if (alloc_live > alloc_peak)
+        alloc_peak = alloc_live;
+    alloc_calls++;
+    SDL_UnlockSpinlock(&alloc_lock);
+} /* track_alloc */
+
+static void *SDLCALL bench_malloc(size_t len)
+{
+    Uint8 *ptr = (Uint8 *) real_malloc(len + ALLOC_HEADER);
+    if (ptr == NULL)
+        return NULL;
+    *((size_t *) ptr) = len;
+    track_alloc(0, len);
+    return ptr + ALLOC_HEADER;
+} /* bench_malloc */
+
+static void *SDLCALL bench_calloc(size_t nmemb, size_t size)
+{
+    const size_t len = nmemb * size;
+    Uint8 *ptr;
+
+    if ((size != 0) && ((len / size) != nmemb))
+        return NULL;  /* overflow. */
+
+    ptr = (Uint8 *) real_calloc(1, len + ALLOC_HEADER);
+    if (ptr == NULL)
+        return NULL;
+    *((size_t *) ptr) = len;
+    track_alloc(0, len);
+    return ptr + ALLOC_HEADER;
+} /* bench_calloc */
+
+static void *SDLCALL bench_realloc(void *mem, size_t len)
+{
+    Uint8 *ptr;
+    size_t oldlen;
+
+    if (mem == NULL)
+        return bench_malloc(len);
+
+    ptr = ((Uint8 *) mem) - ALLOC_HEADER;
+    oldlen = *((size_t *) ptr);
+    ptr = (Uint8 *) real_realloc(ptr, len + ALLOC_HEADER);
+    if (ptr == NULL)
+        return NULL;
+    *((size_t *) ptr) = len;
+    track_alloc(oldlen, len);
+    return ptr + ALLOC_HEADER;
+} /* bench_realloc */
+
+static void SDLCALL bench_free(void *mem)
+{
+    Uint8 *ptr;
+
+    if (mem == NULL)
+        return;
+
+    ptr = ((Uint8 *) mem) - ALLOC_HEADER;
+    SDL_LockSpinlock(&alloc_lock);
+    alloc_live -= *((size_t *) ptr);
+    SDL_UnlockSpinlock(&alloc_lock);
+    real_free(ptr);
+} /* bench_free */
+
+/* Start a new measurement window; returns bytes live right now. */
+static Uint64 alloc_window_start(void)
+{
+    Uint64 retval;
+    SDL_LockSpinlock(&alloc_lock);
+    alloc_peak = alloc_live;
+    alloc_calls = 0;
+    retval = alloc_live;
+    SDL_UnlockSpinlock(&alloc_lock);
+    return retval;
+} /* alloc_window_start */
+
+
+/*
+ * A growable byte buffer, for building the synthetic assets.
+ */
+
+typedef struct
+{
+    Uint8 *data;
+    size_t len;
+    size_t allocated;
+} BenchBuffer;
+
+static bool buf_reserve(BenchBuffer *buf, size_t len)
+{
+    if ((buf->len + len) > buf->allocated)
+    {
+        size_t newlen = buf->allocated ? buf->allocated : 4096;
+        Uint8 *ptr;
+        while (newlen < (buf->len + len))
+            newlen *= 2;
+        ptr = (Uint8 *) SDL_realloc(buf->data, newlen);
+        if (ptr == NULL)
+            return false;
+        buf->data = ptr;
+        buf->allocated = newlen;
+    } /* if */
+    return true;
+} /* buf_reserve */
+
+static bool buf_put(BenchBuffer *buf, const void *data, size_t len)
+{
+    if (!buf_reserve(buf, len))
+        return false;
+    SDL_memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return true;
+} /* buf_put */
+
+static bool buf_u8(BenchBuffer *buf, Uint8 val)
+{
+    return buf_put(buf, &val, 1);
+} /* buf_u8 */
+
+static bool buf_le16(BenchBuffer *buf, Uint16 val)
+{
+    const Uint8 bytes[2] = { (Uint8) val, (Uint8) (val >> 8) };
+    return buf_put(buf, bytes, sizeof (bytes));
+} /* buf_le16 */
+
+static bool buf_le32(BenchBuffer *buf, Uint32 val)
+{
+    const Uint8 bytes[4] = { (Uint8) val, (Uint8) (val >> 8), (Uint8) (val >> 16), (Uint8) (val >> 24) };
+    return buf_put(buf, bytes, sizeof (bytes));
+} /* buf_le32 */
+
+static bool buf_be16(BenchBuffer *buf, Uint16 val)
+{
+    const Uint8 bytes[2] = { (Uint8) (val >> 8), (Uint8) val };
+    return buf_put(buf, bytes, sizeof (bytes));
+} /* buf_be16 */
+
+static bool buf_be32(BenchBuffer *buf, Uint32 val)
+{
+    const Uint8 bytes[4] = { (Uint8) (val >> 24), (Uint8) (val >> 16), (Uint8) (val >> 8), (Uint8) val };
+    return buf_put(buf, bytes, sizeof (bytes));
+} /* buf_be32 */
+
+/* patch a little-endian 32-bit value in after the fact (chunk sizes). */
+static void buf_set_le32(BenchBuffer *buf, size_t pos, Uint32 val)
+{
+    buf->data[pos] = (Uint8) val;
+    buf->data[pos + 1] = (Uint8) (val >> 8);
+    buf->data[pos + 2] = (Uint8) (val >> 16);
+    buf->data[pos + 3] = (Uint8) (val >> 24);
+} /* buf_set_le32 */
+
+
+/*
+ * The signal: two tones on the left channel and a slow sweep on the right,
+ *  same as the compressed fixtures. Mono assets get the left channel.
+ */
+
+static float synth(Uint32 frame, int channel, int rate, Uint32 total)
+{
+    const double t = ((double) frame) / rate;
+    if (channel == 0)
+        return (float) (0.4 * SDL_sin(2.0 * BENCH_PI * 440.0 * t) + 0.2 * SDL_sin(2.0 * BENCH_PI * 1250.0 * t));
+    else
+    {
+        /* integral of a 200Hz -> 2000Hz linear sweep over the whole asset. */
+        const double len = ((double) total) / rate;
+        return (float) (0.5 * SDL_sin(2.0 * BENCH_PI * (200.0 * t + (900.0 * t * t / len))));
+    } /* else */
+} /* synth */
+
+static Sint16 synth16(Uint32 frame, int channel, int rate, Uint32 total)
+{
+    return (Sint16) SDL_lround(synth(frame, channel, rate, total) * 32767.0);
+} /* synth16 */
+
+
+static bool write_wav_header(BenchBuffer *buf, Uint16 tag, Uint16 channels,
+                             Uint32 rate, Uint16 bits, Uint16 align,
+                             Uint32 bytes_per_sec, const BenchBuffer *extra,
+                             size_t *data_size_pos)
+{
+    const Uint32 fmtlen = 16 + (extra ? (2 + (Uint32) extra->len) : 0);
+    bool ok = buf_put(buf, "RIFF", 4) && buf_le32(buf, 0) && buf_put(buf, "WAVE", 4) &&
+              buf_put(buf, "fmt ", 4) && buf_le32(buf, fmtlen) &&
+              buf_le16(buf, tag) && buf_le16(buf, channels) &&
+              buf_le32(buf, rate) && buf_le32(buf, bytes_per_sec) &&
+              buf_le16(buf, align) && buf_le16(buf, bits);
+
+    if (ok && extra)
+        ok = buf_le16(buf, (Uint16) extra->len) && buf_put(buf, extra->data, extra->len);
+
+    ok = ok && buf_put(buf, "data", 4);
+    *data_size_pos = buf->len;
+    return ok && buf_le32(buf, 0);
+} /* write_wav_header */
+
+static void finish_wav(BenchBuffer *buf, size_t data_size_pos)
+{
+    buf_set_le32(buf, data_size_pos, (Uint32) (buf->len - (data_size_pos + 4)));
+    buf_set_le32(buf, 4, (Uint32) (buf->len - 8));
+} /* finish_wav */
+
+static bool gen_wav_pcm16(BenchBuffer *buf, Uint32 frames)
+{
+    size_t pos;
+    Uint32 i;
+
+    if (!write_wav_header(buf, 0x0001, 2, BENCH_RATE, 16, 4, BENCH_RATE * 4, NULL, &pos))
+        return false;
+    else if (!buf_reserve(buf, frames * 4))
+        return false;
+
+    for (i = 0; i < frames; i++)
+    {
+        buf_le16(buf, (Uint16) synth16(i, 0, BENCH_RATE, frames));
+        buf_le16(buf, (Uint16) synth16(i, 1, BENCH_RATE, frames));
+    } /* for */
+
+    finish_wav(buf, pos);
+    return true;
+} /* gen_wav_pcm16 */
+
+static bool gen_wav_float(BenchBuffer *buf, Uint32 frames)
+{
+    size_t pos;
+    Uint32 i;
+    int chan;
+
+    if (!write_wav_header(buf, 0x0003, 2, BENCH_RATE, 32, 8, BENCH_RATE * 8, NULL, &pos))
+        return false;
+    else if (!buf_reserve(buf, frames * 8))
+        return false;
+
+    for (i = 0; i < frames; i++)
+    {
+        for (chan = 0; chan < 2; chan++)
+        {
+            union { float f; Uint32 ui32; } cvt;
+            cvt.f = synth(i, chan, BENCH_RATE, frames);
+            buf_le32(buf, cvt.ui32);
+        } /* for */
+    } /* for */
+
+    finish_wav(buf, pos);
+    return true;
+} /* gen_wav_float */
+
+
+/*
+ * Microsoft ADPCM. This only ever picks the first predictor (which is just
+ *  "the last sample"); the decoder does the same amount of work whichever
+ *  one is in the block header, and we're timing the decoder.
+ */
+
+#define ADPCM_BLOCK_ALIGN 1024
+
+static const Sint16 adpcm_coef[7][2] = {
+    { 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 },
+    { 240, 0 }, { 460, -208 }, { 392, -232 }
+};
+
+static const Sint32 adpcm_adaption[16] = {
+    230, 230, 230, 230, 307, 409, 512, 614,
+    768, 614, 512, 409, 307, 230, 230, 230
+};
+
+typedef struct
+{
+    Sint32 delta;
+    Sint32 samp1;
+    Sint32 samp2;
+} AdpcmChannel;
+
+static Uint8 adpcm_encode(AdpcmChannel *state, Sint32 sample)
+{
+    const Sint32 pred = ((state->samp1 * adpcm_coef[0][0]) + (state->samp2 * adpcm_coef[0][1])) / 256;
+    const Sint32 err = sample - pred;
+    Sint32 nib = (err >= 0) ? ((err + (state->delta / 2)) / state->delta) : -((-err + (state->delta / 2)) / state->delta);
+    Sint32 newsamp;
+
+    if (nib < -8)
+        nib = -8;
+    else if (nib > 7)
+        nib = 7;
+
+    newsamp = pred + (nib * state->delta);
+    if (newsamp < -32768)
+        newsamp = -32768;
+    else if (newsamp > 32767)
+        newsamp = 32767;
+
+    state->delta = (state->delta * adpcm_adaption[nib & 0xF]) / 256;
+    if (state->delta < 16)
+        state->delta = 16;
+    state->samp2 = state->samp1;
+    state->samp1 = newsamp;
+    return (Uint8) (nib & 0xF);
+} /* adpcm_encode */
+
+static bool gen_wav_adpcm(BenchBuffer *buf, Uint32 frames)
+{
+    const Uint16 channels = 2;
+    const Uint16 spb = ((ADPCM_BLOCK_ALIGN - (7 * channels)) * 2 / channels) + 2;
+    const Uint32 blocks = (frames + spb - 1) / spb;
+    BenchBuffer extra;
+    size_t pos;
+    Uint32 block;
+    bool ok;
+    int i;
+
+    SDL_zero(extra);
+    ok = buf_le16(&extra, spb) && buf_le16(&extra, 7);
+    for (i = 0; ok && (i < 7); i++)
+        ok = buf_le16(&extra, (Uint16) adpcm_coef[i][0]) && buf_le16(&extra, (Uint16) adpcm_coef[i][1]);
+
+    ok = ok && write_wav_header(buf, 0x0002, channels, BENCH_RATE, 4, ADPCM_BLOCK_ALIGN,
+                                (BENCH_RATE * ADPCM_BLOCK_ALIGN) / spb, &extra, &pos);
+    SDL_free(extra.data);
+    if (!ok || !buf_reserve(buf, blocks * ADPCM_BLOCK_ALIGN))
+        return false;
+
+    /* the tail end of the last block is silence. */
+    for (block = 0; block < blocks; block++)
+    {
+        const Uint32 first = block * spb;
+        AdpcmChannel state[2];
+        Uint8 byte = 0;
+        bool have_nibble = false;
+        Uint32 frame;
+        int chan;
+
+        for (chan = 0; chan < channels; chan++)
+        {
+            state[chan].delta = 16;
+            state[chan].samp2 = (first < frames) ? synth16(first, chan, BENCH_RATE, frames) : 0;
+            state[chan].samp1 = ((first + 1) < frames) ? synth16(first + 1, chan, BENCH_RATE, frames) : 0;
+        } /* for */
+
+        for (chan = 0; chan < channels; chan++)
+            buf_u8(buf, 0);  /* predictor */
+        for (chan = 0; chan < channels; chan++)
+            buf_le16(buf, (Uint16) state[chan].delta);
+        for (chan = 0; chan < channels; chan++)
+            buf_le16(buf, (Uint16) state[chan].samp1);
+        for (chan = 0; chan < channels; chan++)
+            buf_le16(buf, (Uint16) state[chan].samp2);
+
+        for (frame = first + 2; frame < (first + spb); frame++)
+        {
+            for (chan = 0; chan < channels; chan++)
+            {
+                const Sint32 s = (frame < frames) ? synth16(frame, chan, BENCH_RATE, frames) : 0;
+                const Uint8 nib = adpcm_encode(&state[chan], s);
+                if (!have_nibble)
+                    byte = (Uint8) (nib << 4);
+                else
+                    buf_u8(buf, byte | nib);
+                have_nibble = !have_nibble;
+            } /* for */
+        } /* for */
+    } /* for */
+
+    finish_wav(buf, pos);
+    return true;
+} /* gen_wav_adpcm */
+
+
+static bool gen_aiff(BenchBuffer *buf, Uint32 frames)
+{
+    /* sample rate is an 80-bit IEEE extended float. */
+    Uint32 rate = BENCH_RATE;
+    Uint64 mantissa;
+    int exponent = 0;
+    Uint32 i;
+    bool ok;
+
+    while (rate >> (exponent + 1))
+        exponent++;
+    mantissa = ((Uint64) BENCH_RATE) << (63 - exponent);
+
+    ok = buf_put(buf, "FORM", 4) && buf_be32(buf, 4 + 26 + 16 + (frames * 4)) && buf_put(buf, "AIFF", 4) &&
+         buf_put(buf, "COMM", 4) && buf_be32(buf, 18) &&
+         buf_be16(buf, 2) && buf_be32(buf, frames) && buf_be16(buf, 16) &&
+         buf_be16(buf, (Uint16) (16383 + exponent)) &&
+         buf_be32(buf, (Uint32) (mantissa >> 32)) && buf_be32(buf, (Uint32) mantissa) &&
+         buf_put(buf, "SSND", 4) && buf_be32(buf, 8 + (frames * 4)) &&
+         buf_be32(buf, 0) && buf_be32(buf, 0) &&
+         buf_reserve(buf, frames * 4);
+
+    if (!ok)
+        return false;
+
+    for (i = 0; i < frames; i++)
+    {
+        buf_be16(buf, (Uint16) synth16(i, 0, BENCH_RATE, frames));
+        buf_be16(buf, (Uint16) synth16(i, 1, BENCH_RATE, frames));
+    } /* for */
+
+    return true;
+} /* gen_aiff */
+
+
+static Uint8 ulaw_encode(Sint16 pcm)
+{
+    static const int bias = 0x84;
+    static const int clip = 32635;
+    int sign = (pcm >> 8) & 0x80;
+    int val = pcm;
+    int exponent = 7;
+    int mask;
+
+    if (sign)
+        val = -val;
+    if (val > clip)
+        val = clip;
+    val += bias;
+
+    for (mask = 0x4000; ((val & mask) == 0) && (exponent > 0); mask >>= 1)
+        exponent--;
+
+    return (Uint8) ~(sign | (exponent << 4) | ((val >> (exponent + 3)) & 0x0F));
+} /* ulaw_encode */
+
+static bool gen_au_ulaw(BenchBuffer *buf, Uint32 frames)
+{
+    Uint32 i;
+    bool ok = buf_put(buf, ".snd", 4) && buf_be32(buf, 24) && buf_be32(buf, frames * 2) &&
+              buf_be32(buf, 1) && buf_be32(buf, BENCH_RATE) && buf_be32(buf, 2) &&
+              buf_reserve(buf, frames * 2);
+
+    if (!ok)
+        return false;
+
+    for (i = 0; i < frames; i++)
+    {
+        buf_u8(buf, ulaw_encode(synth16(i, 0, BENCH_RATE, frames)));
+        buf_u8(buf, ulaw_encode(synth16(i, 1, BENCH_RATE, frames)));
+    } /* for */
+
+    return true;
+} /* gen_au_ulaw */
+
+
+/*
+ * Creative VOC: mono, 8-bit unsigned, in plain sound data blocks. The rate
+ *  is a time constant, so 22050Hz comes back out as 22222Hz; we synthesize
+ *  at the rate the decoder will report.
+ */
+
+#define VOC_BLOCK_BYTES 65536
+
+static bool gen_voc(BenchBuffer *buf, Uint32 frames)
+{
+    const Uint8 time_constant = (Uint8) (256 - (1000000 / 22050));
+    const int rate = 1000000 / (256 - time_constant);
+    const Uint32 total = (Uint32) (((Uint64) frames * rate) / BENCH_RATE);
+    Uint32 i = 0;
+    bool ok = buf_put(buf, "Creative Voice File\x1A", 20) &&
+              buf_le16(buf, 26) && buf_le16(buf, 0x010A) && buf_le16(buf, 0x1129) &&
+              buf_reserve(buf, total + ((total / VOC_BLOCK_BYTES) + 1) * 6 + 1);
+
+    while (ok && (i < total))
+    {
+        const Uint32 len = SDL_min(total - i, VOC_BLOCK_BYTES);
+        const Uint32 blocklen = len + 2;
+        Uint32 j;
+
+        buf_u8(buf, 1);  /* sound data */
+        buf_u8(buf, (Uint8) blocklen);
+        buf_u8(buf, (Uint8) (blocklen >> 8));
+        buf_u8(buf, (Uint8) (blocklen >> 16));
+        buf_u8(buf, time_constant);
+        buf_u8(buf, 0);  /* 8-bit unsigned */
+        for (j = 0; j < len; j++, i++)
+            buf_u8(buf, (Uint8) ((synth16(i, 0, rate, total) >> 8) + 128));
+    } /* while */
+
+    return ok && buf_u8(buf, 0);  /* terminator */
+} /* gen_voc */
+
+
+static bool gen_raw(BenchBuffer *buf, Uint32 frames)
+{
+    Uint32 i;
+
+    if (!buf_reserve(buf, frames * 4))
+        return false;
+
+    for (i = 0; i < frames; i++)
+    {
+        buf_le16(buf, (Uint16) synth16(i, 0, BENCH_RATE, frames));
+        buf_le16(buf, (Uint16) synth16(i, 1, BENCH_RATE, frames));
+    } /* for */
+
+    return true;
+} /* gen_raw */
+
+
+/*
+ * The asset list. Assets with a generator are built at startup; the rest
+ *  are loaded from the assets directory.
+ */
+
+typedef struct
+{
+    const char *name;     /* "asset" in the JSON. */
+    const char *ext;      /* handed to Sound_NewSample() to pick a decoder. */
+    bool (*generate)(BenchBuffer *buf, Uint32 frames);
+    const char *fixture;  /* file in the assets directory, if no generator. */
+    Uint8 *data;
+    size_t len;
+} BenchAsset;
+
+static BenchAsset assets[] = {
+    { "wav_pcm16", "WAV", gen_wav_pcm16, NULL, NULL, 0 },
+    { "wav_msadpcm", "WAV", gen_wav_adpcm, NULL, NULL, 0 },
+    { "wav_float", "WAV", gen_wav_float, NULL, NULL, 0 },
+    { "aiff_pcm16", "AIFF", gen_aiff, NULL, NULL, 0 },
+    { "au_ulaw", "AU", gen_au_ulaw, NULL, NULL, 0 },
+    { "voc_u8", "VOC", gen_voc, NULL, NULL, 0 },
+    { "raw_s16", "RAW", gen_raw, NULL, NULL, 0 },
+    { "flac", "FLAC", NULL, "bench.flac", NULL, 0 },
+    { "ogg_vorbis", "OGG", NULL, "bench.ogg", NULL, 0 },
+    { "mp3", "MP3", NULL, "bench.mp3", NULL, 0 },
+    { "mod", "MOD", NULL, "bench.mod", NULL, 0 },
+    { "midi", "MID", NULL, "bench.mid", NULL, 0 }
+};
+
+/* RAW has no header, so it always needs to be told what it's reading. */
+static const SDL_AudioSpec raw_spec = { SDL_AUDIO_S16LE, 2, BENCH_RATE };
+
+typedef struct
+{
+    const char *name;
+    SDL_AudioFormat format;
+    int freq;
+    bool baseline;  /* false if this is mostly timing SDL, not us. */
+} BenchOutput;
+
+static const BenchOutput outputs[] = {
+    { "native", SDL_AUDIO_UNKNOWN, 0, true },
+    { "s16", SDL_AUDIO_S16, 0, true },
+    { "f32", SDL_AUDIO_F32, 0, true },
+    { "s16_48k", SDL_AUDIO_S16, 48000, false }  /* SDL_AudioStream resamples. */
+};
+
+/* where to seek to, as a fraction of the duration. */
+static const double seek_points[] = { 0.75, 0.25, 0.5, 0.9, 0.1, 0.6 };
+
+
+typedef struct
+{
+    bool ok;
+    char error[256];
+    SDL_AudioSpec spec;
+    Uint64 frames;
+    Uint64 open_ns;
+    Uint64 decode_ns;
+    Uint64 seek_ns;
+    bool can_seek;
+    Uint64 decode_all_ns;
+    Uint64 peak_bytes;
+    Uint64 allocs;
+    bool decoder_allocs;  /* SDL_sound counted its decoder's allocations. */
+    Uint64 decoder_open_allocs;
+    Uint64 decoder_open_bytes;
+    double allocs_per_read;
+    Uint64 decoder_steady_bytes;
+    Uint64 decoder_peak_bytes;
+    double calibration;  /* ns per calibration step, measured alongside. */
+} BenchResult;
+
+typedef struct
+{
+    const BenchAsset *asset;
+    const BenchOutput *output;
+    BenchResult result;
+} BenchRecord;
+
+
+static bool decoder_available(const char *ext)
+{
+    const Sound_DecoderInfo **i;
+    const char **e;
+
+    for (i = Sound_AvailableDecoders(); (i != NULL) && (*i != NULL); i++)
+    {
+        for (e = (*i)->extensions; *e != NULL; e++)
+        {
+            if (SDL_strcasecmp(*e, ext) == 0)
+                return true;
+        } /* for */
+    } /* for */
+
+    return false;
+} /* decoder_available */
+
+
+static const char *format_name(SDL_AudioFormat fmt)
+{
+    switch (fmt)
+    {
+        case SDL_AUDIO_U8: return "U8";
+        case SDL_AUDIO_S8: return "S8";
+        case SDL_AUDIO_S16LE: return "S16LE";
+        case SDL_AUDIO_S16BE: return "S16BE";
+        case SDL_AUDIO_S32LE: return "S32LE";
+        case SDL_AUDIO_S32BE: return "S32BE";
+        case SDL_AUDIO_F32LE: return "F32LE";
+        case SDL_AUDIO_F32BE: return "F32BE";
+        default: break;
+    } /* switch */
+    return "UNKNOWN";
+} /* format_name */
+
+
+static void set_error(BenchResult *result, const char *what)
+{
+    const char *err = Sound_GetError();
+    SDL_snprintf(result->error, sizeof (result->error), "%s: %s", what, err ? err : "unknown error");
+    result->ok = false;
+} /* set_error */
+
+
+/*
+ * Calibration: a fixed chunk of integer work that never touches SDL_sound.
+ *  Baseline times are stored in units of "one step of this loop", which
+ *  takes most of the CPU's speed out of the numbers. It's rerun next to
+ *  every measurement, so clock speed changes during a run mostly cancel.
+ */
+
+#define CALIBRATION_WORDS 4096
+#define CALIBRATION_PASSES 64
+
+static Uint32 calibration_data[CALIBRATION_WORDS];
+
+static double calibrate(int runs)
+{
+    Uint64 best = 0;
+    int run, pass, i;
+
+    for (run = 0; run < runs; run++)
+    {
+        const Uint64 start = SDL_GetTicksNS();
+        Uint32 x = 0x12345678;
+        Uint64 elapsed;
+
+        for (pass = 0; pass < CALIBRATION_PASSES; pass++)
+        {
+            for (i = 0; i < CALIBRATION_WORDS; i++)
+            {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                calibration_data[i] += x;
+            } /* for */
+        } /* for */
+
+        elapsed = SDL_GetTicksNS() - start;
+        if ((run == 0) || (elapsed < best))
+            best = elapsed;
+    } /* for */
+
+    return ((double) SDL_max(best, 1)) / (CALIBRATION_WORDS * CALIBRATION_PASSES);
+} /* calibrate */
+
+
+/* One open/decode/seek/free cycle. */
+static void run_once(const BenchAsset *asset, const BenchOutput *output,
+                     Uint32 buffer_size, BenchResult *result)
+{
+    SDL_AudioSpec desired;
+    const SDL_AudioSpec *want = NULL;
+    Sound_AllocStats allocstats;
+    Sound_SampleStats stats;
+    Sound_Sample *sample;
+    SDL_IOStream *io;
+    Uint64 baseline;
+    Uint64 bytes = 0;
+    Uint64 start;
+    Uint32 frame_size;
+    Sint32 duration;
+    size_t i;
+
+    SDL_zerop(result);
+    result->ok = true;
+
+    if (SDL_strcmp(asset->ext, "RAW") == 0)
+        want = &raw_spec;
+    else if (output->format != SDL_AUDIO_UNKNOWN)
+    {
+        desired.format = output->format;
+        desired.channels = 0;
+        desired.freq = output->freq;
+        want = &desired;
+    } /* else if */
+
+    /* the stream is SDL's allocation, not the decoder's, so keep it out. */
+    io = SDL_IOFromConstMem(asset->data, asset->len);
+    if (io == NULL)
+    {
+        SDL_snprintf(result->error, sizeof (result->error), "io: %s", SDL_GetError());
+        result->ok = false;
+        return;
+    } /* if */
+
+    baseline = alloc_window_start();
+
+    start = SDL_GetTicksNS();
+    sample = Sound_NewSample(io, asset->ext, want, buffer_size);
+    result->open_ns = SDL_GetTicksNS() - start;
+
+    if (sample == NULL)
+    {
+        set_error(result, "open");
+        return;
+    } /* if */
+
+    SDL_copyp(&result->spec, &sample->desired);
+    frame_size = SDL_AUDIO_FRAMESIZE(sample->desired);
+
+    /* only a library built to count them fills in the decoder's allocations. */
+    result->decoder_allocs = Sound_GetAllocStats(&allocstats) && Sound_GetSampleStats(sample, &stats);
+    if (result->decoder_allocs)
+    {
+        result->decoder_open_allocs = stats.open_allocs;
+        result->decoder_open_bytes = stats.open_alloc_bytes;
+    } /* if */
+
+    start = SDL_GetTicksNS();
+    while ((sample->flags & (SOUND_SAMPLEFLAG_EOF | SOUND_SAMPLEFLAG_ERROR)) == 0)
+        bytes += Sound_Decode(sample);
+    result->decode_ns = SDL_GetTicksNS() - start;
+    result->frames = bytes / frame_size;
+
+    if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+        set_error(result, "decode");
+
+    if (result->decoder_allocs && Sound_GetSampleStats(sample, &stats))
+    {
+        result->allocs_per_read = stats.decoder_reads ? (((double) stats.read_allocs) / stats.decoder_reads) : 0.0;
+        result->decoder_steady_bytes = stats.decoder_bytes;
+    } /* if */
+
+    result->can_seek = ((sample->flags & SOUND_SAMPLEFLAG_CANSEEK) != 0);
+    if (result->ok && result->can_seek)
+    {
+        duration = Sound_GetDuration(sample);
+        if (duration < 0)
+            duration = (Sint32) ((result->frames * 1000) / sample->desired.freq);
+
+        start = SDL_GetTicksNS();
+        for (i = 0; i < SDL_arraysize(seek_points); i++)
+        {
+            if (!Sound_Seek(sample, (Uint32) (duration * seek_points[i])))
+            {
+                set_error(result, "seek");
+                break;
+            } /* if */
+            Sound_Decode(sample);
+        } /* for */
+        result->seek_ns = (SDL_GetTicksNS() - start) / SDL_arraysize(seek_points);
+    } /* if */
+
+    if (result->ok)
+    {
+        start = SDL_GetTicksNS();
+        if (!Sound_Rewind(sample))
+            set_error(result, "rewind");
+        else
+        {
+            Sound_DecodeAll(sample);
+            if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+                set_error(result, "decode all");
+        } /* else */
+        result->decode_all_ns = SDL_GetTicksNS() - start;
+    } /* if */
+
+    if (result->decoder_allocs && Sound_GetSampleStats(sample, &stats))
+        result->decoder_peak_bytes = stats.decoder_peak_bytes;
+
+    Sound_FreeSample(sample);
+
+    SDL_LockSpinlock(&alloc_lock);
+    result->peak_bytes = alloc_peak - baseline;
+    result->allocs = alloc_calls;
+    SDL_UnlockSpinlock(&alloc_lock);
+} /* run_once */
+
+
+static void run_bench(const BenchAsset *asset, const BenchOutput *output,
+                      Uint32 buffer_size, int iterations, BenchResult *best)
+{
+    BenchResult result;
+    int i;
+
+    run_once(asset, output, buffer_size, best);  /* warm-up, thrown away. */
+    if (best->ok)
+    {
+        const double calibration = calibrate(3);
+        run_once(asset, output, buffer_size, best);
+        best->calibration = calibration;
+    } /* if */
+
+    for (i = 1; best->ok && (i < iterations); i++)
+    {
+        const double calibration = calibrate(3);
+        run_once(asset, output, buffer_size, &result);
+        if (!result.ok)
+        {
+            SDL_copyp(best, &result);
+            break;
+        } /* if */
+
+        best->open_ns = SDL_min(best->open_ns, result.open_ns);
+        best->decode_ns = SDL_min(best->decode_ns, result.decode_ns);
+        best->seek_ns = SDL_min(best->seek_ns, result.seek_ns);
+        best->decode_all_ns = SDL_min(best->decode_all_ns, result.decode_all_ns);
+        best->peak_bytes = SDL_max(best->peak_bytes, result.peak_bytes);
+        best->allocs = SDL_max(best->allocs, result.allocs);
+        best->decoder_open_allocs = SDL_max(best->decoder_open_allocs, result.decoder_open_allocs);
+        best->decoder_open_bytes = SDL_max(best->decoder_open_bytes, result.decoder_open_bytes);
+        best->allocs_per_read = SDL_max(best->allocs_per_read, result.allocs_per_read);
+        best->decoder_steady_bytes = SDL_max(best->decoder_steady_bytes, result.decoder_steady_bytes);
+        best->decoder_peak_bytes = SDL_max(best->decoder_peak_bytes, result.decoder_peak_bytes);
+        best->calibration = SDL_min(best->calibration, calibration);
+    } /* for */
+} /* run_bench */
+
+
+static void json_string(FILE *io, const char *str)
+{
+    fputc('"', io);
+    for (; *str; str++)
+    {
+        const unsigned char ch = (unsigned char) *str;
+        if ((ch == '"') || (ch == '\\'))
+            fprintf(io, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(io, "\\u%04x", ch);
+        else
+            fputc(ch, io);
+    } /* for */
+    fputc('"', io);
+} /* json_string */
+
+
+static void json_result(FILE *io, const BenchAsset *asset,
+                        const BenchOutput *output, const BenchResult *result,
+                        bool first)
+{
+    fprintf(io, "%s\n    { \"decoder\": ", first ? "" : ",");
+    json_string(io, asset->ext);
+    fprintf(io, ", \"asset\": ");
+    json_string(io, asset->name);
+    fprintf(io, ", \"output\": ");
+    json_string(io, output->name);
+
+    if (!result->ok)
+    {
+        fprintf(io, ", \"error\": ");
+        json_string(io, result->error);
+        fprintf(io, " }");
+        return;
+    } /* if */
+
+    fprintf(io, ",\n      \"format\": \"%s\", \"channels\": %d, \"rate\": %d, \"frames\": %llu,\n",
+            format_name(result->spec.format), result->spec.channels,
+            result->spec.freq, (unsigned long long) result->frames);
+    fprintf(io, "      \"open_ns\": %llu, \"decode_ns\": %llu, \"frames_per_sec\": %.0f, \"ns_per_frame\": %.3f,\n",
+            (unsigned long long) result->open_ns,
+            (unsigned long long) result->decode_ns,
+            result->decode_ns ? (((double) result->frames) * 1e9 / result->decode_ns) : 0.0,
+            result->frames ? (((double) result->decode_ns) / result->frames) : 0.0);
+    if (result->can_seek)
+        fprintf(io, "      \"seek_ns\": %llu,", (unsigned long long) result->seek_ns);
+    else
+        fprintf(io, "      \"seek_ns\": null,");
+    fprintf(io, " \"decode_all_ns\": %llu,", (unsigned long long) result->decode_all_ns);
+    fprintf(io, " \"peak_alloc_bytes\": %llu, \"alloc_count\": %llu,\n",
+            (unsigned long long) result->peak_bytes,
+            (unsigned long long) result->allocs);
+    if (result->decoder_allocs)
+    {
+        fprintf(io, "      \"decoder_open_allocs\": %llu, \"decoder_open_bytes\": %llu, \"allocs_per_read\": %.3f,\n",
+                (unsigned long long) result->decoder_open_allocs,
+                (unsigned long long) result->decoder_open_bytes,
+                result->allocs_per_read);
+        fprintf(io, "      \"decoder_steady_bytes\": %llu, \"decoder_peak_bytes\": %llu,\n",
+                (unsigned long long) result->decoder_steady_bytes,
+                (unsigned long long) result->decoder_peak_bytes);
+    } /* if */
+    else
+    {
+        fprintf(io, "      \"decoder_open_allocs\": null, \"decoder_open_bytes\": null, \"allocs_per_read\": null,\n");
+        fprintf(io, "      \"decoder_steady_bytes\": null, \"decoder_peak_bytes\": null,\n");
+    } /* else */
+    fprintf(io, "      \"calibration_ns_per_step\": %.4f }", result->calibration);
+} /* json_result */
+
+
+static bool prepare_asset(BenchAsset *asset, const char *dir, Uint32 frames)
+{
+    if (asset->generate != NULL)
+    {
+        BenchBuffer buf;
+        SDL_zero(buf);
+        if (!asset->generate(&buf, frames))
+        {
+            SDL_free(buf.data);
+            return false;
+        } /* if */
+        asset->data = buf.data;
+        asset->len = buf.len;
+    } /* if */
+    else
+    {
+        char path[1024];
+        SDL_snprintf(path, sizeof (path), "%s/%s", dir, asset->fixture);
+        asset->data = (Uint8 *) SDL_LoadFile(path, &asset->len);
+        if (asset->data == NULL)
+            return false;
+    } /* else */
+
+    return true;
+} /* prepare_asset */
+
+
+
+/*
+ * Baselines are plain text, one "asset output metric value" per line, so
+ *  they diff nicely in review. Metrics:
+ *
+ *   decode      Sound_Decode() time per output frame, in calibration steps.
+ *   decode_all  Sound_DecodeAll() time per output frame, likewise.
+ *   seek        Time to first audio after a seek, likewise.
+ *   allocs      alloc_count; any growth fails.
+ *   peak_bytes  peak_alloc_bytes; growth past BASELINE_PEAK_SLACK fails.
+ */
+
+static const char *baseline_metrics[] = {
+    "decode", "decode_all", "seek", "allocs", "peak_bytes"
+};
+
+/* (ns) is the raw time behind a time metric, zero for the others. */
+static bool get_metric(const BenchResult *result, const char *metric,
+                       double *value, Uint64 *ns)
+{
+    const double frames = (double) SDL_max(result->frames, 1);
+    const double calibration = result->calibration;
+
+    *ns = 0;
+    if (SDL_strcmp(metric, "decode") == 0)
+    {
+        *ns = result->decode_ns;
+        *value = (result->decode_ns / frames) / calibration;
+    } /* if */
+    else if (SDL_strcmp(metric, "decode_all") == 0)
+    {
+        *ns = result->decode_all_ns;
+        *value = (result->decode_all_ns / frames) / calibration;
+    } /* else if */
+    else if (SDL_strcmp(metric, "seek") == 0)
+    {
+        if (!result->can_seek)
+            return false;
+        *ns = result->seek_ns;
+        *value = result->seek_ns / calibration;
+    } /* else if */
+    else if (SDL_strcmp(metric, "allocs") == 0)
+        *value = (double) result->allocs;
+    else if (SDL_strcmp(metric, "peak_bytes") == 0)
+        *value = (double) result->peak_bytes;
+    else
+        return false;
+
+    return true;
+} /* get_metric */
+
+
+static bool write_baseline(const char *path, const BenchRecord *records,
+                           size_t count, double calibration, int seconds,
+                           Uint32 buffer_size)
+{
+    FILE *io = fopen(path, "w");
+    size_t i, j;
+
+    if (io == NULL)
+    {
+        fprintf(stderr, "couldn't open \"%s\" for writing.\n", path);
+        return false;
+    } /* if */
+
+    fprintf(io, "# sdlsound-bench baseline; regenerate with --write-baseline.\n");
+    fprintf(io, "# Made with --seconds %d --buffer %u; check with the same settings.\n", seconds, (unsigned int) buffer_size);
+    fprintf(io, "# Times are in calibration steps (this run: %.4f ns/step).\n", calibration);
+    fprintf(io, "# asset output metric value\n");
+
+    for (i = 0; i < count; i++)
+    {
+        const BenchRecord *rec = &records[i];
+        if (!rec->result.ok || !rec->output->baseline)
+            continue;
+
+        for (j = 0; j < SDL_arraysize(baseline_metrics); j++)
+        {
+            double value;
+            Uint64 ns;
+            if (get_metric(&rec->result, baseline_metrics[j], &value, &ns))
+                fprintf(io, "%s %s %s %.6g\n", rec->asset->name, rec->output->name, baseline_metrics[j], value);
+        } /* for */
+    } /* for */
+
+    fclose(io);
+    return true;
+} /* write_baseline */
+
+
+typedef struct
+{
+    char asset[64];
+    char output[64];
+    char metric[64];
+    double value;
+} BaselineEntry;
+
+typedef struct
+{
+    BaselineEntry *entries;
+    size_t count;
+} Baseline;
+
+static bool load_baseline(const char *path, Baseline *baseline)
+{
+    FILE *io = fopen(path, "r");
+    char line[256];
+    int lineno = 0;
+    bool retval = true;
+
+    SDL_zerop(baseline);
+    if (io == NULL)
+    {
+        fprintf(stderr, "couldn't open baseline \"%s\".\n", path);
+        return false;
+    } /* if */
+
+    while (fgets(line, sizeof (line), io) != NULL)
+    {
+        BaselineEntry entry;
+        void *ptr;
+
+        lineno++;
+        if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r'))
+            continue;
+        else if (sscanf(line, "%63s %63s %63s %lf", entry.asset, entry.output, entry.metric, &entry.value) != 4)
+        {
+            fprintf(stderr, "%s:%d: can't parse this line.\n", path, lineno);
+            retval = false;
+            break;
+        } /* else if */
+
+        ptr = SDL_realloc(baseline->entries, (baseline->count + 1) * sizeof (BaselineEntry));
+        if (ptr == NULL)
+        {
+            fprintf(stderr, "out of memory loading the baseline.\n");
+            retval = false;
+            break;
+        } /* if */
+
+        baseline->entries = (BaselineEntry *) ptr;
+        SDL_copyp(&baseline->entries[baseline->count++], &entry);
+    } /* while */
+
+    fclose(io);
+    return retval;
+} /* load_baseline */
+
+
+/*
+ * Check one run against the baseline. Returns the number of regressions,
+ *  and prints what it found if (report) is set. Entries for things that
+ *  weren't run (decoder not built, --decoder, ...) are left alone.
+ */
+static int check_record(const BenchRecord *rec, const Baseline *baseline,
+                        int tolerance, int *checked, bool report)
+{
+    const char *asset = rec->asset->name;
+    const char *output = rec->output->name;
+    int failures = 0;
+    size_t i;
+
+    for (i = 0; i < baseline->count; i++)
+    {
+        const BaselineEntry *entry = &baseline->entries[i];
+        const char *metric = entry->metric;
+        const double base = entry->value;
+        double value;
+        Uint64 ns;
+
+        if ((SDL_strcmp(entry->asset, asset) != 0) || (SDL_strcmp(entry->output, output) != 0))
+            continue;
+        else if (!rec->result.ok)
+        {
+            if (report)
+                fprintf(stderr, "FAIL %s %s: %s\n", asset, output, rec->result.error);
+            return failures + 1;
+        } /* else if */
+        else if (!get_metric(&rec->result, metric, &value, &ns))
+        {
+            if (report)
+                fprintf(stderr, "FAIL %s %s %s: not measured anymore.\n", asset, output, metric);
+            failures++;
+            continue;
+        } /* else if */
+
+        if (checked)
+            (*checked)++;
+
+        if (SDL_strcmp(metric, "allocs") == 0)
+        {
+            if (value > base)
+            {
+                if (report)
+                    fprintf(stderr, "FAIL %s %s: allocation count grew from %.0f to %.0f.\n", asset, output, base, value);
+                failures++;
+            } /* if */
+        } /* if */
+        else if (SDL_strcmp(metric, "peak_bytes") == 0)
+        {
+            if (value > (base * (100 + BASELINE_PEAK_SLACK) / 100.0))
+            {
+                if (report)
+                    fprintf(stderr, "FAIL %s %s: peak footprint grew from %.0f to %.0f bytes.\n", asset, output, base, value);
+                failures++;
+            } /* if */
+        } /* else if */
+        else if (value > (base * (100 + tolerance) / 100.0))
+        {
+            if (ns < BASELINE_NOISE_FLOOR_NS)
+            {
+                if (report)
+                    fprintf(stderr, "note %s %s %s: %.1f%% slower, but too short to judge.\n", asset, output, metric, ((value / base) - 1.0) * 100.0);
+            } /* if */
+            else
+            {
+                if (report)
+                    fprintf(stderr, "FAIL %s %s %s: %.1f%% slower (%.4g -> %.4g).\n", asset, output, metric, ((value / base) - 1.0) * 100.0, base, value);
+                failures++;
+            } /* else */
+        } /* else if */
+        else if (report && ((value * (100 + tolerance) / 100.0) < base))
+            fprintf(stderr, "note %s %s %s: %.1f%% faster; consider updating the baseline.\n", asset, output, metric, (1.0 - (value / base)) * 100.0);
+    } /* for */
+
+    return failures;
+} /* check_record */
+
+
+static void output_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "USAGE: %s [...options...]\n"
+        "\n"
+        "   Options:\n"
+        "     --iterations n  Runs per asset and output format; best is kept (default 5).\n"
+        "     --seconds n     Length of the synthesized assets (default 10).\n"
+        "     --buffer n      Sound_Sample buffer size in bytes (default 16384).\n"
+        "     --assets dir    Where the compressed fixtures live\n"
+        "                      (default \"%s\").\n"
+        "     --decoder ext   Only run assets for this decoder (\"MP3\", \"WAV\", ...).\n"
+        "     --output file   Write the JSON report here instead of stdout.\n"
+        "     --baseline file Compare against this baseline; exit nonzero on regressions.\n"
+        "     --tolerance n   Percent slower allowed by --baseline (default 25).\n"
+        "     --write-baseline file  Write this run out as a new baseline.\n"
+        "     --help          Display this information and exit.\n"
+        "\n",
+        argv0, SDLSOUND_BENCH_ASSETS);
+} /* output_usage */
+
+
+int main(int argc, char **argv)
+{
+    const char *assets_dir = SDLSOUND_BENCH_ASSETS;
+    const char *only_decoder = NULL;
+    const char *output_path = NULL;
+    const char *baseline_path = NULL;
+    const char *write_baseline_path = NULL;
+    int iterations = 5;
+    int seconds = 10;
+    int tolerance = 25;
+    Uint32 buffer_size = 16384;
+    FILE *io = stdout;
+    BenchRecord records[SDL_arraysize(assets) * SDL_arraysize(outputs)];
+    size_t num_records = 0;
+    double calibration;
+    Baseline baseline;
+    int failures = 0;
+    int checked = 0;
+    int version;
+    size_t i, j;
+    int k;
+
+    /* must happen before anything allocates through SDL. */
+    SDL_GetOriginalMemoryFunctions(&real_malloc, &real_calloc, &real_realloc, &real_free);
+    SDL_SetMemoryFunctions(bench_malloc, bench_calloc, bench_realloc, bench_free);
+
+    for (i = 1; i < (size_t) argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = ((i + 1) < (size_t) argc) ? argv[i + 1] : NULL;
+
+        if (SDL_strcmp(arg, "--help") == 0)
+        {
+            output_usage(argv[0]);
+            return 0;
+        } /* if */
+        else if (val == NULL)
+        {
+            fprintf(stderr, "unknown option or missing argument: \"%s\"\n", arg);
+            output_usage(argv[0]);
+            return 1;
+        } /* else if */
+        else if (SDL_strcmp(arg, "--iterations") == 0)
+            iterations = atoi(val);
+        else if (SDL_strcmp(arg, "--seconds") == 0)
+            seconds = atoi(val);
+        else if (SDL_strcmp(arg, "--buffer") == 0)
+            buffer_size = (Uint32) strtoul(val, NULL, 10);
+        else if (SDL_strcmp(arg, "--assets") == 0)
+            assets_dir = val;
+        else if (SDL_strcmp(arg, "--decoder") == 0)
+            only_decoder = val;
+        else if (SDL_strcmp(arg, "--output") == 0)
+            output_path = val;
+        else if (SDL_strcmp(arg, "--baseline") == 0)
+            baseline_path = val;
+        else if (SDL_strcmp(arg, "--tolerance") == 0)
+            tolerance = atoi(val);
+        else if (SDL_strcmp(arg, "--write-baseline") == 0)
+            write_baseline_path = val;
+        else
+        {
+            fprintf(stderr, "unknown option: \"%s\"\n", arg);
+            output_usage(argv[0]);
+            return 1;
+        } /* else */
+        i++;  /* skip the argument. */
+    } /* for */
+
+    if ((iterations < 1) || (seconds < 1) || (tolerance < 0) || (buffer_size < 1024))
+    {
+        fprintf(stderr, "iterations and seconds must be positive, tolerance not negative, buffer at least 1024.\n");
+        return 1;
+    } /* if */
+
+    SDL_zero(baseline);
+
+    if (!SDL_Init(0))
+    {
+        fprintf(stderr, "SDL_Init() failed: %s\n", SDL_GetError());
+        return 1;
+    } /* if */
+
+    if (!Sound_Init())
+    {
+        fprintf(stderr, "Sound_Init() failed: %s\n", Sound_GetError());
+        SDL_Quit();
+        return 1;
+    } /* if */
+
+    if ((baseline_path != NULL) && (!load_baseline(baseline_path, &baseline)))
+    {
+        SDL_free(baseline.entries);
+        Sound_Quit();
+        SDL_Quit();
+        return 1;
+    } /* if */
+
+    if (output_path != NULL)
+    {
+        io = fopen(output_path, "w");
+        if (io == NULL)
+        {
+            fprintf(stderr, "couldn't open \"%s\" for writing.\n", output_path);
+            SDL_free(baseline.entries);
+            Sound_Quit();
+            SDL_Quit();
+            return 1;
+        } /* if */
+    } /* if */
+
+    calibration = calibrate(9);
+
+    version = Sound_Version();
+    fprintf(io, "{\n  \"benchmark\": \"sdlsound-bench\",\n");
+    fprintf(io, "  \"sdl_sound_version\": \"%d.%d.%d\",\n",
+            SDL_VERSIONNUM_MAJOR(version), SDL_VERSIONNUM_MINOR(version),
+            SDL_VERSIONNUM_MICRO(version));
+    fprintf(io, "  \"iterations\": %d, \"seconds\": %d, \"buffer_size\": %u,\n",
+            iterations, seconds, (unsigned int) buffer_size);
+    fprintf(io, "  \"calibration_ns_per_step\": %.4f,\n", calibration);
+    fprintf(io, "  \"results\": [");
+
+    for (i = 0; i < SDL_arraysize(assets); i++)
+    {
+        BenchAsset *asset = &assets[i];
+
+        if ((only_decoder != NULL) && (SDL_strcasecmp(only_decoder, asset->ext) != 0))
+            continue;
+        else if (!decoder_available(asset->ext))
+        {
+            fprintf(stderr, "%s: no %s decoder in this build, skipping.\n", asset->name, asset->ext);
+            continue;
+        } /* else if */
+        else if (!prepare_asset(asset, assets_dir, (Uint32) seconds * BENCH_RATE))
+        {
+            fprintf(stderr, "%s: couldn't prepare asset: %s\n", asset->name, SDL_GetError());
+            continue;
+        } /* else if */
+
+        for (j = 0; j < SDL_arraysize(outputs); j++)
+        {
+            BenchRecord *rec = &records[num_records];
+
+            /* RAW output is whatever we tell it the input is. */
+            if ((j > 0) && (SDL_strcmp(asset->ext, "RAW") == 0))
+                break;
+
+            fprintf(stderr, "%s -> %s...\n", asset->name, outputs[j].name);
+            rec->asset = asset;
+            rec->output = &outputs[j];
+            run_bench(asset, &outputs[j], buffer_size, iterations, &rec->result);
+
+            /* don't fail the gate over one noisy measurement. */
+            for (k = 0; k < BASELINE_RETRIES; k++)
+            {
+                const int failed = check_record(rec, &baseline, tolerance, NULL, false);
+                BenchResult again;
+                if ((failed == 0) || !rec->result.ok)
+                    break;
+                fprintf(stderr, "%s -> %s looks slower, measuring again...\n", asset->name, outputs[j].name);
+                run_bench(asset, &outputs[j], buffer_size, iterations, &again);
+                if (again.ok)
+                {
+                    const BenchRecord retry = { asset, &outputs[j], again };
+                    if (check_record(&retry, &baseline, tolerance, NULL, false) < failed)
+                        SDL_copyp(&rec->result, &again);
+                } /* if */
+            } /* for */
+
+            json_result(io, asset, &outputs[j], &rec->result, num_records == 0);
+            num_records++;
+        } /* for */
+
+        SDL_free(asset->data);
+        asset->data = NULL;
+    } /* for */
+
+    fprintf(io, "\n  ]\n}\n");
+
+    if (io != stdout)
+        fclose(io);
+
+    if ((write_baseline_path != NULL) && (!write_baseline(write_baseline_path, records, num_records, calibration, seconds, buffer_size)))
+        failures++;
+
+    if (baseline_path != NULL)
+    {
+        for (i = 0; i < num_records; i++)
+            failures += check_record(&records[i], &baseline, tolerance, &checked, true);
+        fprintf(stderr, "baseline: %d checks, %d failed (tolerance %d%%).\n", checked, failures, tolerance);
+        SDL_free(baseline.entries);
+    } /* if */
+
+    Sound_Quit();
+    SDL_Quit();
+    return (failures > 0) ? 1 : 0;
+} /* main */
+
+/* end of sdlsound_bench.c ... */
+
@@ -193,6 +193,64 @@ typedef struct Sound_Sample
 } Sound_Sample;
 
 
+/**
+ * Counters describing where a Sound_Sample has been spending its time.
+ *
+ * Fill one of these in with Sound_GetSampleStats(). The counters start at
+ * zero when the sample is created and only ever go up, so to measure a
+ * stretch of playback, take a snapshot before and after and subtract.
+ *
+ * The time spent in the decoder includes the time it spent waiting on the
+ * SDL_IOStream, so if `io_ns` is most of `decode_ns`, the sample is I/O
+ * bound; if `decode_ns` dominates, it's decode bound, and if `convert_ns`
+ * does, it's spending its time converting to the `desired` format.
+ *
+ * \since This struct is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_GetSampleStats
+ */
+typedef struct Sound_SampleStats
+{
+    Uint64 io_bytes_read;   /**< Bytes read from the sample's SDL_IOStream. */
+    Uint64 io_read_calls;   /**< Number of reads from the SDL_IOStream. */
+    Uint64 io_ns;           /**< Nanoseconds spent reading the SDL_IOStream. */
+    Uint64 decoder_reads;   /**< Times the decoder was asked for more audio. */
+    Uint64 frames_decoded;  /**< Sample frames decoded, in `actual` format. */
+    Uint64 decode_ns;       /**< Nanoseconds spent decoding, including I/O. */
+    Uint64 convert_ns;      /**< Nanoseconds spent converting to `desired`. */
+    Uint64 seeks;           /**< Seeks and rewinds handed to the decoder. */
+    Uint64 seek_ns;         /**< Nanoseconds spent on all of those seeks. */
+    Uint64 seek_max_ns;     /**< Nanoseconds taken by the slowest one. */
+    Uint64 open_allocs;     /**< Allocations the decoder made while opening. */
+    Uint64 open_alloc_bytes; /**< Bytes the decoder allocated while opening. */
+    Uint64 read_allocs;     /**< Allocations made while asked for more audio. */
+    Uint64 read_alloc_bytes; /**< Bytes allocated while asked for more audio. */
+    Uint64 decoder_bytes;   /**< Bytes the decoder is holding right now. */
+    Uint64 decoder_peak_bytes; /**< The most it has ever held at once. */
+} Sound_SampleStats;
+
+
+/**
+ * Counts of every allocation SDL_sound has made.
+ *
+ * Fill one of these in with Sound_GetAllocStats(). This covers SDL_sound
+ * itself, its decoders and the libraries they're built on, but not memory
+ * SDL allocates on SDL_sound's behalf (an SDL_AudioStream's, say).
+ *
+ * \since This struct is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_GetAllocStats
+ */
+typedef struct Sound_AllocStats
+{
+    Uint64 allocations;       /**< Successful allocations and reallocations. */
+    Uint64 bytes_allocated;   /**< Bytes asked for by all of those. */
+    Uint64 frees;             /**< Blocks handed back. */
+    Uint64 bytes_in_use;      /**< Bytes allocated and not yet freed. */
+    Uint64 peak_bytes_in_use; /**< The highest (bytes_in_use) has been. */
+} Sound_AllocStats;
+
+
 
 /* functions and macros... */
 
@@ -342,6 +400,19 @@ extern SDL_DECLSPEC void SDLCALL Sound_ClearError(void);
  * incoming format of the data, preconversion, can be found in the
  * Sound_Sample structure.
  *
+ * Some decoders can produce more than one format themselves (FLAC, MP3 and
+ * Ogg Vorbis can all give SDL_AUDIO_S16 or SDL_AUDIO_F32, as can 24-bit WAV
+ * files), and will pick the desired one if they can, so only the channels
+ * and sample rate might still need converting. Sound_SetDesiredFormat()
+ * doesn't change the format a decoder already picked.
+ *
+ * When only the format and the channels change (between mono and stereo),
+ * and the sample rate stays the same, the common cases (SDL_AUDIO_S32,
+ * SDL_AUDIO_F32 or SDL_AUDIO_U8 to SDL_AUDIO_S16, and SDL_AUDIO_S16 or
+ * SDL_AUDIO_U8 to SDL_AUDIO_F32, in either byte order) are converted in
+ * place, with SIMD code where the CPU has it. Everything else goes through
+ * an SDL_AudioStream.
+ *
  * Note that the raw sound data "decoder" needs you to specify both the
  * extension "RAW" and a "desired" format, or it will refuse to handle the
  * data. This is to prevent it from catching all formats unsupported by the
@@ -354,6 +425,11 @@ extern SDL_DECLSPEC void SDLCALL Sound_ClearError(void);
  * take. Note that different data formats require more or less space to store.
  * This buffer can be resized later via Sound_SetBufferSize().
  *
+ * A buffer size of zero is allowed, in which case no decoding buffer is
+ * allocated at all, and the app must decode with Sound_DecodeInto(), which
+ * writes into memory the app supplies. Sound_Decode() will fail on such a
+ * sample until a buffer is allocated with Sound_SetBufferSize().
+ *
  * The buffer size specified must be a multiple of the size of a single sample
  * frame. So, if you want 16-bit, stereo samples, then your sample frame size
  * is (2 channels * 16 bits), or 32 bits per frame, which is four bytes. In
@@ -405,6 +481,10 @@ extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSample(SDL_IOStream *io,
  * This is identical to Sound_NewSample(), but it creates an SDL_IOStream for
  * you from the `size` bytes of memory referenced by `data`.
  *
+ * If Sound_SetCacheSize() has enabled the decoded audio cache, the same
+ * bytes opened again with the same `desired` format are read from the cache
+ * instead of being decoded again.
+ *
  * \param data Buffer of data holding contents of an audio file to decode.
  * \param size Size, in bytes, of buffer pointed to by (data).
  * \param ext File extension normally associated with a data format. Can
@@ -424,6 +504,7 @@ extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSample(SDL_IOStream *io,
  *
  * \sa Sound_NewSample
  * \sa Sound_SetBufferSize
+ * \sa Sound_SetCacheSize
  * \sa Sound_Decode
  * \sa Sound_DecodeAll
  * \sa Sound_Seek
@@ -448,6 +529,15 @@ extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSampleFromMem(const Uint8 *d
  * Sound_NewSample()'s "ext" parameter is gleaned from the contents of
  * `filename`.
  *
+ * If Sound_SetCacheSize() has enabled the decoded audio cache, the same file
+ * opened again with the same `desired` format is read from the cache instead
+ * of being decoded again.
+ *
+ * On Linux, larger files are mapped into memory instead of being read
+ * through SDL_IOFromFile(), which makes decoders that seek around a lot, or
+ * need the whole file at once, cheaper. Don't truncate a file while a sample
+ * is decoding it.
+ *
  * \param filename file containing sound data.
  * \param desired Format to convert sound data into. Can usually be NULL, if
  *                you don't need conversion.
@@ -464,6 +554,7 @@ extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSampleFromMem(const Uint8 *d
  *
  * \sa Sound_NewSample
  * \sa Sound_SetBufferSize
+ * \sa Sound_SetCacheSize
  * \sa Sound_Decode
  * \sa Sound_DecodeAll
  * \sa Sound_Seek
@@ -474,6 +565,105 @@ extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSampleFromFile(const char *f
                                                       const SDL_AudioSpec *desired,
                                                       Uint32 bufferSize);
 
+/**
+ * Start decoding a new sound sample from data you hand over as it arrives.
+ *
+ * This is for audio that shows up a piece at a time, like off a network
+ * socket, when you'd rather not wrap it in an SDL_IOStream of your own.
+ * Feed the data to the new sample with Sound_PushData(), in pieces of any
+ * size, and call Sound_PushEnd() after the last one.
+ *
+ * The format isn't known until enough data has been pushed to figure it out,
+ * so until then `sample->decoder` is NULL, `sample->actual` is zeroed, and
+ * Sound_Decode() returns zero and sets SOUND_SAMPLEFLAG_EAGAIN. After that,
+ * Sound_Decode() decodes what has been pushed so far, and when it catches
+ * up, it returns what it has and sets SOUND_SAMPLEFLAG_EAGAIN, until
+ * Sound_PushEnd() is called and it reaches the end as usual.
+ *
+ * MP3, FLAC, Ogg Vorbis, and uncompressed WAV, AIFF, AU and raw data decode
+ * as the data comes in. Other formats (ADPCM WAV files and MOD files, for
+ * example) don't open until Sound_PushEnd(), and some might stop with an
+ * error if they catch up with the data. A FLAC file whose frames are bigger
+ * than its header claims also stops with an error if it catches up, since
+ * that needs a seek back to the start of the frame.
+ *
+ * Pushed data is copied, and let go of once it's decoded, so you can reuse
+ * your buffers right away and the sample doesn't hang on to the whole file.
+ * This also means push samples can't seek or rewind, and
+ * Sound_StartDecodeAhead() and seek indexes don't work with them.
+ *
+ * \param ext File extension normally associated with a data format. Can
+ *            usually be NULL.
+ * \param desired Format to convert sound data into. Can usually be NULL, if
+ *                you don't need conversion.
+ * \param bufferSize size, in bytes, of initial read buffer.
+ * \returns Sound_Sample pointer, which is used as a handle to several other
+ *          SDL_sound APIs. NULL on error. If error, use Sound_GetError() to
+ *          see what went wrong.
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_PushData
+ * \sa Sound_PushEnd
+ * \sa Sound_Decode
+ * \sa Sound_FreeSample
+ */
+extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewPushSample(const char *ext,
+                                                      const SDL_AudioSpec *desired,
+                                                      Uint32 bufferSize);
+
+/**
+ * Hand more data to a sample made by Sound_NewPushSample().
+ *
+ * The `len` bytes at `data` are copied, so you can do what you like with
+ * them after this returns. Once enough data has been pushed to tell what
+ * format it is, `sample->decoder` and `sample->actual` are filled in; if
+ * the data turns out to be something SDL_sound can't decode, this fails and
+ * sets SOUND_SAMPLEFLAG_ERROR.
+ *
+ * \param sample the push sample to feed.
+ * \param data the next piece of the sound data.
+ * \param len size, in bytes, of the buffer pointed to by `data`.
+ * \returns non-zero on success, zero on error. If error, use
+ *          Sound_GetError() to see what went wrong.
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_NewPushSample
+ * \sa Sound_PushEnd
+ * \sa Sound_Decode
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_PushData(Sound_Sample *sample, const void *data, Uint32 len);
+
+/**
+ * Tell a sample made by Sound_NewPushSample() that there's no more data.
+ *
+ * After this, Sound_Decode() stops waiting for more and decodes the rest of
+ * what was pushed, and then sets SOUND_SAMPLEFLAG_EOF. This is also the last
+ * chance to find a decoder for the data; if none will take it, this fails
+ * and sets SOUND_SAMPLEFLAG_ERROR.
+ *
+ * \param sample the push sample that's finished.
+ * \returns non-zero on success, zero on error. If error, use
+ *          Sound_GetError() to see what went wrong.
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_NewPushSample
+ * \sa Sound_PushData
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_PushEnd(Sound_Sample *sample);
+
 /**
  * Dispose of a Sound_Sample.
  *
@@ -495,13 +685,127 @@ extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSampleFromFile(const char *f
  */
 extern SDL_DECLSPEC void SDLCALL Sound_FreeSample(Sound_Sample *sample);
 
+/**
+ * Set limits on SDL_sound's pool of recycled sample memory.
+ *
+ * When a Sound_Sample is freed, SDL_sound keeps its bookkeeping structures
+ * and decoding buffer around, so the next call to Sound_NewSample() can
+ * reuse them instead of going back to the allocator. This helps apps that
+ * create and destroy lots of short-lived samples, like sound effects.
+ *
+ * Decoding buffers are pooled in power-of-two size classes from 4 kilobytes
+ * to 1 megabyte; while pooling is enabled, a requested buffer size in that
+ * range is rounded up to its size class. Larger buffers, and buffers resized
+ * by Sound_DecodeAll(), are allocated exactly and never pooled.
+ *
+ * By default, up to 16 samples and 1 megabyte of buffers are kept. Setting
+ * both limits to zero disables pooling entirely. Changing the limits releases
+ * anything already in the pool, as Sound_TrimPool() does.
+ *
+ * The pool is emptied by Sound_Quit(), but these limits persist.
+ *
+ * \param max_samples maximum number of freed samples to keep for reuse.
+ * \param max_buffer_bytes maximum total bytes of decoding buffers to keep
+ *                         for reuse.
+ * \returns non-zero on success, zero on failure. Specifics of the error can
+ *          be gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_TrimPool
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_SetPoolSize(Uint32 max_samples,
+                                                  Uint32 max_buffer_bytes);
+
+/**
+ * Release all memory held in SDL_sound's pool of recycled sample memory.
+ *
+ * This frees everything that Sound_FreeSample() has put aside for reuse.
+ * Samples that are still in use are not affected. The pool will fill up
+ * again as samples are freed, up to the limits set by Sound_SetPoolSize().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SetPoolSize
+ */
+extern SDL_DECLSPEC void SDLCALL Sound_TrimPool(void);
+
+/**
+ * Set how much decoded audio SDL_sound may cache.
+ *
+ * With a non-zero budget, Sound_NewSampleFromFile() and
+ * Sound_NewSampleFromMem() keep the fully-decoded audio of what they open,
+ * so opening the same file (or the same bytes) again, with the same desired
+ * format, skips decoding entirely and just copies PCM out of memory. This
+ * is meant for short, frequently-replayed sounds, like UI clicks and
+ * gunshots.
+ *
+ * Only samples that can seek and know their total length are cached, and
+ * only if their decoded size fits in the budget; everything else is decoded
+ * on the fly as usual. When the budget is exceeded, the least-recently-used
+ * entries are dropped. Samples still reading from a dropped entry keep it
+ * alive until they are freed. Files are recognized by path, size, and
+ * modification time, so a file that changes on disk is decoded again.
+ * Sound_NewSample() never uses the cache.
+ *
+ * Filling the cache isn't free: on a miss, the whole sample is decoded
+ * right away, inside Sound_NewSampleFromFile() or Sound_NewSampleFromMem(),
+ * before it returns. The budget caps how much audio that can be, so keep
+ * it modest if open latency matters, or open samples you only play once
+ * with Sound_NewSample().
+ *
+ * The budget is zero (no caching) by default. Lowering it drops entries
+ * right away. The cache is emptied by Sound_Quit(), but the budget persists.
+ *
+ * \param max_bytes maximum total bytes of decoded audio to keep, or zero to
+ *                  disable the cache.
+ * \returns non-zero on success, zero on failure. Specifics of the error can
+ *          be gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_FlushCache
+ * \sa Sound_NewSampleFromFile
+ * \sa Sound_NewSampleFromMem
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_SetCacheSize(Uint64 max_bytes);
+
+/**
+ * Drop everything in SDL_sound's decoded audio cache.
+ *
+ * Samples that are currently reading from the cache keep working; their
+ * audio is freed when they are. The budget set by Sound_SetCacheSize() is
+ * not changed.
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SetCacheSize
+ */
+extern SDL_DECLSPEC void SDLCALL Sound_FlushCache(void);
+
 
 /**
  * Retrieve total play time of sample, in milliseconds.
  *
- * Report total time length of sample, in milliseconds. This is a fast call.
- * Duration is calculated during Sound_NewSample*, so this is just an accessor
- * into otherwise opaque data.
+ * Report total time length of sample, in milliseconds. This is usually a
+ * fast call: duration is calculated during Sound_NewSample*, so this is just
+ * an accessor into otherwise opaque data.
+ *
+ * The exception is a format where the only way to know for sure is to go
+ * through the whole file, like an MP3 without a Xing, Info or VBRI header.
+ * Rather than make every Sound_NewSample* pay for that, SDL_sound estimates
+ * the duration when it opens the sample and only works out the real one the
+ * first time this function is called (or, if it gets there first, when
+ * decoding reaches the end). That first call can take as long as reading the
+ * file does; later calls are fast again.
  *
  * Please note that not all formats can determine a total time, some can't be
  * exact without fully decoding the data, and thus will estimate the duration.
@@ -517,13 +821,80 @@ extern SDL_DECLSPEC void SDLCALL Sound_FreeSample(Sound_Sample *sample);
  * \returns Sample length in milliseconds, or -1 if duration can't be
  *          determined for any reason.
  *
- * \threadsafety It is safe to call this function from any thread.
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
  *
  * \since This function is available since SDL_sound 1.0.0.
  */
 extern SDL_DECLSPEC Sint32 SDLCALL Sound_GetDuration(Sound_Sample *sample);
 
 
+/**
+ * Get decoding statistics for a sample.
+ *
+ * This reports how much data a sample has pulled from its SDL_IOStream, how
+ * much audio its decoder has produced, and how long was spent reading,
+ * decoding, converting and seeking to get there. It's meant to tell you why
+ * a stream is slow without attaching a profiler.
+ *
+ * The counters are kept up to date by Sound_Decode(), Sound_DecodeInto(),
+ * Sound_DecodeAll(), Sound_Seek(), Sound_SeekFrame() and Sound_Rewind(),
+ * and include any reading the decoder did while the sample was opened.
+ *
+ * If SDL_sound was built with allocation statistics (see
+ * Sound_GetAllocStats()), the `*_alloc*` and `decoder_*bytes` fields say
+ * how much memory the sample's decoder asked for, while it was opening and
+ * while it was decoding, and how much it's holding on to; this is how to
+ * tell which formats allocate as they play. Otherwise they stay zero.
+ *
+ * Keeping them puts a timer in front of every read from the sample's
+ * SDL_IOStream, so they're only there if SDL_sound was built with them
+ * (`-DSDLSOUND_STATS=ON` in CMake); otherwise this function zeroes `stats`
+ * and fails.
+ *
+ * \param sample the Sound_Sample to query.
+ * \param stats a Sound_SampleStats to fill in.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SampleStats
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_GetSampleStats(Sound_Sample *sample,
+                                                    Sound_SampleStats *stats);
+
+
+/**
+ * Get counts of the memory SDL_sound has allocated.
+ *
+ * These cover every sample and everything else SDL_sound has done since the
+ * program started, Sound_Quit() doesn't reset them. To see what one
+ * sample's decoder allocates, use Sound_GetSampleStats() instead.
+ *
+ * Counting costs a lock per allocation, so it's only there if SDL_sound was
+ * built with it (`-DSDLSOUND_STATS=ON -DSDLSOUND_ALLOC_STATS=ON` in CMake);
+ * otherwise this function zeroes `stats` and fails.
+ *
+ * \param stats a Sound_AllocStats to fill in.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_AllocStats
+ * \sa Sound_GetSampleStats
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_GetAllocStats(Sound_AllocStats *stats);
+
+
 /**
  * Change the current buffer size for a sample.
  *
@@ -541,6 +912,9 @@ extern SDL_DECLSPEC Sint32 SDLCALL Sound_GetDuration(Sound_Sample *sample);
  * 130, or 131 (although in reality, you'll want to specify a MUCH larger
  * buffer).
  *
+ * A `new_size` of zero frees the buffer entirely, leaving `sample->buffer`
+ * NULL; this is useful for apps that only use Sound_DecodeInto().
+ *
  * \param sample The Sound_Sample whose buffer to modify.
  * \param new_size The desired size, in bytes, of the new buffer.
  * \returns non-zero if buffer size changed, zero on failure.
@@ -573,6 +947,9 @@ extern SDL_DECLSPEC int SDLCALL Sound_SetBufferSize(Sound_Sample *sample,
  * If `desired` is NULL, the sample's actual format is used, disabling audio
  * conversion.
  *
+ * If the desired rate differs from the actual one, Sound_SetResampleQuality()
+ * decides how the rate is changed.
+ *
  * If this function fails (out of memory setting up a new internal audio
  * stream, etc), the sample remains usable with its current, unchanged format.
  *
@@ -588,9 +965,73 @@ extern SDL_DECLSPEC int SDLCALL Sound_SetBufferSize(Sound_Sample *sample,
  *
  * \sa Sound_Decode
  * \sa Sound_DecodeAll
+ * \sa Sound_SetResampleQuality
  */
 extern SDL_DECLSPEC int SDLCALL Sound_SetDesiredFormat(Sound_Sample *sample, const SDL_AudioSpec *desired);
 
+/**
+ * How SDL_sound should change a sample's rate, if it has to.
+ *
+ * Every tier but SOUND_RESAMPLE_DEFAULT is SDL_sound's own resampler, which
+ * works in SDL_AUDIO_F32 and pays for more quality with more work per output
+ * frame. The FIR tiers are windowed-sinc filters that are symmetric around
+ * the output frame, so none of the tiers delay the audio at all: the group
+ * delay is zero, and positions and seeks line up exactly with the source.
+ * What they cost instead is lookahead, the input frames that have to be
+ * decoded past the one being output: one frame for linear, 8 for the short
+ * FIR and 32 for the long one. Going down in rate, the FIR filters get
+ * longer by the same factor, rounded up, so they still cut off cleanly
+ * below the new Nyquist rate: 44100Hz to 22050Hz needs 16 and 64 frames of
+ * lookahead, and no filter is longer than 256 taps (128 frames). The audio
+ * before the first frame and after the last is taken to be silence.
+ *
+ * \since This enum is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SetResampleQuality
+ */
+typedef enum Sound_ResampleQuality
+{
+    SOUND_RESAMPLE_DEFAULT,    /**< Let SDL_AudioStream do it, as usual. */
+    SOUND_RESAMPLE_LINEAR,     /**< Straight-line interpolation. Cheapest; audible aliasing. */
+    SOUND_RESAMPLE_SHORT_FIR,  /**< 16-tap filter (more, going down). Good for lots of sound effects at once. */
+    SOUND_RESAMPLE_LONG_FIR    /**< 64-tap filter (more, going down). For music; costs about 4x the short one. */
+} Sound_ResampleQuality;
+
+/**
+ * Choose how a sample's rate is changed when its desired rate differs.
+ *
+ * This takes effect right away, for the sample's current desired format,
+ * and sticks for later calls to Sound_SetDesiredFormat(). It only matters
+ * when the desired rate is different from the actual one.
+ *
+ * SDL_sound's own resampler handles any number of channels as long as the
+ * channel count doesn't change, or changes between mono and stereo. It
+ * falls back to SDL_AudioStream when it can't do the job: other channel
+ * changes, formats it can't convert to and from SDL_AUDIO_F32 itself, or
+ * rates whose ratio would need more than 1024 filters (8000Hz to 44100Hz
+ * needs 441; 44100Hz to 48000Hz needs 160). SOUND_RESAMPLE_LINEAR never
+ * needs the filters, so it only falls back for the other reasons.
+ *
+ * Switching between SDL_sound's resampler and SDL_AudioStream partway
+ * through a sample loses the few frames the old one was holding on to;
+ * seek afterwards if that matters.
+ *
+ * \param sample The Sound_Sample whose resampling should change.
+ * \param quality The new resampling quality.
+ * \returns non-zero on success, zero on failure. Specifics of the error can
+ *          be gleaned from Sound_GetError(). The sample is unchanged on
+ *          failure.
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SetDesiredFormat
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_SetResampleQuality(Sound_Sample *sample, Sound_ResampleQuality quality);
+
 
 /**
  * Decode more of the sound data in a Sound_Sample.
@@ -602,6 +1043,13 @@ extern SDL_DECLSPEC int SDLCALL Sound_SetDesiredFormat(Sound_Sample *sample, con
  * `sample->flags` to determine if this was an end-of-stream or error
  * condition.
  *
+ * If the sample's SDL_IOStream is non-blocking and reports
+ * SDL_IO_STATUS_NOT_READY, decoders that support it (MP3, FLAC, and
+ * uncompressed WAV, AIFF, AU and raw data) return what they have so far and
+ * set SOUND_SAMPLEFLAG_EAGAIN, converted to the desired format or not; call
+ * this again once more data has arrived and decoding carries on from the
+ * same spot.
+ *
  * \param sample Do more decoding to this Sound_Sample.
  * \returns number of bytes decoded into sample->buffer.
  *
@@ -612,6 +1060,7 @@ extern SDL_DECLSPEC int SDLCALL Sound_SetDesiredFormat(Sound_Sample *sample, con
  * \since This function is available since SDL_sound 1.0.0.
  *
  * \sa Sound_DecodeAll
+ * \sa Sound_DecodeInto
  * \sa Sound_SetBufferSize
  * \sa Sound_Seek
  * \sa Sound_Rewind
@@ -619,6 +1068,88 @@ extern SDL_DECLSPEC int SDLCALL Sound_SetDesiredFormat(Sound_Sample *sample, con
 extern SDL_DECLSPEC Uint32 SDLCALL Sound_Decode(Sound_Sample *sample);
 
 
+/**
+ * Decode more of the sound data in a Sound_Sample into an app-supplied buffer.
+ *
+ * This works like Sound_Decode(), but it decodes at most `len` bytes, in the
+ * desired format, directly into `buffer` instead of `sample->buffer`. The
+ * decoder writes straight into this memory, and if format conversion is
+ * needed, `buffer` is also used as the decoder's scratch space, so no data
+ * passes through `sample->buffer` at all. This lets an app decode into its
+ * own mixing or ring buffer without an extra copy, and a sample created with
+ * a buffer size of zero needs no decoding buffer of its own.
+ *
+ * `len` is rounded down to a multiple of the desired sample frame size. If
+ * conversion is needed, `len` must also be large enough to hold at least one
+ * sample frame in the sample's actual format, or this function will fail.
+ *
+ * The contents of `buffer` past the returned byte count are undefined after
+ * this call, since they may have been used as scratch space.
+ *
+ * If `len` bytes could not be decoded, then please refer to `sample->flags`
+ * to determine if this was an end-of-stream or error condition.
+ *
+ * Calls to this function and Sound_Decode() may be freely mixed on the same
+ * sample; they both continue from the same position in the stream.
+ *
+ * \param sample Do more decoding to this Sound_Sample.
+ * \param buffer Memory to decode into.
+ * \param len Size, in bytes, of the memory pointed to by `buffer`.
+ * \returns number of bytes decoded into `buffer`.
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_Decode
+ * \sa Sound_SetBufferSize
+ */
+extern SDL_DECLSPEC Uint32 SDLCALL Sound_DecodeInto(Sound_Sample *sample,
+                                                    void *buffer,
+                                                    Uint32 len);
+
+
+/**
+ * Decode more of the sound data in a Sound_Sample, without copying if possible.
+ *
+ * This works like Sound_Decode(), decoding up to `sample->buffer_size` bytes,
+ * but instead of always leaving the audio in `sample->buffer`, it reports
+ * where the audio ended up in `*data`. For uncompressed formats (WAV and AIFF
+ * PCM, linear AU, RAW, and anything from the cache that
+ * Sound_SetCacheSize() enables) that are already in memory (opened with
+ * Sound_NewSampleFromMem(), or a file that Sound_NewSampleFromFile() mapped
+ * into memory), and that need no conversion to the desired format, `*data`
+ * points straight into the source data and nothing is copied at all. In
+ * every other case, the audio is decoded into `sample->buffer` as usual, and
+ * `*data` points there.
+ *
+ * Either way, the data is read-only, and is only good until the next call
+ * that decodes, seeks, or frees this sample.
+ *
+ * If fewer bytes than `sample->buffer_size` came back, please refer to
+ * `sample->flags` to determine if this was an end-of-stream or error
+ * condition. Calls to this function, Sound_Decode() and Sound_DecodeInto()
+ * may be freely mixed on the same sample.
+ *
+ * \param sample Do more decoding to this Sound_Sample.
+ * \param data On return, points to the decoded audio, or NULL on error.
+ * \returns number of bytes of audio at `*data`.
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_Decode
+ * \sa Sound_DecodeInto
+ */
+extern SDL_DECLSPEC Uint32 SDLCALL Sound_DecodeView(Sound_Sample *sample,
+                                                    const void **data);
+
+
 /**
  * Decode the remainder of the sound data in a Sound_Sample.
  *
@@ -633,14 +1164,29 @@ extern SDL_DECLSPEC Uint32 SDLCALL Sound_Decode(Sound_Sample *sample);
  * an Internet radio feed that doesn't end) may fill all available memory
  * before giving up...be sure to use this on finite sound sources only!
  *
- * When decoding the sample in its entirety, the work is done one buffer at a
- * time. That is, sound is decoded in `sample->buffer_size` blocks, and
- * appended to a continually-growing buffer until the decoding completes. That
- * means that this function will need enough RAM to hold approximately
- * `sample->buffer_size` bytes plus the complete decoded sample at most. The
- * larger your buffer size, the less overhead this function needs, but beware
- * the possibility of paging to disk. Best to make this user-configurable if
- * the sample isn't specific and small.
+ * If the sample's duration is known, the output buffer is allocated at its
+ * final size up front, and the sound is decoded directly into it. Otherwise,
+ * the buffer starts small and doubles in size as needed. Either way, any
+ * unused space is trimmed off once decoding completes. That means that this
+ * function will need enough RAM to hold the complete decoded sample, plus up
+ * to that much again while the buffer is growing for a sample of unknown
+ * length. Beware the possibility of paging to disk. Best to make this
+ * user-configurable if the sample isn't specific and small.
+ *
+ * If the app allows it with Sound_SetDecodeAllThreads(), long samples can
+ * be split across several threads, each decoding its own stretch of the
+ * sample; see that function for which ones qualify. The result is identical
+ * to decoding it in one go.
+ *
+ * If the sample is decoding ahead, that is stopped first; see
+ * Sound_StopDecodeAhead().
+ *
+ * On a push sample (see Sound_NewPushSample()), this decodes what has been
+ * pushed so far and returns with SOUND_SAMPLEFLAG_EAGAIN set if the end
+ * hasn't been pushed yet; call it again after pushing more.
+ *
+ * The previous `sample->buffer` is freed, and it is fine to call this on a
+ * sample that was created with a buffer size of zero.
  *
  * \param sample do all decoding for this Sound_Sample.
  * \returns number of bytes decoded into sample->buffer. You should check
@@ -655,9 +1201,39 @@ extern SDL_DECLSPEC Uint32 SDLCALL Sound_Decode(Sound_Sample *sample);
  *
  * \sa Sound_Decode
  * \sa Sound_SetBufferSize
+ * \sa Sound_SetDecodeAllThreads
  */
 extern SDL_DECLSPEC Uint32 SDLCALL Sound_DecodeAll(Sound_Sample *sample);
 
+/**
+ * Let Sound_DecodeAll() use several threads at once.
+ *
+ * With this set to two or more, Sound_DecodeAll() splits what's left of a
+ * long sample into stretches, up to one per CPU core but no more than
+ * `max_threads`, and starts a thread to decode each one with its own
+ * instance of the decoder. They all read the sample's stream, taking turns.
+ *
+ * This is only done for samples that can seek to an exact frame, whose
+ * decoder knows (rather than guesses) their duration, that aren't being
+ * resampled, and whose stream can report its size, seek, and say where it
+ * was when the sample was opened. Anything else is decoded on the calling
+ * thread as usual, as is anything too short to be worth the threads.
+ *
+ * This is zero (off) by default. The setting persists across Sound_Quit().
+ *
+ * \param max_threads the most threads Sound_DecodeAll() may use for one
+ *                    sample. Zero or one keeps it on the calling thread.
+ * \returns non-zero on success, zero on failure. Specifics of the error can
+ *          be gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_DecodeAll
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_SetDecodeAllThreads(int max_threads);
+
 
 /**
  * Rewind a sample to the start.
@@ -742,9 +1318,463 @@ extern SDL_DECLSPEC int SDLCALL Sound_Rewind(Sound_Sample *sample);
  * \since This function is available since SDL_sound 1.0.0.
  *
  * \sa Sound_Rewind
+ * \sa Sound_SeekFrame
  */
 extern SDL_DECLSPEC int SDLCALL Sound_Seek(Sound_Sample *sample, Uint32 ms);
 
+/**
+ * Seek to a specific sample frame.
+ *
+ * This works like Sound_Seek(), but the position is given in sample frames
+ * instead of milliseconds, so it's exact and won't overflow on long streams.
+ * Frames are counted at the sample's native rate, `sample->actual.freq`,
+ * from the start of the sample, not at the rate you asked for in
+ * `sample->desired`.
+ *
+ * Decoders that can't position themselves to an exact frame will round the
+ * position down to the nearest millisecond instead, and fail if the position
+ * can't be expressed in milliseconds at all.
+ *
+ * The same caveats about seekable streams, SOUND_SAMPLEFLAG_CANSEEK, and
+ * failure apply here as they do for Sound_Seek().
+ *
+ * \param sample the Sound_Sample to seek.
+ * \param frame the new position, in sample frames from start of sample.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_Seek
+ * \sa Sound_TellFrame
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_SeekFrame(Sound_Sample *sample, Uint64 frame);
+
+/**
+ * Report the current decoding position of a sample, in sample frames.
+ *
+ * This is the frame, counted at `sample->actual.freq` from the start of the
+ * sample, that the next call to Sound_Decode() will start from. It's updated
+ * by decoding, Sound_Rewind(), Sound_Seek() and Sound_SeekFrame().
+ *
+ * If SDL_sound is converting your sample to a different rate, the position
+ * is scaled back from the frames you've been handed and rounded down, so it
+ * might be off by a frame or so. It doesn't count what the converter is
+ * still holding on to; that's audio you haven't been handed yet.
+ *
+ * \param sample the Sound_Sample to query.
+ * \returns the current frame position, or -1 on error. Specifics of the
+ *          error can be gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SeekFrame
+ */
+extern SDL_DECLSPEC Sint64 SDLCALL Sound_TellFrame(Sound_Sample *sample);
+
+/**
+ * Write out a sample's seek index.
+ *
+ * Some formats can't jump straight to a position in the file; an MP3, for
+ * example, has to be read from the start to find where a given moment is.
+ * Decoders for these build an index as they go, the first time you seek
+ * somewhere new, so later seeks are quick. This function saves that index,
+ * so that you can give it back to Sound_LoadSeekIndex() the next time you
+ * open the same file, and skip building it all over again.
+ *
+ * The index covers the whole file, so if the decoder hasn't built all of it
+ * yet, this will finish it first, which means reading through the file.
+ * The sample's decoding position doesn't change.
+ *
+ * The index is a few bytes per second of audio, in a format that doesn't
+ * depend on the machine that wrote it. It's only good for the exact file
+ * it was made from; it carries the same key that Sound_GetSeekIndexKey()
+ * reports, and Sound_LoadSeekIndex() refuses it for any other file.
+ *
+ * SDL_sound never writes an index on its own; where to keep it (a file next
+ * to the audio, a cache directory named by Sound_GetSeekIndexKey(), etc) is
+ * up to the app.
+ *
+ * Currently the MP3, Ogg Vorbis, VOC and Shorten decoders keep an index.
+ * Decoders that don't need one will fail this with "Operation not
+ * supported".
+ *
+ * \param sample the Sound_Sample whose index to save.
+ * \param io the SDL_IOStream to write the index to.
+ * \param closeio true to close `io` before returning, even on failure.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_LoadSeekIndex
+ * \sa Sound_GetSeekIndexKey
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_SaveSeekIndex(Sound_Sample *sample, SDL_IOStream *io, bool closeio);
+
+/**
+ * Give a sample a seek index that Sound_SaveSeekIndex() wrote earlier.
+ *
+ * Call this right after opening the sample, before seeking, to make seeking
+ * fast from the start. The index records the size of the file it was made
+ * from and a hash of its first and last 64 kilobytes; if those don't match
+ * this sample's stream, or the index was made by a different decoder, or
+ * it's damaged, this fails and the sample carries on as if it was never
+ * called. Checking the key means reading up to 128 kilobytes of the stream,
+ * so the stream has to be seekable.
+ *
+ * \param sample the Sound_Sample to give the index to.
+ * \param io the SDL_IOStream to read the index from.
+ * \param closeio true to close `io` before returning, even on failure.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SaveSeekIndex
+ * \sa Sound_NewSampleWithIndex
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_LoadSeekIndex(Sound_Sample *sample, SDL_IOStream *io, bool closeio);
+
+/**
+ * Get the key that identifies a sample's stream to its seek index.
+ *
+ * This is the key Sound_SaveSeekIndex() stores in an index and
+ * Sound_LoadSeekIndex() checks against: the stream's size and a hash of its
+ * first and last 64 kilobytes, written as 32 lowercase hex digits. Apps can
+ * use it to name cached index files, so the right index can be found for a
+ * file even after it's been renamed or moved.
+ *
+ * The sample's decoding position doesn't change.
+ *
+ * \param sample the Sound_Sample whose key to get.
+ * \param buf where to write the key, as a null-terminated string.
+ * \param len the size of `buf` in bytes; must be at least 33.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SaveSeekIndex
+ * \sa Sound_LoadSeekIndex
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_GetSeekIndexKey(Sound_Sample *sample, char *buf, int len);
+
+/**
+ * Start decoding a sound sample, and give it a saved seek index.
+ *
+ * This is Sound_NewSample() followed by Sound_LoadSeekIndex(). If the index
+ * can't be used (it's stale, damaged, or for a different file), the sample
+ * is still opened and works normally; the first seek to a new spot will
+ * just be slow, as if no index was given.
+ *
+ * \param io an SDL_IOStream with sound data.
+ * \param ext file extension normally associated with a data format. Can
+ *            usually be NULL.
+ * \param desired format to convert sound data into. Can usually be NULL,
+ *                if you don't need conversion.
+ * \param bufferSize size, in bytes, to allocate for the decoding buffer.
+ * \param index an SDL_IOStream with an index that Sound_SaveSeekIndex()
+ *              wrote, or NULL for none.
+ * \param closeindex true to close `index` before returning, even on
+ *                   failure.
+ * \returns Sound_Sample pointer, which is used as a handle to several other
+ *          SDL_sound APIs. NULL on error. If error, use Sound_GetError() to
+ *          see what went wrong.
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_NewSample
+ * \sa Sound_LoadSeekIndex
+ */
+extern SDL_DECLSPEC Sound_Sample * SDLCALL Sound_NewSampleWithIndex(SDL_IOStream *io,
+                                                                   const char *ext,
+                                                                   const SDL_AudioSpec *desired,
+                                                                   Uint32 bufferSize,
+                                                                   SDL_IOStream *index,
+                                                                   bool closeindex);
+
+/**
+ * Start decoding a sample ahead of time on a background thread.
+ *
+ * Once this is running, a worker thread keeps up to `lookahead` bytes of
+ * audio (in the sample's desired format) decoded ahead of the app, and
+ * Sound_Decode() and Sound_DecodeInto() just copy from that, so they never
+ * wait on the decoder or the disk. This is meant for things like an audio
+ * callback that can't afford to stall.
+ *
+ * If the worker hasn't caught up yet, those functions hand back whatever is
+ * ready (possibly nothing) and set SOUND_SAMPLEFLAG_EAGAIN; try again later.
+ * SOUND_SAMPLEFLAG_EOF and SOUND_SAMPLEFLAG_ERROR are only set once the app
+ * has read everything that was decoded before them.
+ *
+ * Sound_Rewind(), Sound_Seek() and Sound_SeekFrame() still work; they throw
+ * out what was decoded ahead and restart the worker from the new position.
+ * Sound_TellFrame() reports where the app is, not where the worker is.
+ * Sound_SetBufferSize() and Sound_SetDesiredFormat() fail until
+ * Sound_StopDecodeAhead() is called. Sound_DecodeAll() and
+ * Sound_FreeSample() stop the worker themselves.
+ *
+ * \param sample the Sound_Sample to decode ahead.
+ * \param lookahead the most bytes to decode ahead of the app. This is
+ *                  rounded up to a power of two. Zero picks about one
+ *                  second of audio.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time; the worker thread doesn't count.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StartPooledDecodeAhead
+ * \sa Sound_StopDecodeAhead
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_StartDecodeAhead(Sound_Sample *sample, Uint32 lookahead);
+
+/**
+ * How urgently the shared decoding threads should get to a sample.
+ *
+ * Whenever there's more work than threads, every job at a higher priority
+ * is done before any job at a lower one.
+ *
+ * \since This enum is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StartPooledDecodeAhead
+ */
+typedef enum Sound_DecodePriority
+{
+    SOUND_DECODE_PRIORITY_BACKGROUND,  /**< Preloading; whenever there's time. */
+    SOUND_DECODE_PRIORITY_NORMAL,      /**< The usual. */
+    SOUND_DECODE_PRIORITY_REALTIME     /**< Something is playing this right now. */
+} Sound_DecodePriority;
+
+/**
+ * Start decoding a sample ahead of time on SDL_sound's shared threads.
+ *
+ * This works just like Sound_StartDecodeAhead(), except that instead of
+ * getting a thread of its own, the sample is handed to a set of worker
+ * threads (one per CPU core) that SDL_sound shares between every sample
+ * decoding this way. This lets an app keep hundreds of streams decoded
+ * ahead without hundreds of threads.
+ *
+ * The threads are started the first time this is called, and stopped by
+ * Sound_Quit(). A sample only takes up a thread's time while there's room
+ * to decode into; `priority` decides who goes first when they're busy.
+ *
+ * Stop it with Sound_StopDecodeAhead(), same as the other kind.
+ *
+ * \param sample the Sound_Sample to decode ahead.
+ * \param lookahead the most bytes to decode ahead of the app. This is
+ *                  rounded up to a power of two. Zero picks about one
+ *                  second of audio.
+ * \param priority how urgently this sample needs its audio.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time; the worker threads don't count.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StartDecodeAhead
+ * \sa Sound_StopDecodeAhead
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_StartPooledDecodeAhead(Sound_Sample *sample,
+                                                            Uint32 lookahead,
+                                                            Sound_DecodePriority priority);
+
+/**
+ * Stop decoding a sample ahead of time.
+ *
+ * This waits for the worker started by Sound_StartDecodeAhead() or
+ * Sound_StartPooledDecodeAhead() to finish up. Anything it decoded that the
+ * app hasn't read yet is kept, and the next calls to Sound_Decode() and
+ * friends hand that out before the decoder is asked for more, so decoding
+ * carries on without a gap, even if the sample is being converted to a
+ * different rate. If Sound_SetDesiredFormat() changes the format before it
+ * has all been read, the rest is thrown out and the sample seeks back to
+ * Sound_TellFrame(), if it can seek.
+ *
+ * It's safe to call this on a sample that isn't decoding ahead; it does
+ * nothing and returns nonzero.
+ *
+ * \param sample the Sound_Sample to stop decoding ahead.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError(). The worker is stopped either way.
+ *
+ * \threadsafety It is safe to call this function from any thread, but a
+ *               single Sound_Sample should not be accessed from two threads
+ *               at the same time.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StartDecodeAhead
+ * \sa Sound_StartPooledDecodeAhead
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_StopDecodeAhead(Sound_Sample *sample);
+
+
+/**
+ * The points in SDL_sound's work that can be reported to a trace callback.
+ *
+ * Each of these is reported twice: once when it begins, and once when it
+ * ends, so a trace callback can measure how long it took.
+ *
+ * \since This enum is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SetTraceCallback
+ */
+typedef enum Sound_TraceEvent
+{
+    SOUND_TRACE_NEWSAMPLE,   /**< Sound_NewSample() and friends. */
+    SOUND_TRACE_OPEN,        /**< A decoder deciding whether to take a sample. */
+    SOUND_TRACE_READ,        /**< A decoder decoding more audio. */
+    SOUND_TRACE_SEEK,        /**< A decoder seeking. */
+    SOUND_TRACE_REWIND,      /**< A decoder rewinding. */
+    SOUND_TRACE_STREAM_PUT,  /**< Decoded audio going into the converter. */
+    SOUND_TRACE_STREAM_GET   /**< Converted audio coming out of it. */
+} Sound_TraceEvent;
+
+/**
+ * A function that SDL_sound calls as it works, for tracing and profiling.
+ *
+ * \param userdata the pointer passed to Sound_SetTraceCallback().
+ * \param event what SDL_sound is doing.
+ * \param begin true when `event` is starting, false when it's finished.
+ * \param sample the Sound_Sample involved. This is NULL when
+ *               SOUND_TRACE_NEWSAMPLE begins, and when it ends without
+ *               creating a sample. During SOUND_TRACE_OPEN, the sample isn't
+ *               finished yet, but `sample->decoder` says which decoder is
+ *               looking at it. Work done for a sample on another thread,
+ *               like decoding ahead, is reported with the app's sample too.
+ * \param timestamp_ns when this happened, from SDL_GetTicksNS().
+ *
+ * \threadsafety This is called on whatever thread is using the sample, so
+ *               it can be called from several threads at once.
+ *
+ * \since This datatype is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_SetTraceCallback
+ */
+typedef void (SDLCALL *Sound_TraceCallback)(void *userdata,
+                                            Sound_TraceEvent event,
+                                            bool begin,
+                                            Sound_Sample *sample,
+                                            Uint64 timestamp_ns);
+
+/**
+ * Set a function to be told about SDL_sound's work as it happens.
+ *
+ * Once set, the callback is called when each Sound_TraceEvent begins and
+ * ends, for every sample. This lets you line decoding work up against the
+ * rest of your application's timeline, to find out which sounds are
+ * stalling your audio thread, for example.
+ *
+ * Only one callback can be set at a time; setting a new one replaces the
+ * old one. Pass NULL to stop tracing. The callback runs on the decoding
+ * thread, in the middle of SDL_sound's work, so it should be quick.
+ *
+ * This doesn't wait for calls that other threads are already making, so
+ * the previous callback can still be running, and using its `userdata`,
+ * after this returns. Don't free what `userdata` points to until nothing
+ * can still be decoding with it: after Sound_Quit(), or once every sample
+ * that other threads (decode-ahead workers included) were working on has
+ * been stopped or freed.
+ *
+ * This can be called whether SDL_sound is initialized or not.
+ * Sound_StartChromeTrace() is a ready-made callback that writes a trace file.
+ *
+ * \param callback the function to call, or NULL to disable tracing.
+ * \param userdata a pointer passed to `callback`.
+ *
+ * \threadsafety It is safe to call this function from any thread, but
+ *               events that were already underway may still be reported to
+ *               the previous callback after this returns; see above.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StartChromeTrace
+ */
+extern SDL_DECLSPEC void SDLCALL Sound_SetTraceCallback(Sound_TraceCallback callback,
+                                                       void *userdata);
+
+/**
+ * Start writing SDL_sound's work to a Chrome trace file.
+ *
+ * This installs a trace callback (replacing any set with
+ * Sound_SetTraceCallback()) that writes each Sound_TraceEvent to `io` in the
+ * Chrome trace event JSON format, which can be loaded into Perfetto
+ * (https://ui.perfetto.dev/) or chrome://tracing. Each event shows up as a
+ * span on the thread that did the work, with the decoder and sample noted.
+ *
+ * Timestamps are SDL_GetTicksNS() converted to microseconds, so if your
+ * application writes its own trace events on the same clock, they'll line
+ * up.
+ *
+ * Events are buffered, and written out in chunks, so the file won't be
+ * complete until you call Sound_StopChromeTrace().
+ *
+ * \param io the stream to write the trace to.
+ * \param closeio true to close `io` when the trace is stopped, or right away
+ *                if this function fails.
+ * \returns nonzero on success, zero on error. Specifics of the error can be
+ *          gleaned from Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StopChromeTrace
+ * \sa Sound_SetTraceCallback
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_StartChromeTrace(SDL_IOStream *io, bool closeio);
+
+/**
+ * Stop writing a Chrome trace file.
+ *
+ * This removes the trace callback, writes out anything still buffered, and
+ * finishes the file started by Sound_StartChromeTrace(). If that was told
+ * to, `io` is closed, too.
+ *
+ * It's safe to call this if no trace is running; it does nothing.
+ *
+ * \returns nonzero on success, zero if there was a problem writing the end of
+ *          the trace. Specifics of the error can be gleaned from
+ *          Sound_GetError().
+ *
+ * \threadsafety It is safe to call this function from any thread.
+ *
+ * \since This function is available since SDL_sound 3.3.0.
+ *
+ * \sa Sound_StartChromeTrace
+ */
+extern SDL_DECLSPEC int SDLCALL Sound_StopChromeTrace(void);
+
 #ifdef __cplusplus
 }
 #endif
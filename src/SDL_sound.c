@@ -16,6 +16,13 @@
 #define __SDL_SOUND_INTERNAL__
 #include "SDL_sound_internal.h"
 
+#if SOUND_SUPPORTS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 /* The various decoder drivers... */
 
 /* All these externs may be missing; we check SOUND_SUPPORTS_xxx before use. */
@@ -98,6 +105,27 @@ static SDL_Mutex *samplelist_mutex = NULL;
 static const Sound_DecoderInfo **available_decoders = NULL;
 static int initialized = 0;
 
+/*
+ * Freed Sound_Samples (with their Sound_SampleInternal still attached via
+ *  the opaque field) and decoding buffers are kept around for reuse, so
+ *  apps that open and close lots of short-lived samples don't hit the
+ *  allocator every time. Buffers are pooled in power-of-two size classes.
+ *  Everything here is protected by pool_mutex.
+ */
+#define POOL_MIN_BUFFER_SHIFT 12  /* 4 kilobytes */
+#define POOL_MAX_BUFFER_SHIFT 20  /* 1 megabyte */
+#define POOL_BUFFER_CLASSES (POOL_MAX_BUFFER_SHIFT - POOL_MIN_BUFFER_SHIFT + 1)
+#define POOL_DEFAULT_MAX_SAMPLES 16
+#define POOL_DEFAULT_MAX_BYTES (1024 * 1024)
+
+static SDL_Mutex *pool_mutex = NULL;
+static Sound_Sample *pooled_samples = NULL;  /* linked through internal->next. */
+static Uint32 pooled_sample_count = 0;
+static Uint32 pool_max_samples = POOL_DEFAULT_MAX_SAMPLES;
+static void *pooled_buffers[POOL_BUFFER_CLASSES];  /* linked through first bytes. */
+static Uint32 pooled_buffer_bytes = 0;
+static Uint32 pool_max_bytes = POOL_DEFAULT_MAX_BYTES;
+
 
 /* functions ... */
 
@@ -125,6 +153,8 @@ int Sound_Init(void)
     BAIL_IF_MACRO(!SDL_SetTLS(&tlsid_errmsg, NULL, NULL), ERR_OUT_OF_MEMORY, 0);
 
     samplelist_mutex = SDL_CreateMutex();
+    pool_mutex = SDL_CreateMutex();
+    __Sound_CacheInit();
 
     for (i = 0; decoders[i].funcs != NULL; i++)
     {
@@ -141,6 +171,8 @@ int Sound_Init(void)
 } /* Sound_Init */
 
 
+static void sched_stop(void);  /* below. */
+
 int Sound_Quit(void)
 {
     size_t i;
@@ -150,12 +182,19 @@ int Sound_Quit(void)
     while (((volatile Sound_Sample *) sample_list) != NULL)
         Sound_FreeSample(sample_list);
 
+    sched_stop();  /* every sample is gone, so nobody's using it now. */
+    __Sound_CacheQuit();
+
     initialized = 0;
 
     SDL_DestroyMutex(samplelist_mutex);
     samplelist_mutex = NULL;
     sample_list = NULL;
 
+    Sound_TrimPool();
+    SDL_DestroyMutex(pool_mutex);
+    pool_mutex = NULL;
+
     for (i = 0; decoders[i].funcs != NULL; i++)
     {
         if (decoders[i].available)
@@ -241,16 +280,277 @@ void __Sound_SetError(const char *str)
 } /* __Sound_SetError */
 
 
-Uint32 __Sound_convertMsToBytePos(SDL_AudioSpec *info, Uint32 ms)
+Uint64 __Sound_convertMsToFrames(const SDL_AudioSpec *info, Uint32 ms)
 {
     /* "frames" == "sample frames" */
-    float frames_per_ms = ((float) info->freq) / 1000.0f;
-    Uint32 frame_offset = (Uint32) (frames_per_ms * ((float) ms));
-    Uint32 frame_size = (Uint32) ((info->format & 0xFF) / 8) * info->channels;
-    return frame_offset * frame_size;
+    return (((Uint64) ms) * ((Uint64) info->freq)) / 1000;
+} /* __Sound_convertMsToFrames */
+
+
+Uint64 __Sound_convertMsToBytePos(const SDL_AudioSpec *info, Uint32 ms)
+{
+    const Uint64 frame_size = (Uint64) SDL_AUDIO_FRAMESIZE(*info);
+    return __Sound_convertMsToFrames(info, ms) * frame_size;
 } /* __Sound_convertMsToBytePos */
 
 
+/* Which pooled size class a buffer of (len) bytes goes in, -1 if none. */
+static int pool_buffer_class(Uint32 len)
+{
+    int i;
+    for (i = 0; i < POOL_BUFFER_CLASSES; i++)
+    {
+        if (len <= (((Uint32) 1) << (POOL_MIN_BUFFER_SHIFT + i)))
+            return i;
+    } /* for */
+    return -1;
+} /* pool_buffer_class */
+
+
+/*
+ * Get a decoding buffer of at least (len) bytes, from the pool if possible.
+ *  The number of bytes actually allocated goes in (*capacity).
+ */
+static void *acquire_buffer(Uint32 len, Uint32 *capacity)
+{
+    const int cls = pool_buffer_class(len);
+    void *retval = NULL;
+    Uint32 allocsize = len;
+
+    SDL_LockMutex(pool_mutex);
+    if ((cls >= 0) && (pool_max_bytes > 0))
+    {
+        allocsize = ((Uint32) 1) << (POOL_MIN_BUFFER_SHIFT + cls);
+        retval = pooled_buffers[cls];
+        if (retval != NULL)
+        {
+            pooled_buffers[cls] = *((void **) retval);
+            pooled_buffer_bytes -= allocsize;
+        } /* if */
+    } /* if */
+    SDL_UnlockMutex(pool_mutex);
+
+    if (retval == NULL)
+        retval = __Sound_SIMDAlloc(allocsize);
+
+    if (retval != NULL)
+        *capacity = allocsize;
+
+    return retval;
+} /* acquire_buffer */
+
+
+/* Give a decoding buffer of (capacity) bytes back to the pool, or free it. */
+static void release_buffer(void *buf, Uint32 capacity)
+{
+    const int cls = pool_buffer_class(capacity);
+
+    if (buf == NULL)
+        return;
+
+    /* only buffers that are exactly a size class's size go in the pool. */
+    if ((cls >= 0) && (capacity == (((Uint32) 1) << (POOL_MIN_BUFFER_SHIFT + cls))))
+    {
+        SDL_LockMutex(pool_mutex);
+        if ((pooled_buffer_bytes + capacity) <= pool_max_bytes)
+        {
+            *((void **) buf) = pooled_buffers[cls];
+            pooled_buffers[cls] = buf;
+            pooled_buffer_bytes += capacity;
+            buf = NULL;
+        } /* if */
+        SDL_UnlockMutex(pool_mutex);
+    } /* if */
+
+    __Sound_SIMDFree(buf);  /* NULL if it went to the pool. */
+} /* release_buffer */
+
+
+/*
+ * Give a Sound_Sample's memory back to the pool, or free it. Anything else
+ *  it owns (decoder state, audio stream, SDL_IOStream) must already be gone.
+ */
+static void release_sample(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+
+    release_buffer(sample->buffer, internal->buffer_capacity);
+    __Sound_SIMDFree(internal->convert_buffer);
+    __Sound_SIMDFree(internal->resample_buffer);
+    __Sound_SIMDFree(internal->decode_buffer);
+    __Sound_DestroyResampler(internal->resampler);
+    SDL_free(internal->leftover);
+
+    SDL_LockMutex(pool_mutex);
+    if (pooled_sample_count < pool_max_samples)
+    {
+        SDL_zerop(internal);
+        SDL_zerop(sample);
+        sample->opaque = internal;
+        internal->next = pooled_samples;
+        pooled_samples = sample;
+        pooled_sample_count++;
+        sample = NULL;
+    } /* if */
+    SDL_UnlockMutex(pool_mutex);
+
+    if (sample != NULL)
+    {
+        SDL_free(internal);
+        SDL_free(sample);
+    } /* if */
+} /* release_sample */
+
+
+int Sound_SetPoolSize(Uint32 max_samples, Uint32 max_buffer_bytes)
+{
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+
+    SDL_LockMutex(pool_mutex);
+    pool_max_samples = max_samples;
+    pool_max_bytes = max_buffer_bytes;
+    SDL_UnlockMutex(pool_mutex);
+
+    /* dump whatever doesn't fit under the new limits. */
+    Sound_TrimPool();
+    return 1;
+} /* Sound_SetPoolSize */
+
+
+void Sound_TrimPool(void)
+{
+    Sound_Sample *samples;
+    void *buffers[POOL_BUFFER_CLASSES];
+    int i;
+
+    /* detach it all under the lock, free it all outside of it. */
+    SDL_LockMutex(pool_mutex);
+    samples = pooled_samples;
+    pooled_samples = NULL;
+    pooled_sample_count = 0;
+    SDL_memcpy(buffers, pooled_buffers, sizeof (buffers));
+    SDL_zeroa(pooled_buffers);
+    pooled_buffer_bytes = 0;
+    SDL_UnlockMutex(pool_mutex);
+
+    while (samples != NULL)
+    {
+        Sound_SampleInternal *internal = (Sound_SampleInternal *) samples->opaque;
+        Sound_Sample *next = internal->next;
+        SDL_free(internal);
+        SDL_free(samples);
+        samples = next;
+    } /* while */
+
+    for (i = 0; i < POOL_BUFFER_CLASSES; i++)
+    {
+        while (buffers[i] != NULL)
+        {
+            void *next = *((void **) buffers[i]);
+            __Sound_SIMDFree(buffers[i]);
+            buffers[i] = next;
+        } /* while */
+    } /* for */
+} /* Sound_TrimPool */
+
+
+#if SOUND_SUPPORTS_STATS
+/*
+ * When statistics are enabled, a sample's SDL_IOStream is wrapped in one
+ *  that just passes everything through to the app's stream, counting reads
+ *  on the way. This way the decoders don't have to know about it.
+ */
+static Sint64 SDLCALL counted_io_size(void *userdata)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) userdata;
+    return SDL_GetIOSize(internal->counted_io);
+} /* counted_io_size */
+
+
+static Sint64 SDLCALL counted_io_seek(void *userdata, Sint64 offset, SDL_IOWhence whence)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) userdata;
+    return SDL_SeekIO(internal->counted_io, offset, whence);
+} /* counted_io_seek */
+
+
+static size_t SDLCALL counted_io_read(void *userdata, void *ptr, size_t size, SDL_IOStatus *status)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) userdata;
+    const Uint64 start = SDL_GetTicksNS();
+    const size_t retval = SDL_ReadIO(internal->counted_io, ptr, size);
+    *status = SDL_GetIOStatus(internal->counted_io);
+    internal->stats.io_ns += SDL_GetTicksNS() - start;
+    internal->stats.io_read_calls++;
+    internal->stats.io_bytes_read += retval;
+    return retval;
+} /* counted_io_read */
+
+
+static size_t SDLCALL counted_io_write(void *userdata, const void *ptr, size_t size, SDL_IOStatus *status)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) userdata;
+    const size_t retval = SDL_WriteIO(internal->counted_io, ptr, size);
+    *status = SDL_GetIOStatus(internal->counted_io);
+    return retval;
+} /* counted_io_write */
+
+
+static bool SDLCALL counted_io_flush(void *userdata, SDL_IOStatus *status)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) userdata;
+    const bool retval = SDL_FlushIO(internal->counted_io);
+    *status = SDL_GetIOStatus(internal->counted_io);
+    return retval;
+} /* counted_io_flush */
+
+
+static bool SDLCALL counted_io_close(void *userdata)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) userdata;
+    const bool retval = SDL_CloseIO(internal->counted_io);
+    internal->counted_io = NULL;
+    return retval;
+} /* counted_io_close */
+
+
+/* Returns the stream the sample should read from; (io) itself on failure. */
+static SDL_IOStream *count_io(Sound_SampleInternal *internal, SDL_IOStream *io)
+{
+    SDL_IOStreamInterface iface;
+    SDL_IOStream *retval;
+    SDL_PropertiesID props;
+    void *mem;
+
+    SDL_INIT_INTERFACE(&iface);
+    iface.size = counted_io_size;
+    iface.seek = counted_io_seek;
+    iface.read = counted_io_read;
+    iface.write = counted_io_write;
+    iface.flush = counted_io_flush;
+    iface.close = counted_io_close;
+
+    retval = SDL_OpenIO(&iface, internal);
+    if (retval == NULL)
+        return io;  /* oh well, we just won't count i/o for this one. */
+
+    /* let decoders still find the data if the app's stream is in memory. */
+    props = SDL_GetIOProperties(io);
+    mem = SDL_GetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, NULL);
+    if (mem != NULL)
+    {
+        const Sint64 memlen = SDL_GetNumberProperty(props, SDL_PROP_IOSTREAM_MEMORY_SIZE_NUMBER, 0);
+        props = SDL_GetIOProperties(retval);
+        SDL_SetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, mem);
+        SDL_SetNumberProperty(props, SDL_PROP_IOSTREAM_MEMORY_SIZE_NUMBER, memlen);
+    } /* if */
+
+    internal->counted_io = io;
+    return retval;
+} /* count_io */
+#endif
+
+
 /*
  * Allocate a Sound_Sample, and fill in most of its fields. Those that need
  *  to be filled in later, by a decoder, will be initialized to zero.
@@ -258,41 +558,63 @@ Uint32 __Sound_convertMsToBytePos(SDL_AudioSpec *info, Uint32 ms)
 static Sound_Sample *alloc_sample(SDL_IOStream *io, const SDL_AudioSpec *desired,
                                   Uint32 bufferSize)
 {
-    /*
-     * !!! FIXME: We're going to need to pool samples, since the mixer
-     * !!! FIXME:  might be allocating tons of these on a regular basis.
-     */
-    Sound_Sample *retval = SDL_calloc(1, sizeof (Sound_Sample));
-    Sound_SampleInternal *internal = SDL_calloc(1, sizeof (Sound_SampleInternal));
-    if ((retval == NULL) || (internal == NULL))
-    {
-        __Sound_SetError(ERR_OUT_OF_MEMORY);
-        if (retval)
-            SDL_free(retval);
-        if (internal)
-            SDL_free(internal);
+    Sound_Sample *retval = NULL;
+    Sound_SampleInternal *internal = NULL;
 
-        return NULL;
+    SDL_LockMutex(pool_mutex);
+    if (pooled_samples != NULL)
+    {
+        retval = pooled_samples;
+        internal = (Sound_SampleInternal *) retval->opaque;
+        pooled_samples = internal->next;
+        pooled_sample_count--;
+        internal->next = NULL;
     } /* if */
+    SDL_UnlockMutex(pool_mutex);
+
+    if (retval == NULL)
+    {
+        retval = SDL_calloc(1, sizeof (Sound_Sample));
+        internal = SDL_calloc(1, sizeof (Sound_SampleInternal));
+        if ((retval == NULL) || (internal == NULL))
+        {
+            __Sound_SetError(ERR_OUT_OF_MEMORY);
+            if (retval)
+                SDL_free(retval);
+            if (internal)
+                SDL_free(internal);
 
-    SDL_assert(bufferSize > 0);
+            return NULL;
+        } /* if */
+        retval->opaque = internal;
+    } /* if */
 
-    retval->buffer = __Sound_SIMDAlloc(bufferSize);
-    if (!retval->buffer)
+    /* a zero bufferSize means the app will only use Sound_DecodeInto(). */
+    if (bufferSize > 0)
     {
-        __Sound_SetError(ERR_OUT_OF_MEMORY);
-        SDL_free(internal);
-        SDL_free(retval);
-        return NULL;
+        retval->buffer = acquire_buffer(bufferSize, &internal->buffer_capacity);
+        if (!retval->buffer)
+        {
+            __Sound_SetError(ERR_OUT_OF_MEMORY);
+            release_sample(retval);
+            return NULL;
+        } /* if */
+        SDL_memset(retval->buffer, '\0', bufferSize);
+        retval->buffer_size = bufferSize;
     } /* if */
-    SDL_memset(retval->buffer, '\0', bufferSize);
-    retval->buffer_size = bufferSize;
 
     if (desired != NULL)
         SDL_memcpy(&retval->desired, desired, sizeof (SDL_AudioSpec));
 
+    /* the app's stream doesn't have to start at the top of the file. */
+    internal->io_start = SDL_TellIO(io);
+
+#if SOUND_SUPPORTS_STATS
+    io = count_io(internal, io);
+#endif
+
     internal->io = io;
-    retval->opaque = internal;
+    internal->owner = retval;
     return retval;
 } /* alloc_sample */
 
@@ -323,6 +645,19 @@ static SDL_INLINE const char *fmt_to_str(Uint16 fmt)
 #endif
 
 
+/* Prepend a new Sound_Sample to the sample_list, so Sound_Quit() can find it. */
+static void link_sample(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    SDL_LockMutex(samplelist_mutex);
+    internal->next = sample_list;
+    if (sample_list != NULL)
+        ((Sound_SampleInternal *) sample_list->opaque)->prev = sample;
+    sample_list = sample;
+    SDL_UnlockMutex(samplelist_mutex);
+} /* link_sample */
+
+
 /*
  * The bulk of the Sound_NewSample() work is done here...
  *  Ask the specified decoder to handle the data in (io), and if
@@ -336,11 +671,25 @@ static int init_sample(const Sound_DecoderFunctions *funcs,
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     SDL_AudioSpec desired;
     const Sint64 pos = SDL_TellIO(internal->io);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+    int rc;
 
         /* fill in the funcs for this decoder... */
     sample->decoder = &funcs->info;
     internal->funcs = funcs;
-    if (!funcs->open(sample, ext))
+    internal->duration_estimated = false;
+    __Sound_Trace(SOUND_TRACE_OPEN, true, sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OPEN);
+#endif
+    rc = funcs->open(sample, ext);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    __Sound_AllocLeave(scope);
+#endif
+    __Sound_Trace(SOUND_TRACE_OPEN, false, sample);
+    if (!rc)
     {
         SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET); /* set for next try... */
         return 0;
@@ -363,12 +712,20 @@ static int init_sample(const Sound_DecoderFunctions *funcs,
              (sample->actual.channels != desired.channels) ||
              (sample->actual.freq != desired.freq) )
         {
-            internal->stream = SDL_CreateAudioStream(&sample->actual, &desired);
+            /* if we can do it ourselves, we don't need a stream. */
+            if (!__Sound_InitConverter(&internal->converter, &sample->actual, &desired))
+                internal->stream = SDL_CreateAudioStream(&sample->actual, &desired);
 
-            if (internal->stream == NULL)
+            if ((internal->stream == NULL) && (internal->converter.num_stages == 0))
             {
                 __Sound_SetError(SDL_GetError());
+#if SOUND_SUPPORTS_ALLOC_STATS
+                scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OTHER);
+#endif
                 funcs->close(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+                __Sound_AllocLeave(scope);
+#endif
                 SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET); /* set for next try... */
                 return 0;
             } /* if */
@@ -380,14 +737,6 @@ static int init_sample(const Sound_DecoderFunctions *funcs,
     internal->buffer = sample->buffer;
     internal->buffer_size = sample->buffer_size;
 
-    /* Prepend our new Sound_Sample to the sample_list... */
-    SDL_LockMutex(samplelist_mutex);
-    internal->next = sample_list;
-    if (sample_list != NULL)
-        ((Sound_SampleInternal *) sample_list->opaque)->prev = sample;
-    sample_list = sample;
-    SDL_UnlockMutex(samplelist_mutex);
-
     SNDDBG(("New sample DESIRED format: %s format, %d freq, %d channels.\n",
             fmt_to_str(sample->desired.format),
             sample->desired.freq,
@@ -399,25 +748,53 @@ static int init_sample(const Sound_DecoderFunctions *funcs,
             sample->actual.channels));
 
     SNDDBG(("On-the-fly conversion: %s.\n",
-            (internal->stream != NULL) ? "ENABLED" : "DISABLED"));
+            (internal->stream != NULL) ? "ENABLED" :
+            (internal->converter.num_stages > 0) ? "ENABLED (built-in)" : "DISABLED"));
 
     return 1;
 } /* init_sample */
 
 
-Sound_Sample *Sound_NewSample(SDL_IOStream *io, const char *ext,
-                              const SDL_AudioSpec *desired, Uint32 bSize)
+/*
+ * How much of the start of a stream we hand to the decoders' probe() methods.
+ *  This is read once, and shared by all of them.
+ */
+#define PROBE_HEADER_SIZE 1024
+
+/*
+ * Read the start of the stream for the probe() methods, and put the stream
+ *  back where it was. Returns the number of bytes read into (header), or -1
+ *  if we can't probe this stream (it can't report its position or seek back),
+ *  in which case every decoder should just get a shot at it.
+ */
+static Sint32 read_probe_header(SDL_IOStream *io, Uint8 *header)
 {
-    Sound_Sample *retval;
-    decoder_element *decoder;
+    const Sint64 pos = SDL_TellIO(io);
+    size_t br;
 
-    /* sanity checks. */
-    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
-    BAIL_IF_MACRO(io == NULL, ERR_INVALID_ARGUMENT, NULL);
+    if (pos < 0)
+        return -1;
 
-    retval = alloc_sample(io, desired, bSize);
-    if (!retval)
-        return NULL;  /* alloc_sample() sets error message... */
+    br = SDL_ReadIO(io, header, PROBE_HEADER_SIZE);
+    if (SDL_SeekIO(io, pos, SDL_IO_SEEK_SET) != pos)
+        return -1;
+
+    return (Sint32) br;
+} /* read_probe_header */
+
+
+/*
+ * Find a decoder that will take (sample)'s stream, trying the ones that
+ *  claim (ext) first. Returns zero if nothing could handle it.
+ */
+static int open_decoder(Sound_Sample *retval, const char *ext,
+                        const SDL_AudioSpec *desired)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) retval->opaque;
+    decoder_element *decoder;
+    Uint8 header[PROBE_HEADER_SIZE];
+    Sint32 headerlen = 0;
+    bool probed = false;
 
     if (ext != NULL)
     {
@@ -431,7 +808,7 @@ Sound_Sample *Sound_NewSample(SDL_IOStream *io, const char *ext,
                     if (SDL_strcasecmp(*decoderExt, ext) == 0)
                     {
                         if (init_sample(decoder->funcs, retval, ext, desired))
-                            return retval;
+                            return 1;
                         break;  /* done with this decoder either way. */
                     } /* if */
                     decoderExt++;
@@ -459,84 +836,567 @@ Sound_Sample *Sound_NewSample(SDL_IOStream *io, const char *ext,
                 decoderExt++;
             } /* while */
 
+                /* skip if the data obviously isn't in this format... */
+            if ((should_try) && (decoder->funcs->probe != NULL))
+            {
+                if (!probed)
+                {
+                    headerlen = read_probe_header(internal->io, header);
+                    probed = true;
+                } /* if */
+
+                if (headerlen >= 0)
+                    should_try = decoder->funcs->probe(header, (Uint32) headerlen);
+            } /* if */
+
             if (should_try)
             {
                 if (init_sample(decoder->funcs, retval, ext, desired))
-                    return retval;
+                    return 1;
             } /* if */
         } /* if */
     } /* for */
 
-    /* nothing could handle the sound data... */
-    /* !!! FIXME: can we just push this through Sound_FreeSample() ? */
-    if (retval->opaque != NULL)
+    return 0;  /* nothing could handle the sound data... */
+} /* open_decoder */
+
+
+static Sound_Sample *new_sample(SDL_IOStream *io, const char *ext,
+                                const SDL_AudioSpec *desired, Uint32 bSize)
+{
+    Sound_Sample *retval;
+    Sound_SampleInternal *internal;
+
+    /* sanity checks. */
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
+    BAIL_IF_MACRO(io == NULL, ERR_INVALID_ARGUMENT, NULL);
+
+    retval = alloc_sample(io, desired, bSize);
+    if (!retval)
+        return NULL;  /* alloc_sample() sets error message... */
+
+    if (open_decoder(retval, ext, desired))
     {
-        SDL_DestroyAudioStream(((Sound_SampleInternal *) retval->opaque)->stream);
-        SDL_free(retval->opaque);
+        link_sample(retval);
+        return retval;
     } /* if */
 
-    __Sound_SIMDFree(retval->buffer);
-    SDL_free(retval);
-    SDL_CloseIO(io);
+    internal = (Sound_SampleInternal *) retval->opaque;
+    SDL_DestroyAudioStream(internal->stream);
+    SDL_CloseIO(internal->io);  /* closes the app's stream, too, if wrapped. */
+    release_sample(retval);
     __Sound_SetError(ERR_UNSUPPORTED_FORMAT);
     return NULL;
+} /* new_sample */
+
+
+Sound_Sample *Sound_NewSample(SDL_IOStream *io, const char *ext,
+                              const SDL_AudioSpec *desired, Uint32 bSize)
+{
+    Sound_Sample *retval;
+    __Sound_Trace(SOUND_TRACE_NEWSAMPLE, true, NULL);
+    retval = new_sample(io, ext, desired, bSize);
+    __Sound_Trace(SOUND_TRACE_NEWSAMPLE, false, retval);
+    return retval;
 } /* Sound_NewSample */
 
 
-Sound_Sample *Sound_NewSampleFromFile(const char *filename,
-                                      const SDL_AudioSpec *desired,
-                                      Uint32 bufferSize)
+/*
+ * Build a sample that reads decoded audio out of the cache. This takes over
+ *  the caller's reference to (entry), even if it fails.
+ */
+static Sound_Sample *new_cached_sample(Sound_CacheEntry *entry, Uint32 bSize)
 {
-    const char *ext;
+    Sound_Sample *retval;
+    Sound_SampleInternal *internal;
     SDL_IOStream *io;
 
-    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
-    BAIL_IF_MACRO(filename == NULL, ERR_INVALID_ARGUMENT, NULL);
+    io = __Sound_CacheOpenIO(entry);
+    if (io == NULL)
+    {
+        __Sound_CacheRelease(entry);
+        return NULL;  /* __Sound_CacheOpenIO() sets error message... */
+    } /* if */
 
-    ext = SDL_strrchr(filename, '.');
-    io = SDL_IOFromFile(filename, "rb");
-    BAIL_IF_MACRO(io == NULL, SDL_GetError(), NULL);
+    retval = alloc_sample(io, NULL, bSize);
+    if (!retval)
+    {
+        SDL_CloseIO(io);
+        __Sound_CacheRelease(entry);
+        return NULL;  /* alloc_sample() sets error message... */
+    } /* if */
 
-    if (ext != NULL)
-        ext++;
+    internal = (Sound_SampleInternal *) retval->opaque;
+    internal->decoder_private = entry;  /* CACHE_open() looks for this. */
+    if (!init_sample(&__Sound_DecoderFunctions_CACHE, retval, NULL, NULL))
+    {
+        SDL_CloseIO(internal->io);
+        release_sample(retval);
+        __Sound_CacheRelease(entry);
+        return NULL;
+    } /* if */
 
-    return Sound_NewSample(io, ext, desired, bufferSize);
-} /* Sound_NewSampleFromFile */
+    link_sample(retval);
+    return retval;
+} /* new_cached_sample */
 
 
-Sound_Sample *Sound_NewSampleFromMem(const Uint8 *data,
-                                     Uint32 size,
-                                     const char *ext,
-                                     const SDL_AudioSpec *desired,
-                                     Uint32 bufferSize)
+/*
+ * Put (sample) back to streaming after cache_sample() decoded it all. The
+ *  whole-sample buffer goes first, since Sound_SetBufferSize() would just
+ *  keep using it, being big enough for (bSize) already.
+ */
+static void uncache_sample(Sound_Sample *sample, Uint32 bSize)
 {
-    SDL_IOStream *io;
-
-    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
-    BAIL_IF_MACRO(data == NULL, ERR_INVALID_ARGUMENT, NULL);
-    BAIL_IF_MACRO(size == 0, ERR_INVALID_ARGUMENT, NULL);
-
-    io = SDL_IOFromConstMem(data, size);
-    BAIL_IF_MACRO(io == NULL, SDL_GetError(), NULL);
-
-    return Sound_NewSample(io, ext, desired, bufferSize);
-} /* Sound_NewSampleFromMem */
+    Sound_Rewind(sample);
+    Sound_SetBufferSize(sample, 0);
+    Sound_SetBufferSize(sample, bSize);
+} /* uncache_sample */
 
 
-void Sound_FreeSample(Sound_Sample *sample)
+/*
+ * (sample) was just opened for something that isn't in the cache yet. If
+ *  it'll fit, decode all of it, hand the result to the cache, and give back
+ *  a sample that reads from there instead. Otherwise, or if decoding goes
+ *  wrong, (sample) is put back the way it was and returned as-is.
+ */
+static Sound_Sample *cache_sample(Sound_Sample *sample, const Sound_CacheKey *key,
+                                  Uint32 bSize)
 {
-    Sound_SampleInternal *internal;
-
-    if (!initialized)
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Uint64 budget = __Sound_CacheBudget();
+    Sound_CacheEntry *entry;
+    Uint64 frames;
+    Uint32 decoded;
+
+    if ((sample->flags & SOUND_SAMPLEFLAG_CANSEEK) == 0)
+        return sample;  /* couldn't go back to streaming if this goes wrong. */
+    else if (internal->total_time <= 0)
+        return sample;  /* no idea how big it is; don't risk decoding it all. */
+
+    frames = (((Uint64) internal->total_time) * ((Uint64) sample->desired.freq)) / 1000;
+    if ((frames * SDL_AUDIO_FRAMESIZE(sample->desired)) > budget)
+        return sample;  /* wouldn't stay in the cache anyhow. */
+
+    decoded = Sound_DecodeAll(sample);
+    if ( (decoded == 0) || (sample->flags & SOUND_SAMPLEFLAG_ERROR) )
     {
-        __Sound_SetError(ERR_NOT_INITIALIZED);
-        return;
+        /* just go back to streaming it; the app can sort out any error. */
+        uncache_sample(sample, bSize);
+        return sample;
     } /* if */
 
-    if (sample == NULL)
+    entry = __Sound_CacheAdd(key, sample, sample->buffer, decoded);
+    if (entry == NULL)
     {
-        __Sound_SetError(ERR_INVALID_ARGUMENT);
-        return;
+        uncache_sample(sample, bSize);
+        return sample;
+    } /* if */
+
+    /* the cache owns the decoded audio now. */
+    internal->buffer = sample->buffer = NULL;
+    internal->buffer_size = sample->buffer_size = 0;
+    internal->buffer_capacity = 0;
+    Sound_FreeSample(sample);
+
+    return new_cached_sample(entry, bSize);
+} /* cache_sample */
+
+
+#if SOUND_SUPPORTS_MMAP
+/*
+ * Files at least this big are mapped into memory by Sound_NewSampleFromFile().
+ *  Smaller ones are just read; buffered reads are cheap enough there, and
+ *  setting up a mapping isn't free.
+ */
+#define MMAP_MIN_FILE_SIZE (64 * 1024)
+
+/*
+ * A read-only SDL_IOStream over a mapped file. Reads are memcpy()s out of
+ *  the page cache and seeks are free, and the mapping is advertised with the
+ *  same properties SDL_IOFromConstMem() sets, so decoders that want the
+ *  whole file at once can use it in place.
+ */
+typedef struct MappedFile
+{
+    Uint8 *base;
+    size_t size;
+    size_t pos;
+} MappedFile;
+
+static Sint64 SDLCALL mapped_io_size(void *userdata)
+{
+    return (Sint64) ((MappedFile *) userdata)->size;
+} /* mapped_io_size */
+
+
+static Sint64 SDLCALL mapped_io_seek(void *userdata, Sint64 offset, SDL_IOWhence whence)
+{
+    MappedFile *mapped = (MappedFile *) userdata;
+    Sint64 pos;
+
+    switch (whence)
+    {
+        case SDL_IO_SEEK_SET: pos = offset; break;
+        case SDL_IO_SEEK_CUR: pos = ((Sint64) mapped->pos) + offset; break;
+        case SDL_IO_SEEK_END: pos = ((Sint64) mapped->size) + offset; break;
+        default: BAIL_MACRO(ERR_INVALID_ARGUMENT, -1);
+    } /* switch */
+
+    /* clamp it, like SDL's memory streams do. */
+    if (pos < 0)
+        pos = 0;
+    else if (pos > (Sint64) mapped->size)
+        pos = (Sint64) mapped->size;
+
+    mapped->pos = (size_t) pos;
+    return pos;
+} /* mapped_io_seek */
+
+
+static size_t SDLCALL mapped_io_read(void *userdata, void *ptr, size_t size, SDL_IOStatus *status)
+{
+    MappedFile *mapped = (MappedFile *) userdata;
+    const size_t avail = mapped->size - mapped->pos;
+
+    if (size > avail)
+        size = avail;
+
+    if (size == 0)
+        *status = SDL_IO_STATUS_EOF;
+    else
+    {
+        SDL_memcpy(ptr, mapped->base + mapped->pos, size);
+        mapped->pos += size;
+    } /* else */
+
+    return size;
+} /* mapped_io_read */
+
+
+static size_t SDLCALL mapped_io_write(void *userdata, const void *ptr, size_t size, SDL_IOStatus *status)
+{
+    *status = SDL_IO_STATUS_READONLY;
+    return 0;
+} /* mapped_io_write */
+
+
+static bool SDLCALL mapped_io_close(void *userdata)
+{
+    MappedFile *mapped = (MappedFile *) userdata;
+    munmap(mapped->base, mapped->size);
+    SDL_free(mapped);
+    return true;
+} /* mapped_io_close */
+
+
+/* Returns NULL if (filename) can't or shouldn't be mapped; just read it. */
+static SDL_IOStream *open_mapped_file(const char *filename)
+{
+    SDL_IOStreamInterface iface;
+    SDL_PropertiesID props;
+    SDL_IOStream *retval;
+    MappedFile *mapped;
+    struct stat statbuf;
+    void *base;
+    int fd;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+
+    /* only regular files; pipes and devices can't be mapped, or change size. */
+    if ( (fstat(fd, &statbuf) == -1) || (!S_ISREG(statbuf.st_mode)) ||
+         (statbuf.st_size < MMAP_MIN_FILE_SIZE) ||
+         (((Uint64) statbuf.st_size) > ((Uint64) SDL_SIZE_MAX)) )
+    {
+        close(fd);
+        return NULL;
+    } /* if */
+
+    base = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  /* the mapping keeps its own reference to the file. */
+    if (base == MAP_FAILED)
+        return NULL;
+
+    mapped = (MappedFile *) SDL_malloc(sizeof (MappedFile));
+    if (mapped == NULL)
+    {
+        munmap(base, (size_t) statbuf.st_size);
+        return NULL;
+    } /* if */
+
+    mapped->base = (Uint8 *) base;
+    mapped->size = (size_t) statbuf.st_size;
+    mapped->pos = 0;
+
+    SDL_INIT_INTERFACE(&iface);
+    iface.size = mapped_io_size;
+    iface.seek = mapped_io_seek;
+    iface.read = mapped_io_read;
+    iface.write = mapped_io_write;
+    iface.close = mapped_io_close;
+
+    retval = SDL_OpenIO(&iface, mapped);
+    if (retval == NULL)
+    {
+        mapped_io_close(mapped);
+        return NULL;
+    } /* if */
+
+    props = SDL_GetIOProperties(retval);
+    SDL_SetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, mapped->base);
+    SDL_SetNumberProperty(props, SDL_PROP_IOSTREAM_MEMORY_SIZE_NUMBER, (Sint64) mapped->size);
+
+    return retval;
+} /* open_mapped_file */
+#endif
+
+
+Sound_Sample *Sound_NewSampleFromFile(const char *filename,
+                                      const SDL_AudioSpec *desired,
+                                      Uint32 bufferSize)
+{
+    Sound_CacheKey key;
+    Sound_CacheEntry *entry;
+    Sound_Sample *retval;
+    bool cacheable = false;
+    const char *ext;
+    SDL_IOStream *io;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
+    BAIL_IF_MACRO(filename == NULL, ERR_INVALID_ARGUMENT, NULL);
+
+    if (__Sound_CacheBudget() > 0)
+        cacheable = __Sound_CacheKeyFromFile(&key, filename, desired);
+
+    if (cacheable)
+    {
+        entry = __Sound_CacheFind(&key);
+        if (entry != NULL)
+        {
+            __Sound_Trace(SOUND_TRACE_NEWSAMPLE, true, NULL);
+            retval = new_cached_sample(entry, bufferSize);
+            __Sound_Trace(SOUND_TRACE_NEWSAMPLE, false, retval);
+            return retval;
+        } /* if */
+    } /* if */
+
+    ext = SDL_strrchr(filename, '.');
+#if SOUND_SUPPORTS_MMAP
+    io = open_mapped_file(filename);
+    if (io == NULL)
+#endif
+    io = SDL_IOFromFile(filename, "rb");
+    BAIL_IF_MACRO(io == NULL, SDL_GetError(), NULL);
+
+    if (ext != NULL)
+        ext++;
+
+    retval = Sound_NewSample(io, ext, desired, bufferSize);
+    if ((retval != NULL) && (cacheable))
+        retval = cache_sample(retval, &key, bufferSize);
+    return retval;
+} /* Sound_NewSampleFromFile */
+
+
+Sound_Sample *Sound_NewSampleFromMem(const Uint8 *data,
+                                     Uint32 size,
+                                     const char *ext,
+                                     const SDL_AudioSpec *desired,
+                                     Uint32 bufferSize)
+{
+    Sound_CacheKey key;
+    Sound_CacheEntry *entry;
+    Sound_Sample *retval;
+    const bool cacheable = (__Sound_CacheBudget() > 0);
+    SDL_IOStream *io;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
+    BAIL_IF_MACRO(data == NULL, ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF_MACRO(size == 0, ERR_INVALID_ARGUMENT, NULL);
+
+    if (cacheable)
+    {
+        __Sound_CacheKeyFromMem(&key, data, size, desired);
+        entry = __Sound_CacheFind(&key);
+        if (entry != NULL)
+        {
+            __Sound_Trace(SOUND_TRACE_NEWSAMPLE, true, NULL);
+            retval = new_cached_sample(entry, bufferSize);
+            __Sound_Trace(SOUND_TRACE_NEWSAMPLE, false, retval);
+            return retval;
+        } /* if */
+    } /* if */
+
+    io = SDL_IOFromConstMem(data, size);
+    BAIL_IF_MACRO(io == NULL, SDL_GetError(), NULL);
+
+    retval = Sound_NewSample(io, ext, desired, bufferSize);
+    if ((retval != NULL) && (cacheable))
+        retval = cache_sample(retval, &key, bufferSize);
+    return retval;
+} /* Sound_NewSampleFromMem */
+
+
+/*
+ * How much a push sample should have before its first try at finding a
+ *  decoder. Each try that comes up short waits for twice as much again,
+ *  so pushing lots of small pieces doesn't mean as many tries.
+ */
+#define PUSH_OPEN_MIN_BYTES 4096
+
+/*
+ * Try to find a decoder for a push sample, with everything pushed so far.
+ *  If one fails just because it ran out of data, wait for more (or the end)
+ *  and try again then. Returns zero if this sample won't ever open.
+ */
+static int push_open(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_PushBuffer *pb = internal->push;
+    const bool ended = __Sound_PushEnded(pb);
+    const Uint64 total = __Sound_PushTotal(pb);
+    SDL_AudioSpec desired;
+
+    if (internal->funcs != NULL)
+        return 1;  /* already open. */
+    else if ((!ended) && (total < internal->push_retry_at))
+        return 1;  /* not worth another try yet. */
+
+    SDL_copyp(&desired, &sample->desired);
+    SDL_SeekIO(internal->io, 0, SDL_IO_SEEK_SET);
+    __Sound_PushStarved(pb);  /* reset it. */
+
+    if (open_decoder(sample, internal->push_ext, &desired))
+    {
+        /* we can't go back to the start anymore, so no seeking. */
+        sample->flags &= ~SOUND_SAMPLEFLAG_CANSEEK;
+        __Sound_PushForget(pb);
+        if (internal->resample_quality != SOUND_RESAMPLE_DEFAULT)
+        {
+            SDL_copyp(&desired, &sample->desired);
+            Sound_SetDesiredFormat(sample, &desired);
+        } /* if */
+        return 1;
+    } /* if */
+
+    /* init_sample() leaves the last decoder it tried behind; clear it out. */
+    sample->decoder = NULL;
+    internal->funcs = NULL;
+    sample->flags = 0;
+    SDL_zero(sample->actual);
+    SDL_copyp(&sample->desired, &desired);
+    internal->total_time = -1;
+
+    if ((__Sound_PushStarved(pb)) && (!ended))
+    {
+        internal->push_retry_at = SDL_max(total * 2, PUSH_OPEN_MIN_BYTES);
+        return 1;  /* maybe it'll work with more data. */
+    } /* if */
+
+    sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+    BAIL_MACRO(ERR_UNSUPPORTED_FORMAT, 0);
+} /* push_open */
+
+
+Sound_Sample *Sound_NewPushSample(const char *ext, const SDL_AudioSpec *desired,
+                                  Uint32 bufferSize)
+{
+    Sound_PushBuffer *pb = NULL;
+    Sound_SampleInternal *internal;
+    Sound_Sample *retval;
+    SDL_IOStream *io;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, NULL);
+
+    io = __Sound_PushOpenIO(&pb);
+    if (io == NULL)
+        return NULL;  /* __Sound_PushOpenIO() sets the error message. */
+
+    retval = alloc_sample(io, desired, bufferSize);
+    if (retval == NULL)
+    {
+        SDL_CloseIO(io);
+        return NULL;  /* alloc_sample() sets error message... */
+    } /* if */
+
+    internal = (Sound_SampleInternal *) retval->opaque;
+    internal->push = pb;
+    internal->total_time = -1;
+    internal->push_retry_at = PUSH_OPEN_MIN_BYTES;
+    if (ext != NULL)
+    {
+        internal->push_ext = SDL_strdup(ext);
+        if (internal->push_ext == NULL)
+        {
+            SDL_CloseIO(internal->io);
+            release_sample(retval);
+            BAIL_MACRO(ERR_OUT_OF_MEMORY, NULL);
+        } /* if */
+    } /* if */
+
+    link_sample(retval);
+    return retval;
+} /* Sound_NewPushSample */
+
+
+int Sound_PushData(Sound_Sample *sample, const void *data, Uint32 len)
+{
+    Sound_SampleInternal *internal;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO((data == NULL) && (len > 0), ERR_INVALID_ARGUMENT, 0);
+    internal = (Sound_SampleInternal *) sample->opaque;
+    BAIL_IF_MACRO(internal->push == NULL, ERR_NOT_PUSH_SAMPLE, 0);
+    BAIL_IF_MACRO(__Sound_PushEnded(internal->push), ERR_PUSH_ENDED, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
+
+    if ((len > 0) && (!__Sound_PushAppend(internal->push, data, len)))
+        return 0;  /* __Sound_PushAppend() sets the error message. */
+
+    return push_open(sample);
+} /* Sound_PushData */
+
+
+int Sound_PushEnd(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    internal = (Sound_SampleInternal *) sample->opaque;
+    BAIL_IF_MACRO(internal->push == NULL, ERR_NOT_PUSH_SAMPLE, 0);
+    BAIL_IF_MACRO(__Sound_PushEnded(internal->push), ERR_PUSH_ENDED, 0);
+
+    __Sound_PushEnd(internal->push);
+    if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+        return 1;  /* nothing more to do; the error was already reported. */
+    return push_open(sample);
+} /* Sound_PushEnd */
+
+
+static int stop_decode_ahead(Sound_Sample *sample, bool resync);  /* below. */
+static void drop_leftover(Sound_SampleInternal *internal);  /* below. */
+
+void Sound_FreeSample(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal;
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+
+    if (!initialized)
+    {
+        __Sound_SetError(ERR_NOT_INITIALIZED);
+        return;
+    } /* if */
+
+    if (sample == NULL)
+    {
+        __Sound_SetError(ERR_INVALID_ARGUMENT);
+        return;
     } /* if */
 
     internal = (Sound_SampleInternal *) sample->opaque;
@@ -565,16 +1425,25 @@ void Sound_FreeSample(Sound_Sample *sample)
 
     SDL_UnlockMutex(samplelist_mutex);
 
+    stop_decode_ahead(sample, false);
+
     /* nuke it... */
-    internal->funcs->close(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OTHER);
+#endif
+    if (internal->funcs != NULL)  /* a push sample might not have a decoder yet. */
+        internal->funcs->close(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    __Sound_AllocLeave(scope);
+#endif
 
     if (internal->io != NULL)  /* this condition is a "just in case" thing. */
-        SDL_CloseIO(internal->io);
+        SDL_CloseIO(internal->io);  /* frees internal->push, too. */
+
+    SDL_free(internal->push_ext);
 
     SDL_DestroyAudioStream(internal->stream);
-    SDL_free(internal);
-    __Sound_SIMDFree(sample->buffer);
-    SDL_free(sample);
+    release_sample(sample);
 } /* Sound_FreeSample */
 
 
@@ -586,8 +1455,37 @@ int Sound_SetBufferSize(Sound_Sample *sample, Uint32 newSize)
     BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
     BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
     internal = ((Sound_SampleInternal *) sample->opaque);
-    newBuf = __Sound_SIMDRealloc(sample->buffer, newSize);
-    BAIL_IF_MACRO(newBuf == NULL, ERR_OUT_OF_MEMORY, 0);
+    BAIL_IF_MACRO(internal->ahead != NULL, ERR_DECODING_AHEAD, 0);
+
+    if (newSize == 0)  /* drop the buffer; app will use Sound_DecodeInto(). */
+    {
+        release_buffer(sample->buffer, internal->buffer_capacity);
+        internal->buffer = sample->buffer = NULL;
+        internal->buffer_size = sample->buffer_size = 0;
+        internal->buffer_capacity = 0;
+        return 1;
+    } /* if */
+
+    if (newSize <= internal->buffer_capacity)  /* already have the space. */
+        newBuf = sample->buffer;
+
+    else if (pool_buffer_class(newSize) >= 0)  /* swap for a pooled buffer. */
+    {
+        Uint32 capacity = 0;
+        newBuf = acquire_buffer(newSize, &capacity);
+        BAIL_IF_MACRO(newBuf == NULL, ERR_OUT_OF_MEMORY, 0);
+        if (sample->buffer != NULL)
+            SDL_memcpy(newBuf, sample->buffer, sample->buffer_size);
+        release_buffer(sample->buffer, internal->buffer_capacity);
+        internal->buffer_capacity = capacity;
+    } /* else if */
+
+    else
+    {
+        newBuf = __Sound_SIMDRealloc(sample->buffer, newSize);
+        BAIL_IF_MACRO(newBuf == NULL, ERR_OUT_OF_MEMORY, 0);
+        internal->buffer_capacity = newSize;
+    } /* else */
 
     internal->buffer = sample->buffer = newBuf;
     internal->buffer_size = sample->buffer_size = newSize;
@@ -596,14 +1494,104 @@ int Sound_SetBufferSize(Sound_Sample *sample, Uint32 newSize)
 } /* Sound_SetBufferSize */
 
 
+/* do (a) and (b) have the same format and channels? */
+static bool same_layout(const SDL_AudioSpec *a, const SDL_AudioSpec *b)
+{
+    return ((a->format == b->format) && (a->channels == b->channels));
+} /* same_layout */
+
+
+/*
+ * Try to set (sample) up to get to (desired) with SDL_sound's own resampler,
+ *  at the quality the app picked. It resamples in SDL_AUDIO_F32, with the
+ *  smaller channel count when changing between mono and stereo, and the
+ *  built-in converter gets the audio to and from that. Returns false,
+ *  changing nothing, if it can't, and SDL_AudioStream has to do it.
+ */
+static bool init_resampling(Sound_Sample *sample, const SDL_AudioSpec *desired)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_Converter cvtin, cvtout;
+    SDL_AudioSpec in, out;
+    Sound_Resampler *rs;
+
+    if ((internal->resample_quality == SOUND_RESAMPLE_DEFAULT) || (desired->freq == sample->actual.freq))
+        return false;
+
+    in.format = SDL_AUDIO_F32;
+    in.channels = sample->actual.channels;
+    in.freq = sample->actual.freq;
+    if (desired->channels != sample->actual.channels)
+    {
+        if ((sample->actual.channels > 2) || (desired->channels < 1) || (desired->channels > 2))
+            return false;
+        in.channels = 1;
+    } /* if */
+
+    SDL_copyp(&out, &in);
+    out.freq = desired->freq;
+
+    SDL_zero(cvtin);
+    SDL_zero(cvtout);
+    if (!same_layout(&sample->actual, &in) && !__Sound_InitConverter(&cvtin, &sample->actual, &in))
+        return false;
+    else if (!same_layout(&out, desired) && !__Sound_InitConverter(&cvtout, &out, desired))
+        return false;
+
+    rs = __Sound_CreateResampler(internal->resample_quality, in.channels, in.freq, out.freq);
+    if (rs == NULL)
+        return false;
+
+    __Sound_DestroyResampler(internal->resampler);
+    internal->resampler = rs;
+    SDL_copyp(&internal->resample_in, &cvtin);
+    SDL_copyp(&internal->resample_out, &cvtout);
+    return true;
+} /* init_resampling */
+
+
+static void drop_resampler(Sound_SampleInternal *internal)
+{
+    __Sound_DestroyResampler(internal->resampler);
+    internal->resampler = NULL;
+} /* drop_resampler */
+
+
 int Sound_SetDesiredFormat(Sound_Sample *sample, const SDL_AudioSpec *desired)
 {
     Sound_SampleInternal *internal = NULL;
+    Sound_Converter cvt;
     Uint32 framesize;
+    bool idle;
 
     BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
     BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
     internal = ((Sound_SampleInternal *) sample->opaque);
+    BAIL_IF_MACRO(internal->ahead != NULL, ERR_DECODING_AHEAD, 0);
+
+    /* a push sample without a decoder yet just remembers this for later. */
+    if (internal->funcs == NULL)
+    {
+        if (desired != NULL)
+            SDL_copyp(&sample->desired, desired);
+        else
+            SDL_zero(sample->desired);
+        return 1;
+    } /* if */
+
+    /* What a stopped worker left behind is in the old format, so throw it out
+       and have the decoder go back to where the app is, as near as it can. */
+    if ( (internal->leftover != NULL) &&
+         (SDL_memcmp(desired ? desired : &sample->actual, &sample->desired, sizeof (SDL_AudioSpec)) != 0) )
+    {
+        const Sint64 frame = Sound_TellFrame(sample);
+        drop_leftover(internal);
+        if (sample->flags & SOUND_SAMPLEFLAG_CANSEEK)
+            BAIL_IF_MACRO(!Sound_SeekFrame(sample, (Uint64) frame), NULL, 0);
+    } /* if */
+
+    /* we can only drop the stream for something else if it has nothing queued. */
+    idle = ((!internal->stream) || (SDL_GetAudioStreamQueued(internal->stream) == 0));
 
     /* no conversion necessary. */
     if (!desired || (SDL_memcmp(desired, &sample->actual, sizeof (*desired)) == 0)) {
@@ -611,12 +1599,31 @@ int Sound_SetDesiredFormat(Sound_Sample *sample, const SDL_AudioSpec *desired)
             SDL_DestroyAudioStream(internal->stream);
             internal->stream = NULL;
         }
+        internal->converter.num_stages = 0;
+        drop_resampler(internal);
         SDL_copyp(&sample->desired, &sample->actual);
+    } else if (idle && init_resampling(sample, desired)) {  /* we resample this ourselves. */
+        if (internal->stream) {
+            SDL_DestroyAudioStream(internal->stream);
+            internal->stream = NULL;
+        }
+        internal->converter.num_stages = 0;
+        SDL_copyp(&sample->desired, desired);
+    } else if (idle && __Sound_InitConverter(&cvt, &sample->actual, desired)) {  /* we convert this ourselves. */
+        if (internal->stream) {
+            SDL_DestroyAudioStream(internal->stream);
+            internal->stream = NULL;
+        }
+        SDL_copyp(&internal->converter, &cvt);
+        drop_resampler(internal);
+        SDL_copyp(&sample->desired, desired);
     } else if (!internal->stream) {  /* have to convert formats and we need an audiostream. */
         internal->stream = SDL_CreateAudioStream(&sample->actual, desired);
         if (!internal->stream) {
             return 0;
         }
+        internal->converter.num_stages = 0;
+        drop_resampler(internal);
         SDL_copyp(&sample->desired, desired);
     } else {  /* have to convert formats and we have a stream, so just adjust it. */
         if (!SDL_SetAudioStreamFormat(internal->stream, NULL, desired)) {
@@ -636,44 +1643,564 @@ int Sound_SetDesiredFormat(Sound_Sample *sample, const SDL_AudioSpec *desired)
 } /* Sound_SetDesiredFormat */
 
 
-Uint32 Sound_Decode(Sound_Sample *sample)
+int Sound_SetResampleQuality(Sound_Sample *sample, Sound_ResampleQuality quality)
 {
     Sound_SampleInternal *internal = NULL;
-    int available;
+    Sound_ResampleQuality oldquality;
+    SDL_AudioSpec desired;
 
-        /* a boatload of sanity checks... */
     BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
     BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
-    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PREV_EOF, 0);
+    BAIL_IF_MACRO((quality < SOUND_RESAMPLE_DEFAULT) || (quality > SOUND_RESAMPLE_LONG_FIR), ERR_INVALID_ARGUMENT, 0);
+    internal = ((Sound_SampleInternal *) sample->opaque);
+    BAIL_IF_MACRO(internal->ahead != NULL, ERR_DECODING_AHEAD, 0);
 
-    internal = (Sound_SampleInternal *) sample->opaque;
+    if (quality == internal->resample_quality)
+        return 1;
+
+    /* set up the current format again, with the new quality. */
+    oldquality = internal->resample_quality;
+    internal->resample_quality = quality;
+    SDL_copyp(&desired, &sample->desired);
+    if (!Sound_SetDesiredFormat(sample, &desired))
+    {
+        internal->resample_quality = oldquality;
+        return 0;
+    } /* if */
+
+    return 1;
+} /* Sound_SetResampleQuality */
+
+
+/* All calls to the decoder's read() method go through here. */
+static Uint32 read_decoder(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+#if SOUND_SUPPORTS_STATS
+    const Uint64 start = SDL_GetTicksNS();
+#endif
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+    Uint32 retval;
+
+    /* reset EAGAIN. Decoder can flip it back on if it needs to. */
+    sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
+
+    __Sound_Trace(SOUND_TRACE_READ, true, sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_READ);
+#endif
+    retval = internal->funcs->read(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    __Sound_AllocLeave(scope);
+#endif
+    __Sound_Trace(SOUND_TRACE_READ, false, sample);
+
+#if SOUND_SUPPORTS_STATS
+    internal->stats.decode_ns += SDL_GetTicksNS() - start;
+    internal->stats.decoder_reads++;
+    internal->stats_decoded_bytes += retval;
+#endif
+
+    return retval;
+} /* read_decoder */
+
+
+Uint32 __Sound_ReadPCM(Sound_Sample *sample, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+
+    if (internal->view_wanted)
+    {
+        const SDL_PropertiesID props = SDL_GetIOProperties(internal->io);
+        const Uint8 *mem = (const Uint8 *) SDL_GetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, NULL);
+        const Sint64 memlen = SDL_GetNumberProperty(props, SDL_PROP_IOSTREAM_MEMORY_SIZE_NUMBER, 0);
+        const Sint64 pos = (mem != NULL) ? SDL_TellIO(internal->io) : -1;
+
+        if ((pos >= 0) && (pos <= memlen))
+        {
+            if (((Sint64) len) > (memlen - pos))
+                len = (Uint32) (memlen - pos);
+
+            if (SDL_SeekIO(internal->io, (Sint64) len, SDL_IO_SEEK_CUR) == (pos + len))
+            {
+                internal->view = mem + pos;
+#if SOUND_SUPPORTS_STATS
+                internal->stats.io_read_calls++;
+                internal->stats.io_bytes_read += len;
+#endif
+                return len;
+            } /* if */
+
+            SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);  /* just in case. */
+        } /* if */
+    } /* if */
+
+    return (Uint32) __Sound_ReadFrames(internal->io, internal->buffer, len, (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual));
+} /* __Sound_ReadPCM */
+
+
+size_t __Sound_ReadFrames(SDL_IOStream *io, void *buf, size_t len, Uint32 framesize)
+{
+    size_t retval = SDL_ReadIO(io, buf, len);
+
+    /* a short read might just be all there was this time; keep going until
+       the stream says why it stopped. */
+    while ((retval > 0) && (retval < len) && (SDL_GetIOStatus(io) == SDL_IO_STATUS_READY))
+    {
+        const size_t br = SDL_ReadIO(io, ((Uint8 *) buf) + retval, len - retval);
+        if (br == 0)
+            break;
+        retval += br;
+    } /* while */
+
+    if ((retval < len) && (framesize > 1) && (SDL_GetIOStatus(io) == SDL_IO_STATUS_NOT_READY))
+    {
+        const size_t partial = retval % framesize;
+        if ((partial > 0) && (SDL_SeekIO(io, -((Sint64) partial), SDL_IO_SEEK_CUR) != -1))
+            retval -= partial;
+    } /* if */
+
+    return retval;
+} /* __Sound_ReadFrames */
+
+
+bool __Sound_IOBufferFill(Sound_IOBuffer *iob, SDL_IOStream *io, Uint32 len)
+{
+    Uint32 avail = iob->len - iob->pos;
+
+    if ((!iob->staging) || (avail >= len) || (iob->ended))
+        return true;
+
+    /* room for twice what's asked, so we only slide things down now and then. */
+    if (len > (iob->capacity / 2))
+    {
+        void *ptr = (len <= 0x7FFFFFFF) ? SDL_realloc(iob->data, len * 2) : NULL;
+        if (ptr == NULL)
+            return true;  /* just read straight through, like we used to. */
+        iob->data = (Uint8 *) ptr;
+        iob->capacity = len * 2;
+    } /* if */
+
+    if ((iob->capacity - iob->len) < (len - avail))
+    {
+        SDL_memmove(iob->data, iob->data + iob->pos, avail);
+        iob->len = avail;
+        iob->pos = 0;
+    } /* if */
+
+    while (avail < len)
+    {
+        const size_t rc = SDL_ReadIO(io, iob->data + iob->len, iob->capacity - iob->len);
+        if (rc == 0)
+        {
+            if (SDL_GetIOStatus(io) == SDL_IO_STATUS_NOT_READY)
+                return false;
+            iob->ended = true;
+            break;
+        } /* if */
+        iob->len += (Uint32) rc;
+        avail += (Uint32) rc;
+    } /* while */
+
+    return true;
+} /* __Sound_IOBufferFill */
+
+
+size_t __Sound_IOBufferRead(Sound_IOBuffer *iob, SDL_IOStream *io, void *ptr, size_t len)
+{
+    Uint8 *dst = (Uint8 *) ptr;
+    size_t retval = SDL_min((size_t) (iob->len - iob->pos), len);
+
+    if (retval > 0)
+    {
+        SDL_memcpy(dst, iob->data + iob->pos, retval);
+        iob->pos += (Uint32) retval;
+        if (iob->pos == iob->len)
+            iob->pos = iob->len = 0;
+    } /* if */
+
+    while (retval < len)
+    {
+        const size_t rc = SDL_ReadIO(io, dst + retval, len - retval);
+        if (rc == 0)
+        {
+            if (SDL_GetIOStatus(io) == SDL_IO_STATUS_NOT_READY)
+                iob->starved = iob->staging = true;
+            else
+                iob->ended = true;
+            break;
+        } /* if */
+        retval += rc;
+    } /* while */
+
+    return retval;
+} /* __Sound_IOBufferRead */
+
+
+bool __Sound_IOBufferSeek(Sound_IOBuffer *iob, SDL_IOStream *io, Sint64 offset, SDL_IOWhence whence)
+{
+    const Uint32 avail = iob->len - iob->pos;
+
+    /* skipping ahead through what we have doesn't need a seekable stream. */
+    if ((whence == SDL_IO_SEEK_CUR) && (offset >= 0) && (offset <= (Sint64) avail))
+    {
+        iob->pos += (Uint32) offset;
+        return true;
+    } /* if */
+
+    if (whence == SDL_IO_SEEK_CUR)
+        offset -= (Sint64) avail;
+
+    iob->pos = iob->len = 0;
+    iob->ended = iob->starved = false;
+    return (SDL_SeekIO(io, offset, whence) != -1);
+} /* __Sound_IOBufferSeek */
+
+
+Sint64 __Sound_IOBufferTell(const Sound_IOBuffer *iob, SDL_IOStream *io)
+{
+    const Sint64 pos = SDL_TellIO(io);
+    return (pos < 0) ? pos : (pos - (Sint64) (iob->len - iob->pos));
+} /* __Sound_IOBufferTell */
+
+
+void __Sound_IOBufferFree(Sound_IOBuffer *iob)
+{
+    SDL_free(iob->data);
+    SDL_zerop(iob);
+} /* __Sound_IOBufferFree */
+
+
+/*
+ * Make sure (*buf) is at least (len) bytes, or flag (sample) as broken and
+ *  return NULL. These are scratch space, so nothing in them is kept.
+ */
+static void *grow_buffer(Sound_Sample *sample, void **buf, Uint32 *size, Uint32 len)
+{
+    if (len > *size)
+    {
+        void *ptr = __Sound_SIMDRealloc(*buf, len);
+        if (ptr == NULL)
+        {
+            __Sound_SetError(ERR_OUT_OF_MEMORY);
+            sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+            return NULL;
+        } /* if */
+        *buf = ptr;
+        *size = len;
+    } /* if */
+
+    return *buf;
+} /* grow_buffer */
+
+
+/*
+ * decode_some() for a sample using a Sound_Converter instead of a stream:
+ *  have the decoder put its frames where the converter wants them, then
+ *  convert them in place. This happens in (buf) itself unless the
+ *  conversion needs more room along the way than the result does.
+ */
+static Uint32 decode_converted(Sound_Sample *sample, Uint8 *buf, Uint32 outlen)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Sound_Converter *cvt = &internal->converter;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    const Uint32 actual_framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+    const Uint32 frames = outlen / framesize;
+    void *origbuf = internal->buffer;
+    const Uint32 origsize = internal->buffer_size;
+    Uint8 *work = buf;
+    Uint32 br, decoded;
+#if SOUND_SUPPORTS_STATS
+    Uint64 start;
+#endif
+
+    if (cvt->span > framesize)
+    {
+        work = (Uint8 *) grow_buffer(sample, &internal->convert_buffer,
+                                     &internal->convert_buffer_size, frames * cvt->span);
+        if (work == NULL)
+            return 0;
+    } /* if */
+
+    internal->buffer = work + (frames * cvt->in_offset);
+    internal->buffer_size = frames * actual_framesize;
+    br = read_decoder(sample);
+    internal->buffer = origbuf;
+    internal->buffer_size = origsize;
+
+    decoded = br / actual_framesize;  /* decoders hand back whole frames. */
+    if (decoded == 0)
+        return 0;
+
+#if SOUND_SUPPORTS_STATS
+    start = SDL_GetTicksNS();
+#endif
+
+    /* a short read has to move down to where a shorter conversion expects it. */
+    if ((decoded < frames) && (cvt->in_offset > 0))
+        SDL_memmove(work + (decoded * cvt->in_offset), work + (frames * cvt->in_offset), decoded * actual_framesize);
+
+    __Sound_RunConverter(cvt, work, decoded);
 
-    SDL_assert(sample->buffer != NULL);
-    SDL_assert(sample->buffer_size > 0);
-    SDL_assert(internal->buffer != NULL);
-    SDL_assert(internal->buffer_size > 0);
+    if (work != buf)
+        SDL_memcpy(buf, work, decoded * framesize);
+
+#if SOUND_SUPPORTS_STATS
+    internal->stats.convert_ns += SDL_GetTicksNS() - start;
+#endif
+
+    return decoded * framesize;
+} /* decode_converted */
+
+
+/* most frames to decode into the resampler at a time. */
+#define RESAMPLE_CHUNK_FRAMES 4096
+
+/* the resampler's channel count; see init_resampling(). */
+static int resampler_channels(const Sound_Sample *sample)
+{
+    return (sample->actual.channels == sample->desired.channels) ? sample->actual.channels : 1;
+} /* resampler_channels */
+
+
+/*
+ * Decode about (frames) more frames into the resampler, converted to what
+ *  it takes. Returns false if there's nothing more to be had right now.
+ *  Like decode_some(), EOF and errors are held back until the resampler
+ *  has let out everything before them.
+ */
+static bool feed_resampler(Sound_Sample *sample, Uint32 frames)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Sound_Converter *cvt = &internal->resample_in;
+    const Uint32 actual_framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+    const Uint32 span = (cvt->num_stages > 0) ? cvt->span : actual_framesize;
+    void *origbuf = internal->buffer;
+    const Uint32 origsize = internal->buffer_size;
+    Uint32 decoded = 0;
+    Uint8 *work;
+
+    frames = SDL_min(frames, RESAMPLE_CHUNK_FRAMES);
+    work = (Uint8 *) grow_buffer(sample, &internal->resample_buffer,
+                                 &internal->resample_buffer_size, frames * span);
+    if (work != NULL)
+    {
+        internal->buffer = work + (frames * cvt->in_offset);
+        internal->buffer_size = frames * actual_framesize;
+        decoded = read_decoder(sample) / actual_framesize;
+        internal->buffer = origbuf;
+        internal->buffer_size = origsize;
+    } /* if */
+
+    if (decoded > 0)
+    {
+        if (cvt->num_stages > 0)
+        {
+            if ((decoded < frames) && (cvt->in_offset > 0))
+                SDL_memmove(work + (decoded * cvt->in_offset), work + (frames * cvt->in_offset), decoded * actual_framesize);
+            __Sound_RunConverter(cvt, work, decoded);
+        } /* if */
+
+        if (!__Sound_PutResampler(internal->resampler, (const float *) work, decoded))
+        {
+            __Sound_SetError(ERR_OUT_OF_MEMORY);
+            sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        } /* if */
+    } /* if */
+
+    if (sample->flags & SOUND_SAMPLEFLAG_EOF)
+    {
+        sample->flags &= ~SOUND_SAMPLEFLAG_EOF;
+        internal->pending_eof = true;
+        __Sound_FlushResampler(internal->resampler);
+    } /* if */
+
+    if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+    {
+        sample->flags &= ~SOUND_SAMPLEFLAG_ERROR;
+        internal->pending_error = true;
+        __Sound_FlushResampler(internal->resampler);
+    } /* if */
+
+    return ((decoded > 0) || internal->pending_eof || internal->pending_error);
+} /* feed_resampler */
+
+
+/*
+ * decode_some() for a sample using SDL_sound's own resampler: it works in
+ *  SDL_AUDIO_F32, so internal->resample_in converts the decoder's frames to
+ *  that on the way in, and internal->resample_out converts its frames to
+ *  the desired format in place, the same way decode_converted() does.
+ */
+static Uint32 decode_resampled(Sound_Sample *sample, Uint8 *buf, Uint32 outlen)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_Resampler *rs = internal->resampler;
+    const Sound_Converter *cvt = &internal->resample_out;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    const Uint32 rs_framesize = (Uint32) (resampler_channels(sample) * sizeof (float));
+    const Uint32 frames = outlen / framesize;
+    Uint32 produced = 0;
+    Uint8 *work = buf;
+    Uint8 *out;
+#if SOUND_SUPPORTS_STATS
+    const Uint64 start = SDL_GetTicksNS();
+    const Uint64 decode_start = internal->stats.decode_ns;
+#endif
+
+    if ((cvt->num_stages > 0) && (cvt->span > framesize))
+    {
+        work = (Uint8 *) grow_buffer(sample, &internal->convert_buffer,
+                                     &internal->convert_buffer_size, frames * cvt->span);
+        if (work == NULL)
+            return 0;
+    } /* if */
+
+    out = work + (frames * cvt->in_offset);
+    while (produced < frames)
+    {
+        produced += __Sound_GetResampled(rs, (float *) (out + (produced * rs_framesize)), frames - produced);
+        if ((produced == frames) || internal->pending_eof || internal->pending_error)
+            break;
+        else if (!feed_resampler(sample, SDL_max(__Sound_ResamplerInputNeeded(rs, frames - produced), 1)))
+            break;
+    } /* while */
+
+    if (produced > 0)
+    {
+        if (cvt->num_stages > 0)
+        {
+            if ((produced < frames) && (cvt->in_offset > 0))
+                SDL_memmove(work + (produced * cvt->in_offset), out, produced * rs_framesize);
+            __Sound_RunConverter(cvt, work, produced);
+        } /* if */
+
+        if (work != buf)
+            SDL_memcpy(buf, work, produced * framesize);
+    } /* if */
+
+#if SOUND_SUPPORTS_STATS
+    /* the decoder's share of this was already counted. */
+    internal->stats.convert_ns += (SDL_GetTicksNS() - start) - (internal->stats.decode_ns - decode_start);
+#endif
+
+    if (produced > 0)
+        return produced * framesize;
+
+    /* resampler is empty, set final flags. */
+    if (internal->pending_eof)
+        sample->flags |= SOUND_SAMPLEFLAG_EOF;
+
+    if (internal->pending_error)
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+
+    internal->pending_eof = internal->pending_error = false;
+
+    return 0;
+} /* decode_resampled */
+
+
+/* most bytes to have the decoder produce at once for the audio stream. */
+#define STREAM_READ_MAX (256 * 1024)
+
+/*
+ * How many bytes the decoder should produce for the audio stream to give
+ *  back (outlen) more bytes. That's more than goes in (outlen) when the
+ *  conversion shrinks the data, going to a lower rate or from S32 to S16,
+ *  and asking for it all at once saves calling read() again and again for
+ *  one buffer. Never less than (minlen), which fits in the caller's buffer.
+ */
+static Uint32 stream_read_size(const Sound_Sample *sample, Uint32 outlen, Uint32 minlen)
+{
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+    const Uint64 desired_framesize = (Uint64) SDL_AUDIO_FRAMESIZE(sample->desired);
+    const Uint64 desired_freq = (Uint64) sample->desired.freq;
+    Uint64 frames = ((Uint64) outlen) / desired_framesize;
+    Uint64 retval;
+
+    frames = ((frames * (Uint64) sample->actual.freq) + (desired_freq - 1)) / desired_freq;
+    retval = SDL_min(frames * framesize, (Uint64) (STREAM_READ_MAX - (STREAM_READ_MAX % framesize)));
+    return (retval > minlen) ? (Uint32) retval : minlen;
+} /* stream_read_size */
+
+
+/*
+ * Decode up to (len) bytes, in the desired format, into (buf). This is the
+ *  guts of Sound_Decode() and Sound_DecodeInto(), via decode_into(). The decoder's read() method
+ *  only knows about internal->buffer, so we point that at the caller's memory
+ *  for the duration of the call. When converting, (buf) doubles as scratch
+ *  space for the decoder before the audio stream drains into it, so there's
+ *  no intermediate copy in either case, unless filling (buf) takes more
+ *  decoded audio than fits in it; see stream_read_size().
+ */
+static Uint32 decode_some(Sound_Sample *sample, void *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    const Uint32 outlen = len - (len % framesize);
+    void *origbuf = internal->buffer;
+    const Uint32 origsize = internal->buffer_size;
+    Uint32 retval = 0;
+    Uint32 directlen;
+    int available;
+#if SOUND_SUPPORTS_STATS
+    Uint64 start;
+#endif
+
+    BAIL_IF_MACRO(outlen == 0, ERR_INVALID_ARGUMENT, 0);
+
+    if (internal->resampler != NULL)
+        return decode_resampled(sample, (Uint8 *) buf, outlen);
+    else if (internal->converter.num_stages > 0)
+        return decode_converted(sample, (Uint8 *) buf, outlen);
 
     /* No AudioStream? No conversion. Decode right into the buffer and return it. */
     if (!internal->stream)
     {
-        /* reset EAGAIN. Decoder can flip it back on if it needs to. */
-        sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
-        return internal->funcs->read(sample);
+        internal->buffer = buf;
+        internal->buffer_size = outlen;
+        retval = read_decoder(sample);
+
+        internal->buffer = origbuf;
+        internal->buffer_size = origsize;
+        return retval;
     } /* if */
 
+    /* the decoder has to hand the stream whole frames in its own format. */
+    directlen = len - (len % SDL_AUDIO_FRAMESIZE(sample->actual));
+    BAIL_IF_MACRO(directlen == 0, ERR_INVALID_ARGUMENT, 0);
+
     /* call into the decoder several times until we have enough data. */
-    while ((available = SDL_GetAudioStreamAvailable(internal->stream)) < internal->buffer_size)
+    while ((available = SDL_GetAudioStreamAvailable(internal->stream)) < (int) outlen)
     {
+        const Uint32 readlen = stream_read_size(sample, outlen - (Uint32) available, directlen);
         bool flush_stream = false;
+        bool put_ok = true;
         Uint32 br;
 
         if (internal->pending_eof || internal->pending_error)
             break;
 
-        /* reset EAGAIN. Decoder can flip it back on if it needs to. */
-        sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
-        br = internal->funcs->read(sample);
+        /* if (buf) is too small to decode it all in one go, use our own. */
+        internal->buffer = buf;
+        internal->buffer_size = directlen;
+        if (readlen > directlen)
+        {
+            internal->buffer = grow_buffer(sample, &internal->decode_buffer,
+                                           &internal->decode_buffer_size, readlen);
+            internal->buffer_size = readlen;
+            if (internal->buffer == NULL)
+            {
+                internal->buffer = origbuf;
+                internal->buffer_size = origsize;
+                return 0;  /* oh well. */
+            } /* if */
+        } /* if */
+
+        br = read_decoder(sample);
 
         /* if the sample hit an error or EOF, note it, but don't let these flags
            be set for the calling app until the stream is empty too. */
@@ -691,22 +2218,56 @@ Uint32 Sound_Decode(Sound_Sample *sample)
             flush_stream = true;
         } /* if */
 
-        if ((br > 0) && (!SDL_PutAudioStreamData(internal->stream, internal->buffer, (int) br)))
+#if SOUND_SUPPORTS_STATS
+        start = SDL_GetTicksNS();
+#endif
+
+        if (br > 0)
+        {
+            __Sound_Trace(SOUND_TRACE_STREAM_PUT, true, sample);
+            put_ok = SDL_PutAudioStreamData(internal->stream, internal->buffer, (int) br);
+            __Sound_Trace(SOUND_TRACE_STREAM_PUT, false, sample);
+        } /* if */
+
+        if (!put_ok)
         {
             __Sound_SetError(SDL_GetError());
             sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+            internal->buffer = origbuf;
+            internal->buffer_size = origsize;
             return 0;  /* oh well. */
         } /* if */
 
         if (flush_stream)
             SDL_FlushAudioStream(internal->stream);
+
+#if SOUND_SUPPORTS_STATS
+        internal->stats.convert_ns += SDL_GetTicksNS() - start;
+#endif
+
+        /* a push sample or non-blocking stream that has caught up: hand over
+           what the stream has. */
+        if ((br == 0) && (sample->flags & SOUND_SAMPLEFLAG_EAGAIN))
+            break;
     } /* while */
 
+    internal->buffer = origbuf;
+    internal->buffer_size = origsize;
+
     /* if we hit eof or error, drain the stream before reporting that. */
     if (available > 0)
     {
-        const int readlen = SDL_min(available, sample->buffer_size);
-        const int br = SDL_GetAudioStreamData(internal->stream, sample->buffer, readlen);
+        const int readlen = SDL_min(available, (int) outlen);
+        int br;
+#if SOUND_SUPPORTS_STATS
+        start = SDL_GetTicksNS();
+#endif
+        __Sound_Trace(SOUND_TRACE_STREAM_GET, true, sample);
+        br = SDL_GetAudioStreamData(internal->stream, buf, readlen);
+        __Sound_Trace(SOUND_TRACE_STREAM_GET, false, sample);
+#if SOUND_SUPPORTS_STATS
+        internal->stats.convert_ns += SDL_GetTicksNS() - start;
+#endif
         if (br != readlen)
         {
             __Sound_SetError(SDL_GetError());
@@ -728,99 +2289,1972 @@ Uint32 Sound_Decode(Sound_Sample *sample)
     internal->pending_eof = internal->pending_error = false;
 
     return 0;
-} /* Sound_Decode */
+} /* decode_some */
 
 
-Uint32 Sound_DecodeAll(Sound_Sample *sample)
+/*
+ * Decode-ahead (see Sound_StartDecodeAhead()).
+ *
+ * A worker thread decodes the sample into a ring buffer, and Sound_Decode()
+ *  and friends just copy out of it, so the app's thread never waits on the
+ *  decoder. The ring has a single producer (the worker) and a single
+ *  consumer (whoever calls Sound_Decode()), so its two positions are all the
+ *  synchronization it needs. The positions only ever increase, wrapping at
+ *  2^32, and the ring's size is a power of two so that works out.
+ *
+ * The worker decodes with its own copy of the Sound_Sample (shadow), which
+ *  shares the real one's internal state, so the flags the decoder sets
+ *  don't reach the app until it has read everything decoded before them.
+ *  Those flags are handed over in final_flags once the worker is done.
+ *
+ * Anything that has to touch the decoder from the app's thread (seeking,
+ *  stopping) takes (lock), which the worker holds while it decodes.
+ *
+ * The worker is either a thread of the sample's own, or whichever of the
+ *  shared scheduler's threads picks the sample up (see below); the ring
+ *  works the same either way.
+ */
+#define DECODE_AHEAD_WAIT_MS 100  /* worker naps this long, tops, when idle. */
+#define DECODE_AHEAD_EAGAIN_MS 5  /* ...and this long when the decoder says EAGAIN. */
+
+typedef struct DecodeAhead
 {
-    Sound_SampleInternal *internal = NULL;
-    void *buf = NULL;
-    Uint32 newBufSize = 0;
+    Sound_Sample shadow;  /* what the worker hands to the decoder. */
+    SDL_Thread *thread;
+    SDL_Mutex *lock;  /* held by the worker while it's in the decoder. */
+    SDL_Semaphore *wake;  /* posted when the worker might have work again, or,
+                             if (pooled), when a stopped one lets go. */
+    SDL_AtomicInt waiting;  /* nonzero while the worker is waiting on (wake). */
+    SDL_AtomicInt quit;
+    SDL_AtomicInt final_flags;  /* EOF/ERROR once the worker is done, or 0. */
+    SDL_AtomicInt write_pos;  /* only the worker changes this. */
+    SDL_AtomicInt read_pos;  /* only the consumer changes this. */
+    Uint8 *ring;
+    Uint32 capacity;  /* size of (ring); a power of two. */
+    Uint8 *scratch;  /* the worker decodes into this, then copies to (ring). */
+    Uint32 chunk;  /* size of (scratch); how much the worker decodes at once. */
+    bool pooled;  /* true if the shared scheduler does the work, not (thread). */
+    int priority;  /* a Sound_DecodePriority, if (pooled). */
+    SDL_AtomicInt scheduled;  /* nonzero while queued, stalled, or running. */
+    SDL_AtomicInt queue;  /* the scheduler deque it's on, or SCHED_NOWHERE. */
+    struct DecodeAhead *next_job;  /* for the scheduler's deques. */
+    struct DecodeAhead *prev_job;
+} DecodeAhead;
+
+
+static SDL_INLINE Uint32 decode_ahead_used(DecodeAhead *ahead)
+{
+    const Uint32 w = (Uint32) SDL_GetAtomicInt(&ahead->write_pos);
+    const Uint32 r = (Uint32) SDL_GetAtomicInt(&ahead->read_pos);
+    return w - r;
+} /* decode_ahead_used */
 
-    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
-    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PREV_EOF, 0);
-    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
 
-    internal = (Sound_SampleInternal *) sample->opaque;
+/* Is there anything for the worker to do right now? */
+static SDL_INLINE bool decode_ahead_has_work(DecodeAhead *ahead)
+{
+    return ( (SDL_GetAtomicInt(&ahead->final_flags) == 0) &&
+             ((ahead->capacity - decode_ahead_used(ahead)) >= ahead->chunk) );
+} /* decode_ahead_has_work */
 
-    while ( ((sample->flags & SOUND_SAMPLEFLAG_EOF) == 0) &&
-            ((sample->flags & SOUND_SAMPLEFLAG_ERROR) == 0) )
+
+/*
+ * Decode one chunk into the ring, if there's room. Worker thread only.
+ *  Returns 1 if it decoded something, 0 if there was nothing to do, and -1
+ *  if the decoder couldn't produce anything yet (EAGAIN).
+ */
+static int decode_ahead_fill(DecodeAhead *ahead)
+{
+    Sound_Sample *shadow = &ahead->shadow;
+    bool stalled = false;
+    Uint32 br = 0;
+
+    SDL_LockMutex(ahead->lock);
+    if (decode_ahead_has_work(ahead))
     {
-        Uint32 br = Sound_Decode(sample);
-        void *ptr = __Sound_SIMDRealloc(buf, newBufSize + br);
-        if (ptr == NULL)
+        br = decode_some(shadow, ahead->scratch, ahead->chunk);
+        if (br > 0)
         {
-            sample->flags |= SOUND_SAMPLEFLAG_ERROR;
-            __Sound_SetError(ERR_OUT_OF_MEMORY);
+            const Uint32 w = (Uint32) SDL_GetAtomicInt(&ahead->write_pos);
+            const Uint32 offset = w & (ahead->capacity - 1);
+            const Uint32 first = SDL_min(br, ahead->capacity - offset);
+            SDL_memcpy(ahead->ring + offset, ahead->scratch, first);
+            SDL_memcpy(ahead->ring, ahead->scratch + first, br - first);
+            SDL_SetAtomicInt(&ahead->write_pos, (int) (w + br));
+        } /* if */
+
+        /* publish these _after_ the data, so the consumer sees it first. */
+        if (shadow->flags & (SOUND_SAMPLEFLAG_EOF | SOUND_SAMPLEFLAG_ERROR))
+        {
+            const int flags = (int) (shadow->flags & (SOUND_SAMPLEFLAG_EOF | SOUND_SAMPLEFLAG_ERROR));
+            SDL_SetAtomicInt(&ahead->final_flags, flags);
+        } /* if */
+
+        else if (br == 0)
+            stalled = true;
+    } /* if */
+    SDL_UnlockMutex(ahead->lock);
+
+    return (br > 0) ? 1 : (stalled ? -1 : 0);
+} /* decode_ahead_fill */
+
+
+static int SDLCALL decode_ahead_thread(void *data)
+{
+    DecodeAhead *ahead = (DecodeAhead *) data;
+
+    while (!SDL_GetAtomicInt(&ahead->quit))
+    {
+        const int rc = decode_ahead_fill(ahead);
+        if (rc > 0)
+            continue;
+
+        /* Check again after saying we're waiting, so we can't miss a wakeup. */
+        SDL_SetAtomicInt(&ahead->waiting, 1);
+        if (rc < 0)  /* decoder is starved; give the i/o a moment. */
+            SDL_WaitSemaphoreTimeout(ahead->wake, DECODE_AHEAD_EAGAIN_MS);
+        else if (!decode_ahead_has_work(ahead) && !SDL_GetAtomicInt(&ahead->quit))
+            SDL_WaitSemaphoreTimeout(ahead->wake, DECODE_AHEAD_WAIT_MS);
+        SDL_SetAtomicInt(&ahead->waiting, 0);
+    } /* while */
+
+    return 0;
+} /* decode_ahead_thread */
+
+
+/*
+ * The shared scheduler (see Sound_StartPooledDecodeAhead()).
+ *
+ * A fixed set of threads, one per CPU core, services every pooled sample.
+ *  A job is "decode one chunk for this sample", and a sample is queued
+ *  (scheduled != 0) only while it has room in its ring, so a thousand idle
+ *  streams cost nothing.
+ *
+ * Each thread has a deque of jobs per priority. It takes jobs from the
+ *  front of its own and puts them back on the end after a chunk, so its
+ *  samples take turns; a thread that runs out of work steals from the end
+ *  of someone else's. Every thread takes the highest priority job it can
+ *  find, so real-time streams are topped up before anything gets preloaded,
+ *  and (sched_queued) counts what's waiting at each priority, so nobody
+ *  looks through the deques when there's nothing in them. Samples whose
+ *  decoder says EAGAIN go on one more deque, after the threads' ones, and
+ *  are retried a little later.
+ *
+ * Each thread's deques share a spinlock, so threads only contend when
+ *  stealing, and a job knows which deque it's on (queue), so taking it back
+ *  out doesn't mean searching for it. A scheduler thread that lets go of a
+ *  job that's being stopped posts the job's (wake), which is what
+ *  stop_decode_ahead() waits on. The scheduler is started the first time a
+ *  sample needs it, and stopped by Sound_Quit().
+ */
+#define SCHED_PRIORITIES 3  /* one deque per Sound_DecodePriority. */
+#define SCHED_NOWHERE -1  /* (queue) of a job that isn't on any deque. */
+
+typedef struct SchedQueue
+{
+    SDL_SpinLock lock;
+    DecodeAhead *head[SCHED_PRIORITIES];  /* the owner takes jobs from here... */
+    DecodeAhead *tail[SCHED_PRIORITIES];  /* ...and thieves take them from here. */
+} SchedQueue;
+
+static SDL_Thread **sched_threads = NULL;
+static SchedQueue *sched_queues = NULL;  /* one per thread, then the stalled jobs. */
+static int sched_thread_count = 0;
+static SDL_Semaphore *sched_work = NULL;  /* posted when a job is submitted. */
+static SDL_AtomicInt sched_quit;
+static SDL_AtomicInt sched_next;  /* round-robins submissions across threads. */
+static SDL_AtomicInt sched_queued[SCHED_PRIORITIES];  /* jobs on the threads' deques. */
+static SDL_AtomicInt sched_stalled;  /* jobs on the stalled deque. */
+
+
+static SDL_INLINE SDL_AtomicInt *sched_counter(int index, int priority)
+{
+    return (index == sched_thread_count) ? &sched_stalled : &sched_queued[priority];
+} /* sched_counter */
+
+
+/* Put (job) on the end of deque (index). */
+static void sched_push(int index, DecodeAhead *job)
+{
+    SchedQueue *queue = &sched_queues[index];
+    const int priority = job->priority;
+
+    SDL_LockSpinlock(&queue->lock);
+    job->next_job = NULL;
+    job->prev_job = queue->tail[priority];
+    if (job->prev_job == NULL)
+        queue->head[priority] = job;
+    else
+        job->prev_job->next_job = job;
+    queue->tail[priority] = job;
+    SDL_SetAtomicInt(&job->queue, index);
+    SDL_AddAtomicInt(sched_counter(index, priority), 1);
+    SDL_UnlockSpinlock(&queue->lock);
+} /* sched_push */
+
+
+/* Take (job) off deque (index). Call with that deque's lock held. */
+static void sched_unlink(int index, DecodeAhead *job)
+{
+    SchedQueue *queue = &sched_queues[index];
+    const int priority = job->priority;
+
+    if (job->prev_job == NULL)
+        queue->head[priority] = job->next_job;
+    else
+        job->prev_job->next_job = job->next_job;
+
+    if (job->next_job == NULL)
+        queue->tail[priority] = job->prev_job;
+    else
+        job->next_job->prev_job = job->prev_job;
+
+    job->next_job = NULL;
+    job->prev_job = NULL;
+    SDL_SetAtomicInt(&job->queue, SCHED_NOWHERE);
+    SDL_AddAtomicInt(sched_counter(index, priority), -1);
+} /* sched_unlink */
+
+
+/* Take the job at the front of deque (index), or the end if (steal). */
+static DecodeAhead *sched_take(int index, int priority, bool steal)
+{
+    SchedQueue *queue = &sched_queues[index];
+    DecodeAhead *retval;
+
+    SDL_LockSpinlock(&queue->lock);
+    retval = steal ? queue->tail[priority] : queue->head[priority];
+    if (retval != NULL)
+        sched_unlink(index, retval);
+    SDL_UnlockSpinlock(&queue->lock);
+
+    return retval;
+} /* sched_take */
+
+
+/* Find the most urgent job: our own deque first, then steal. */
+static DecodeAhead *sched_pop(int index)
+{
+    int priority;
+    int i;
+
+    for (priority = SCHED_PRIORITIES - 1; priority >= 0; priority--)
+    {
+        DecodeAhead *job;
+
+        if (SDL_GetAtomicInt(&sched_queued[priority]) == 0)
+            continue;  /* nothing waiting anywhere. */
+
+        job = sched_take(index, priority, false);
+        for (i = 1; (job == NULL) && (i < sched_thread_count); i++)
+            job = sched_take((index + i) % sched_thread_count, priority, true);
+
+        if (job != NULL)
+            return job;
+    } /* for */
+
+    return NULL;
+} /* sched_pop */
+
+
+/* Queue up (ahead) if it isn't already. Safe from any thread. */
+static void sched_submit(DecodeAhead *ahead)
+{
+    if (SDL_CompareAndSwapAtomicInt(&ahead->scheduled, 0, 1))
+    {
+        const int index = (int) (((Uint32) SDL_AddAtomicInt(&sched_next, 1)) % (Uint32) sched_thread_count);
+        sched_push(index, ahead);
+        SDL_SignalSemaphore(sched_work);
+    } /* if */
+} /* sched_submit */
+
+
+/* Put everything that stalled on EAGAIN back in line, on our own deque. */
+static void sched_retry_stalled(int index)
+{
+    int priority;
+
+    for (priority = 0; priority < SCHED_PRIORITIES; priority++)
+    {
+        DecodeAhead *job;
+        while ((job = sched_take(sched_thread_count, priority, false)) != NULL)
+            sched_push(index, job);
+    } /* for */
+} /* sched_retry_stalled */
+
+
+/*
+ * Take (ahead) off whatever deque it's on. Returns false if it isn't on
+ *  one: a scheduler thread is running it, or moving it between deques.
+ */
+static bool sched_remove(DecodeAhead *ahead)
+{
+    int index;
+
+    while ((index = SDL_GetAtomicInt(&ahead->queue)) != SCHED_NOWHERE)
+    {
+        SchedQueue *queue = &sched_queues[index];
+        bool found;
+
+        SDL_LockSpinlock(&queue->lock);
+        found = (SDL_GetAtomicInt(&ahead->queue) == index);
+        if (found)
+            sched_unlink(index, ahead);
+        SDL_UnlockSpinlock(&queue->lock);
+
+        if (found)
+            return true;
+        /* else it moved before we got the lock; look again. */
+    } /* while */
+
+    return false;
+} /* sched_remove */
+
+
+static int SDLCALL sched_thread(void *data)
+{
+    const int index = (int) (intptr_t) data;
+
+    while (!SDL_GetAtomicInt(&sched_quit))
+    {
+        DecodeAhead *job = sched_pop(index);
+
+        if (job == NULL)
+        {
+            const Sint32 timeout = SDL_GetAtomicInt(&sched_stalled) ? DECODE_AHEAD_EAGAIN_MS : -1;
+            if (!SDL_WaitSemaphoreTimeout(sched_work, timeout))
+                sched_retry_stalled(index);
+            continue;
+        } /* if */
+
+        if (!SDL_GetAtomicInt(&job->quit))  /* if it's being stopped, let it go. */
+        {
+            const int rc = decode_ahead_fill(job);
+            if (rc < 0)  /* decoder is starved; try again in a bit. */
+            {
+                sched_push(sched_thread_count, job);
+                continue;
+            } /* if */
+
+            else if (decode_ahead_has_work(job))  /* more to do, but let others have a turn. */
+            {
+                sched_push(index, job);
+                continue;
+            } /* else if */
+        } /* if */
+
+        /* Ring is full, we're done, or it's being stopped. If it isn't being
+           stopped, check again after letting go, in case the consumer
+           drained some and couldn't resubmit us. This is all done under the
+           lock, since once (scheduled) is zero, a stop can free the job as
+           soon as it can get the lock. */
+        SDL_LockMutex(job->lock);
+        SDL_SetAtomicInt(&job->scheduled, 0);
+        if (SDL_GetAtomicInt(&job->quit))
+            SDL_SignalSemaphore(job->wake);  /* stop_decode_ahead() is waiting. */
+        else if (decode_ahead_has_work(job))
+            sched_submit(job);
+        SDL_UnlockMutex(job->lock);
+    } /* while */
+
+    return 0;
+} /* sched_thread */
+
+
+/* Call with samplelist_mutex held. */
+static bool sched_start(void)
+{
+    int count;
+    int i;
+
+    if (sched_threads != NULL)
+        return true;  /* already running. */
+
+    count = SDL_max(SDL_GetNumLogicalCPUCores(), 1);
+    sched_queues = (SchedQueue *) SDL_calloc(count + 1, sizeof (SchedQueue));
+    sched_threads = (SDL_Thread **) SDL_calloc(count, sizeof (SDL_Thread *));
+    sched_work = SDL_CreateSemaphore(0);
+    if (!sched_queues || !sched_threads || !sched_work)
+    {
+        SDL_DestroySemaphore(sched_work);
+        SDL_free(sched_threads);
+        SDL_free(sched_queues);
+        sched_work = NULL;
+        sched_threads = NULL;
+        sched_queues = NULL;
+        BAIL_MACRO(ERR_OUT_OF_MEMORY, false);
+    } /* if */
+
+    SDL_SetAtomicInt(&sched_quit, 0);
+    sched_thread_count = count;
+    for (i = 0; i < count; i++)
+    {
+        sched_threads[i] = SDL_CreateThread(sched_thread, "SDL_sound sched", (void *) (intptr_t) i);
+        if (sched_threads[i] == NULL)
+        {
+            __Sound_SetError(SDL_GetError());
+            sched_stop();  /* shut down whatever did start. */
+            return false;
         } /* if */
+    } /* for */
+
+    return true;
+} /* sched_start */
+
+
+/* Shut the scheduler down. All pooled samples must be stopped already. */
+static void sched_stop(void)
+{
+    int i;
+
+    if (sched_threads == NULL)
+        return;
+
+    SDL_SetAtomicInt(&sched_quit, 1);
+    for (i = 0; i < sched_thread_count; i++)
+        SDL_SignalSemaphore(sched_work);
+    for (i = 0; i < sched_thread_count; i++)
+        SDL_WaitThread(sched_threads[i], NULL);  /* NULL ones are no-ops. */
+
+    SDL_DestroySemaphore(sched_work);
+    SDL_free(sched_threads);
+    SDL_free(sched_queues);
+    sched_work = NULL;
+    sched_threads = NULL;
+    sched_queues = NULL;
+    sched_thread_count = 0;
+    for (i = 0; i < SCHED_PRIORITIES; i++)
+        SDL_SetAtomicInt(&sched_queued[i], 0);
+    SDL_SetAtomicInt(&sched_stalled, 0);
+} /* sched_stop */
+
+
+static void decode_ahead_wake(DecodeAhead *ahead)
+{
+    if (ahead->pooled)
+        sched_submit(ahead);
+    else if (SDL_CompareAndSwapAtomicInt(&ahead->waiting, 1, 0))
+        SDL_SignalSemaphore(ahead->wake);
+} /* decode_ahead_wake */
+
+
+/* Copy decoded data out of the ring. Never blocks. Consumer only. */
+static Uint32 decode_ahead_read(Sound_Sample *sample, DecodeAhead *ahead,
+                                Uint8 *buf, Uint32 len)
+{
+    /* read this first: if it's set, everything the worker wrote is in. */
+    const int final_flags = SDL_GetAtomicInt(&ahead->final_flags);
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    const Uint32 r = (Uint32) SDL_GetAtomicInt(&ahead->read_pos);
+    const Uint32 used = decode_ahead_used(ahead);
+    Uint32 retval = SDL_min(used, len);
+
+    if (!final_flags)
+        retval -= retval % framesize;  /* the rest of the frame is coming. */
+
+    if (retval > 0)
+    {
+        const Uint32 offset = r & (ahead->capacity - 1);
+        const Uint32 first = SDL_min(retval, ahead->capacity - offset);
+        SDL_memcpy(buf, ahead->ring + offset, first);
+        SDL_memcpy(buf + first, ahead->ring, retval - first);
+        SDL_SetAtomicInt(&ahead->read_pos, (int) (r + retval));
+        decode_ahead_wake(ahead);
+    } /* if */
+
+    sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
+    if (final_flags && (retval == used))
+        sample->flags |= (Sound_SampleFlags) final_flags;  /* drained; pass them on. */
+    else if ((!final_flags) && (retval < len))
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;  /* worker fell behind. */
+
+    return retval;
+} /* decode_ahead_read */
+
+
+/* Throw out what a stopped worker left behind; see stop_decode_ahead(). */
+static void drop_leftover(Sound_SampleInternal *internal)
+{
+    SDL_free(internal->leftover);
+    internal->leftover = NULL;
+    internal->leftover_capacity = internal->leftover_pos = internal->leftover_end = 0;
+    internal->leftover_flags = 0;
+} /* drop_leftover */
+
+
+/*
+ * Copy out what a stopped worker decoded that the app hadn't read yet. The
+ *  decoder carries on from the end of it, so this is served before anything
+ *  else, and the worker's final flags are only passed on once it's empty.
+ */
+static Uint32 read_leftover(Sound_Sample *sample, Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    const Uint32 used = internal->leftover_end - internal->leftover_pos;
+    const Uint32 offset = internal->leftover_pos & (internal->leftover_capacity - 1);
+    Uint32 retval = SDL_min(used, len);
+    Uint32 first;
+
+    if (retval < used)
+        retval -= retval % framesize;
+
+    first = SDL_min(retval, internal->leftover_capacity - offset);
+    SDL_memcpy(buf, internal->leftover + offset, first);
+    SDL_memcpy(buf + first, internal->leftover, retval - first);
+    internal->leftover_pos += retval;
+
+    sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
+    if (retval == used)
+    {
+        sample->flags |= internal->leftover_flags;
+        drop_leftover(internal);
+    } /* if */
+
+    return retval;
+} /* read_leftover */
+
+
+/* decode_some(), plus keeping track of where we are in the stream. */
+static Uint32 decode_into(Sound_Sample *sample, void *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Uint32 retval;
+
+    if (internal->funcs == NULL)  /* push sample still waiting to open. */
+    {
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+        return 0;
+    } /* if */
+
+    if (internal->leftover != NULL)
+        retval = read_leftover(sample, (Uint8 *) buf, len);
+    else if (internal->ahead != NULL)
+        retval = decode_ahead_read(sample, internal->ahead, (Uint8 *) buf, len);
+    else
+        retval = decode_some(sample, buf, len);
+
+    internal->delivered_bytes += retval;
+    return retval;
+} /* decode_into */
+
+
+Uint32 Sound_Decode(Sound_Sample *sample)
+{
+        /* a boatload of sanity checks... */
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PREV_EOF, 0);
+    BAIL_IF_MACRO(sample->buffer == NULL, ERR_NO_BUFFER, 0);
+
+    return decode_into(sample, sample->buffer, sample->buffer_size);
+} /* Sound_Decode */
+
+
+Uint32 Sound_DecodeInto(Sound_Sample *sample, void *buffer, Uint32 len)
+{
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(buffer == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PREV_EOF, 0);
+
+    return decode_into(sample, buffer, len);
+} /* Sound_DecodeInto */
+
+
+Uint32 Sound_DecodeView(Sound_Sample *sample, const void **data)
+{
+    Sound_SampleInternal *internal;
+    Uint32 retval;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(data == NULL, ERR_INVALID_ARGUMENT, 0);
+    *data = NULL;
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PREV_EOF, 0);
+    BAIL_IF_MACRO(sample->buffer == NULL, ERR_NO_BUFFER, 0);
+
+    internal = (Sound_SampleInternal *) sample->opaque;
+
+    /* only lend out the source data if it's exactly what the app asked for. */
+    internal->view = NULL;
+    internal->view_wanted = ( (internal->stream == NULL) && (internal->converter.num_stages == 0) &&
+                              (internal->resampler == NULL) && (internal->ahead == NULL) &&
+                              (internal->leftover == NULL) );
+    retval = decode_into(sample, sample->buffer, sample->buffer_size);
+    internal->view_wanted = false;
+
+    *data = (internal->view != NULL) ? internal->view : sample->buffer;
+    internal->view = NULL;
+    return retval;
+} /* Sound_DecodeView */
+
+
+/*
+ * Sound_DecodeAll() decodes straight into the tail of its output buffer,
+ *  this many bytes (or sample->buffer_size, if larger) at a time.
+ */
+#define DECODEALL_CHUNK_SIZE (64 * 1024)
+
+/* Largest Sound_DecodeAll() result we can report through a Uint32. */
+#define DECODEALL_MAX_SIZE (0xFFFFFFFF - 0xFFFF)
+
+/*
+ * Parallel Sound_DecodeAll().
+ *
+ * If the decoder can seek to an exact frame and we know about how long the
+ *  sample is, what's left of it is split into one segment per CPU core,
+ *  and each segment is decoded on its own thread by its own instance of the
+ *  decoder. Since every segment starts on an exact frame, gluing them back
+ *  together is just a matter of putting them end to end; decoders that have
+ *  to prime themselves after a seek (MP3, say) already do that inside
+ *  seek_frame(). This isn't done when resampling, as the resampler's state
+ *  at each seam wouldn't match a straight run through the sample.
+ *
+ * The instances all read the sample's own stream, through views that each
+ *  keep their own position and take turns seeking and reading the real
+ *  thing. That serializes the i/o, but decoding is where the time goes.
+ *
+ * This is off unless the app asks for it with Sound_SetDecodeAllThreads().
+ */
+#define DECODEALL_PARALLEL_MIN_FRAMES (1024 * 1024)  /* not worth a thread for less. */
+#define DECODEALL_PARALLEL_MAX_SEGMENTS 64
+
+static SDL_AtomicInt decodeall_threads;  /* zero or one: don't. */
+
+typedef struct SharedIO
+{
+    SDL_IOStream *io;
+    SDL_Mutex *lock;
+    Sint64 size;
+    Sint64 start;  /* where the stream was when the sample was opened. */
+} SharedIO;
+
+typedef struct SharedIOView
+{
+    SharedIO *shared;
+    Sint64 pos;
+} SharedIOView;
+
+static Sint64 SDLCALL shared_io_size(void *userdata)
+{
+    SharedIOView *view = (SharedIOView *) userdata;
+    return view->shared->size;
+} /* shared_io_size */
+
+
+static Sint64 SDLCALL shared_io_seek(void *userdata, Sint64 offset, SDL_IOWhence whence)
+{
+    SharedIOView *view = (SharedIOView *) userdata;
+    Sint64 pos;
+
+    switch (whence)
+    {
+        case SDL_IO_SEEK_SET: pos = offset; break;
+        case SDL_IO_SEEK_CUR: pos = view->pos + offset; break;
+        case SDL_IO_SEEK_END: pos = view->shared->size + offset; break;
+        default: BAIL_MACRO(ERR_INVALID_ARGUMENT, -1);
+    } /* switch */
+
+    BAIL_IF_MACRO(pos < 0, ERR_INVALID_ARGUMENT, -1);
+    view->pos = pos;
+    return pos;
+} /* shared_io_seek */
+
+
+static size_t SDLCALL shared_io_read(void *userdata, void *ptr, size_t size, SDL_IOStatus *status)
+{
+    SharedIOView *view = (SharedIOView *) userdata;
+    SharedIO *shared = view->shared;
+    size_t retval = 0;
+
+    SDL_LockMutex(shared->lock);
+    if (SDL_SeekIO(shared->io, view->pos, SDL_IO_SEEK_SET) != view->pos)
+        *status = SDL_IO_STATUS_ERROR;
+    else
+    {
+        retval = SDL_ReadIO(shared->io, ptr, size);
+        *status = SDL_GetIOStatus(shared->io);
+        view->pos += (Sint64) retval;
+    } /* else */
+    SDL_UnlockMutex(shared->lock);
+
+    return retval;
+} /* shared_io_read */
+
+
+static bool SDLCALL shared_io_close(void *userdata)
+{
+    SDL_free(userdata);  /* the shared stream belongs to someone else. */
+    return true;
+} /* shared_io_close */
+
+
+static SDL_IOStream *open_shared_io_view(SharedIO *shared)
+{
+    SDL_IOStreamInterface iface;
+    SharedIOView *view;
+    SDL_IOStream *retval;
+
+    view = (SharedIOView *) SDL_calloc(1, sizeof (SharedIOView));
+    BAIL_IF_MACRO(view == NULL, ERR_OUT_OF_MEMORY, NULL);
+    view->shared = shared;
+    view->pos = shared->start;  /* the decoder opened it from here. */
+
+    SDL_INIT_INTERFACE(&iface);
+    iface.size = shared_io_size;
+    iface.seek = shared_io_seek;
+    iface.read = shared_io_read;
+    iface.close = shared_io_close;
+
+    retval = SDL_OpenIO(&iface, view);
+    if (retval == NULL)
+    {
+        __Sound_SetError(SDL_GetError());
+        SDL_free(view);
+    } /* if */
+
+    return retval;
+} /* open_shared_io_view */
+
+
+typedef struct DecodeAllSegment
+{
+    Sound_Sample *parent;
+    SharedIO *shared;
+    SDL_Thread *thread;
+    Uint64 frame;  /* where this segment starts. */
+    Uint8 *buf;  /* where its audio goes; the last segment allocates its own. */
+    Uint64 len;  /* bytes wanted; the last segment runs to EOF instead. */
+    Uint64 decoded;  /* bytes actually decoded. */
+    bool last;
+    bool eof;
+    bool failed;
+#if SOUND_SUPPORTS_STATS
+    Sound_SampleStats stats;
+    Uint64 stats_decoded_bytes;
+#endif
+} DecodeAllSegment;
+
+
+/* Open another instance of (parent)'s decoder on the shared stream. */
+static Sound_Sample *open_segment_instance(DecodeAllSegment *seg)
+{
+    Sound_Sample *parent = seg->parent;
+    Sound_SampleInternal *pinternal = (Sound_SampleInternal *) parent->opaque;
+    SDL_IOStream *io = open_shared_io_view(seg->shared);
+    Sound_Sample *retval;
+    Sound_SampleInternal *internal;
+
+    if (io == NULL)
+        return NULL;
+
+    retval = alloc_sample(io, &parent->desired, 0);
+    if (retval == NULL)
+    {
+        SDL_CloseIO(io);
+        return NULL;
+    } /* if */
+
+    internal = (Sound_SampleInternal *) retval->opaque;
+    if (!init_sample(pinternal->funcs, retval, parent->decoder->extensions[0], &parent->desired))
+    {
+        SDL_CloseIO(internal->io);
+        release_sample(retval);
+        return NULL;
+    } /* if */
+
+    link_sample(retval);
+    internal->owner = parent;  /* its work shows up in traces as the app's. */
+
+    /* it should be the same file, but make sure the audio lines up. */
+    if (SDL_memcmp(&retval->actual, &parent->actual, sizeof (SDL_AudioSpec)) != 0)
+    {
+        Sound_FreeSample(retval);
+        return NULL;
+    } /* if */
+
+    return retval;
+} /* open_segment_instance */
+
+
+static int SDLCALL decodeall_segment_thread(void *data)
+{
+    DecodeAllSegment *seg = (DecodeAllSegment *) data;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(seg->parent->desired);
+    const Uint32 chunk = DECODEALL_CHUNK_SIZE - (DECODEALL_CHUNK_SIZE % framesize);
+    Sound_Sample *sample = open_segment_instance(seg);
+    Uint64 bufsize = seg->last ? 0 : seg->len;  /* the last one starts empty. */
+    Uint32 br;
+
+    if ((sample == NULL) || !Sound_SeekFrame(sample, seg->frame))
+    {
+        if (sample != NULL)
+            Sound_FreeSample(sample);
+        seg->failed = true;
+        return 0;
+    } /* if */
+
+    while ( ((sample->flags & SOUND_SAMPLEFLAG_EOF) == 0) &&
+            ((sample->flags & SOUND_SAMPLEFLAG_ERROR) == 0) )
+    {
+        Uint64 want = chunk;
+
+        if (!seg->last)
+        {
+            if (seg->decoded >= seg->len)
+                break;
+            want = SDL_min(want, seg->len - seg->decoded);
+        } /* if */
+
+        else if ((bufsize - seg->decoded) < want)
+        {
+            const Uint64 newsize = SDL_max(bufsize * 2, seg->decoded + want);
+            void *ptr = (newsize <= DECODEALL_MAX_SIZE) ? __Sound_SIMDRealloc(seg->buf, (size_t) newsize) : NULL;
+            if (ptr == NULL)
+            {
+                seg->failed = true;
+                break;
+            } /* if */
+            seg->buf = (Uint8 *) ptr;
+            bufsize = newsize;
+        } /* else if */
+
+        br = decode_some(sample, seg->buf + seg->decoded, (Uint32) want);
+        seg->decoded += br;
+
+        /* nothing and no EOF (EAGAIN, say): let the usual way sort it out. */
+        if ((br == 0) && ((sample->flags & SOUND_SAMPLEFLAG_EOF) == 0))
+        {
+            seg->failed = true;
+            break;
+        } /* if */
+    } /* while */
+
+    if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+        seg->failed = true;
+    seg->eof = ((sample->flags & SOUND_SAMPLEFLAG_EOF) != 0);
+
+#if SOUND_SUPPORTS_STATS
+    {
+        Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+        SDL_copyp(&seg->stats, &internal->stats);
+        seg->stats_decoded_bytes = internal->stats_decoded_bytes;
+    }
+#endif
+
+    Sound_FreeSample(sample);
+    return 0;
+} /* decodeall_segment_thread */
+
+
+/*
+ * Try to do Sound_DecodeAll() in parallel. Returns false if this sample
+ *  isn't a candidate, or if anything went wrong, in which case nothing about
+ *  (sample) has changed and the caller should just decode it the usual way.
+ */
+static bool decodeall_parallel(Sound_Sample *sample, Uint32 *result)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    DecodeAllSegment segs[DECODEALL_PARALLEL_MAX_SEGMENTS];
+    SharedIO shared;
+    Uint64 start, total, frames_per_seg, decoded, mainlen, bufsize;
+    Sint64 iopos;
+    Uint8 *buf = NULL;
+    int nsegs, used, i;
+    bool ok = true;
+
+    if ( (SDL_GetAtomicInt(&decodeall_threads) < 2) ||
+         !(sample->flags & SOUND_SAMPLEFLAG_CANSEEK) ||
+         (internal->funcs->seek_frame == NULL) ||
+         (internal->total_time <= 0) ||
+         (internal->duration_estimated) ||
+         (internal->io_start < 0) ||
+         (sample->desired.freq != sample->actual.freq) ||
+         (internal->pending_eof) || (internal->pending_error) ||
+         (internal->leftover != NULL) ||
+         (internal->funcs == &__Sound_DecoderFunctions_CACHE) ||
+         ((internal->stream != NULL) && (SDL_GetAudioStreamQueued(internal->stream) != 0)) )
+        return false;
+
+    start = internal->base_frame + (internal->delivered_bytes / framesize);
+    total = (((Uint64) internal->total_time) * ((Uint64) sample->actual.freq)) / 1000;
+    if (total <= start)
+        return false;
+
+    nsegs = SDL_min(SDL_GetAtomicInt(&decodeall_threads), SDL_GetNumLogicalCPUCores());
+    nsegs = SDL_min(nsegs, DECODEALL_PARALLEL_MAX_SEGMENTS);
+    nsegs = (int) SDL_min((Uint64) nsegs, (total - start) / DECODEALL_PARALLEL_MIN_FRAMES);
+    if (nsegs < 2)
+        return false;
+
+    frames_per_seg = (total - start) / nsegs;
+    mainlen = frames_per_seg * framesize * (nsegs - 1);  /* the last one brings its own. */
+    if (mainlen + (frames_per_seg * framesize) > DECODEALL_MAX_SIZE)
+        return false;  /* the usual way will cope with the overflow. */
+
+    iopos = SDL_TellIO(internal->io);
+    shared.io = internal->io;
+    shared.size = SDL_GetIOSize(internal->io);
+    shared.start = internal->io_start;
+    if ((iopos < 0) || (shared.size < 0))
+        return false;
+
+    shared.lock = SDL_CreateMutex();
+    buf = (Uint8 *) __Sound_SIMDAlloc((size_t) mainlen);
+    if ((shared.lock == NULL) || (buf == NULL))
+    {
+        SDL_DestroyMutex(shared.lock);
+        __Sound_SIMDFree(buf);
+        return false;
+    } /* if */
+
+    SDL_zeroa(segs);
+    for (i = 0; i < nsegs; i++)
+    {
+        DecodeAllSegment *seg = &segs[i];
+        seg->parent = sample;
+        seg->shared = &shared;
+        seg->frame = start + (frames_per_seg * i);
+        seg->len = frames_per_seg * framesize;
+        seg->last = (i == (nsegs - 1));
+        seg->buf = seg->last ? NULL : (buf + (seg->len * i));
+        seg->thread = SDL_CreateThread(decodeall_segment_thread, "SDL_sound decodeall", seg);
+        if (seg->thread == NULL)  /* do it ourselves, then. */
+            decodeall_segment_thread(seg);
+    } /* for */
+
+    for (i = 0; i < nsegs; i++)
+        SDL_WaitThread(segs[i].thread, NULL);
+
+    SDL_DestroyMutex(shared.lock);
+    SDL_SeekIO(internal->io, iopos, SDL_IO_SEEK_SET);  /* put it back for the real decoder. */
+
+    /*
+     * Every segment but the last decoded exactly its share, unless it hit
+     *  EOF early (the duration was an overestimate), in which case nothing
+     *  after it counts.
+     */
+    decoded = 0;
+    bufsize = mainlen;
+    for (used = 0; used < nsegs; used++)
+    {
+        DecodeAllSegment *seg = &segs[used];
+        if (seg->failed)
+        {
+            ok = false;
+            break;
+        } /* if */
+
+        decoded += seg->decoded;
+        if (seg->eof)
+        {
+            used++;
+            break;
+        } /* if */
+    } /* for */
+
+    if (ok && (used == nsegs) && (segs[nsegs - 1].decoded > 0))
+    {
+        /* tack the last segment, which had its own buffer, onto the end. */
+        const Uint64 lastlen = segs[nsegs - 1].decoded;
+        void *ptr = NULL;
+        if (decoded <= DECODEALL_MAX_SIZE)
+            ptr = __Sound_SIMDRealloc(buf, (size_t) decoded);
+        if (ptr == NULL)
+            ok = false;
         else
         {
-            buf = ptr;
-            SDL_memcpy( ((char *) buf) + newBufSize, sample->buffer, br );
-            newBufSize += br;
+            buf = (Uint8 *) ptr;
+            bufsize = decoded;
+            SDL_memcpy(buf + (decoded - lastlen), segs[nsegs - 1].buf, (size_t) lastlen);
         } /* else */
+    } /* if */
+
+    __Sound_SIMDFree(segs[nsegs - 1].buf);
+
+    if (!ok)
+    {
+        __Sound_SIMDFree(buf);
+        return false;
+    } /* if */
+
+#if SOUND_SUPPORTS_STATS
+    for (i = 0; i < nsegs; i++)
+    {
+        internal->stats.decoder_reads += segs[i].stats.decoder_reads;
+        internal->stats.decode_ns += segs[i].stats.decode_ns;
+        internal->stats.convert_ns += segs[i].stats.convert_ns;
+        internal->stats_decoded_bytes += segs[i].stats_decoded_bytes;
+        internal->stats.read_allocs += segs[i].stats.read_allocs;
+        internal->stats.read_alloc_bytes += segs[i].stats.read_alloc_bytes;
+    } /* for */
+#endif
+
+    release_buffer(sample->buffer, internal->buffer_capacity);
+    internal->buffer_capacity = (Uint32) bufsize;
+    internal->buffer = sample->buffer = buf;
+    internal->buffer_size = sample->buffer_size = (Uint32) decoded;
+
+    /* the instances did the decoding; the sample itself just skips to the end. */
+    internal->base_frame = start + (decoded / framesize);
+    internal->delivered_bytes = 0;
+    sample->flags |= SOUND_SAMPLEFLAG_EOF;
+
+    *result = (Uint32) decoded;
+    return true;
+} /* decodeall_parallel */
+
+/*
+ * Sound_DecodeAll() for a sample reading out of the cache. The rest of the
+ *  audio is already in memory, in the desired format, so copy it out in one
+ *  go instead of a chunk at a time. Returns false if (sample) isn't one of
+ *  those, or if anything went wrong, like decodeall_parallel() does.
+ */
+static bool decodeall_cached(Sound_Sample *sample, Uint32 *result)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sint64 pos, size;
+    Uint8 *buf;
+    Uint32 len;
+
+    if ( (internal->funcs != &__Sound_DecoderFunctions_CACHE) ||
+         (internal->stream != NULL) || (internal->resampler != NULL) ||
+         (internal->converter.num_stages > 0) ||
+         (internal->pending_eof) || (internal->pending_error) ||
+         (internal->leftover != NULL) )
+        return false;
+
+    pos = SDL_TellIO(internal->io);
+    size = SDL_GetIOSize(internal->io);
+    if ((pos < 0) || (size <= pos) || ((size - pos) > DECODEALL_MAX_SIZE))
+        return false;
+
+    len = (Uint32) (size - pos);
+    buf = (Uint8 *) __Sound_SIMDAlloc(len);
+    if (buf == NULL)
+        return false;
+
+    len = decode_into(sample, buf, len);
+    if ((sample->flags & SOUND_SAMPLEFLAG_ERROR) == 0)
+        sample->flags |= SOUND_SAMPLEFLAG_EOF;  /* that was all of it. */
+
+    release_buffer(sample->buffer, internal->buffer_capacity);
+    internal->buffer_capacity = (Uint32) (size - pos);
+    internal->buffer = sample->buffer = buf;
+    internal->buffer_size = sample->buffer_size = len;
+
+    *result = len;
+    return true;
+} /* decodeall_cached */
+
+
+Uint32 Sound_DecodeAll(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = NULL;
+    Uint32 decoded32 = 0;
+    Uint8 *buf = NULL;
+    Uint32 framesize;
+    Uint32 chunk;
+    Uint64 bufsize;
+    Uint64 decoded = 0;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PREV_EOF, 0);
+    BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_PREV_ERROR, 0);
+
+    internal = (Sound_SampleInternal *) sample->opaque;
+    if (internal->funcs == NULL)  /* push sample still waiting to open. */
+    {
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+        return 0;
+    } /* if */
+
+    /* no point in decoding ahead of ourselves here; just get on with it. */
+    if (!stop_decode_ahead(sample, true))
+        return 0;
+    else if (sample->flags & (SOUND_SAMPLEFLAG_EOF | SOUND_SAMPLEFLAG_ERROR))
+        return 0;  /* the worker already got to the end. */
+
+    if (decodeall_cached(sample, &decoded32))
+        return decoded32;
+    else if (decodeall_parallel(sample, &decoded32))
+        return decoded32;
+
+    framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    chunk = SDL_max(sample->buffer_size, DECODEALL_CHUNK_SIZE);
+    chunk -= chunk % framesize;
+
+    /*
+     * If we know how long this thing is, allocate all of what's left of it
+     *  up front (plus a chunk of slack, so a slightly-off duration doesn't
+     *  force a resize at the very end). Otherwise start small and double as
+     *  we go, so the total copying stays linear in the size of the output.
+     */
+    bufsize = ((Uint64) chunk) * 4;
+    if (internal->total_time > 0)
+    {
+        const Uint64 total = (((Uint64) internal->total_time) * ((Uint64) sample->actual.freq)) / 1000;
+        const Uint64 pos = (Uint64) SDL_max(Sound_TellFrame(sample), 0);
+        const Uint64 frames = (total > pos) ? (((total - pos) * ((Uint64) sample->desired.freq)) / ((Uint64) sample->actual.freq)) : 0;
+        bufsize = (frames * framesize) + chunk;
+    } /* if */
+
+    if (bufsize > DECODEALL_MAX_SIZE)
+        bufsize = DECODEALL_MAX_SIZE;
+
+    buf = (Uint8 *) __Sound_SIMDAlloc((size_t) bufsize);
+    if (buf == NULL)
+    {
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        __Sound_SetError(ERR_OUT_OF_MEMORY);
+        return sample->buffer_size;
+    } /* if */
+
+    while ( ((sample->flags & SOUND_SAMPLEFLAG_EOF) == 0) &&
+            ((sample->flags & SOUND_SAMPLEFLAG_ERROR) == 0) )
+    {
+        if ((bufsize - decoded) < chunk)
+        {
+            Uint64 newsize = SDL_max(bufsize * 2, decoded + chunk);
+            void *ptr;
+
+            if (newsize > DECODEALL_MAX_SIZE)
+                newsize = DECODEALL_MAX_SIZE;
+
+            ptr = (newsize > bufsize) ? __Sound_SIMDRealloc(buf, (size_t) newsize) : NULL;
+            if (ptr == NULL)
+            {
+                sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+                __Sound_SetError(ERR_OUT_OF_MEMORY);
+                break;
+            } /* if */
+
+            buf = (Uint8 *) ptr;
+            bufsize = newsize;
+        } /* if */
+
+        decoded += decode_into(sample, buf + decoded, chunk);
+
+        /* a push sample can't get more data until we return. */
+        if ((internal->push != NULL) && (sample->flags & SOUND_SAMPLEFLAG_EAGAIN))
+            break;
     } /* while */
 
-    if (buf == NULL)  /* ...in case first call to __Sound_SIMDRealloc() fails... */
-        return sample->buffer_size;
+    /* trim off any slack, once. */
+    if (decoded < bufsize)
+    {
+        void *ptr = __Sound_SIMDRealloc(buf, (size_t) decoded);
+        if (ptr != NULL)  /* if shrinking failed, just keep the bigger block. */
+        {
+            buf = (Uint8 *) ptr;
+            bufsize = decoded;
+        } /* if */
+    } /* if */
+
+    release_buffer(sample->buffer, internal->buffer_capacity);
+
+    internal->buffer_capacity = (Uint32) bufsize;
+    internal->buffer = sample->buffer = buf;
+    internal->buffer_size = sample->buffer_size = (Uint32) decoded;
+
+    return (Uint32) decoded;
+} /* Sound_DecodeAll */
+
+
+int Sound_SetDecodeAllThreads(int max_threads)
+{
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(max_threads < 0, ERR_INVALID_ARGUMENT, 0);
+    SDL_SetAtomicInt(&decodeall_threads, max_threads);
+    return 1;
+} /* Sound_SetDecodeAllThreads */
+
+
+/*
+ * Ask the decoder to reposition to (frame) (or (ms), if it can only seek by
+ *  time; or the start, for a rewind), and if that works, throw away anything
+ *  still buffered for the old position and start counting from the new one.
+ *  (sample) is whatever is handed to the decoder; see reposition().
+ */
+static int reposition_decoder(Sound_Sample *sample, bool rewind, Uint64 frame, Uint32 ms)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+#if SOUND_SUPPORTS_STATS
+    const Uint64 start = SDL_GetTicksNS();
+    Uint64 elapsed;
+#endif
+    const Sound_TraceEvent event = rewind ? SOUND_TRACE_REWIND : SOUND_TRACE_SEEK;
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+    int rc;
+
+    __Sound_Trace(event, true, sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OTHER);
+#endif
+    if (rewind)
+        rc = internal->funcs->rewind(sample);
+    else if (internal->funcs->seek_frame != NULL)
+        rc = internal->funcs->seek_frame(sample, frame);
+    else
+        rc = internal->funcs->seek(sample, ms);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    __Sound_AllocLeave(scope);
+#endif
+    __Sound_Trace(event, false, sample);
+
+#if SOUND_SUPPORTS_STATS
+    elapsed = SDL_GetTicksNS() - start;
+    internal->stats.seeks++;
+    internal->stats.seek_ns += elapsed;
+    if (elapsed > internal->stats.seek_max_ns)
+        internal->stats.seek_max_ns = elapsed;
+#endif
+
+    if (!rc)
+        return 0;
+
+    if (internal->stream != NULL)
+        SDL_ClearAudioStream(internal->stream);
+    else if (internal->resampler != NULL)
+        __Sound_ResetResampler(internal->resampler);
+
+    internal->pending_eof = internal->pending_error = false;
+    internal->base_frame = frame;
+    internal->delivered_bytes = 0;
+
+    sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
+    sample->flags &= ~SOUND_SAMPLEFLAG_ERROR;
+    sample->flags &= ~SOUND_SAMPLEFLAG_EOF;
+    return 1;
+} /* reposition_decoder */
+
+
+/* All rewinds and seeks go through here. */
+static int reposition(Sound_Sample *sample, bool rewind, Uint64 frame, Uint32 ms)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    DecodeAhead *ahead = internal->ahead;
+    int retval;
 
-    __Sound_SIMDFree(sample->buffer);
+    if (ahead == NULL)
+    {
+        retval = reposition_decoder(sample, rewind, frame, ms);
+        if (retval)
+            drop_leftover(internal);
+        return retval;
+    } /* if */
 
-    internal->buffer = sample->buffer = buf;
-    internal->buffer_size = sample->buffer_size = newBufSize;
+    /* park the worker, move its decoder, and dump what it decoded so far. */
+    SDL_LockMutex(ahead->lock);
+    retval = reposition_decoder(&ahead->shadow, rewind, frame, ms);
+    if (retval)
+    {
+        SDL_SetAtomicInt(&ahead->read_pos, SDL_GetAtomicInt(&ahead->write_pos));
+        SDL_SetAtomicInt(&ahead->final_flags, 0);
+        sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
+        sample->flags &= ~SOUND_SAMPLEFLAG_ERROR;
+        sample->flags &= ~SOUND_SAMPLEFLAG_EOF;
+    } /* if */
+    SDL_UnlockMutex(ahead->lock);
 
-    return newBufSize;
-} /* Sound_DecodeAll */
+    decode_ahead_wake(ahead);
+    return retval;
+} /* reposition */
 
 
 int Sound_Rewind(Sound_Sample *sample)
 {
-    Sound_SampleInternal *internal;
     BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
 
-    internal = (Sound_SampleInternal *) sample->opaque;
-    if (!internal->funcs->rewind(sample))
+    /* what was pushed is gone; that's not an error in the sample itself. */
+    if (((Sound_SampleInternal *) sample->opaque)->push != NULL)
+        BAIL_MACRO(ERR_CANNOT_SEEK, 0);
+
+    if (!reposition(sample, true, 0, 0))
     {
         sample->flags |= SOUND_SAMPLEFLAG_ERROR;
         return 0;
     } /* if */
 
-    sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
-    sample->flags &= ~SOUND_SAMPLEFLAG_ERROR;
-    sample->flags &= ~SOUND_SAMPLEFLAG_EOF;
-
     return 1;
 } /* Sound_Rewind */
 
 
 int Sound_Seek(Sound_Sample *sample, Uint32 ms)
+{
+    Uint64 frame;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    if (!(sample->flags & SOUND_SAMPLEFLAG_CANSEEK))
+        BAIL_MACRO(ERR_CANNOT_SEEK, 0);
+
+    frame = __Sound_convertMsToFrames(&sample->actual, ms);
+    BAIL_IF_MACRO(!reposition(sample, false, frame, ms), NULL, 0);
+    return 1;
+} /* Sound_Seek */
+
+
+int Sound_SeekFrame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal;
+    Uint32 ms = 0;
 
     BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
     if (!(sample->flags & SOUND_SAMPLEFLAG_CANSEEK))
         BAIL_MACRO(ERR_CANNOT_SEEK, 0);
 
     internal = (Sound_SampleInternal *) sample->opaque;
-    BAIL_IF_MACRO(!internal->funcs->seek(sample, ms), NULL, 0);
-
-    sample->flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
-    sample->flags &= ~SOUND_SAMPLEFLAG_ERROR;
-    sample->flags &= ~SOUND_SAMPLEFLAG_EOF;
+    if (internal->funcs->seek_frame == NULL)
+    {
+        /* decoder can only seek by time; get as close as we can. */
+        const Uint64 ms64 = (frame * 1000) / (Uint64) sample->actual.freq;
+        BAIL_IF_MACRO(ms64 > 0xFFFFFFFF, ERR_PAST_EOF, 0);
+        ms = (Uint32) ms64;
+        frame = __Sound_convertMsToFrames(&sample->actual, ms);
+    } /* if */
 
+    BAIL_IF_MACRO(!reposition(sample, false, frame, ms), NULL, 0);
     return 1;
-} /* Sound_Rewind */
+} /* Sound_SeekFrame */
 
 
-Sint32 Sound_GetDuration(Sound_Sample *sample)
+Sint64 Sound_TellFrame(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal;
+    Uint64 frames;
+
     BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, -1);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, -1);
+
+    internal = (Sound_SampleInternal *) sample->opaque;
+    if (internal->funcs == NULL)  /* push sample still waiting to open. */
+        return 0;
+
+    frames = internal->delivered_bytes / SDL_AUDIO_FRAMESIZE(sample->desired);
+
+    /* we count output frames; scale back to the decoder's rate if needed. */
+    if (sample->desired.freq != sample->actual.freq)
+        frames = (frames * (Uint64) sample->actual.freq) / (Uint64) sample->desired.freq;
+
+    return (Sint64) (internal->base_frame + frames);
+} /* Sound_TellFrame */
+
+
+static void free_decode_ahead(DecodeAhead *ahead)
+{
+    SDL_DestroySemaphore(ahead->wake);
+    SDL_DestroyMutex(ahead->lock);
+    SDL_free(ahead->scratch);
+    SDL_free(ahead->ring);
+    SDL_free(ahead);
+} /* free_decode_ahead */
+
+
+/* Guts of Sound_StartDecodeAhead() and Sound_StartPooledDecodeAhead(). */
+static int start_decode_ahead(Sound_Sample *sample, Uint32 lookahead,
+                              bool pooled, Sound_DecodePriority priority)
+{
+    Sound_SampleInternal *internal;
+    DecodeAhead *ahead;
+    Uint32 framesize;
+    Uint32 capacity;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO((int) priority < 0, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO((int) priority >= SCHED_PRIORITIES, ERR_INVALID_ARGUMENT, 0);
+
     internal = (Sound_SampleInternal *) sample->opaque;
+    BAIL_IF_MACRO(internal->ahead != NULL, ERR_DECODING_AHEAD, 0);
+    BAIL_IF_MACRO(internal->push != NULL, ERR_NOT_SUPPORTED, 0);
+
+    framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->desired);
+    if (lookahead == 0)  /* about a second of audio. */
+        lookahead = framesize * (Uint32) sample->desired.freq;
+
+    /* a power of two, with room for a few chunks of whole frames (and
+       anything a worker that was stopped before left behind). */
+    lookahead = SDL_max(lookahead, framesize * 4);
+    lookahead = SDL_max(lookahead, internal->leftover_end - internal->leftover_pos);
+    BAIL_IF_MACRO(lookahead > 0x40000000, ERR_INVALID_ARGUMENT, 0);
+    for (capacity = 1; capacity < lookahead; capacity <<= 1) { /* spin. */ }
+
+    if (pooled)
+    {
+        bool started;
+        SDL_LockMutex(samplelist_mutex);
+        started = sched_start();
+        SDL_UnlockMutex(samplelist_mutex);
+        if (!started)
+            return 0;  /* error is already set. */
+    } /* if */
+
+    ahead = (DecodeAhead *) SDL_calloc(1, sizeof (DecodeAhead));
+    BAIL_IF_MACRO(ahead == NULL, ERR_OUT_OF_MEMORY, 0);
+
+    ahead->capacity = capacity;
+    ahead->chunk = (capacity / 4) - ((capacity / 4) % framesize);
+    ahead->pooled = pooled;
+    ahead->priority = (int) priority;
+    ahead->ring = (Uint8 *) SDL_malloc(ahead->capacity);
+    ahead->scratch = (Uint8 *) SDL_malloc(ahead->chunk);
+    ahead->lock = SDL_CreateMutex();
+    ahead->wake = SDL_CreateSemaphore(0);
+    SDL_SetAtomicInt(&ahead->queue, SCHED_NOWHERE);
+
+    if (!ahead->ring || !ahead->scratch || !ahead->lock || !ahead->wake)
+    {
+        free_decode_ahead(ahead);
+        BAIL_MACRO(ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    SDL_copyp(&ahead->shadow, sample);
+    ahead->shadow.flags &= ~SOUND_SAMPLEFLAG_EAGAIN;
+    SDL_SetAtomicInt(&ahead->final_flags, (int) (sample->flags & (SOUND_SAMPLEFLAG_EOF | SOUND_SAMPLEFLAG_ERROR)));
+
+    if (internal->leftover != NULL)  /* the app still has to read this first. */
+    {
+        const Uint32 used = internal->leftover_end - internal->leftover_pos;
+        const Uint32 offset = internal->leftover_pos & (internal->leftover_capacity - 1);
+        const Uint32 first = SDL_min(used, internal->leftover_capacity - offset);
+        SDL_memcpy(ahead->ring, internal->leftover + offset, first);
+        SDL_memcpy(ahead->ring + first, internal->leftover, used - first);
+        SDL_SetAtomicInt(&ahead->write_pos, (int) used);
+        SDL_SetAtomicInt(&ahead->final_flags, (int) internal->leftover_flags);
+    } /* if */
+
+    if (pooled)
+        sched_submit(ahead);
+    else
+    {
+        ahead->thread = SDL_CreateThread(decode_ahead_thread, "SDL_sound decode", ahead);
+        if (ahead->thread == NULL)
+        {
+            __Sound_SetError(SDL_GetError());
+            free_decode_ahead(ahead);
+            return 0;
+        } /* if */
+    } /* else */
+
+    drop_leftover(internal);  /* it's in the ring now. */
+    internal->ahead = ahead;
+    return 1;
+} /* start_decode_ahead */
+
+
+int Sound_StartDecodeAhead(Sound_Sample *sample, Uint32 lookahead)
+{
+    return start_decode_ahead(sample, lookahead, false, SOUND_DECODE_PRIORITY_NORMAL);
+} /* Sound_StartDecodeAhead */
+
+
+int Sound_StartPooledDecodeAhead(Sound_Sample *sample, Uint32 lookahead,
+                                 Sound_DecodePriority priority)
+{
+    return start_decode_ahead(sample, lookahead, true, priority);
+} /* Sound_StartPooledDecodeAhead */
+
+
+/*
+ * Shut down a sample's decode-ahead worker. If (resync) is true, whatever
+ *  it decoded that the app hasn't read yet is kept, and handed out before
+ *  the decoder is asked for more (see read_leftover()), so decoding carries
+ *  on from where the app has read up to; otherwise it's just thrown out.
+ */
+static int stop_decode_ahead(Sound_Sample *sample, bool resync)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    DecodeAhead *ahead = internal->ahead;
+    int final_flags;
+
+    if (ahead == NULL)
+        return 1;  /* nothing to do. */
+
+    SDL_SetAtomicInt(&ahead->quit, 1);
+    if (!ahead->pooled)
+    {
+        SDL_SignalSemaphore(ahead->wake);
+        SDL_WaitThread(ahead->thread, NULL);
+    } /* if */
+
+    else
+    {
+        /* If it's waiting in line, take it out. If a scheduler thread has
+           it, that thread sees (quit), lets go of it, and posts (wake). It
+           might have requeued it just before it saw (quit), though, so look
+           again each time, holding the lock so it can't be in the middle of
+           that when we do. */
+        SDL_LockMutex(ahead->lock);
+        while (SDL_GetAtomicInt(&ahead->scheduled))
+        {
+            if (sched_remove(ahead))
+                SDL_SetAtomicInt(&ahead->scheduled, 0);
+            else
+            {
+                SDL_UnlockMutex(ahead->lock);
+                SDL_WaitSemaphore(ahead->wake);
+                SDL_LockMutex(ahead->lock);
+            } /* else */
+        } /* while */
+        SDL_UnlockMutex(ahead->lock);
+    } /* else */
+
+    final_flags = SDL_GetAtomicInt(&ahead->final_flags);
+    internal->ahead = NULL;
+
+    if (resync && (decode_ahead_used(ahead) == 0))
+        sample->flags |= (Sound_SampleFlags) final_flags;  /* the decoder is right where it should be. */
+
+    else if (resync)
+    {
+        /* The decoder is past what the app has read, and there's no getting
+           it back to exactly there by seeking if it's converting rates, so
+           keep what's left of the ring and hand that out first instead. */
+        internal->leftover = ahead->ring;
+        internal->leftover_capacity = ahead->capacity;
+        internal->leftover_pos = (Uint32) SDL_GetAtomicInt(&ahead->read_pos);
+        internal->leftover_end = (Uint32) SDL_GetAtomicInt(&ahead->write_pos);
+        internal->leftover_flags = (Sound_SampleFlags) final_flags;
+        ahead->ring = NULL;
+    } /* else if */
+
+    free_decode_ahead(ahead);
+    return 1;
+} /* stop_decode_ahead */
+
+
+int Sound_StopDecodeAhead(Sound_Sample *sample)
+{
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    return stop_decode_ahead(sample, true);
+} /* Sound_StopDecodeAhead */
+
+
+/*
+ * Get exclusive use of a sample's decoder, outside of decoding: if a
+ *  decode-ahead worker is running, it owns the decoder, so park it, like
+ *  reposition() does. Returns the Sound_Sample to hand to the decoder's
+ *  methods. Call unlock_decoder() when done.
+ */
+static Sound_Sample *lock_decoder(Sound_Sample *sample)
+{
+    DecodeAhead *ahead = ((Sound_SampleInternal *) sample->opaque)->ahead;
+    if (ahead == NULL)
+        return sample;
+    SDL_LockMutex(ahead->lock);
+    return &ahead->shadow;
+} /* lock_decoder */
+
+
+static void unlock_decoder(Sound_Sample *sample)
+{
+    DecodeAhead *ahead = ((Sound_SampleInternal *) sample->opaque)->ahead;
+    if (ahead != NULL)
+        SDL_UnlockMutex(ahead->lock);
+} /* unlock_decoder */
+
+
+/*
+ * If the decoder only guessed at the sample's length when it opened it, ask
+ *  it to work out the real one now. This can mean reading the whole stream,
+ *  so it's put off until someone actually wants to know.
+ */
+static Sint32 exact_duration(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_Sample *decoder;
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+
+    if (!internal->duration_estimated || (internal->funcs->duration == NULL))
+        return internal->total_time;
+
+    decoder = lock_decoder(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+    scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OTHER);
+#endif
+    if (internal->duration_estimated)  /* the decoder might have hit EOF. */
+    {
+        const Sint32 ms = internal->funcs->duration(decoder);
+        if (ms >= 0)
+            internal->total_time = ms;
+        internal->duration_estimated = false;  /* either way, don't try again. */
+    } /* if */
+#if SOUND_SUPPORTS_ALLOC_STATS
+    __Sound_AllocLeave(scope);
+#endif
+    unlock_decoder(sample);
+
     return internal->total_time;
+} /* exact_duration */
+
+
+Sint32 Sound_GetDuration(Sound_Sample *sample)
+{
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, -1);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, -1);
+    return exact_duration(sample);
 } /* Sound_GetDuration */
 
 
+/*
+ * A seek index file is a small header, then whatever the decoder's
+ *  save_index() method made, all little endian:
+ *
+ *  char magic[8]; Uint32 version; char decoder[8];
+ *  Uint64 stream_size; Uint64 stream_hash; Uint32 len; Uint64 data_hash;
+ *  Uint8 data[len];
+ *
+ * (decoder) is the decoder's first file extension, padded with nulls.
+ *  (stream_size) and (stream_hash) are the content key; see seekindex_key().
+ *  (data_hash) is seekindex_hash() over (data), so a damaged index is
+ *  refused before a decoder trusts state it can't sanity check itself.
+ */
+#define SEEKINDEX_MAGIC "SDLSNDIX"
+#define SEEKINDEX_VERSION 2
+#define SEEKINDEX_NAME_SIZE 8
+#define SEEKINDEX_MAX_SIZE (64 * 1024 * 1024)
+#define SEEKINDEX_KEY_SPAN (64 * 1024)
+#define SEEKINDEX_HASH_SEED 0xCBF29CE484222325ULL  /* FNV-1a offset basis. */
+
+Uint8 *__Sound_IndexPut16(Uint8 *ptr, Uint16 val)
+{
+    ptr[0] = (Uint8) (val & 0xFF);
+    ptr[1] = (Uint8) (val >> 8);
+    return ptr + 2;
+} /* __Sound_IndexPut16 */
+
+
+Uint8 *__Sound_IndexPut32(Uint8 *ptr, Uint32 val)
+{
+    ptr = __Sound_IndexPut16(ptr, (Uint16) (val & 0xFFFF));
+    return __Sound_IndexPut16(ptr, (Uint16) (val >> 16));
+} /* __Sound_IndexPut32 */
+
+
+Uint8 *__Sound_IndexPut64(Uint8 *ptr, Uint64 val)
+{
+    ptr = __Sound_IndexPut32(ptr, (Uint32) (val & 0xFFFFFFFF));
+    return __Sound_IndexPut32(ptr, (Uint32) (val >> 32));
+} /* __Sound_IndexPut64 */
+
+
+Uint16 __Sound_IndexGet16(const Uint8 *ptr)
+{
+    return (Uint16) (((Uint16) ptr[0]) | (((Uint16) ptr[1]) << 8));
+} /* __Sound_IndexGet16 */
+
+
+Uint32 __Sound_IndexGet32(const Uint8 *ptr)
+{
+    return ((Uint32) __Sound_IndexGet16(ptr)) | (((Uint32) __Sound_IndexGet16(ptr + 2)) << 16);
+} /* __Sound_IndexGet32 */
+
+
+Uint64 __Sound_IndexGet64(const Uint8 *ptr)
+{
+    return ((Uint64) __Sound_IndexGet32(ptr)) | (((Uint64) __Sound_IndexGet32(ptr + 4)) << 32);
+} /* __Sound_IndexGet64 */
+
+
+static void seekindex_name(const Sound_Sample *sample, char *name)
+{
+    const char *ext = sample->decoder->extensions[0];
+    SDL_memset(name, '\0', SEEKINDEX_NAME_SIZE);
+    SDL_memcpy(name, ext, SDL_min(SDL_strlen(ext), SEEKINDEX_NAME_SIZE));
+} /* seekindex_name */
+
+
+/* byte-at-a-time FNV-1a, so the answer doesn't depend on the machine. */
+static Uint64 seekindex_hash(Uint64 hash, const Uint8 *data, size_t len)
+{
+    while (len--)
+        hash = (hash ^ *(data++)) * 0x100000001B3ULL;
+    return hash;
+} /* seekindex_hash */
+
+
+/*
+ * An index is only good for the exact bytes it was made from, so it's
+ *  stamped with a key made from the stream's size and a hash of its first
+ *  and last 64K. Hashing the whole thing would be surer, but the point of
+ *  an index is to not read through a multi-gigabyte file on open. The
+ *  stream's position is left where it was.
+ */
+static int seekindex_key(SDL_IOStream *io, Uint64 *size, Uint64 *hash)
+{
+    const Sint64 pos = SDL_TellIO(io);
+    const Sint64 len = SDL_GetIOSize(io);
+    Uint8 sizebuf[8];
+    Uint8 *buf;
+    Sint64 tail;
+    size_t br;
+    int retval = 0;
+
+    BAIL_IF_MACRO((pos < 0) || (len < 0), ERR_CANNOT_SEEK, 0);
+    buf = (Uint8 *) SDL_malloc(SEEKINDEX_KEY_SPAN);
+    BAIL_IF_MACRO(buf == NULL, ERR_OUT_OF_MEMORY, 0);
+
+    *size = (Uint64) len;
+    __Sound_IndexPut64(sizebuf, *size);
+    *hash = seekindex_hash(SEEKINDEX_HASH_SEED, sizebuf, sizeof (sizebuf));
+
+    /* the tail starts where the head stops, if the two would overlap. */
+    tail = SDL_max(len - SEEKINDEX_KEY_SPAN, SDL_min(len, SEEKINDEX_KEY_SPAN));
+    br = (size_t) SDL_min(len, SEEKINDEX_KEY_SPAN);
+    if ( (SDL_SeekIO(io, 0, SDL_IO_SEEK_SET) == 0) && (SDL_ReadIO(io, buf, br) == br) )
+    {
+        *hash = seekindex_hash(*hash, buf, br);
+        br = (size_t) (len - tail);
+        if ( (SDL_SeekIO(io, tail, SDL_IO_SEEK_SET) == tail) && (SDL_ReadIO(io, buf, br) == br) )
+        {
+            *hash = seekindex_hash(*hash, buf, br);
+            retval = 1;
+        } /* if */
+    } /* if */
+
+    SDL_free(buf);
+    if (SDL_SeekIO(io, pos, SDL_IO_SEEK_SET) != pos)
+        retval = 0;
+    BAIL_IF_MACRO(!retval, ERR_IO_ERROR, 0);
+    return 1;
+} /* seekindex_key */
+
+
+int Sound_GetSeekIndexKey(Sound_Sample *sample, char *buf, int len)
+{
+    Sound_Sample *decoder;
+    Uint64 size = 0;
+    Uint64 hash = 0;
+    int rc;
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO((sample == NULL) || (buf == NULL), ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(len < 33, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(((Sound_SampleInternal *) sample->opaque)->push != NULL, ERR_NOT_SUPPORTED, 0);
+
+    decoder = lock_decoder(sample);
+    rc = seekindex_key(((Sound_SampleInternal *) decoder->opaque)->io, &size, &hash);
+    unlock_decoder(sample);
+    BAIL_IF_MACRO(!rc, NULL, 0);
+
+    SDL_snprintf(buf, (size_t) len, "%016" SDL_PRIx64 "%016" SDL_PRIx64, hash, size);
+    return 1;
+} /* Sound_GetSeekIndexKey */
+
+
+int Sound_SaveSeekIndex(Sound_Sample *sample, SDL_IOStream *io, bool closeio)
+{
+    Sound_SampleInternal *internal;
+    char name[SEEKINDEX_NAME_SIZE];
+    Sound_Sample *decoder;
+    Uint8 *buf = NULL;
+    Uint32 len = 0;
+    Uint64 size = 0;
+    Uint64 hash = 0;
+    bool ok = false;
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+
+    if (!initialized)
+        __Sound_SetError(ERR_NOT_INITIALIZED);
+    else if ((sample == NULL) || (io == NULL))
+        __Sound_SetError(ERR_INVALID_ARGUMENT);
+    else if (((Sound_SampleInternal *) sample->opaque)->push != NULL)
+        __Sound_SetError(ERR_NOT_SUPPORTED);
+    else if (((Sound_SampleInternal *) sample->opaque)->funcs->save_index == NULL)
+        __Sound_SetError(ERR_NOT_SUPPORTED);
+    else
+    {
+        internal = (Sound_SampleInternal *) sample->opaque;
+        decoder = lock_decoder(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+        scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OTHER);
+#endif
+        if (seekindex_key(internal->io, &size, &hash))
+            len = internal->funcs->save_index(decoder, NULL, 0);
+        if ((len > 0) && (len <= SEEKINDEX_MAX_SIZE))
+        {
+            buf = (Uint8 *) SDL_malloc(len);
+            if (buf == NULL)
+                __Sound_SetError(ERR_OUT_OF_MEMORY);
+            else if (internal->funcs->save_index(decoder, buf, len) == len)
+                ok = true;
+        } /* if */
+        else if (len > 0)
+            __Sound_SetError(ERR_OUT_OF_MEMORY);  /* no sane index is this big. */
+#if SOUND_SUPPORTS_ALLOC_STATS
+        __Sound_AllocLeave(scope);
+#endif
+        unlock_decoder(sample);
+
+        if (ok)
+        {
+            seekindex_name(sample, name);
+            ok = ( (SDL_WriteIO(io, SEEKINDEX_MAGIC, 8) == 8) &&
+                   SDL_WriteU32LE(io, SEEKINDEX_VERSION) &&
+                   (SDL_WriteIO(io, name, sizeof (name)) == sizeof (name)) &&
+                   SDL_WriteU64LE(io, size) &&
+                   SDL_WriteU64LE(io, hash) &&
+                   SDL_WriteU32LE(io, len) &&
+                   SDL_WriteU64LE(io, seekindex_hash(SEEKINDEX_HASH_SEED, buf, len)) &&
+                   (SDL_WriteIO(io, buf, len) == len) );
+            if (!ok)
+                __Sound_SetError(ERR_IO_ERROR);
+        } /* if */
+        SDL_free(buf);
+    } /* else */
+
+    if (closeio && (io != NULL) && !SDL_CloseIO(io) && ok)
+    {
+        __Sound_SetError(ERR_IO_ERROR);  /* the data might not have made it to disk. */
+        ok = false;
+    } /* if */
+
+    return ok ? 1 : 0;
+} /* Sound_SaveSeekIndex */
+
+
+int Sound_LoadSeekIndex(Sound_Sample *sample, SDL_IOStream *io, bool closeio)
+{
+    Sound_SampleInternal *internal;
+    char magic[8];
+    char name[SEEKINDEX_NAME_SIZE];
+    char expected[SEEKINDEX_NAME_SIZE];
+    Sound_Sample *decoder;
+    Uint32 version = 0;
+    Uint64 size = 0;
+    Uint64 hash = 0;
+    Uint64 stream_size = 0;
+    Uint64 stream_hash = 0;
+    Uint64 data_hash = 0;
+    Uint32 len = 0;
+    Uint8 *buf = NULL;
+    int retval = 0;
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocScope scope;
+#endif
+
+    if (!initialized)
+        __Sound_SetError(ERR_NOT_INITIALIZED);
+    else if ((sample == NULL) || (io == NULL))
+        __Sound_SetError(ERR_INVALID_ARGUMENT);
+    else if (((Sound_SampleInternal *) sample->opaque)->push != NULL)
+        __Sound_SetError(ERR_NOT_SUPPORTED);
+    else if (((Sound_SampleInternal *) sample->opaque)->funcs->load_index == NULL)
+        __Sound_SetError(ERR_NOT_SUPPORTED);
+    else if ( (SDL_ReadIO(io, magic, sizeof (magic)) != sizeof (magic)) ||
+              !SDL_ReadU32LE(io, &version) )
+        __Sound_SetError(ERR_IO_ERROR);
+    else if ((SDL_memcmp(magic, SEEKINDEX_MAGIC, 8) != 0) || (version != SEEKINDEX_VERSION))
+        __Sound_SetError("Not a seek index, or from an incompatible version of SDL_sound");
+    else if ( (SDL_ReadIO(io, name, sizeof (name)) != sizeof (name)) ||
+              !SDL_ReadU64LE(io, &size) ||
+              !SDL_ReadU64LE(io, &hash) ||
+              !SDL_ReadU32LE(io, &len) ||
+              !SDL_ReadU64LE(io, &data_hash) )
+        __Sound_SetError(ERR_IO_ERROR);
+    else
+    {
+        seekindex_name(sample, expected);
+        if (SDL_memcmp(name, expected, sizeof (name)) != 0)
+            __Sound_SetError("Seek index is for a different decoder");
+        else if ((len == 0) || (len > SEEKINDEX_MAX_SIZE))
+            __Sound_SetError(ERR_CORRUPT_SEEK_INDEX);
+        else if ((buf = (Uint8 *) SDL_malloc(len)) == NULL)
+            __Sound_SetError(ERR_OUT_OF_MEMORY);
+        else if (SDL_ReadIO(io, buf, len) != len)
+            __Sound_SetError(ERR_IO_ERROR);
+        else if (seekindex_hash(SEEKINDEX_HASH_SEED, buf, len) != data_hash)
+            __Sound_SetError(ERR_CORRUPT_SEEK_INDEX);
+        else
+        {
+            internal = (Sound_SampleInternal *) sample->opaque;
+            decoder = lock_decoder(sample);
+#if SOUND_SUPPORTS_ALLOC_STATS
+            scope = __Sound_AllocEnter(sample, SOUND_ALLOCPHASE_OTHER);
+#endif
+            if (seekindex_key(internal->io, &stream_size, &stream_hash))
+            {
+                if ((stream_size != size) || (stream_hash != hash))
+                    __Sound_SetError(ERR_WRONG_SEEK_INDEX);
+                else
+                    retval = internal->funcs->load_index(decoder, buf, len);
+            } /* if */
+#if SOUND_SUPPORTS_ALLOC_STATS
+            __Sound_AllocLeave(scope);
+#endif
+            unlock_decoder(sample);
+        } /* else */
+        SDL_free(buf);
+    } /* else */
+
+    if (closeio && (io != NULL))
+        SDL_CloseIO(io);
+
+    return retval;
+} /* Sound_LoadSeekIndex */
+
+
+Sound_Sample *Sound_NewSampleWithIndex(SDL_IOStream *io, const char *ext,
+                                       const SDL_AudioSpec *desired,
+                                       Uint32 bufferSize, SDL_IOStream *index,
+                                       bool closeindex)
+{
+    Sound_Sample *retval = Sound_NewSample(io, ext, desired, bufferSize);
+
+    if ((retval != NULL) && (index != NULL))
+    {
+        /* a stale or missing index just means the first seek is slow again. */
+        Sound_LoadSeekIndex(retval, index, closeindex);
+    } /* if */
+    else if (closeindex && (index != NULL))
+        SDL_CloseIO(index);
+
+    return retval;
+} /* Sound_NewSampleWithIndex */
+
+
+int Sound_GetSampleStats(Sound_Sample *sample, Sound_SampleStats *stats)
+{
+#if SOUND_SUPPORTS_STATS
+    Sound_SampleInternal *internal;
+#endif
+
+    BAIL_IF_MACRO(!initialized, ERR_NOT_INITIALIZED, 0);
+    BAIL_IF_MACRO(sample == NULL, ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_MACRO(stats == NULL, ERR_INVALID_ARGUMENT, 0);
+
+#if SOUND_SUPPORTS_STATS
+    internal = (Sound_SampleInternal *) sample->opaque;
+    if (internal->ahead != NULL)  /* the worker updates these as it goes. */
+        SDL_LockMutex(internal->ahead->lock);
+    SDL_copyp(stats, &internal->stats);
+    stats->frames_decoded = internal->stats_decoded_bytes / SDL_AUDIO_FRAMESIZE(sample->actual);
+    if (internal->ahead != NULL)
+        SDL_UnlockMutex(internal->ahead->lock);
+    return 1;
+#else
+    SDL_zerop(stats);
+    BAIL_MACRO(ERR_NOT_SUPPORTED, 0);
+#endif
+} /* Sound_GetSampleStats */
+
+
 /* Utility functions ... */
 
 void *__Sound_SIMDAlloc(const size_t len)
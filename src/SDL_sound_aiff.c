@@ -44,7 +44,7 @@ typedef struct S_AIFF_FMT_T
     void (*free)(struct S_AIFF_FMT_T *fmt);
     Uint32 (*read_sample)(Sound_Sample *sample);
     int (*rewind_sample)(Sound_Sample *sample);
-    int (*seek_sample)(Sound_Sample *sample, Uint32 ms);
+    int (*seek_sample)(Sound_Sample *sample, Uint64 frame);
 
 
 #if 0
@@ -269,12 +269,15 @@ static Uint32 read_sample_fmt_normal(Sound_Sample *sample)
          * We don't actually do any decoding, so we read the AIFF data
          *  directly into the internal buffer...
          */
-    retval = SDL_ReadIO(internal->io, internal->buffer, max);
+    retval = __Sound_ReadPCM(sample, max);
 
     a->bytesLeft -= retval;
 
         /* Make sure the read went smoothly... */
-    if ((retval == 0) || (a->bytesLeft == 0))
+    if ((retval == 0) && (SDL_GetIOStatus(internal->io) == SDL_IO_STATUS_NOT_READY))
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;  /* non-blocking stream; more is coming. */
+
+    else if ((retval == 0) || (a->bytesLeft == 0))
         sample->flags |= SOUND_SAMPLEFLAG_EOF;
 
     else if (retval == -1) /** FIXME: this error check is broken **/
@@ -295,16 +298,20 @@ static int rewind_sample_fmt_normal(Sound_Sample *sample)
 } /* rewind_sample_fmt_normal */
 
 
-static int seek_sample_fmt_normal(Sound_Sample *sample, Uint32 ms)
+static int seek_sample_fmt_normal(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     aiff_t *a = (aiff_t *) internal->decoder_private;
     const fmt_t *fmt = &a->fmt;
-    const Uint32 offset = __Sound_convertMsToBytePos(&sample->actual, ms);
-    const Sint64 pos = (Sint64) (fmt->data_starting_offset + offset);
-    const Sint64 rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
+    const Uint64 offset = frame * SDL_AUDIO_FRAMESIZE(sample->actual);
+    Sint64 pos;
+    Sint64 rc;
+
+    BAIL_IF_MACRO(offset > fmt->total_bytes, ERR_PAST_EOF, 0);
+    pos = (Sint64) (fmt->data_starting_offset + offset);
+    rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
     BAIL_IF_MACRO(rc != pos, ERR_IO_ERROR, 0);
-    a->bytesLeft = fmt->total_bytes - offset;
+    a->bytesLeft = fmt->total_bytes - (Uint32) offset;
     return 1;  /* success. */
 } /* seek_sample_fmt_normal */
 
@@ -505,13 +512,27 @@ static int AIFF_rewind(Sound_Sample *sample)
 } /* AIFF_rewind */
 
 
-static int AIFF_seek(Sound_Sample *sample, Uint32 ms)
+static int AIFF_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     aiff_t *a = (aiff_t *) internal->decoder_private;
-    return a->fmt.seek_sample(sample, ms);
+    return a->fmt.seek_sample(sample, frame);
+} /* AIFF_seek_frame */
+
+
+static int AIFF_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return AIFF_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* AIFF_seek */
 
+static int AIFF_probe(const Uint8 *header, Uint32 len)
+{
+    return ( (len >= 12) && (SDL_memcmp(header, "FORM", 4) == 0) &&
+             ( (SDL_memcmp(header + 8, "AIFF", 4) == 0) ||
+               (SDL_memcmp(header + 8, "AIFC", 4) == 0) ) );
+} /* AIFF_probe */
+
+
 static const char *extensions_aiff[] = { "AIFF", "AIF", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_AIFF =
 {
@@ -528,7 +549,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_AIFF =
     AIFF_close,     /*  close() method */
     AIFF_read,      /*   read() method */
     AIFF_rewind,    /* rewind() method */
-    AIFF_seek       /*   seek() method */
+    AIFF_seek,      /*   seek() method */
+    AIFF_seek_frame, /* seek_frame() method */
+    AIFF_probe,     /*  probe() method */
+    NULL,           /* duration() method */
+    NULL,           /* save_index() method */
+    NULL            /* load_index() method */
 };
 
 
@@ -0,0 +1,243 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/**
+ * This file implements the counting allocator behind Sound_GetAllocStats().
+ *
+ * When SDL_sound is built with SOUND_SUPPORTS_ALLOC_STATS, SDL_sound_internal.h
+ *  turns SDL_malloc() and friends into calls to the functions here, in every
+ *  file that includes it. That's all of SDL_sound, and the decoders' libraries
+ *  too, since dr_mp3, dr_flac, stb_vorbis, libmodplug and timidity are all
+ *  told to use SDL_malloc(). Each block carries its size in a small header in
+ *  front of it, so frees can be counted as well.
+ *
+ * SDL_sound.c brackets every call into a decoder with __Sound_AllocEnter()
+ *  and __Sound_AllocLeave(), which point a thread-local at the sample, so
+ *  anything allocated or freed on that thread in the meantime is charged to
+ *  the sample's Sound_SampleStats as well as the global totals.
+ */
+
+#define SOUND_ALLOC_NO_REDIRECT 1
+#define __SDL_SOUND_INTERNAL__
+#include "SDL_sound_internal.h"
+
+#if SOUND_SUPPORTS_ALLOC_STATS
+
+/* keeps the block after it as aligned as SDL_malloc()'s own. */
+#define ALLOC_HEADER_SIZE 16
+
+static SDL_SpinLock alloc_lock = 0;
+static Sound_AllocStats alloc_stats;
+static SDL_TLSID tlsid_alloc_sample;
+
+/* (delta) is the change in bytes in use; (size) is nonzero for an allocation. */
+static void count_alloc(size_t size, Sint64 delta, bool freed)
+{
+    Sound_Sample *sample = (Sound_Sample *) SDL_GetTLS(&tlsid_alloc_sample);
+
+    SDL_LockSpinlock(&alloc_lock);
+
+    if (freed)
+        alloc_stats.frees++;
+    else
+    {
+        alloc_stats.allocations++;
+        alloc_stats.bytes_allocated += size;
+    } /* else */
+
+    alloc_stats.bytes_in_use += delta;
+    if (alloc_stats.bytes_in_use > alloc_stats.peak_bytes_in_use)
+        alloc_stats.peak_bytes_in_use = alloc_stats.bytes_in_use;
+
+    if (sample != NULL)
+    {
+        Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+        Sound_SampleStats *stats = &internal->stats;
+
+        if (!freed)
+        {
+            if (internal->alloc_phase == SOUND_ALLOCPHASE_OPEN)
+            {
+                stats->open_allocs++;
+                stats->open_alloc_bytes += size;
+            } /* if */
+            else if (internal->alloc_phase == SOUND_ALLOCPHASE_READ)
+            {
+                stats->read_allocs++;
+                stats->read_alloc_bytes += size;
+            } /* else if */
+        } /* if */
+
+        /* memory from before the sample existed can be freed in its close(). */
+        if ((delta < 0) && (((Uint64) -delta) > stats->decoder_bytes))
+            stats->decoder_bytes = 0;
+        else
+            stats->decoder_bytes += delta;
+
+        if (stats->decoder_bytes > stats->decoder_peak_bytes)
+            stats->decoder_peak_bytes = stats->decoder_bytes;
+    } /* if */
+
+    SDL_UnlockSpinlock(&alloc_lock);
+} /* count_alloc */
+
+
+Sound_AllocScope __Sound_AllocEnter(Sound_Sample *sample, Sound_AllocPhase phase)
+{
+    Sound_AllocScope prev;
+    prev.sample = (Sound_Sample *) SDL_GetTLS(&tlsid_alloc_sample);
+    prev.phase = SOUND_ALLOCPHASE_NONE;
+    if (prev.sample != NULL)
+        prev.phase = ((Sound_SampleInternal *) prev.sample->opaque)->alloc_phase;
+
+    ((Sound_SampleInternal *) sample->opaque)->alloc_phase = phase;
+    SDL_SetTLS(&tlsid_alloc_sample, sample, NULL);
+    return prev;
+} /* __Sound_AllocEnter */
+
+
+void __Sound_AllocLeave(Sound_AllocScope prev)
+{
+    Sound_Sample *sample = (Sound_Sample *) SDL_GetTLS(&tlsid_alloc_sample);
+    if (sample != NULL)
+        ((Sound_SampleInternal *) sample->opaque)->alloc_phase = SOUND_ALLOCPHASE_NONE;
+    if (prev.sample != NULL)
+        ((Sound_SampleInternal *) prev.sample->opaque)->alloc_phase = prev.phase;
+    SDL_SetTLS(&tlsid_alloc_sample, prev.sample, NULL);
+} /* __Sound_AllocLeave */
+
+
+void *__Sound_Malloc(size_t size)
+{
+    Uint8 *ptr;
+    size_t total;
+
+    if (!SDL_size_add_check_overflow(size, ALLOC_HEADER_SIZE, &total))
+        return NULL;
+
+    ptr = (Uint8 *) SDL_malloc(total);
+    if (ptr == NULL)
+        return NULL;
+
+    *((size_t *) ptr) = size;
+    count_alloc(size, (Sint64) size, false);
+    return ptr + ALLOC_HEADER_SIZE;
+} /* __Sound_Malloc */
+
+
+void *__Sound_Calloc(size_t nmemb, size_t size)
+{
+    void *retval;
+    size_t total;
+
+    if (!SDL_size_mul_check_overflow(nmemb, size, &total))
+        return NULL;
+
+    retval = __Sound_Malloc(total);
+    if (retval != NULL)
+        SDL_memset(retval, '\0', total);
+    return retval;
+} /* __Sound_Calloc */
+
+
+void *__Sound_Realloc(void *mem, size_t size)
+{
+    Uint8 *ptr;
+    size_t oldsize;
+    size_t total;
+
+    if (mem == NULL)
+        return __Sound_Malloc(size);
+
+    if (!SDL_size_add_check_overflow(size, ALLOC_HEADER_SIZE, &total))
+        return NULL;
+
+    ptr = ((Uint8 *) mem) - ALLOC_HEADER_SIZE;
+    oldsize = *((size_t *) ptr);
+    ptr = (Uint8 *) SDL_realloc(ptr, total);
+    if (ptr == NULL)
+        return NULL;
+
+    *((size_t *) ptr) = size;
+    count_alloc(size, ((Sint64) size) - ((Sint64) oldsize), false);
+    return ptr + ALLOC_HEADER_SIZE;
+} /* __Sound_Realloc */
+
+
+void __Sound_Free(void *mem)
+{
+    if (mem != NULL)
+    {
+        Uint8 *ptr = ((Uint8 *) mem) - ALLOC_HEADER_SIZE;
+        count_alloc(0, -((Sint64) *((size_t *) ptr)), true);
+        SDL_free(ptr);
+    } /* if */
+} /* __Sound_Free */
+
+
+char *__Sound_Strdup(const char *str)
+{
+    const size_t len = SDL_strlen(str) + 1;
+    char *retval = (char *) __Sound_Malloc(len);
+    if (retval != NULL)
+        SDL_memcpy(retval, str, len);
+    return retval;
+} /* __Sound_Strdup */
+
+
+/*
+ * The same layout as SDL's: the real block's address goes just before the
+ *  aligned one. __Sound_SIMDRealloc() counts on that, and it reallocates
+ *  through __Sound_Realloc(), so the real block has to come from here too.
+ */
+void *__Sound_AlignedAlloc(size_t alignment, size_t size)
+{
+    const size_t padding = (alignment - (size % alignment)) % alignment;
+    Uint8 *retval;
+    Uint8 *ptr;
+    size_t total;
+
+    if (!SDL_size_add_check_overflow(size, alignment + padding + sizeof (void *), &total))
+        return NULL;
+
+    ptr = (Uint8 *) __Sound_Malloc(total);
+    if (ptr == NULL)
+        return NULL;
+
+    retval = ptr + sizeof (void *);
+    retval += alignment - (((size_t) retval) % alignment);
+    *(((void **) retval) - 1) = ptr;
+    return retval;
+} /* __Sound_AlignedAlloc */
+
+
+void __Sound_AlignedFree(void *mem)
+{
+    if (mem != NULL)
+        __Sound_Free(*(((void **) mem) - 1));
+} /* __Sound_AlignedFree */
+
+#endif  /* SOUND_SUPPORTS_ALLOC_STATS */
+
+
+int Sound_GetAllocStats(Sound_AllocStats *stats)
+{
+    BAIL_IF_MACRO(stats == NULL, ERR_INVALID_ARGUMENT, 0);
+
+#if SOUND_SUPPORTS_ALLOC_STATS
+    SDL_LockSpinlock(&alloc_lock);
+    SDL_copyp(stats, &alloc_stats);
+    SDL_UnlockSpinlock(&alloc_lock);
+    return 1;
+#else
+    SDL_zerop(stats);
+    BAIL_MACRO(ERR_NOT_SUPPORTED, 0);
+#endif
+} /* Sound_GetAllocStats */
+
+/* end of SDL_sound_alloc.c ... */
@@ -268,8 +268,13 @@ static Uint32 AU_read(Sound_Sample *sample)
 
     if (maxlen > dec->remaining)
         maxlen = dec->remaining;
-    ret = SDL_ReadIO(internal->io, buf, maxlen);
-    if (ret == 0)
+    if (dec->encoding == AU_ENC_ULAW_8)
+        ret = (int) __Sound_ReadFrames(internal->io, buf, maxlen, sample->actual.channels);
+    else
+        ret = __Sound_ReadPCM(sample, maxlen);
+    if ((ret == 0) && (SDL_GetIOStatus(internal->io) == SDL_IO_STATUS_NOT_READY))
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;  /* non-blocking stream; more is coming. */
+    else if (ret == 0)
         sample->flags |= SOUND_SAMPLEFLAG_EOF;
     else if (ret == -1) /** FIXME: this error check is broken **/
         sample->flags |= SOUND_SAMPLEFLAG_ERROR;
@@ -304,24 +309,37 @@ static int AU_rewind(Sound_Sample *sample)
 } /* AU_rewind */
 
 
-static int AU_seek(Sound_Sample *sample, Uint32 ms)
+static int AU_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     struct audec *dec = (struct audec *) internal->decoder_private;
-    Sint64 offset = __Sound_convertMsToBytePos(&sample->actual, ms);
+    const Uint64 bytes_per_frame = ((dec->encoding == AU_ENC_LINEAR_16) ? 2 : 1) * sample->actual.channels;
+    const Uint64 offset = frame * bytes_per_frame;  /* offset in the file, not the decoded data. */
     Sint64 rc;
     Sint64 pos;
 
-    if (dec->encoding == AU_ENC_ULAW_8)
-        offset >>= 1;  /* halve the byte offset for compression. */
+    BAIL_IF_MACRO(offset > dec->total, ERR_PAST_EOF, 0);
 
-    pos = (dec->start_offset + offset);
+    pos = (dec->start_offset + (Sint64) offset);
     rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
     BAIL_IF_MACRO(rc != pos, ERR_IO_ERROR, 0);
-    dec->remaining = dec->total - offset;
+    dec->remaining = dec->total - (Uint32) offset;
     return 1;
+} /* AU_seek_frame */
+
+
+static int AU_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return AU_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* AU_seek */
 
+/* headerless .au files are only accepted by extension, so need the magic. */
+static int AU_probe(const Uint8 *header, Uint32 len)
+{
+    return ((len >= 4) && (SDL_memcmp(header, ".snd", 4) == 0));
+} /* AU_probe */
+
+
 /*
  * Sometimes the extension ".snd" is used for these files (mostly on the NeXT),
  * and the magic number comes from this. However it may clash with other
@@ -343,7 +361,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_AU =
     AU_close,       /*  close() method */
     AU_read,        /*   read() method */
     AU_rewind,      /* rewind() method */
-    AU_seek         /*   seek() method */
+    AU_seek,        /*   seek() method */
+    AU_seek_frame,  /* seek_frame() method */
+    AU_probe,       /*  probe() method */
+    NULL,           /* duration() method */
+    NULL,           /* save_index() method */
+    NULL            /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_AU */
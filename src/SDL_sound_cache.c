@@ -0,0 +1,440 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/**
+ * This file implements the decoded-PCM cache (see Sound_SetCacheSize()).
+ *
+ * Sound_NewSampleFromFile() and Sound_NewSampleFromMem() look up their data
+ *  here first. On a miss, SDL_sound.c decodes the whole sample and hands the
+ *  result to __Sound_CacheAdd(); on a hit, it builds a sample that reads the
+ *  cached audio through the CACHE "decoder" below, which is just a raw PCM
+ *  reader over a memory stream.
+ *
+ * Entries live on a list in most-recently-used order, and are evicted from
+ *  the back when the total goes over budget. Samples hold a reference to the
+ *  entry they read from, so an evicted entry sticks around until the last of
+ *  them is freed. Everything is protected by cache_mutex.
+ *
+ * Documentation is in SDL_sound.h ... It's verbose, honest.  :)
+ */
+
+#define __SDL_SOUND_INTERNAL__
+#include "SDL_sound_internal.h"
+
+struct Sound_CacheEntry
+{
+    Sound_CacheKey key;  /* key.path is our own copy. */
+    SDL_AudioSpec spec;  /* format of (pcm). */
+    const Sound_DecoderInfo *decoder;  /* what decoded it in the first place. */
+    Uint8 *pcm;
+    Uint32 pcmlen;
+    int refcount;
+    bool evicted;  /* off the list; free it when refcount hits zero. */
+    Sound_CacheEntry *prev;
+    Sound_CacheEntry *next;
+};
+
+static SDL_Mutex *cache_mutex = NULL;
+static Uint64 cache_budget = 0;  /* zero means the cache is off. */
+static Uint64 cache_bytes = 0;  /* total (pcmlen) of everything on the list. */
+static Sound_CacheEntry *cache_head = NULL;  /* most recently used. */
+static Sound_CacheEntry *cache_tail = NULL;  /* next to go. */
+
+
+static void free_entry(Sound_CacheEntry *entry)
+{
+    __Sound_SIMDFree(entry->pcm);
+    SDL_free((void *) entry->key.path);
+    SDL_free(entry);
+} /* free_entry */
+
+
+/* Call with cache_mutex held. */
+static void unlink_entry(Sound_CacheEntry *entry)
+{
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        cache_head = entry->next;
+
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        cache_tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+} /* unlink_entry */
+
+
+/* Call with cache_mutex held. */
+static void link_entry(Sound_CacheEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache_head;
+    if (cache_head != NULL)
+        cache_head->prev = entry;
+    else
+        cache_tail = entry;
+    cache_head = entry;
+} /* link_entry */
+
+
+/* Call with cache_mutex held. */
+static void evict_entry(Sound_CacheEntry *entry)
+{
+    unlink_entry(entry);
+    cache_bytes -= entry->pcmlen;
+    if (entry->refcount == 0)
+        free_entry(entry);
+    else
+        entry->evicted = true;  /* last sample using it will free it. */
+} /* evict_entry */
+
+
+/* Call with cache_mutex held. */
+static void evict_down_to(Uint64 bytes)
+{
+    while ((cache_tail != NULL) && (cache_bytes > bytes))
+        evict_entry(cache_tail);
+} /* evict_down_to */
+
+
+static bool keys_match(const Sound_CacheKey *a, const Sound_CacheKey *b)
+{
+    if ( (a->hash != b->hash) || (a->size != b->size) || (a->mtime != b->mtime) ||
+         (SDL_memcmp(&a->desired, &b->desired, sizeof (SDL_AudioSpec)) != 0) )
+        return false;
+    else if ((a->path == NULL) || (b->path == NULL))
+        return (a->path == b->path);
+    return (SDL_strcmp(a->path, b->path) == 0);
+} /* keys_match */
+
+
+/* Call with cache_mutex held. */
+static Sound_CacheEntry *find_entry(const Sound_CacheKey *key)
+{
+    Sound_CacheEntry *entry;
+    for (entry = cache_head; entry != NULL; entry = entry->next)
+    {
+        if (keys_match(&entry->key, key))
+            return entry;
+    } /* for */
+    return NULL;
+} /* find_entry */
+
+
+/* 64-bit FNV-1a, a word at a time; we just need it to be quick and spread out. */
+static Uint64 hash_bytes(const Uint8 *data, size_t len)
+{
+    const Uint64 prime = 0x100000001B3ULL;
+    Uint64 hash = 0xCBF29CE484222325ULL;
+    Uint64 word;
+
+    while (len >= sizeof (word))
+    {
+        SDL_memcpy(&word, data, sizeof (word));
+        hash = (hash ^ word) * prime;
+        data += sizeof (word);
+        len -= sizeof (word);
+    } /* while */
+
+    while (len--)
+        hash = (hash ^ *(data++)) * prime;
+
+    return hash;
+} /* hash_bytes */
+
+
+static void key_desired(Sound_CacheKey *key, const SDL_AudioSpec *desired)
+{
+    if (desired == NULL)
+        SDL_zero(key->desired);
+    else
+    {
+        key->desired.format = desired->format;
+        key->desired.channels = desired->channels;
+        key->desired.freq = desired->freq;
+    } /* else */
+} /* key_desired */
+
+
+bool __Sound_CacheInit(void)
+{
+    cache_mutex = SDL_CreateMutex();
+    return (cache_mutex != NULL);
+} /* __Sound_CacheInit */
+
+
+void __Sound_CacheQuit(void)
+{
+    Sound_FlushCache();
+    SDL_DestroyMutex(cache_mutex);
+    cache_mutex = NULL;
+} /* __Sound_CacheQuit */
+
+
+Uint64 __Sound_CacheBudget(void)
+{
+    Uint64 retval;
+    SDL_LockMutex(cache_mutex);
+    retval = cache_budget;
+    SDL_UnlockMutex(cache_mutex);
+    return retval;
+} /* __Sound_CacheBudget */
+
+
+bool __Sound_CacheKeyFromFile(Sound_CacheKey *key, const char *filename,
+                              const SDL_AudioSpec *desired)
+{
+    SDL_PathInfo info;
+
+    if (!SDL_GetPathInfo(filename, &info))
+        return false;  /* can't tell if it changed; don't cache it. */
+
+    SDL_zerop(key);
+    key->hash = hash_bytes((const Uint8 *) filename, SDL_strlen(filename));
+    key->size = info.size;
+    key->mtime = (Sint64) info.modify_time;
+    key->path = filename;
+    key_desired(key, desired);
+    return true;
+} /* __Sound_CacheKeyFromFile */
+
+
+void __Sound_CacheKeyFromMem(Sound_CacheKey *key, const Uint8 *data,
+                             Uint32 size, const SDL_AudioSpec *desired)
+{
+    SDL_zerop(key);
+    key->hash = hash_bytes(data, size);
+    key->size = size;
+    key_desired(key, desired);
+} /* __Sound_CacheKeyFromMem */
+
+
+Sound_CacheEntry *__Sound_CacheFind(const Sound_CacheKey *key)
+{
+    Sound_CacheEntry *entry;
+
+    SDL_LockMutex(cache_mutex);
+    entry = find_entry(key);
+    if (entry != NULL)
+    {
+        unlink_entry(entry);  /* move it to the front. */
+        link_entry(entry);
+        entry->refcount++;
+    } /* if */
+    SDL_UnlockMutex(cache_mutex);
+
+    return entry;
+} /* __Sound_CacheFind */
+
+
+Sound_CacheEntry *__Sound_CacheAdd(const Sound_CacheKey *key,
+                                   const Sound_Sample *sample,
+                                   void *pcm, Uint32 len)
+{
+    Sound_CacheEntry *entry;
+    Sound_CacheEntry *old;
+
+    entry = (Sound_CacheEntry *) SDL_calloc(1, sizeof (Sound_CacheEntry));
+    BAIL_IF_MACRO(entry == NULL, ERR_OUT_OF_MEMORY, NULL);
+
+    SDL_copyp(&entry->key, key);
+    if (key->path != NULL)
+    {
+        entry->key.path = SDL_strdup(key->path);
+        if (entry->key.path == NULL)
+        {
+            SDL_free(entry);
+            BAIL_MACRO(ERR_OUT_OF_MEMORY, NULL);
+        } /* if */
+    } /* if */
+
+    SDL_copyp(&entry->spec, &sample->desired);
+    entry->decoder = sample->decoder;
+    entry->pcm = (Uint8 *) pcm;
+    entry->pcmlen = len;
+    entry->refcount = 1;  /* for the caller. */
+
+    SDL_LockMutex(cache_mutex);
+
+    old = find_entry(key);  /* someone else decoded it at the same time? */
+    if (old != NULL)
+        evict_entry(old);
+
+    if (len > cache_budget)  /* too big to keep; it just lives as long as the sample. */
+        entry->evicted = true;
+    else
+    {
+        evict_down_to(cache_budget - len);
+        link_entry(entry);
+        cache_bytes += len;
+    } /* else */
+
+    SDL_UnlockMutex(cache_mutex);
+
+    return entry;
+} /* __Sound_CacheAdd */
+
+
+void __Sound_CacheRelease(Sound_CacheEntry *entry)
+{
+    bool dead;
+
+    if (entry == NULL)
+        return;
+
+    SDL_LockMutex(cache_mutex);
+    entry->refcount--;
+    dead = (entry->evicted && (entry->refcount == 0));
+    SDL_UnlockMutex(cache_mutex);
+
+    if (dead)
+        free_entry(entry);
+} /* __Sound_CacheRelease */
+
+
+SDL_IOStream *__Sound_CacheOpenIO(Sound_CacheEntry *entry)
+{
+    SDL_IOStream *retval = SDL_IOFromConstMem(entry->pcm, entry->pcmlen);
+    BAIL_IF_MACRO(retval == NULL, SDL_GetError(), NULL);
+    return retval;
+} /* __Sound_CacheOpenIO */
+
+
+int Sound_SetCacheSize(Uint64 max_bytes)
+{
+    BAIL_IF_MACRO(cache_mutex == NULL, ERR_NOT_INITIALIZED, 0);
+
+    SDL_LockMutex(cache_mutex);
+    cache_budget = max_bytes;
+    evict_down_to(max_bytes);
+    SDL_UnlockMutex(cache_mutex);
+
+    return 1;
+} /* Sound_SetCacheSize */
+
+
+void Sound_FlushCache(void)
+{
+    if (cache_mutex == NULL)
+        return;
+
+    SDL_LockMutex(cache_mutex);
+    evict_down_to(0);
+    SDL_UnlockMutex(cache_mutex);
+} /* Sound_FlushCache */
+
+
+
+/*
+ * The CACHE decoder. This isn't in the decoder list; SDL_sound.c uses it
+ *  directly for cache hits, with the entry in internal->decoder_private and
+ *  a memory stream over the entry's audio in internal->io.
+ */
+
+static bool CACHE_init(void)
+{
+    return true;  /* always succeeds. */
+} /* CACHE_init */
+
+
+static void CACHE_quit(void)
+{
+    /* it's a no-op. */
+} /* CACHE_quit */
+
+
+static int CACHE_open(Sound_Sample *sample, const char *ext)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_CacheEntry *entry = (Sound_CacheEntry *) internal->decoder_private;
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(entry->spec);
+    const Uint64 frames = entry->pcmlen / framesize;
+
+    SDL_copyp(&sample->actual, &entry->spec);
+    sample->decoder = entry->decoder;  /* report what really decoded it. */
+    sample->flags = SOUND_SAMPLEFLAG_CANSEEK;
+
+    internal->total_time = (Sint32) ((frames / entry->spec.freq) * 1000);
+    internal->total_time += (Sint32) (((frames % entry->spec.freq) * 1000) / entry->spec.freq);
+    return 1;
+} /* CACHE_open */
+
+
+static void CACHE_close(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    __Sound_CacheRelease((Sound_CacheEntry *) internal->decoder_private);
+} /* CACHE_close */
+
+
+static Uint32 CACHE_read(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    const Uint32 retval = __Sound_ReadPCM(sample, internal->buffer_size);
+
+    if (retval < internal->buffer_size)
+        sample->flags |= SOUND_SAMPLEFLAG_EOF;
+
+    return retval;
+} /* CACHE_read */
+
+
+static int CACHE_rewind(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    BAIL_IF_MACRO(SDL_SeekIO(internal->io, 0, SDL_IO_SEEK_SET) != 0, ERR_IO_ERROR, 0);
+    return 1;
+} /* CACHE_rewind */
+
+
+static int CACHE_seek_frame(Sound_Sample *sample, Uint64 frame)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_CacheEntry *entry = (Sound_CacheEntry *) internal->decoder_private;
+    const Uint64 pos = frame * SDL_AUDIO_FRAMESIZE(entry->spec);
+
+    BAIL_IF_MACRO(pos > entry->pcmlen, ERR_PAST_EOF, 0);
+    BAIL_IF_MACRO(SDL_SeekIO(internal->io, (Sint64) pos, SDL_IO_SEEK_SET) != (Sint64) pos, ERR_IO_ERROR, 0);
+    return 1;
+} /* CACHE_seek_frame */
+
+
+static int CACHE_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return CACHE_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
+} /* CACHE_seek */
+
+
+static const char *extensions_cache[] = { NULL };
+const Sound_DecoderFunctions __Sound_DecoderFunctions_CACHE =
+{
+    {
+        extensions_cache,
+        "Decoded audio from SDL_sound's cache",
+        "Ryan C. Gordon <icculus@icculus.org>",
+        "https://icculus.org/SDL_sound/"
+    },
+
+    CACHE_init,       /*   init() method */
+    CACHE_quit,       /*   quit() method */
+    CACHE_open,       /*   open() method */
+    CACHE_close,      /*  close() method */
+    CACHE_read,       /*   read() method */
+    CACHE_rewind,     /* rewind() method */
+    CACHE_seek,       /*   seek() method */
+    CACHE_seek_frame, /* seek_frame() method */
+    NULL,             /*  probe() method */
+    NULL,             /* duration() method */
+    NULL,             /* save_index() method */
+    NULL              /* load_index() method */
+};
+
+/* end of SDL_sound_cache.c ... */
+
@@ -0,0 +1,797 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/**
+ * This file implements the conversions Sound_Decode() does itself, instead
+ *  of going through an SDL_AudioStream: sample format changes and mono/stereo
+ *  up- and downmixing, when the sample rate doesn't change. These are all
+ *  one-pass loops over the decoded data, so there's no need for the stream's
+ *  queueing, locking and resampler setup.
+ *
+ * A conversion is a short list of stages, each one a kernel that converts
+ *  a run of samples (or frames, for the mixers). Everything happens in place,
+ *  front to back, in one work area: stages that shrink the data write over
+ *  their own input, and stages that grow it have their input placed at the
+ *  end of where their output goes, so the output never catches up with input
+ *  that hasn't been read yet. __Sound_InitConverter() works out where the
+ *  decoder has to put its data to make that happen.
+ *
+ * The kernels that get a lot of use have SSE2, AVX2 and NEON versions, which
+ *  are picked at runtime. They process the same way as the plain C versions,
+ *  a block at a time, loading a whole block before storing any of it, and
+ *  give identical results.
+ */
+
+#define __SDL_SOUND_INTERNAL__
+#include "SDL_sound_internal.h"
+
+/* Plain C versions. The SIMD versions finish off their leftovers with these. */
+
+static void convert_s16_to_f32_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    float *d = (float *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++)
+        d[i] = ((float) s[i]) * (1.0f / 32768.0f);
+} /* convert_s16_to_f32_scalar */
+
+static void convert_f32_to_s16_scalar(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++)
+    {
+        float f = s[i];
+        Sint32 val;
+        f = (f > -1.0f) ? f : -1.0f;  /* written like this so NaN becomes -1, like SSE does. */
+        f = (f < 1.0f) ? f : 1.0f;
+        val = (Sint32) (f * 32768.0f);
+        d[i] = (Sint16) ((val > 32767) ? 32767 : val);
+    } /* for */
+} /* convert_f32_to_s16_scalar */
+
+static void convert_s32_to_s16_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Sint32 *s = (const Sint32 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++)
+        d[i] = (Sint16) (s[i] >> 16);
+} /* convert_s32_to_s16_scalar */
+
+static void convert_u8_to_s16_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint8 *s = (const Uint8 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++)
+        d[i] = (Sint16) ((((Sint32) s[i]) - 128) * 256);
+} /* convert_u8_to_s16_scalar */
+
+static void convert_swap16_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint16 *s = (const Uint16 *) src;
+    Uint16 *d = (Uint16 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++)
+        d[i] = SDL_Swap16(s[i]);
+} /* convert_swap16_scalar */
+
+static void convert_swap32_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint32 *s = (const Uint32 *) src;
+    Uint32 *d = (Uint32 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++)
+        d[i] = SDL_Swap32(s[i]);
+} /* convert_swap32_scalar */
+
+/* the mixers take a count of frames, not samples. */
+
+static void convert_downmix_u8_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint8 *s = (const Uint8 *) src;
+    Uint8 *d = (Uint8 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, s += 2)
+        d[i] = (Uint8) ((((Uint32) s[0]) + ((Uint32) s[1])) >> 1);
+} /* convert_downmix_u8_scalar */
+
+static void convert_downmix_s8_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Sint8 *s = (const Sint8 *) src;
+    Sint8 *d = (Sint8 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, s += 2)
+        d[i] = (Sint8) ((((Sint32) s[0]) + ((Sint32) s[1])) >> 1);
+} /* convert_downmix_s8_scalar */
+
+static void convert_downmix_s16_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, s += 2)
+        d[i] = (Sint16) ((((Sint32) s[0]) + ((Sint32) s[1])) >> 1);
+} /* convert_downmix_s16_scalar */
+
+static void convert_downmix_s32_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Sint32 *s = (const Sint32 *) src;
+    Sint32 *d = (Sint32 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, s += 2)
+        d[i] = (Sint32) ((((Sint64) s[0]) + ((Sint64) s[1])) >> 1);
+} /* convert_downmix_s32_scalar */
+
+static void convert_downmix_f32_scalar(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    float *d = (float *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, s += 2)
+        d[i] = (s[0] + s[1]) * 0.5f;
+} /* convert_downmix_f32_scalar */
+
+static void convert_upmix8_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint8 *s = (const Uint8 *) src;
+    Uint8 *d = (Uint8 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, d += 2)
+    {
+        const Uint8 val = s[i];
+        d[0] = d[1] = val;
+    } /* for */
+} /* convert_upmix8_scalar */
+
+static void convert_upmix16_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint16 *s = (const Uint16 *) src;
+    Uint16 *d = (Uint16 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, d += 2)
+    {
+        const Uint16 val = s[i];
+        d[0] = d[1] = val;
+    } /* for */
+} /* convert_upmix16_scalar */
+
+static void convert_upmix32_scalar(void *dst, const void *src, Uint32 count)
+{
+    const Uint32 *s = (const Uint32 *) src;
+    Uint32 *d = (Uint32 *) dst;
+    Uint32 i;
+    for (i = 0; i < count; i++, d += 2)
+    {
+        const Uint32 val = s[i];
+        d[0] = d[1] = val;
+    } /* for */
+} /* convert_upmix32_scalar */
+
+
+#if defined(SDL_SSE2_INTRINSICS)
+static void SDL_TARGETING("sse2") convert_s16_to_f32_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    float *d = (float *) dst;
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+        _mm_storeu_ps(d + i, _mm_mul_ps(lo, scale));
+        _mm_storeu_ps(d + i + 4, _mm_mul_ps(hi, scale));
+    } /* for */
+    convert_s16_to_f32_scalar(d + i, s + i, count - i);
+} /* convert_s16_to_f32_sse2 */
+
+static void SDL_TARGETING("sse2") convert_f32_to_s16_sse2(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    Sint16 *d = (Sint16 *) dst;
+    const __m128 minval = _mm_set1_ps(-1.0f);
+    const __m128 maxval = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128 a = _mm_loadu_ps(s + i);
+        const __m128 b = _mm_loadu_ps(s + i + 4);
+        const __m128i ia = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(a, minval), maxval), scale));
+        const __m128i ib = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b, minval), maxval), scale));
+        _mm_storeu_si128((__m128i *) (d + i), _mm_packs_epi32(ia, ib));  /* saturates 32768 to 32767. */
+    } /* for */
+    convert_f32_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_f32_to_s16_sse2 */
+
+static void SDL_TARGETING("sse2") convert_s32_to_s16_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Sint32 *s = (const Sint32 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (s + i)), 16);
+        const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (s + i + 4)), 16);
+        _mm_storeu_si128((__m128i *) (d + i), _mm_packs_epi32(a, b));
+    } /* for */
+    convert_s32_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_s32_to_s16_sse2 */
+
+static void SDL_TARGETING("sse2") convert_u8_to_s16_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Uint8 *s = (const Uint8 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    const __m128i flip = _mm_set1_epi8((char) 0x80);
+    const __m128i zero = _mm_setzero_si128();
+    Uint32 i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        /* flipping the top bit makes it signed; putting it in the high byte scales it. */
+        const __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (s + i)), flip);
+        _mm_storeu_si128((__m128i *) (d + i), _mm_unpacklo_epi8(zero, x));
+        _mm_storeu_si128((__m128i *) (d + i + 8), _mm_unpackhi_epi8(zero, x));
+    } /* for */
+    convert_u8_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_u8_to_s16_sse2 */
+
+static void SDL_TARGETING("sse2") convert_swap16_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Uint16 *s = (const Uint16 *) src;
+    Uint16 *d = (Uint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        _mm_storeu_si128((__m128i *) (d + i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+    } /* for */
+    convert_swap16_scalar(d + i, s + i, count - i);
+} /* convert_swap16_sse2 */
+
+static void SDL_TARGETING("sse2") convert_swap32_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Uint32 *s = (const Uint32 *) src;
+    Uint32 *d = (Uint32 *) dst;
+    Uint32 i = 0;
+    for (; (i + 4) <= count; i += 4)
+    {
+        /* swap the 16-bit halves of each value, then the bytes in each half. */
+        __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+        _mm_storeu_si128((__m128i *) (d + i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+    } /* for */
+    convert_swap32_scalar(d + i, s + i, count - i);
+} /* convert_swap32_sse2 */
+
+static void SDL_TARGETING("sse2") convert_downmix_s16_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    const __m128i ones = _mm_set1_epi16(1);
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        /* multiply-add by one sums each left/right pair into 32 bits. */
+        const __m128i a = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i *) (s + (i * 2))), ones), 1);
+        const __m128i b = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i *) (s + (i * 2) + 8)), ones), 1);
+        _mm_storeu_si128((__m128i *) (d + i), _mm_packs_epi32(a, b));
+    } /* for */
+    convert_downmix_s16_scalar(d + i, s + (i * 2), count - i);
+} /* convert_downmix_s16_sse2 */
+
+static void SDL_TARGETING("sse2") convert_downmix_f32_sse2(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    float *d = (float *) dst;
+    const __m128 half = _mm_set1_ps(0.5f);
+    Uint32 i = 0;
+    for (; (i + 4) <= count; i += 4)
+    {
+        const __m128 a = _mm_loadu_ps(s + (i * 2));
+        const __m128 b = _mm_loadu_ps(s + (i * 2) + 4);
+        const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(d + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    } /* for */
+    convert_downmix_f32_scalar(d + i, s + (i * 2), count - i);
+} /* convert_downmix_f32_sse2 */
+
+static void SDL_TARGETING("sse2") convert_upmix16_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Uint16 *s = (const Uint16 *) src;
+    Uint16 *d = (Uint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        _mm_storeu_si128((__m128i *) (d + (i * 2)), _mm_unpacklo_epi16(x, x));
+        _mm_storeu_si128((__m128i *) (d + (i * 2) + 8), _mm_unpackhi_epi16(x, x));
+    } /* for */
+    convert_upmix16_scalar(d + (i * 2), s + i, count - i);
+} /* convert_upmix16_sse2 */
+
+static void SDL_TARGETING("sse2") convert_upmix32_sse2(void *dst, const void *src, Uint32 count)
+{
+    const Uint32 *s = (const Uint32 *) src;
+    Uint32 *d = (Uint32 *) dst;
+    Uint32 i = 0;
+    for (; (i + 4) <= count; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        _mm_storeu_si128((__m128i *) (d + (i * 2)), _mm_unpacklo_epi32(x, x));
+        _mm_storeu_si128((__m128i *) (d + (i * 2) + 4), _mm_unpackhi_epi32(x, x));
+    } /* for */
+    convert_upmix32_scalar(d + (i * 2), s + i, count - i);
+} /* convert_upmix32_sse2 */
+#endif
+
+
+#if defined(SDL_AVX2_INTRINSICS)
+static void SDL_TARGETING("avx2") convert_s16_to_f32_avx2(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    float *d = (float *) dst;
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    Uint32 i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *) (s + i + 8));
+        const __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+        const __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(y));
+        _mm256_storeu_ps(d + i, _mm256_mul_ps(a, scale));
+        _mm256_storeu_ps(d + i + 8, _mm256_mul_ps(b, scale));
+    } /* for */
+    convert_s16_to_f32_scalar(d + i, s + i, count - i);
+} /* convert_s16_to_f32_avx2 */
+
+static void SDL_TARGETING("avx2") convert_f32_to_s16_avx2(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    Sint16 *d = (Sint16 *) dst;
+    const __m256 minval = _mm256_set1_ps(-1.0f);
+    const __m256 maxval = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    Uint32 i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        const __m256 a = _mm256_loadu_ps(s + i);
+        const __m256 b = _mm256_loadu_ps(s + i + 8);
+        const __m256i ia = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(a, minval), maxval), scale));
+        const __m256i ib = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(b, minval), maxval), scale));
+        /* packing works per 128-bit lane, so put the quarters back in order after. */
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(ia, ib), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *) (d + i), packed);
+    } /* for */
+    convert_f32_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_f32_to_s16_avx2 */
+
+static void SDL_TARGETING("avx2") convert_s32_to_s16_avx2(void *dst, const void *src, Uint32 count)
+{
+    const Sint32 *s = (const Sint32 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        const __m256i a = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *) (s + i)), 16);
+        const __m256i b = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *) (s + i + 8)), 16);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *) (d + i), packed);
+    } /* for */
+    convert_s32_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_s32_to_s16_avx2 */
+#endif
+
+
+#if defined(SDL_NEON_INTRINSICS)
+static void convert_s16_to_f32_neon(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    float *d = (float *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const int16x8_t x = vld1q_s16(s + i);
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+        vst1q_f32(d + i, vmulq_n_f32(lo, 1.0f / 32768.0f));
+        vst1q_f32(d + i + 4, vmulq_n_f32(hi, 1.0f / 32768.0f));
+    } /* for */
+    convert_s16_to_f32_scalar(d + i, s + i, count - i);
+} /* convert_s16_to_f32_neon */
+
+static void convert_f32_to_s16_neon(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    Sint16 *d = (Sint16 *) dst;
+    const float32x4_t minval = vdupq_n_f32(-1.0f);
+    const float32x4_t maxval = vdupq_n_f32(1.0f);
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        float32x4_t a = vld1q_f32(s + i);
+        float32x4_t b = vld1q_f32(s + i + 4);
+        /* compare-and-select, rather than vmaxq/vminq, so NaN becomes -1 like everywhere else. */
+        a = vbslq_f32(vcgtq_f32(a, minval), a, minval);
+        b = vbslq_f32(vcgtq_f32(b, minval), b, minval);
+        a = vbslq_f32(vcltq_f32(a, maxval), a, maxval);
+        b = vbslq_f32(vcltq_f32(b, maxval), b, maxval);
+        vst1q_s16(d + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(a, 32768.0f))),
+                                      vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(b, 32768.0f)))));
+    } /* for */
+    convert_f32_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_f32_to_s16_neon */
+
+static void convert_s32_to_s16_neon(void *dst, const void *src, Uint32 count)
+{
+    const Sint32 *s = (const Sint32 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const int32x4_t a = vld1q_s32(s + i);
+        const int32x4_t b = vld1q_s32(s + i + 4);
+        vst1q_s16(d + i, vcombine_s16(vshrn_n_s32(a, 16), vshrn_n_s32(b, 16)));
+    } /* for */
+    convert_s32_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_s32_to_s16_neon */
+
+static void convert_u8_to_s16_neon(void *dst, const void *src, Uint32 count)
+{
+    const Uint8 *s = (const Uint8 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    const uint8x16_t flip = vdupq_n_u8(0x80);
+    Uint32 i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        const int8x16_t x = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(s + i), flip));
+        const int16x8_t lo = vshll_n_s8(vget_low_s8(x), 8);
+        const int16x8_t hi = vshll_n_s8(vget_high_s8(x), 8);
+        vst1q_s16(d + i, lo);
+        vst1q_s16(d + i + 8, hi);
+    } /* for */
+    convert_u8_to_s16_scalar(d + i, s + i, count - i);
+} /* convert_u8_to_s16_neon */
+
+static void convert_swap16_neon(void *dst, const void *src, Uint32 count)
+{
+    const Uint16 *s = (const Uint16 *) src;
+    Uint16 *d = (Uint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+        vst1q_u8((Uint8 *) (d + i), vrev16q_u8(vld1q_u8((const Uint8 *) (s + i))));
+    convert_swap16_scalar(d + i, s + i, count - i);
+} /* convert_swap16_neon */
+
+static void convert_swap32_neon(void *dst, const void *src, Uint32 count)
+{
+    const Uint32 *s = (const Uint32 *) src;
+    Uint32 *d = (Uint32 *) dst;
+    Uint32 i = 0;
+    for (; (i + 4) <= count; i += 4)
+        vst1q_u8((Uint8 *) (d + i), vrev32q_u8(vld1q_u8((const Uint8 *) (s + i))));
+    convert_swap32_scalar(d + i, s + i, count - i);
+} /* convert_swap32_neon */
+
+static void convert_downmix_s16_neon(void *dst, const void *src, Uint32 count)
+{
+    const Sint16 *s = (const Sint16 *) src;
+    Sint16 *d = (Sint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const int16x8x2_t x = vld2q_s16(s + (i * 2));  /* deinterleaves left and right. */
+        vst1q_s16(d + i, vhaddq_s16(x.val[0], x.val[1]));
+    } /* for */
+    convert_downmix_s16_scalar(d + i, s + (i * 2), count - i);
+} /* convert_downmix_s16_neon */
+
+static void convert_downmix_f32_neon(void *dst, const void *src, Uint32 count)
+{
+    const float *s = (const float *) src;
+    float *d = (float *) dst;
+    Uint32 i = 0;
+    for (; (i + 4) <= count; i += 4)
+    {
+        const float32x4x2_t x = vld2q_f32(s + (i * 2));
+        vst1q_f32(d + i, vmulq_n_f32(vaddq_f32(x.val[0], x.val[1]), 0.5f));
+    } /* for */
+    convert_downmix_f32_scalar(d + i, s + (i * 2), count - i);
+} /* convert_downmix_f32_neon */
+
+static void convert_upmix16_neon(void *dst, const void *src, Uint32 count)
+{
+    const Uint16 *s = (const Uint16 *) src;
+    Uint16 *d = (Uint16 *) dst;
+    Uint32 i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        uint16x8x2_t x;
+        x.val[0] = x.val[1] = vld1q_u16(s + i);
+        vst2q_u16(d + (i * 2), x);
+    } /* for */
+    convert_upmix16_scalar(d + (i * 2), s + i, count - i);
+} /* convert_upmix16_neon */
+
+static void convert_upmix32_neon(void *dst, const void *src, Uint32 count)
+{
+    const Uint32 *s = (const Uint32 *) src;
+    Uint32 *d = (Uint32 *) dst;
+    Uint32 i = 0;
+    for (; (i + 4) <= count; i += 4)
+    {
+        uint32x4x2_t x;
+        x.val[0] = x.val[1] = vld1q_u32(s + i);
+        vst2q_u32(d + (i * 2), x);
+    } /* for */
+    convert_upmix32_scalar(d + (i * 2), s + i, count - i);
+} /* convert_upmix32_neon */
+#endif
+
+
+/*
+ * Pick the best version of each kernel for this CPU. Each gets a macro that
+ *  expands to the right checks for whatever this compiler can build.
+ */
+#if defined(SDL_AVX2_INTRINSICS)
+#define TRY_AVX2(fn) if (SDL_HasAVX2()) { return fn##_avx2; }
+#else
+#define TRY_AVX2(fn)
+#endif
+
+#if defined(SDL_SSE2_INTRINSICS)
+#define TRY_SSE2(fn) if (SDL_HasSSE2()) { return fn##_sse2; }
+#else
+#define TRY_SSE2(fn)
+#endif
+
+#if defined(SDL_NEON_INTRINSICS)
+#define TRY_NEON(fn) if (SDL_HasNEON()) { return fn##_neon; }
+#else
+#define TRY_NEON(fn)
+#endif
+
+#define CONVERT_PICKER_AVX2(fn) \
+    static Sound_ConvertFunc pick_##fn(void) { \
+        TRY_AVX2(convert_##fn) TRY_SSE2(convert_##fn) TRY_NEON(convert_##fn) \
+        return convert_##fn##_scalar; \
+    }
+
+#define CONVERT_PICKER(fn) \
+    static Sound_ConvertFunc pick_##fn(void) { \
+        TRY_SSE2(convert_##fn) TRY_NEON(convert_##fn) \
+        return convert_##fn##_scalar; \
+    }
+
+CONVERT_PICKER_AVX2(s16_to_f32)
+CONVERT_PICKER_AVX2(f32_to_s16)
+CONVERT_PICKER_AVX2(s32_to_s16)
+CONVERT_PICKER(u8_to_s16)
+CONVERT_PICKER(swap16)
+CONVERT_PICKER(swap32)
+CONVERT_PICKER(downmix_s16)
+CONVERT_PICKER(downmix_f32)
+CONVERT_PICKER(upmix16)
+CONVERT_PICKER(upmix32)
+
+#undef CONVERT_PICKER
+#undef CONVERT_PICKER_AVX2
+#undef TRY_NEON
+#undef TRY_SSE2
+#undef TRY_AVX2
+
+
+/* (fmt) with its byte order changed to this CPU's. */
+static SDL_AudioFormat native_format(SDL_AudioFormat fmt)
+{
+    if (SDL_AUDIO_BYTESIZE(fmt) == 1)
+        return fmt;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    return (SDL_AudioFormat) (fmt & ~SDL_AUDIO_MASK_BIG_ENDIAN);
+#else
+    return (SDL_AudioFormat) (fmt | SDL_AUDIO_MASK_BIG_ENDIAN);
+#endif
+} /* native_format */
+
+
+static bool add_stage(Sound_Converter *cvt, Sound_ConvertFunc func,
+                      Uint32 count_per_frame, Uint32 in_framesize,
+                      Uint32 out_framesize)
+{
+    Sound_ConvertStage *stage;
+
+    if (cvt->num_stages >= SOUND_CONVERT_MAX_STAGES)
+        return false;  /* shouldn't happen. */
+
+    stage = &cvt->stages[cvt->num_stages++];
+    stage->func = func;
+    stage->count_per_frame = count_per_frame;
+    stage->in_framesize = in_framesize;
+    stage->out_framesize = out_framesize;
+    return true;
+} /* add_stage */
+
+
+/* Add a stage for stereo to mono in (fmt), a native format. */
+static bool add_downmix(Sound_Converter *cvt, SDL_AudioFormat fmt)
+{
+    const Uint32 size = (Uint32) SDL_AUDIO_BYTESIZE(fmt);
+    Sound_ConvertFunc func;
+
+    switch (fmt)
+    {
+        case SDL_AUDIO_U8: func = convert_downmix_u8_scalar; break;
+        case SDL_AUDIO_S8: func = convert_downmix_s8_scalar; break;
+        case SDL_AUDIO_S16: func = pick_downmix_s16(); break;
+        case SDL_AUDIO_S32: func = convert_downmix_s32_scalar; break;
+        case SDL_AUDIO_F32: func = pick_downmix_f32(); break;
+        default: return false;
+    } /* switch */
+
+    return add_stage(cvt, func, 1, size * 2, size);
+} /* add_downmix */
+
+
+/* Add a stage for mono to stereo in (fmt); byte order doesn't matter. */
+static bool add_upmix(Sound_Converter *cvt, SDL_AudioFormat fmt)
+{
+    const Uint32 size = (Uint32) SDL_AUDIO_BYTESIZE(fmt);
+    Sound_ConvertFunc func;
+
+    switch (size)
+    {
+        case 1: func = convert_upmix8_scalar; break;
+        case 2: func = pick_upmix16(); break;
+        case 4: func = pick_upmix32(); break;
+        default: return false;
+    } /* switch */
+
+    return add_stage(cvt, func, 1, size, size * 2);
+} /* add_upmix */
+
+
+/* Add stages to get from native format (from) to native format (to). */
+static bool add_format_change(Sound_Converter *cvt, SDL_AudioFormat from,
+                              SDL_AudioFormat to, Uint32 channels)
+{
+    if (from == to)
+        return true;
+
+    else if ((from == SDL_AUDIO_U8) && ((to == SDL_AUDIO_S16) || (to == SDL_AUDIO_F32)))
+    {
+        if (!add_stage(cvt, pick_u8_to_s16(), channels, channels, channels * 2))
+            return false;
+        return add_format_change(cvt, SDL_AUDIO_S16, to, channels);
+    } /* else if */
+
+    else if ((from == SDL_AUDIO_S16) && (to == SDL_AUDIO_F32))
+        return add_stage(cvt, pick_s16_to_f32(), channels, channels * 2, channels * 4);
+
+    else if ((from == SDL_AUDIO_F32) && (to == SDL_AUDIO_S16))
+        return add_stage(cvt, pick_f32_to_s16(), channels, channels * 4, channels * 2);
+
+    else if ((from == SDL_AUDIO_S32) && (to == SDL_AUDIO_S16))
+        return add_stage(cvt, pick_s32_to_s16(), channels, channels * 4, channels * 2);
+
+    return false;  /* let SDL_AudioStream handle it. */
+} /* add_format_change */
+
+
+/* Add all the stages to get from (src) to (dst), or return false if we can't. */
+static bool add_stages(Sound_Converter *cvt, const SDL_AudioSpec *src,
+                       const SDL_AudioSpec *dst)
+{
+    const SDL_AudioFormat srcfmt = native_format(src->format);
+    const SDL_AudioFormat dstfmt = native_format(dst->format);
+    const Uint32 dstsize = (Uint32) SDL_AUDIO_BYTESIZE(dst->format);
+    bool mixed = false;
+
+    if (src->freq != dst->freq)
+        return false;  /* resampling is SDL_AudioStream's job. */
+    else if ((src->channels < 1) || (src->channels > 2) || (dst->channels < 1) || (dst->channels > 2))
+        return false;  /* only doing mono and stereo here. */
+
+    if (srcfmt != src->format)
+        add_stage(cvt, (SDL_AUDIO_BYTESIZE(srcfmt) == 2) ? pick_swap16() : pick_swap32(),
+                  src->channels, SDL_AUDIO_FRAMESIZE(*src), SDL_AUDIO_FRAMESIZE(*src));
+
+    /* downmix first if the format change would lose precision anyway, so
+       there's half as much to convert; otherwise mix in the wider format. */
+    if ( (src->channels == 2) && (dst->channels == 1) &&
+         (SDL_AUDIO_BYTESIZE(srcfmt) >= SDL_AUDIO_BYTESIZE(dstfmt)) &&
+         (srcfmt != SDL_AUDIO_U8) && (srcfmt != SDL_AUDIO_S8) )
+    {
+        if (!add_downmix(cvt, srcfmt))
+            return false;
+        mixed = true;
+    } /* if */
+
+    if (!add_format_change(cvt, srcfmt, dstfmt, mixed ? 1 : src->channels))
+        return false;
+
+    if ((src->channels == 2) && (dst->channels == 1) && !mixed)
+    {
+        if (!add_downmix(cvt, dstfmt))
+            return false;
+    } /* if */
+
+    else if ((src->channels == 1) && (dst->channels == 2))
+    {
+        if (!add_upmix(cvt, dstfmt))
+            return false;
+    } /* else if */
+
+    if (dstfmt != dst->format)
+    {
+        if (!add_stage(cvt, (dstsize == 2) ? pick_swap16() : pick_swap32(),
+                       dst->channels, dstsize * dst->channels, dstsize * dst->channels))
+            return false;
+    } /* if */
+
+    return (cvt->num_stages > 0);  /* nothing to do, so nothing to do it with. */
+} /* add_stages */
+
+
+bool __Sound_InitConverter(Sound_Converter *cvt, const SDL_AudioSpec *src,
+                           const SDL_AudioSpec *dst)
+{
+    Uint32 offset;
+    int i;
+
+    SDL_zerop(cvt);
+    if (!add_stages(cvt, src, dst))
+    {
+        SDL_zerop(cvt);  /* leave it unused. */
+        return false;
+    } /* if */
+
+    /*
+     * Work backwards from the output, which lands at the start of the work
+     *  area, to find where each stage's input has to be. A stage that grows
+     *  the data needs its input pushed out by the difference.
+     */
+    offset = 0;
+    cvt->span = (Uint32) SDL_AUDIO_FRAMESIZE(*dst);
+    for (i = cvt->num_stages - 1; i >= 0; i--)
+    {
+        const Sound_ConvertStage *stage = &cvt->stages[i];
+        if (stage->out_framesize > stage->in_framesize)
+            offset += stage->out_framesize - stage->in_framesize;
+        cvt->span = SDL_max(cvt->span, offset + stage->in_framesize);
+    } /* for */
+    cvt->in_offset = offset;
+
+    return true;
+} /* __Sound_InitConverter */
+
+
+void __Sound_RunConverter(const Sound_Converter *cvt, Uint8 *work, Uint32 frames)
+{
+    Uint32 offset = cvt->in_offset * frames;
+    int i;
+
+    for (i = 0; i < cvt->num_stages; i++)
+    {
+        const Sound_ConvertStage *stage = &cvt->stages[i];
+        Uint32 outoffset = offset;
+        if (stage->out_framesize > stage->in_framesize)
+            outoffset -= (stage->out_framesize - stage->in_framesize) * frames;
+        stage->func(work + outoffset, work + offset, frames * stage->count_per_frame);
+        offset = outoffset;
+    } /* for */
+
+    SDL_assert(offset == 0);
+} /* __Sound_RunConverter */
+
+/* end of SDL_sound_convert.c ... */
+
@@ -663,7 +663,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_CoreAudio =
     CoreAudio_close,      /*  close() method */
     CoreAudio_read,       /*   read() method */
     CoreAudio_rewind,     /* rewind() method */
-    CoreAudio_seek        /*   seek() method */
+    CoreAudio_seek,       /*   seek() method */
+    NULL,                 /* seek_frame() method */
+    NULL,                 /*  probe() method */
+    NULL,                 /* duration() method */
+    NULL,                 /* save_index() method */
+    NULL                  /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_COREAUDIO */
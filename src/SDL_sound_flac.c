@@ -38,33 +38,34 @@
 
 #include "dr_flac.h"
 
+/* the biggest an Ogg page can be, header and all. */
+#define FLAC_OGG_PAGE_MAX (27 + 255 + (255 * 255))
+
+typedef struct
+{
+    drflac *dr;
+    Sound_IOBuffer iobuf;  /* between dr_flac and internal->io. */
+    Uint32 max_frame_bytes;  /* from STREAMINFO; zero if it doesn't say. */
+    Uint32 reserve;  /* see flac_reserve(). */
+    bool resync;  /* a frame came up short and has to be decoded again; see flac_resync(). */
+    Uint64 resync_frame;  /* where to pick up again if (resync). */
+} FLACData;
+
+/* dr_flac treats a short read as EOF, so FLAC_read() makes sure it never has to wait; see flac_reserve(). */
 static size_t flac_read(void* pUserData, void* pBufferOut, size_t bytesToRead)
 {
-    /* !!! FIXME: dr_flac treats returning less than bytesToRead as EOF. So we can't EAGAIN. */
-    Uint8 *ptr = (Uint8 *) pBufferOut;
     Sound_Sample *sample = (Sound_Sample *) pUserData;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    SDL_IOStream *io = internal->io;
-    size_t retval = 0;
-
-    /* !!! FIXME: dr_flac treats returning less than bytesToRead as EOF. So we can't EAGAIN. */
-    while (bytesToRead)
-    {
-        const size_t rc = SDL_ReadIO(io, ptr, bytesToRead);
-        if (rc == 0) break;
-        bytesToRead -= rc;
-        retval += rc;
-        ptr += rc;
-    } /* while */
-
-    return retval;
+    FLACData *flac = (FLACData *) internal->decoder_private;
+    return __Sound_IOBufferRead(&flac->iobuf, internal->io, pBufferOut, bytesToRead);
 } /* flac_read */
 
 static drflac_bool32 flac_seek(void* pUserData, int offset, drflac_seek_origin origin)
 {
     Sound_Sample *sample = (Sound_Sample *) pUserData;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    int whence;
+    FLACData *flac = (FLACData *) internal->decoder_private;
+    SDL_IOWhence whence;
     switch (origin) {
     case DRFLAC_SEEK_SET:
         whence = SDL_IO_SEEK_SET;
@@ -78,17 +79,55 @@ static drflac_bool32 flac_seek(void* pUserData, int offset, drflac_seek_origin o
     default:
         return DRFLAC_FALSE;
     }
-    return (SDL_SeekIO(internal->io, offset, whence) != -1) ? DRFLAC_TRUE : DRFLAC_FALSE;
+    return __Sound_IOBufferSeek(&flac->iobuf, internal->io, offset, whence) ? DRFLAC_TRUE : DRFLAC_FALSE;
 } /* flac_seek */
 
 static drflac_bool32 flac_tell(void* pUserData, drflac_int64* pCursor)
 {
     Sound_Sample *sample = (Sound_Sample *) pUserData;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    *pCursor = SDL_TellIO(internal->io);
+    FLACData *flac = (FLACData *) internal->decoder_private;
+    *pCursor = __Sound_IOBufferTell(&flac->iobuf, internal->io);
     return (*pCursor != -1) ? DRFLAC_TRUE : DRFLAC_FALSE;
 } /* flac_tell */
 
+static void flac_meta(void* pUserData, drflac_metadata* pMetadata)
+{
+    Sound_Sample *sample = (Sound_Sample *) pUserData;
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    FLACData *flac = (FLACData *) internal->decoder_private;
+
+    /* despite the name, this is STREAMINFO's maximum frame size in bytes. */
+    if (pMetadata->type == DRFLAC_METADATA_BLOCK_TYPE_STREAMINFO)
+        flac->max_frame_bytes = pMetadata->data.streaminfo.maxFrameSizeInPCMFrames;
+} /* flac_meta */
+
+/*
+ * How much of the stream to have on hand before dr_flac starts on a new
+ *  FLAC frame, so it never reads up short: the biggest frame there can be,
+ *  plus the most dr_flac reads ahead of what it needs. If STREAMINFO
+ *  doesn't say how big frames get, assume every subframe is stored
+ *  verbatim (the side channel of a stereo pair gets an extra bit), plus
+ *  headers and footer. Ogg FLAC reads whole pages, and a frame can span
+ *  two of them.
+ */
+static Uint32 flac_reserve(const FLACData *flac)
+{
+    const drflac *dr = flac->dr;
+    Uint32 retval = flac->max_frame_bytes;
+
+    if (retval == 0)
+    {
+        const Uint32 bits = (Uint32) dr->maxBlockSizeInPCMFrames * (dr->bitsPerSample + 1);
+        retval = 16 + (dr->channels * (2 + ((bits + 7) / 8))) + 2;
+    } /* if */
+
+    retval += DR_FLAC_BUFFER_SIZE;
+    if (dr->container == drflac_container_ogg)
+        retval += 2 * FLAC_OGG_PAGE_MAX;
+    return retval;
+} /* flac_reserve */
+
 static bool FLAC_init(void)
 {
     return true; /* always succeeds. */
@@ -104,20 +143,36 @@ static void FLAC_quit(void)
 static int FLAC_open(Sound_Sample *sample, const char *ext)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drflac *dr = drflac_open(flac_read, flac_seek, flac_tell, sample, NULL);
+    FLACData *flac = (FLACData *) SDL_calloc(1, sizeof (FLACData));
+    drflac *dr;
 
+    BAIL_IF_MACRO(!flac, ERR_OUT_OF_MEMORY, 0);
+    flac->iobuf.staging = (internal->push != NULL);
+    internal->decoder_private = flac;  /* the callbacks need this already. */
+    dr = drflac_open_with_metadata(flac_read, flac_seek, flac_tell, flac_meta, sample, NULL);
     if (!dr)
     {
+        internal->decoder_private = NULL;
+        __Sound_IOBufferFree(&flac->iobuf);
+        SDL_free(flac);
         BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_IO_ERROR, 0);
         BAIL_MACRO("FLAC: Not a FLAC stream.", 0);
     } /* if */
 
+    flac->dr = dr;
+    flac->reserve = flac_reserve(flac);
+
     SNDDBG(("FLAC: Accepting data stream.\n"));
     sample->flags = SOUND_SAMPLEFLAG_CANSEEK;
 
     sample->actual.channels = dr->channels;
     sample->actual.freq = dr->sampleRate;
-    sample->actual.format = SDL_AUDIO_S32; /* dr_flac only does Sint32. */
+
+    /* dr_flac can give us any of these itself; save a conversion if we can. */
+    if ((sample->desired.format == SDL_AUDIO_S16) || (sample->desired.format == SDL_AUDIO_F32))
+        sample->actual.format = sample->desired.format;
+    else
+        sample->actual.format = SDL_AUDIO_S32;
 
     if (dr->totalPCMFrameCount == 0)
         internal->total_time = -1;
@@ -129,47 +184,175 @@ static int FLAC_open(Sound_Sample *sample, const char *ext)
         internal->total_time += ((dr->totalPCMFrameCount % dr->sampleRate) * 1000) / dr->sampleRate;
     } /* else */
 
-    internal->decoder_private = dr;
-
     return 1;
 } /* FLAC_open */
 
 static void FLAC_close(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drflac *dr = (drflac *) internal->decoder_private;
-    drflac_close(dr);
+    FLACData *flac = (FLACData *) internal->decoder_private;
+    drflac_close(flac->dr);
+    __Sound_IOBufferFree(&flac->iobuf);
+    SDL_free(flac);
 } /* FLAC_close */
 
+/*
+ * If the stream runs dry partway through a FLAC frame, dr_flac loses that
+ *  frame, so we have to seek back to it, which needs a seekable stream.
+ *  Seeking to where dr_flac thinks it already is does nothing, so go by way
+ *  of the first frame to make it read the stream fresh (straight there, as
+ *  drflac_seek_to_pcm_frame(0) does nothing either if that's where we were).
+ *  Returns -1 on failure, 0 if the stream ran dry again (try later), 1 on
+ *  success.
+ */
+static int flac_resync(FLACData *flac)
+{
+    drflac *dr = flac->dr;
+    bool ok;
+
+    flac->iobuf.starved = false;
+    ok = drflac__seek_to_first_frame(dr) &&
+         ((flac->resync_frame == 0) || drflac_seek_to_pcm_frame(dr, flac->resync_frame));
+    if (flac->iobuf.starved)
+        return 0;
+    else if (!ok)
+        return -1;
+    flac->resync = false;
+    return 1;
+} /* flac_resync */
+
+/*
+ * This hands dr_flac one FLAC frame at a time, so that before each one we
+ *  can check there's enough of the stream on hand to decode it. If the
+ *  stream isn't ready, we stop there with EAGAIN and pick up from the same
+ *  spot next time, without dr_flac ever seeing a read come up short.
+ */
 static Uint32 FLAC_read(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    const int channels = (int) sample->actual.channels;
-    drflac *dr = (drflac *) internal->decoder_private;
-    const drflac_uint64 frames_to_read = (internal->buffer_size / channels) / sizeof (drflac_int32);
-    const drflac_uint64 rc = drflac_read_pcm_frames_s32(dr, frames_to_read, (drflac_int32 *) internal->buffer);
-    /* !!! FIXME: we only set the EOF flags, but this only tells you we're done, not about i/o errors, nor corruption. */
-    if (rc < frames_to_read)
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+    FLACData *flac = (FLACData *) internal->decoder_private;
+    drflac *dr = flac->dr;
+    const drflac_uint64 frames_to_read = internal->buffer_size / framesize;
+    drflac_uint64 total = 0;
+    drflac_uint64 want, rc;
+    bool staged;
+    void *ptr;
+
+    while (total < frames_to_read)
+    {
+        ptr = ((Uint8 *) internal->buffer) + (total * framesize);
+        want = frames_to_read - total;
+        staged = flac->iobuf.staging;  /* (reserve) was on hand, if this is set. */
+        if (dr->currentFLACFrame.pcmFramesRemaining > 0)
+            want = SDL_min(want, dr->currentFLACFrame.pcmFramesRemaining);
+        else if (!__Sound_IOBufferFill(&flac->iobuf, internal->io, flac->reserve))
+        {
+            sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+            break;
+        } /* else if */
+        else
+        {
+            want = 1;  /* just decode the one new frame; the rest comes out next time around. */
+
+            if (flac->resync)
+            {
+                const int rc = flac_resync(flac);
+                if (rc < 0)
+                {
+                    __Sound_SetError(ERR_IO_ERROR);
+                    sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+                    break;
+                } /* if */
+                else if (rc == 0)
+                {
+                    sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+                    break;
+                } /* else if */
+                continue;  /* seeking emptied the buffer; fill it again. */
+            } /* if */
+        } /* else */
+
+        flac->iobuf.starved = false;
+        switch (sample->actual.format)
+        {
+            case SDL_AUDIO_S16:
+                rc = drflac_read_pcm_frames_s16(dr, want, (drflac_int16 *) ptr);
+                break;
+            case SDL_AUDIO_F32:
+                rc = drflac_read_pcm_frames_f32(dr, want, (float *) ptr);
+                break;
+            default:
+                rc = drflac_read_pcm_frames_s32(dr, want, (drflac_int32 *) ptr);
+                break;
+        } /* switch */
+        total += rc;
+
+        if (rc == want)
+            continue;
+        else if (flac->iobuf.starved)
+        {
+            flac->resync = true;
+            flac->resync_frame = dr->currentPCMFrame;
+            if (staged)  /* a frame bigger than STREAMINFO promised outran the reserve. */
+                flac->reserve *= 2;
+            sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+            break;
+        } /* else if */
+
+        /* !!! FIXME: we only set the EOF flags, but this only tells you we're done, not about i/o errors, nor corruption. */
         sample->flags |= SOUND_SAMPLEFLAG_EOF;
-    return rc * channels * sizeof (drflac_int32);
+        break;
+    } /* while */
+
+    return (Uint32) (total * framesize);
 } /* FLAC_read */
 
-static int FLAC_rewind(Sound_Sample *sample)
+static int FLAC_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drflac *dr = (drflac *) internal->decoder_private;
-    return (drflac_seek_to_pcm_frame(dr, 0) == DRFLAC_TRUE);
+    FLACData *flac = (FLACData *) internal->decoder_private;
+
+    if (!flac->resync)
+    {
+        flac->iobuf.starved = false;
+        if (drflac_seek_to_pcm_frame(flac->dr, (drflac_uint64) frame))
+        {
+            if (!flac->iobuf.starved)
+                return 1;
+        } /* if */
+        else if (!flac->iobuf.starved)
+        {
+            return 0;
+        } /* else if */
+    } /* if */
+
+    /* seeking reads, too; if that ran dry, finish the job in FLAC_read(). */
+    flac->resync = true;
+    flac->resync_frame = frame;
+    return (flac_resync(flac) >= 0);
+} /* FLAC_seek_frame */
+
+static int FLAC_rewind(Sound_Sample *sample)
+{
+    return FLAC_seek_frame(sample, 0);
 } /* FLAC_rewind */
 
 static int FLAC_seek(Sound_Sample *sample, Uint32 ms)
 {
-    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drflac *dr = (drflac *) internal->decoder_private;
-    const float frames_per_ms = ((float) sample->actual.freq) / 1000.0f;
-    const drflac_uint64 frame_offset = (drflac_uint64) (frames_per_ms * ((float) ms));
-    return (drflac_seek_to_pcm_frame(dr, frame_offset) == DRFLAC_TRUE);
+    return FLAC_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* FLAC_seek */
 
+/* dr_flac skips ID3 tags, and handles FLAC-in-Ogg, too. */
+static int FLAC_probe(const Uint8 *header, Uint32 len)
+{
+    return ( (len >= 4) &&
+             ( (SDL_memcmp(header, "fLaC", 4) == 0) ||
+               (SDL_memcmp(header, "OggS", 4) == 0) ||
+               (SDL_memcmp(header, "ID3", 3) == 0) ) );
+} /* FLAC_probe */
+
+
 static const char *extensions_flac[] = { "FLAC", "FLA", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_FLAC =
 {
@@ -186,7 +369,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_FLAC =
     FLAC_close,      /*  close() method */
     FLAC_read,       /*   read() method */
     FLAC_rewind,     /* rewind() method */
-    FLAC_seek        /*   seek() method */
+    FLAC_seek,       /*   seek() method */
+    FLAC_seek_frame, /* seek_frame() method */
+    FLAC_probe,      /*  probe() method */
+    NULL,            /* duration() method */
+    NULL,            /* save_index() method */
+    NULL             /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_FLAC */
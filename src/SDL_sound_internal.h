@@ -74,6 +74,28 @@
 #define SOUND_SUPPORTS_COREAUDIO 1
 #endif
 
+/* per-sample counters for Sound_GetSampleStats(); off by default, it times every read. */
+#ifndef SOUND_SUPPORTS_STATS
+#define SOUND_SUPPORTS_STATS 0
+#endif
+
+/* count every allocation (Sound_GetAllocStats()); off by default, it costs a lock per malloc. */
+#ifndef SOUND_SUPPORTS_ALLOC_STATS
+#define SOUND_SUPPORTS_ALLOC_STATS 0
+#endif
+#if SOUND_SUPPORTS_ALLOC_STATS && !SOUND_SUPPORTS_STATS
+#error SOUND_SUPPORTS_ALLOC_STATS needs SOUND_SUPPORTS_STATS.
+#endif
+
+/* Sound_NewSampleFromFile() maps big files into memory instead of reading them. */
+#ifndef SOUND_SUPPORTS_MMAP
+#if defined(__linux__)
+#define SOUND_SUPPORTS_MMAP 1
+#else
+#define SOUND_SUPPORTS_MMAP 0
+#endif
+#endif
+
 /* only build CoreAudio support if on an Apple platform. */
 #if SOUND_SUPPORTS_COREAUDIO && !defined(__APPLE__)
 #undef SOUND_SUPPORTS_COREAUDIO
@@ -148,6 +170,26 @@ typedef struct __SOUND_DECODERFUNCTIONS__
          *    bool pending_error; (offlimits)
          *    void *buffer;        (offlimits until read() method)
          *    Uint32 buffer_size;  (offlimits until read() method)
+         *    Uint32 buffer_capacity; (offlimits)
+         *    Uint64 base_frame; (offlimits)
+         *    Uint64 delivered_bytes; (offlimits)
+         *    SDL_IOStream *counted_io; (offlimits)
+         *    Sound_SampleStats stats; (offlimits)
+         *    Uint64 stats_decoded_bytes; (offlimits)
+         *    struct DecodeAhead *ahead; (offlimits)
+         *    bool view_wanted; (offlimits)
+         *    const void *view; (offlimits)
+         *    Sound_Converter converter; (offlimits)
+         *    void *convert_buffer; (offlimits)
+         *    Uint32 convert_buffer_size; (offlimits)
+         *    Sound_ResampleQuality resample_quality; (offlimits)
+         *    Sound_Resampler *resampler; (offlimits)
+         *    Sound_Converter resample_in; (offlimits)
+         *    Sound_Converter resample_out; (offlimits)
+         *    void *resample_buffer; (offlimits)
+         *    Uint32 resample_buffer_size; (offlimits)
+         *    void *decode_buffer; (offlimits)
+         *    Uint32 decode_buffer_size; (offlimits)
          *    void *decoder_private; (read and write access)
          *
          * in rest of Sound_Sample:
@@ -240,24 +282,188 @@ typedef struct __SOUND_DECODERFUNCTIONS__
          *  continue as if nothing happened.
          */
     int (*seek)(Sound_Sample *sample, Uint32 ms);
+
+        /*
+         * Reposition the decoding to a specific sample frame, counted from
+         *  the start of the stream at sample->actual's rate. Nonzero on
+         *  success, zero on failure.
+         *
+         * This is the same as seek(), but the position is exact, and it
+         *  doesn't overflow on long, high-rate streams. When this method
+         *  exists, Sound_Seek() uses it instead of seek(), after converting
+         *  milliseconds to frames itself. Decoders that implement this should
+         *  have their seek() method just convert and call it, too, with
+         *  __Sound_convertMsToFrames().
+         *
+         * Same error-handling rules as seek().
+         *
+         * This method may be NULL, if the decoder can only seek by time.
+         */
+    int (*seek_frame)(Sound_Sample *sample, Uint64 frame);
+
+        /*
+         * Cheaply decide if a stream might be in this decoder's format, by
+         *  looking at its first bytes, without touching the SDL_IOStream.
+         *  (header) holds up to (len) bytes from the start of the stream;
+         *  (len) may be less than you'd like if the stream is short.
+         *
+         * Return non-zero if open() is worth trying, zero if the data
+         *  definitely isn't ours. This is only used when Sound_NewSample()
+         *  is searching for a decoder without a matching file extension,
+         *  so decoders that only accept data by extension (like RAW) should
+         *  return zero.
+         *
+         * This method may be NULL, in which case open() is always tried.
+         */
+    int (*probe)(const Uint8 *header, Uint32 len);
+
+        /*
+         * Work out the exact length of the sample, in milliseconds, when
+         *  open() could only estimate it: it put its guess in
+         *  internal->total_time and set internal->duration_estimated.
+         *  This is called at most once, and only if someone asks, so it can
+         *  afford to scan the whole stream; it must leave the decoder (and
+         *  the SDL_IOStream's position) just as it found them.
+         *
+         * Return the length, or -1 if it can't be found out after all, in
+         *  which case the estimate stands.
+         *
+         * This method may be NULL, if open() always knows the real length.
+         */
+    Sint32 (*duration)(Sound_Sample *sample);
+
+        /*
+         * Serialize whatever this decoder knows that makes seeking cheap
+         *  (for example, a table of frames to byte offsets), so
+         *  Sound_SaveSeekIndex() can store it and a later open of the same
+         *  stream can skip rebuilding it. Building it may take a pass over
+         *  the whole stream; like duration(), leave the decoder (and the
+         *  SDL_IOStream's position) just as you found them.
+         *
+         * Return the size of the index in bytes, and if (buf) isn't NULL
+         *  and (len) is at least that much, write it there. Return zero on
+         *  failure, and set the error message. SDL_sound adds its own header,
+         *  so this is just the decoder's part, in whatever layout it likes,
+         *  but make it byte-order independent (__Sound_IndexPut32() and
+         *  friends help there).
+         *
+         * This method may be NULL, if the decoder has nothing to save.
+         */
+    Uint32 (*save_index)(Sound_Sample *sample, Uint8 *buf, Uint32 len);
+
+        /*
+         * Take back an index that save_index() made for this stream, and use
+         *  it from now on. SDL_sound has already checked that it was made
+         *  from a stream with the same content key, but (buf) is still (len)
+         *  bytes of untrusted data; check it, and fail without changing
+         *  anything if it's wrong or doesn't fit this stream.
+         *
+         * Return non-zero on success, zero on failure (and set the error
+         *  message).
+         *
+         * This method may be NULL only if save_index() is, too.
+         */
+    int (*load_index)(Sound_Sample *sample, const Uint8 *buf, Uint32 len);
 } Sound_DecoderFunctions;
 
 
 typedef void (*MixFunc)(float *dst, void *src, Uint32 frames, float *gains);
 
+/*
+ * With SOUND_SUPPORTS_ALLOC_STATS, every allocation made while a decoder
+ *  method is running is charged to that sample; the phase says which of
+ *  the Sound_SampleStats counters it lands in. See SDL_sound_alloc.c.
+ */
+typedef enum Sound_AllocPhase
+{
+    SOUND_ALLOCPHASE_NONE,
+    SOUND_ALLOCPHASE_OPEN,
+    SOUND_ALLOCPHASE_READ,
+    SOUND_ALLOCPHASE_OTHER  /* seeking, closing. */
+} Sound_AllocPhase;
+
+/*
+ * Sound_Decode() does simple conversions itself, instead of through an
+ *  SDL_AudioStream; see SDL_sound_convert.c. A converter is a list of
+ *  stages, each converting (count_per_frame) samples or frames per frame
+ *  of audio, from (in_framesize) bytes to (out_framesize) bytes.
+ *
+ * To convert (frames) frames in place, put them at (frames * in_offset)
+ *  bytes into a work area of (frames * span) bytes; the result ends up at
+ *  the start of it. (num_stages) is zero when the converter isn't in use.
+ */
+#define SOUND_CONVERT_MAX_STAGES 6
+
+typedef void (*Sound_ConvertFunc)(void *dst, const void *src, Uint32 count);
+
+typedef struct Sound_ConvertStage
+{
+    Sound_ConvertFunc func;
+    Uint32 count_per_frame;
+    Uint32 in_framesize;
+    Uint32 out_framesize;
+} Sound_ConvertStage;
+
+typedef struct Sound_Converter
+{
+    int num_stages;
+    Sound_ConvertStage stages[SOUND_CONVERT_MAX_STAGES];
+    Uint32 in_offset;
+    Uint32 span;
+} Sound_Converter;
+
+/* SDL_sound's own resampler; see SDL_sound_resample.c. */
+typedef struct Sound_Resampler Sound_Resampler;
+
 typedef struct __SOUND_SAMPLEINTERNAL__
 {
     Sound_Sample *next;
     Sound_Sample *prev;
     SDL_IOStream *io;
+    Sint64 io_start;  /* where (io) was when the sample was opened, or -1. */
     const Sound_DecoderFunctions *funcs;
     SDL_AudioStream *stream;
     bool pending_eof;
     bool pending_error;
     void *buffer;
     Uint32 buffer_size;
+    Uint32 buffer_capacity;  /* bytes actually allocated for sample->buffer. */
     void *decoder_private;
     Sint32 total_time;
+    bool duration_estimated;  /* (total_time) is a guess; see duration(). */
+    Uint64 base_frame;  /* actual-rate frame of the last seek/rewind. */
+    Uint64 delivered_bytes;  /* desired-format bytes decoded since then. */
+#if SOUND_SUPPORTS_STATS
+    SDL_IOStream *counted_io;  /* the app's stream; (io) wraps it to count reads. */
+    Sound_SampleStats stats;
+    Uint64 stats_decoded_bytes;  /* actual-format bytes from the read() method. */
+#endif
+#if SOUND_SUPPORTS_ALLOC_STATS
+    Sound_AllocPhase alloc_phase;  /* what the decoder is in the middle of. */
+#endif
+    Sound_Sample *owner;  /* the app's sample; what traces report, not a worker's copy. */
+    struct DecodeAhead *ahead;  /* non-NULL while a worker decodes ahead. */
+    Uint8 *leftover;  /* a stopped worker's ring, if the app hadn't read it all. */
+    Uint32 leftover_capacity;  /* size of (leftover); a power of two. */
+    Uint32 leftover_pos;  /* read position in (leftover), wrapping like the ring's. */
+    Uint32 leftover_end;  /* ...and where the data in it ends. */
+    Sound_SampleFlags leftover_flags;  /* EOF/ERROR to report once it's all read. */
+    struct Sound_PushBuffer *push;  /* non-NULL for push samples; (io) reads from it. */
+    char *push_ext;  /* file extension hint for a push sample that isn't open yet. */
+    Uint64 push_retry_at;  /* don't try to open a push sample again until this much is in. */
+    bool view_wanted;  /* Sound_DecodeView() is asking; see __Sound_ReadPCM(). */
+    const void *view;  /* what __Sound_ReadPCM() lent out instead of copying. */
+    Sound_Converter converter;  /* used instead of (stream) when it can be. */
+    void *convert_buffer;  /* work area when sample->buffer is too small. */
+    Uint32 convert_buffer_size;
+    Sound_ResampleQuality resample_quality;
+    Sound_Resampler *resampler;  /* non-NULL when used instead of (stream). */
+    Sound_Converter resample_in;  /* actual format to what (resampler) takes. */
+    Sound_Converter resample_out;  /* what (resampler) makes to desired format. */
+    void *resample_buffer;  /* decoded audio on its way into (resampler). */
+    Uint32 resample_buffer_size;
+    void *decode_buffer;  /* decoder output for (stream) that won't fit in the app's buffer. */
+    Uint32 decode_buffer_size;
     Uint32 mix_position;
     MixFunc mix;
 } Sound_SampleInternal;
@@ -278,6 +484,13 @@ typedef struct __SOUND_SAMPLEINTERNAL__
 #define ERR_PREV_ERROR           "Previous decoding already caused an error"
 #define ERR_PREV_EOF             "Previous decoding already triggered EOF"
 #define ERR_CANNOT_SEEK          "Sample is not seekable"
+#define ERR_NO_BUFFER            "Sample has no decoding buffer"
+#define ERR_ALREADY_TRACING      "A trace is already running"
+#define ERR_DECODING_AHEAD       "Sample is decoding ahead"
+#define ERR_CORRUPT_SEEK_INDEX   "Seek index is corrupt"
+#define ERR_WRONG_SEEK_INDEX     "Seek index doesn't match this stream"
+#define ERR_NOT_PUSH_SAMPLE      "Not a push sample"
+#define ERR_PUSH_ENDED           "Push sample already ended"
 
 #ifdef __cplusplus
 extern "C" {
@@ -296,7 +509,226 @@ void __Sound_SetError(const char *err);
  * Call this to convert milliseconds to an actual byte position, based on
  *  audio data characteristics.
  */
-Uint32 __Sound_convertMsToBytePos(SDL_AudioSpec *info, Uint32 ms);
+Uint64 __Sound_convertMsToBytePos(const SDL_AudioSpec *info, Uint32 ms);
+
+/*
+ * Call this to convert milliseconds to a sample frame offset, based on
+ *  audio data characteristics. This rounds down, and never overflows.
+ */
+Uint64 __Sound_convertMsToFrames(const SDL_AudioSpec *info, Uint32 ms);
+
+/*
+ * Seek indexes are little endian whatever wrote them; save_index() and
+ *  load_index() methods can use these to build and pick apart their part.
+ *  The put functions return the position just past what they wrote.
+ */
+Uint8 *__Sound_IndexPut16(Uint8 *ptr, Uint16 val);
+Uint8 *__Sound_IndexPut32(Uint8 *ptr, Uint32 val);
+Uint8 *__Sound_IndexPut64(Uint8 *ptr, Uint64 val);
+Uint16 __Sound_IndexGet16(const Uint8 *ptr);
+Uint32 __Sound_IndexGet32(const Uint8 *ptr);
+Uint64 __Sound_IndexGet64(const Uint8 *ptr);
+
+/*
+ * Tell the app's trace callback, if any, that (event) is beginning or
+ *  ending for (sample). This is cheap when tracing is off.
+ */
+void __Sound_Trace(Sound_TraceEvent event, bool begin, Sound_Sample *sample);
+
+/*
+ * Decoders whose read() method hands back the stream's bytes untouched
+ *  should read them with this instead of SDL_ReadIO(internal->io,
+ *  internal->buffer, len). It usually does exactly that, but when
+ *  Sound_DecodeView() is asking and the stream is already in memory, it
+ *  just moves past (len) bytes and lends the app a pointer to them, so
+ *  don't touch internal->buffer afterwards. Returns bytes "read".
+ */
+Uint32 __Sound_ReadPCM(Sound_Sample *sample, Uint32 len);
+
+/*
+ * SDL_ReadIO(), but if a non-blocking stream runs dry partway through a
+ *  frame of (framesize) bytes, put the partial frame back for next time (if
+ *  the stream can seek back), so the caller only ever gets whole frames.
+ *  Short reads are retried until the stream says why it came up short,
+ *  since it might not say NOT_READY until the read after that.
+ *  __Sound_ReadPCM() uses this with sample->actual's frame size; call it
+ *  directly if that's not the size of a frame in the stream.
+ */
+size_t __Sound_ReadFrames(SDL_IOStream *io, void *buf, size_t len, Uint32 framesize);
+
+/*
+ * dr_mp3 and dr_flac take a short read for the end of the stream, so a
+ *  stream that just isn't ready yet (SDL_IO_STATUS_NOT_READY) would end
+ *  the sample early. Their decoders put a Sound_IOBuffer in front of
+ *  internal->io, route the library's read, seek and tell callbacks through
+ *  it, and before letting the library start on its next frame, make sure
+ *  there's enough on hand with __Sound_IOBufferFill(). If that says no,
+ *  set SOUND_SAMPLEFLAG_EAGAIN and try again on the next read().
+ *
+ * __Sound_IOBufferFill() returns false only if fewer than (len) bytes are
+ *  buffered and the stream has nothing more for now; at the end of the
+ *  stream, or on an error, it returns true and lets the library find out
+ *  the usual way. __Sound_IOBufferRead() only comes back short at the end
+ *  of the stream, or if the stream stopped being ready partway through,
+ *  in which case it sets (starved). Seeking drops whatever is buffered.
+ *
+ * Most streams never make anyone wait, so until one says NOT_READY for the
+ *  first time, __Sound_IOBufferFill() does nothing and reads go straight
+ *  through. Decoders set (staging) from the start for push samples, which
+ *  are bound to.
+ */
+typedef struct Sound_IOBuffer
+{
+    Uint8 *data;
+    Uint32 pos;  /* next byte to hand out. */
+    Uint32 len;  /* bytes in (data), from the start. */
+    Uint32 capacity;
+    bool ended;  /* the stream said EOF, or failed; don't wait on it. */
+    bool starved;
+    bool staging;  /* the stream has said NOT_READY; fill before each frame. */
+} Sound_IOBuffer;
+
+bool __Sound_IOBufferFill(Sound_IOBuffer *iob, SDL_IOStream *io, Uint32 len);
+size_t __Sound_IOBufferRead(Sound_IOBuffer *iob, SDL_IOStream *io, void *ptr, size_t len);
+bool __Sound_IOBufferSeek(Sound_IOBuffer *iob, SDL_IOStream *io, Sint64 offset, SDL_IOWhence whence);
+Sint64 __Sound_IOBufferTell(const Sound_IOBuffer *iob, SDL_IOStream *io);
+void __Sound_IOBufferFree(Sound_IOBuffer *iob);
+
+/*
+ * Set up (cvt) to convert from (src) to (dst) without an SDL_AudioStream.
+ *  Returns false if it can't (a rate change, say), or if there's nothing
+ *  to convert. The rest is in SDL_sound_convert.c.
+ */
+bool __Sound_InitConverter(Sound_Converter *cvt, const SDL_AudioSpec *src,
+                           const SDL_AudioSpec *dst);
+
+/* Convert (frames) frames in (work), laid out as Sound_Converter says. */
+void __Sound_RunConverter(const Sound_Converter *cvt, Uint8 *work, Uint32 frames);
+
+#if SOUND_SUPPORTS_ALLOC_STATS
+/*
+ * Charge allocations on this thread to (sample)'s decoder, as (phase),
+ *  until the matching __Sound_AllocLeave(). These nest; hand Leave what
+ *  Enter returned.
+ */
+typedef struct Sound_AllocScope
+{
+    Sound_Sample *sample;
+    Sound_AllocPhase phase;
+} Sound_AllocScope;
+
+Sound_AllocScope __Sound_AllocEnter(Sound_Sample *sample, Sound_AllocPhase phase);
+void __Sound_AllocLeave(Sound_AllocScope prev);
+
+/*
+ * Everything that includes this header, decoders and their third-party
+ *  libraries too, allocates through these, so nothing escapes the count.
+ */
+void *__Sound_Malloc(size_t size);
+void *__Sound_Calloc(size_t nmemb, size_t size);
+void *__Sound_Realloc(void *mem, size_t size);
+void __Sound_Free(void *mem);
+char *__Sound_Strdup(const char *str);
+void *__Sound_AlignedAlloc(size_t alignment, size_t size);
+void __Sound_AlignedFree(void *mem);
+
+#ifndef SOUND_ALLOC_NO_REDIRECT
+#undef SDL_malloc
+#undef SDL_calloc
+#undef SDL_realloc
+#undef SDL_free
+#undef SDL_strdup
+#undef SDL_aligned_alloc
+#undef SDL_aligned_free
+#define SDL_malloc __Sound_Malloc
+#define SDL_calloc __Sound_Calloc
+#define SDL_realloc __Sound_Realloc
+#define SDL_free __Sound_Free
+#define SDL_strdup __Sound_Strdup
+#define SDL_aligned_alloc __Sound_AlignedAlloc
+#define SDL_aligned_free __Sound_AlignedFree
+#endif
+#endif
+
+/*
+ * The resampler takes and makes interleaved, native-endian SDL_AUDIO_F32
+ *  with (channels) channels. Put decoded frames in, and get as many
+ *  resampled frames out as there's input for; it keeps what it still needs.
+ *  Flush it at the end of the input to let the last frames out, and reset
+ *  it to start over, after a seek.
+ *
+ * __Sound_CreateResampler() returns NULL, without setting an error, if it
+ *  can't do (quality) for these rates; it's up to the caller to fall back
+ *  to SDL_AudioStream. __Sound_ResamplerInputNeeded() says how many more
+ *  input frames it needs to make (frames) frames of output.
+ */
+Sound_Resampler *__Sound_CreateResampler(Sound_ResampleQuality quality,
+                                         int channels, int in_rate, int out_rate);
+void __Sound_DestroyResampler(Sound_Resampler *rs);
+void __Sound_ResetResampler(Sound_Resampler *rs);
+bool __Sound_PutResampler(Sound_Resampler *rs, const float *input, Uint32 frames);
+void __Sound_FlushResampler(Sound_Resampler *rs);
+Uint32 __Sound_ResamplerInputNeeded(const Sound_Resampler *rs, Uint32 frames);
+Uint32 __Sound_GetResampled(Sound_Resampler *rs, float *output, Uint32 frames);
+
+/*
+ * The decoded-PCM cache, in SDL_sound_cache.c. A key says where the audio
+ *  came from and what format it was decoded to; (path) is NULL for memory
+ *  blobs, and just borrowed until __Sound_CacheAdd() copies it.
+ *
+ * __Sound_CacheFind() and __Sound_CacheAdd() hand back a reference to the
+ *  entry, which goes away with __Sound_CacheRelease(). Entries are opened
+ *  as samples with __Sound_DecoderFunctions_CACHE, which expects the entry
+ *  in internal->decoder_private and __Sound_CacheOpenIO()'s stream in
+ *  internal->io; it takes over the reference.
+ */
+typedef struct Sound_CacheKey
+{
+    Uint64 hash;
+    Uint64 size;
+    Sint64 mtime;
+    const char *path;
+    SDL_AudioSpec desired;
+} Sound_CacheKey;
+
+typedef struct Sound_CacheEntry Sound_CacheEntry;
+
+bool __Sound_CacheInit(void);
+void __Sound_CacheQuit(void);
+Uint64 __Sound_CacheBudget(void);
+bool __Sound_CacheKeyFromFile(Sound_CacheKey *key, const char *filename,
+                              const SDL_AudioSpec *desired);
+void __Sound_CacheKeyFromMem(Sound_CacheKey *key, const Uint8 *data,
+                             Uint32 size, const SDL_AudioSpec *desired);
+Sound_CacheEntry *__Sound_CacheFind(const Sound_CacheKey *key);
+Sound_CacheEntry *__Sound_CacheAdd(const Sound_CacheKey *key,
+                                   const Sound_Sample *sample,
+                                   void *pcm, Uint32 len);
+void __Sound_CacheRelease(Sound_CacheEntry *entry);
+SDL_IOStream *__Sound_CacheOpenIO(Sound_CacheEntry *entry);
+extern const Sound_DecoderFunctions __Sound_DecoderFunctions_CACHE;
+
+/*
+ * Push samples, in SDL_sound_push.c. __Sound_PushOpenIO() makes the stream
+ *  a push sample's decoder reads from, and hands back the buffer behind it
+ *  in (*pb); the stream owns the buffer, and frees it when it's closed.
+ *
+ * Reads that catch up with __Sound_PushAppend() come up short and say
+ *  SDL_IO_STATUS_NOT_READY, until __Sound_PushEnd(). Everything pushed is
+ *  kept, and the stream can seek anywhere in it, until __Sound_PushForget();
+ *  after that, data is dropped once it's been read. __Sound_PushStarved()
+ *  says if a read or seek has run out of data since the last time it was
+ *  asked. __Sound_PushTotal() is how many bytes have been pushed, ever.
+ */
+typedef struct Sound_PushBuffer Sound_PushBuffer;
+
+SDL_IOStream *__Sound_PushOpenIO(Sound_PushBuffer **pb);
+bool __Sound_PushAppend(Sound_PushBuffer *pb, const void *data, size_t len);
+void __Sound_PushEnd(Sound_PushBuffer *pb);
+bool __Sound_PushEnded(const Sound_PushBuffer *pb);
+Uint64 __Sound_PushTotal(const Sound_PushBuffer *pb);
+bool __Sound_PushStarved(Sound_PushBuffer *pb);
+void __Sound_PushForget(Sound_PushBuffer *pb);
 
 
 /* These get used all over for lessening code clutter. */
@@ -83,6 +83,8 @@ static int MIDI_open(Sound_Sample *sample, const char *ext)
     spec.format = (sample->desired.format == 0) ? SDL_AUDIO_S16 : sample->desired.format;
     spec.freq = (sample->desired.freq == 0) ? 44100 : sample->desired.freq;
     buffer_size = sample->buffer_size / (SDL_AUDIO_BITSIZE(spec.format) / 8) / spec.channels;
+    if (buffer_size == 0)  /* app is using Sound_DecodeInto() only. */
+        buffer_size = 4096;
 
     song = Timidity_LoadSong(io, &spec, buffer_size);
     BAIL_IF_MACRO(song == NULL, "MIDI: Not a MIDI file.", 0);
@@ -155,6 +157,16 @@ static int MIDI_seek(Sound_Sample *sample, Uint32 ms)
 } /* MIDI_seek */
 
 
+static int MIDI_probe(const Uint8 *header, Uint32 len)
+{
+    if ((len >= 4) && (SDL_memcmp(header, "MThd", 4) == 0))
+        return 1;
+
+    return ( (len >= 12) && (SDL_memcmp(header, "RIFF", 4) == 0) &&
+             (SDL_memcmp(header + 8, "RMID", 4) == 0) );
+} /* MIDI_probe */
+
+
 static const char *extensions_midi[] = { "MIDI", "MID", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_MIDI =
 {
@@ -171,7 +183,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_MIDI =
     MIDI_close,      /*  close() method */
     MIDI_read,       /*   read() method */
     MIDI_rewind,     /* rewind() method */
-    MIDI_seek        /*   seek() method */
+    MIDI_seek,       /*   seek() method */
+    NULL,            /* seek_frame() method */
+    MIDI_probe,      /*  probe() method */
+    NULL,            /* duration() method */
+    NULL,            /* save_index() method */
+    NULL             /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_MIDI */
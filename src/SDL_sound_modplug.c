@@ -79,6 +79,7 @@ static int MODPLUG_open(Sound_Sample *sample, const char *ext)
     ModPlug_Settings settings;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     ModPlugFile *module;
+    SDL_PropertiesID props;
     void *data;
     Sint64 size;
     size_t retval;
@@ -105,11 +106,19 @@ static int MODPLUG_open(Sound_Sample *sample, const char *ext)
     size = SDL_GetIOSize(internal->io);
     BAIL_IF_MACRO(size <= 0 || size > (Sint64)0x7fffffff, "MODPLUG: Not a module file.", 0);
 
-    data = SDL_malloc((size_t) size);
-    BAIL_IF_MACRO(data == NULL, ERR_OUT_OF_MEMORY, 0);
-    retval = SDL_ReadIO(internal->io, data, size);
-    if (retval != (size_t)size) SDL_free(data);
-    BAIL_IF_MACRO(retval != (size_t)size, ERR_IO_ERROR, 0);
+    /* if it's already in memory (a memory stream or a mapped file), don't copy it. */
+    props = SDL_GetIOProperties(internal->io);
+    data = SDL_GetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, NULL);
+    if ((data != NULL) && (SDL_GetNumberProperty(props, SDL_PROP_IOSTREAM_MEMORY_SIZE_NUMBER, 0) == size))
+        retval = 0;  /* don't free it. */
+    else
+    {
+        data = SDL_malloc((size_t) size);
+        BAIL_IF_MACRO(data == NULL, ERR_OUT_OF_MEMORY, 0);
+        retval = SDL_ReadIO(internal->io, data, size);
+        if (retval != (size_t)size) SDL_free(data);
+        BAIL_IF_MACRO(retval != (size_t)size, ERR_IO_ERROR, 0);
+    } /* else */
 
     SDL_copyp(&sample->actual, &sample->desired);
     if (sample->actual.freq == 0) sample->actual.freq = 44100;
@@ -206,6 +215,13 @@ static int MODPLUG_seek(Sound_Sample *sample, Uint32 ms)
 } /* MODPLUG_seek */
 
 
+/* ModPlug's loaders are too forgiving, so open() only goes by extension. */
+static int MODPLUG_probe(const Uint8 *header, Uint32 len)
+{
+    return 0;
+} /* MODPLUG_probe */
+
+
 const Sound_DecoderFunctions __Sound_DecoderFunctions_MODPLUG =
 {
     {
@@ -221,7 +237,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_MODPLUG =
     MODPLUG_close,      /*  close() method */
     MODPLUG_read,       /*   read() method */
     MODPLUG_rewind,     /* rewind() method */
-    MODPLUG_seek        /*   seek() method */
+    MODPLUG_seek,       /*   seek() method */
+    NULL,               /* seek_frame() method */
+    MODPLUG_probe,      /*  probe() method */
+    NULL,               /* duration() method */
+    NULL,               /* save_index() method */
+    NULL                /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_MODPLUG */
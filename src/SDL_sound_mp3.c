@@ -32,32 +32,69 @@
 
 #include "dr_mp3.h"
 
+/* MP3 frames between seek points; about 1.7 seconds at 44.1kHz. */
+#define MP3_SEEK_POINT_INTERVAL 64
+
+/* how much of the file mp3_scan() reads at a time. */
+#define MP3_SCAN_BUFFER_SIZE (64 * 1024)
+
+/* the most frames back a seek point can start to have the bit reservoir
+   full again. main_data_begin is at most 511 bytes, and frames are rarely
+   smaller than 48 bytes of data. */
+#define MP3_SCAN_LOOKBACK 16
+
+/* before dr_mp3 starts on a new MP3 frame, have at least this much of the
+   stream on hand, unless it's at its end, so dr_mp3 never reads up short.
+   minimp3 wants the next frame's header too, so this is two of the biggest
+   frames there are (2881 bytes; MPEG-2.5 layer 3 at 160kbps and 8kHz). */
+#define MP3_READ_RESERVE (6 * 1024)
+
+/* the fewest PCM frames an MP3 frame has (layer 1). */
+#define MP3_MIN_FRAME_SAMPLES 384
+
+typedef struct
+{
+    Uint64 pos;
+    Uint16 main_data_begin;
+    Uint16 data_bytes;
+} MP3ScanFrame;
+
+typedef struct
+{
+    drmp3 dr;
+    Sound_IOBuffer iobuf;  /* between dr_mp3 and internal->io. */
+
+    /* the seek table, bound to (dr). It grows as mp3_scan() gets further. */
+    drmp3_seek_point *seek_points;
+    Uint32 seek_point_count;
+    Uint32 seek_point_capacity;
+
+    /* where mp3_scan() is up to, and the last few frames it saw. */
+    Uint64 scan_pos;
+    Uint64 scan_pcm;
+    MP3ScanFrame recent[MP3_SCAN_LOOKBACK];
+    Uint32 recent_count;  /* frames in (recent) since the last junk, up to MP3_SCAN_LOOKBACK. */
+    Uint32 recent_next;  /* where the next one goes. */
+    Uint32 frames_since_point;
+    bool scan_synced;
+    bool scan_done;
+} MP3Data;
+
+/* dr_mp3 treats reading nothing as EOF, so MP3_read() makes sure it never has to wait; see MP3_READ_RESERVE. */
 static size_t mp3_read(void* pUserData, void* pBufferOut, size_t bytesToRead)
 {
-    Uint8 *ptr = (Uint8 *) pBufferOut;
     Sound_Sample *sample = (Sound_Sample *) pUserData;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    SDL_IOStream *io = internal->io;
-    size_t retval = 0;
-
-    /* !!! FIXME: dr_mp3 treats returning less than bytesToRead as EOF. So we can't EAGAIN. */
-    while (bytesToRead)
-    {
-        const size_t rc = SDL_ReadIO(io, ptr, bytesToRead);
-        if (rc == 0) break;
-        bytesToRead -= rc;
-        retval += rc;
-        ptr += rc;
-    } /* while */
-
-    return retval;
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    return __Sound_IOBufferRead(&mp3->iobuf, internal->io, pBufferOut, bytesToRead);
 } /* mp3_read */
 
 static drmp3_bool32 mp3_seek(void* pUserData, int offset, drmp3_seek_origin origin)
 {
     Sound_Sample *sample = (Sound_Sample *) pUserData;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    int whence;
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    SDL_IOWhence whence;
     switch (origin) {
     case DRMP3_SEEK_SET:
         whence = SDL_IO_SEEK_SET;
@@ -71,18 +108,401 @@ static drmp3_bool32 mp3_seek(void* pUserData, int offset, drmp3_seek_origin orig
     default:
         return DRMP3_FALSE;
     }
-    return (SDL_SeekIO(internal->io, offset, whence) != -1) ? DRMP3_TRUE : DRMP3_FALSE;
+    return __Sound_IOBufferSeek(&mp3->iobuf, internal->io, offset, whence) ? DRMP3_TRUE : DRMP3_FALSE;
 } /* mp3_seek */
 
 static drmp3_bool32 mp3_tell(void* pUserData, drmp3_int64* pCursor)
 {
     Sound_Sample *sample = (Sound_Sample *) pUserData;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    *pCursor = SDL_TellIO(internal->io);
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    *pCursor = __Sound_IOBufferTell(&mp3->iobuf, internal->io);
     return (*pCursor != -1) ? DRMP3_TRUE : DRMP3_FALSE;
 } /* mp3_tell */
 
 
+/* bitrates in kbps, by [MPEG-1?][layer - 1][index]. */
+static const Uint16 mp3_bitrates[2][3][15] = {
+    {   /* MPEG-2 and 2.5 */
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+    },
+    {   /* MPEG-1 */
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+    }
+};
+
+static const Uint16 mp3_rates[3] = { 44100, 48000, 32000 };  /* MPEG-1's. */
+
+/*
+ * Returns the size in bytes of the MPEG audio frame whose header is at
+ *  (hdr), and its sample rate and samples per channel, or zero if (hdr)
+ *  isn't a frame header, or is one whose size we can't know (free format).
+ */
+static Uint32 mp3_frame_size(const Uint8 *hdr, Uint32 *freq, Uint32 *frame_samples)
+{
+    const int version = (hdr[1] >> 3) & 3;  /* 3 == MPEG-1, 2 == MPEG-2, 0 == MPEG-2.5 */
+    const int layer = 4 - ((hdr[1] >> 1) & 3);
+    const int bitrate_index = hdr[2] >> 4;
+    const int rate_index = (hdr[2] >> 2) & 3;
+    const int mpeg1 = (version == 3);
+    const Uint32 padding = (hdr[2] >> 1) & 1;
+    Uint32 kbps;
+
+    if ( (hdr[0] != 0xFF) || ((hdr[1] & 0xE0) != 0xE0) ||
+         (version == 1) || (layer == 4) ||
+         (bitrate_index == 0) || (bitrate_index == 15) || (rate_index == 3) )
+        return 0;
+
+    kbps = mp3_bitrates[mpeg1][layer - 1][bitrate_index];
+    *freq = mp3_rates[rate_index] >> (mpeg1 ? 0 : ((version == 2) ? 1 : 2));
+
+    if (layer == 1)
+    {
+        *frame_samples = 384;
+        return ((12000 * kbps / *freq) + padding) * 4;
+    } /* if */
+
+    *frame_samples = ((layer == 3) && !mpeg1) ? 576 : 1152;
+    return (((*frame_samples / 8) * 1000 * kbps) / *freq) + padding;
+} /* mp3_frame_size */
+
+
+/*
+ * Layer 3 frames can keep some of their audio data in the frames before
+ *  them (the "bit reservoir"). Returns how many bytes back (main_data_begin)
+ *  the frame whose header is at (hdr) starts, and puts how many bytes of
+ *  audio data the frame itself carries in (data_bytes). (framesize) is from
+ *  mp3_frame_size(), and that many bytes must be there.
+ */
+static Uint32 mp3_main_data_begin(const Uint8 *hdr, Uint32 framesize, Uint32 *data_bytes)
+{
+    const int mpeg1 = (((hdr[1] >> 3) & 3) == 3);
+    const int mono = ((hdr[3] >> 6) == 3);
+    const Uint32 crc = (hdr[1] & 1) ? 0 : 2;
+    const Uint8 *side = hdr + 4 + crc;
+    const Uint32 sideinfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    const Uint32 used = 4 + crc + sideinfo;
+
+    if ((4 - ((hdr[1] >> 1) & 3)) != 3)  /* layers 1 and 2 stand alone. */
+    {
+        *data_bytes = 0;
+        return 0;
+    } /* if */
+
+    *data_bytes = (framesize > used) ? (framesize - used) : 0;
+    return mpeg1 ? ((((Uint32) side[0]) << 1) | (side[1] >> 7)) : side[0];
+} /* mp3_main_data_begin */
+
+
+/*
+ * Without a Xing/Info header, dr_mp3 can only count frames by walking every
+ *  one of them, which is a full pass over the file. Try a VBRI header
+ *  instead, and failing that, guess from the average size of the first few
+ *  frames. Returns false if we have nothing to go on.
+ */
+static bool mp3_estimate_duration(Sound_Sample *sample, drmp3 *dr)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    SDL_IOStream *io = internal->io;
+    const Sint64 pos = SDL_TellIO(io);
+    Sint64 end = (Sint64) dr->streamLength;
+    Uint64 frames = 0;
+    Uint32 freq = 0, frame_samples = 0, framesize = 0;
+    Uint32 first = 0, offset, count = 0;
+    Uint8 buf[16384];
+    size_t br = 0;
+
+    if (pos < 0)
+        return false;
+
+    if (SDL_SeekIO(io, (Sint64) dr->streamStartOffset, SDL_IO_SEEK_SET) >= 0)
+        br = SDL_ReadIO(io, buf, sizeof (buf));
+
+    if (SDL_SeekIO(io, pos, SDL_IO_SEEK_SET) != pos)
+    {
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        return false;
+    } /* if */
+
+    for (first = 0; (first + 4) <= br; first++)
+    {
+        framesize = mp3_frame_size(buf + first, &freq, &frame_samples);
+        if (framesize > 0)
+            break;
+    } /* for */
+
+    if (framesize == 0)
+        return false;
+
+    /* VBRI sits 32 bytes past the 4-byte header, always. */
+    if (((first + 36 + 18) <= br) && (SDL_memcmp(buf + first + 36, "VBRI", 4) == 0))
+    {
+        const Uint8 *ptr = buf + first + 36 + 14;
+        frames = ((Uint32) ptr[0] << 24) | ((Uint32) ptr[1] << 16) | ((Uint32) ptr[2] << 8) | ((Uint32) ptr[3]);
+        frames++;  /* dr_mp3 doesn't know VBRI, and plays the header as a silent frame. */
+    } /* if */
+
+    else
+    {
+        if (dr->streamLength == DRMP3_UINT64_MAX)
+            end = SDL_GetIOSize(io);  /* (streamLength) is only set if there are tags at the end. */
+        end -= (Sint64) dr->streamStartOffset + first;
+        if (end <= 0)
+            return false;  /* no idea how big the stream is. */
+
+        /* average over every whole frame we read, in case it's VBR. */
+        for (offset = first; (offset + 4) <= br; offset += framesize)
+        {
+            Uint32 f, fs;
+            framesize = mp3_frame_size(buf + offset, &f, &fs);
+            if ((framesize == 0) || ((offset + framesize) > br) || (f != freq) || (fs != frame_samples))
+                break;
+            count++;
+        } /* for */
+
+        if (count == 0)  /* we didn't even get one whole frame; go by its header. */
+        {
+            count = 1;
+            offset = first + mp3_frame_size(buf + first, &freq, &frame_samples);
+        } /* if */
+
+        frames = (((Uint64) end) * count) / (offset - first);
+        internal->duration_estimated = true;
+    } /* else */
+
+    frames *= frame_samples;
+    internal->total_time = (Sint32) SDL_min((frames / freq) * 1000, 0x7FFFFFFF);
+    internal->total_time += (Sint32) (((frames % freq) * 1000) / freq);
+    return true;
+} /* mp3_estimate_duration */
+
+
+static Sint32 mp3_frames_to_ms(const Uint64 frames, const Uint32 freq)
+{
+    const Uint64 ms = ((frames / freq) * 1000) + (((frames % freq) * 1000) / freq);
+    return (Sint32) SDL_min(ms, 0x7FFFFFFF);
+} /* mp3_frames_to_ms */
+
+
+static bool mp3_add_seek_point(MP3Data *mp3, Uint64 pos, Uint64 pcm, Uint16 mp3_discard, Uint16 pcm_discard)
+{
+    drmp3_seek_point *point;
+
+    if (mp3->seek_point_count == mp3->seek_point_capacity)
+    {
+        const Uint32 newcap = mp3->seek_point_capacity ? (mp3->seek_point_capacity * 2) : 64;
+        void *ptr = SDL_realloc(mp3->seek_points, newcap * sizeof (drmp3_seek_point));
+        BAIL_IF_MACRO(!ptr, ERR_OUT_OF_MEMORY, false);
+        mp3->seek_points = (drmp3_seek_point *) ptr;
+        mp3->seek_point_capacity = newcap;
+    } /* if */
+
+    point = &mp3->seek_points[mp3->seek_point_count++];
+    point->seekPosInBytes = pos;
+    point->pcmFrameIndex = pcm;
+    point->mp3FramesToDiscard = mp3_discard;
+    point->pcmFramesToDiscard = pcm_discard;
+    return true;
+} /* mp3_add_seek_point */
+
+
+/*
+ * Find somewhere to start decoding so that the latest frame we've seen will
+ *  decode properly: dr_mp3 resets its decoder when it jumps to a seek point,
+ *  and a frame whose audio data starts in earlier frames (see
+ *  mp3_main_data_begin()) won't decode until the decoder has seen those;
+ *  minimp3 just skips it. This plays out what minimp3 keeps of each frame
+ *  when it isn't asked for audio, the way dr_mp3 runs the frames it
+ *  discards, going back as far as it has to. Returns the index in
+ *  (mp3->recent) to start at, and how many frames from there will decode
+ *  (including the latest one) in (decoded), or -1 if we haven't seen far
+ *  enough back.
+ */
+static int mp3_find_seek_start(const MP3Data *mp3, Uint32 *decoded)
+{
+    const Uint32 latest = (mp3->recent_next + MP3_SCAN_LOOKBACK - 1) % MP3_SCAN_LOOKBACK;
+    Uint32 back, i;
+
+    for (back = 0; back < mp3->recent_count; back++)
+    {
+        const Uint32 start = (latest + MP3_SCAN_LOOKBACK - back) % MP3_SCAN_LOOKBACK;
+        Uint32 reservoir = 0;
+        Uint32 ok = 0;
+
+        for (i = 0; i < back; i++)
+        {
+            const MP3ScanFrame *frame = &mp3->recent[(start + i) % MP3_SCAN_LOOKBACK];
+            if (reservoir >= frame->main_data_begin)
+                ok++;
+            reservoir = SDL_min(reservoir, frame->main_data_begin) + frame->data_bytes;
+            reservoir = SDL_min(reservoir, DRMP3_MAX_BITRESERVOIR_BYTES);
+        } /* for */
+
+        if (reservoir >= mp3->recent[latest].main_data_begin)
+        {
+            *decoded = ok + 1;
+            return (int) start;
+        } /* if */
+    } /* for */
+
+    return -1;
+} /* mp3_find_seek_start */
+
+
+/*
+ * Note the frame at byte (pos), and make it a seek point if it's time for
+ *  one and it's a good place for one. Seeking to it decodes this frame to
+ *  prime the decoder and throws its audio away, after which the output is
+ *  the same as if we'd decoded everything from the start.
+ */
+static bool mp3_scan_frame(MP3Data *mp3, Uint64 pos, const Uint8 *hdr, Uint32 framesize, Uint32 frame_samples)
+{
+    MP3ScanFrame *frame = &mp3->recent[mp3->recent_next];
+    const Uint64 next_pcm = mp3->scan_pcm + frame_samples;
+    Uint32 data_bytes;
+
+    frame->pos = pos;
+    frame->main_data_begin = (Uint16) mp3_main_data_begin(hdr, framesize, &data_bytes);
+    frame->data_bytes = (Uint16) SDL_min(data_bytes, 0xFFFF);
+    mp3->recent_next = (mp3->recent_next + 1) % MP3_SCAN_LOOKBACK;
+    if (mp3->recent_count < MP3_SCAN_LOOKBACK)
+        mp3->recent_count++;
+
+    if (mp3->frames_since_point >= MP3_SEEK_POINT_INTERVAL)
+    {
+        Uint32 decoded = 0;
+        const int start = mp3_find_seek_start(mp3, &decoded);
+        if (start >= 0)  /* otherwise, try again on the next frame. */
+        {
+            if (!mp3_add_seek_point(mp3, mp3->recent[start].pos, next_pcm, (Uint16) decoded, (Uint16) frame_samples))
+                return false;
+            mp3->frames_since_point = 0;
+        } /* if */
+    } /* if */
+
+    mp3->frames_since_point++;
+    mp3->scan_pcm = next_pcm;
+    return true;
+} /* mp3_scan_frame */
+
+
+/*
+ * Walk the frame headers from where we left off, until we're past PCM frame
+ *  (until) or the end of the stream, adding seek points as we go. This only
+ *  reads headers, so it's much cheaper than decoding, but it's still a pass
+ *  over the file, so it's done a piece at a time, as seeks need it. It
+ *  shares the SDL_IOStream with the decoder, so put that back after.
+ */
+static bool mp3_scan(Sound_Sample *sample, MP3Data *mp3, const Uint64 until)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    SDL_IOStream *io = internal->io;
+    const Uint64 end = mp3->dr.streamLength;
+    const Uint32 rate = mp3->dr.sampleRate;
+    const Sint64 pos = SDL_TellIO(io);
+    bool retval = true;
+    Uint8 *buf;
+
+    if (mp3->scan_done)
+        return true;
+    else if (pos < 0)
+        return false;
+
+    buf = (Uint8 *) SDL_malloc(MP3_SCAN_BUFFER_SIZE);
+    BAIL_IF_MACRO(!buf, ERR_OUT_OF_MEMORY, false);
+
+    if (mp3->seek_point_count == 0)  /* dr_mp3 would start at byte 0, before any tags. */
+        retval = mp3_add_seek_point(mp3, mp3->dr.streamStartOffset, 0, 0, 0);
+
+    while (retval && !mp3->scan_done && (mp3->scan_pcm <= until))
+    {
+        size_t want = MP3_SCAN_BUFFER_SIZE;
+        size_t br = 0;
+        size_t off = 0;
+
+        if (end != DRMP3_UINT64_MAX)  /* don't wander into tags at the end. */
+            want = (size_t) ((mp3->scan_pos < end) ? SDL_min(end - mp3->scan_pos, want) : 0);
+
+        if ((want > 0) && (SDL_SeekIO(io, (Sint64) mp3->scan_pos, SDL_IO_SEEK_SET) >= 0))
+        {
+            while (br < want)
+            {
+                const size_t rc = SDL_ReadIO(io, buf + br, want - br);
+                if (rc == 0) break;
+                br += rc;
+            } /* while */
+        } /* if */
+
+        if ((br < want) && (SDL_GetIOStatus(io) != SDL_IO_STATUS_EOF))
+        {
+            retval = false;  /* don't take an i/o error for the end of the file. */
+            break;
+        } /* if */
+
+        while (((off + 4) <= br) && (mp3->scan_pcm <= until))
+        {
+            Uint32 freq = 0, frame_samples = 0, f, fs;
+            const Uint32 framesize = mp3_frame_size(buf + off, &freq, &frame_samples);
+
+            if ((framesize == 0) || (freq != rate))
+            {
+                mp3->scan_synced = false;  /* junk; look for the next frame. */
+                mp3->recent_count = 0;
+                off++;
+                continue;
+            } /* if */
+
+            if ((off + framesize) > br)
+                break;  /* read the rest of it next time around. */
+
+            /* after junk, make sure this isn't a sync word by coincidence. */
+            if ( (!mp3->scan_synced) && ((off + framesize + 4) <= br) &&
+                 ((mp3_frame_size(buf + off + framesize, &f, &fs) == 0) || (f != rate)) )
+            {
+                off++;
+                continue;
+            } /* if */
+
+            mp3->scan_synced = true;
+            if (!mp3_scan_frame(mp3, mp3->scan_pos + off, buf + off, framesize, frame_samples))
+            {
+                retval = false;
+                break;
+            } /* if */
+            off += framesize;
+        } /* while */
+
+        mp3->scan_pos += off;
+
+        /* a short read means this was the last of it; whatever's left isn't a whole frame. */
+        if (retval && (br < want || want == 0) && (mp3->scan_pcm <= until))
+            mp3->scan_done = true;
+    } /* while */
+
+    SDL_free(buf);
+
+    if (SDL_SeekIO(io, pos, SDL_IO_SEEK_SET) != pos)
+    {
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        retval = false;
+    } /* if */
+
+    /* without a Xing header there's no delay to trim, so this is the length. */
+    if (mp3->scan_done && internal->duration_estimated && (mp3->scan_pcm > 0))
+    {
+        internal->total_time = mp3_frames_to_ms(mp3->scan_pcm, rate);
+        internal->duration_estimated = false;
+    } /* if */
+
+    drmp3_bind_seek_table(&mp3->dr, mp3->seek_point_count, mp3->seek_points);
+    return retval;
+} /* mp3_scan */
+
+
 static bool MP3_init(void)
 {
     return true; /* always succeeds. */
@@ -97,13 +517,19 @@ static void MP3_quit(void)
 static int MP3_open(Sound_Sample *sample, const char *ext)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drmp3 *dr = (drmp3 *) SDL_calloc(1, sizeof (drmp3));
+    MP3Data *mp3 = (MP3Data *) SDL_calloc(1, sizeof (MP3Data));
+    drmp3 *dr;
     Uint64 frames;
 
-    BAIL_IF_MACRO(!dr, ERR_OUT_OF_MEMORY, 0);
+    BAIL_IF_MACRO(!mp3, ERR_OUT_OF_MEMORY, 0);
+    dr = &mp3->dr;
+    mp3->iobuf.staging = (internal->push != NULL);
+    internal->decoder_private = mp3;  /* the callbacks need this already. */
     if (drmp3_init(dr, mp3_read, mp3_seek, mp3_tell, NULL, sample, NULL) != DRMP3_TRUE)
     {
-        SDL_free(dr);
+        internal->decoder_private = NULL;
+        __Sound_IOBufferFree(&mp3->iobuf);
+        SDL_free(mp3);
         BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_IO_ERROR, 0);
         BAIL_MACRO("MP3: Not an MPEG-1 layer 1-3 stream.", 0);
     } /* if */
@@ -113,7 +539,30 @@ static int MP3_open(Sound_Sample *sample, const char *ext)
 
     sample->actual.channels = dr->channels;
     sample->actual.freq = dr->sampleRate;
-    sample->actual.format = SDL_AUDIO_F32; /* dr_mp3 only does float. */
+    /* dr_mp3 decodes to float, but converts to Sint16 more cheaply than an SDL_AudioStream would. */
+    sample->actual.format = (sample->desired.format == SDL_AUDIO_S16) ? SDL_AUDIO_S16 : SDL_AUDIO_F32;
+
+    mp3->scan_pos = dr->streamStartOffset;
+
+    /* A Xing/Info header gives us the exact length for free. If there
+       isn't one, don't scan the whole file now; see MP3_duration(). */
+    if (dr->totalPCMFrameCount == DRMP3_UINT64_MAX)
+    {
+        if (!mp3_estimate_duration(sample, dr))
+        {
+            if (sample->flags & SOUND_SAMPLEFLAG_ERROR)  /* lost our place. */
+            {
+                drmp3_uninit(dr);
+                internal->decoder_private = NULL;
+                __Sound_IOBufferFree(&mp3->iobuf);
+                SDL_free(mp3);
+                BAIL_MACRO(ERR_IO_ERROR, 0);
+            } /* if */
+            internal->total_time = -1;
+            internal->duration_estimated = true;
+        } /* if */
+        return 1;
+    } /* if */
 
     frames = drmp3_get_pcm_frame_count(dr);
     if (frames == 0) /* ever possible ??? */
@@ -125,48 +574,265 @@ static int MP3_open(Sound_Sample *sample, const char *ext)
         internal->total_time += ((frames % freq) * 1000) / freq;
     } /* else */
 
-    internal->decoder_private = dr;
-
     return 1;
 } /* MP3_open */
 
 static void MP3_close(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drmp3 *dr = (drmp3 *) internal->decoder_private;
-    drmp3_uninit(dr);
-    SDL_free(dr);
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    drmp3_uninit(&mp3->dr);
+    __Sound_IOBufferFree(&mp3->iobuf);
+    SDL_free(mp3->seek_points);
+    SDL_free(mp3);
 } /* MP3_close */
 
+/*
+ * This hands dr_mp3 one MP3 frame at a time, so that before each one we
+ *  can check there's enough of the stream on hand to decode it. If the
+ *  stream isn't ready, we stop there with EAGAIN and pick up from the same
+ *  spot next time, without dr_mp3 ever seeing a read come up empty.
+ */
 static Uint32 MP3_read(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    const int channels = (int) sample->actual.channels;
-    drmp3 *dr = (drmp3 *) internal->decoder_private;
-    const drmp3_uint64 frames_to_read = (internal->buffer_size / channels) / sizeof (float);
-    const drmp3_uint64 rc = drmp3_read_pcm_frames_f32(dr, frames_to_read, (float *) internal->buffer);
-    /* !!! FIXME: we only set the EOF flags, but this only tells you we're done, not about i/o errors, nor corruption. */
-    if (rc < frames_to_read)
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    drmp3 *dr = &mp3->dr;
+    const drmp3_uint64 frames_to_read = internal->buffer_size / framesize;
+    drmp3_uint64 total = 0;
+    drmp3_uint64 want, rc;
+    void *ptr;
+
+    while (total < frames_to_read)
+    {
+        ptr = ((Uint8 *) internal->buffer) + (total * framesize);
+        want = frames_to_read - total;
+        if (dr->pcmFramesRemainingInMP3Frame > 0)
+            want = SDL_min(want, dr->pcmFramesRemainingInMP3Frame);
+        else if ( (dr->dataSize < MP3_READ_RESERVE) &&
+                  (!__Sound_IOBufferFill(&mp3->iobuf, internal->io, MP3_READ_RESERVE - (Uint32) dr->dataSize)) )
+        {
+            sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+            break;
+        } /* else if */
+        else
+            want = SDL_min(want, MP3_MIN_FRAME_SAMPLES);  /* just the one new frame. */
+
+        mp3->iobuf.starved = false;
+        if (sample->actual.format == SDL_AUDIO_S16)
+            rc = drmp3_read_pcm_frames_s16(dr, want, (drmp3_int16 *) ptr);
+        else
+            rc = drmp3_read_pcm_frames_f32(dr, want, (float *) ptr);
+        total += rc;
+
+        if (rc == want)
+            continue;
+
+        /* junk in the stream can make dr_mp3 read past the reserve. If
+           that ran dry, dr_mp3 still has what it read; carry on later. */
+        if (mp3->iobuf.starved)
+        {
+            dr->atEnd = DRMP3_FALSE;
+            sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+            break;
+        } /* if */
+
+        /* !!! FIXME: we only set the EOF flags, but this only tells you we're done, not about i/o errors, nor corruption. */
         sample->flags |= SOUND_SAMPLEFLAG_EOF;
-    return rc * channels * sizeof (float);
+
+        /* without a Xing header there's no delay to trim, so this is the length. */
+        if (internal->duration_estimated && (dr->currentPCMFrame > 0))
+        {
+            internal->total_time = mp3_frames_to_ms(dr->currentPCMFrame, dr->sampleRate);
+            internal->duration_estimated = false;
+        } /* if */
+        break;
+    } /* while */
+
+    return (Uint32) (total * framesize);
 } /* MP3_read */
 
+/*
+ * Counting the frames is the same walk over the file that builds the seek
+ *  table, so finish that, and the table is ready for the next seek, too.
+ */
+static Sint32 MP3_duration(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+
+    if (!mp3_scan(sample, mp3, DRMP3_UINT64_MAX) || (mp3->scan_pcm == 0))
+        return -1;
+    return mp3_frames_to_ms(mp3->scan_pcm, mp3->dr.sampleRate);
+} /* MP3_duration */
+
 static int MP3_rewind(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drmp3 *dr = (drmp3 *) internal->decoder_private;
+    drmp3 *dr = &((MP3Data *) internal->decoder_private)->dr;
     return (drmp3_seek_to_pcm_frame(dr, 0) == DRMP3_TRUE);
 } /* MP3_rewind */
 
-static int MP3_seek(Sound_Sample *sample, Uint32 ms)
+/*
+ * Without a seek table, dr_mp3 decodes everything from the start of the
+ *  file up to (frame), for every seek. So the first time we seek somewhere
+ *  the table doesn't reach yet, extend it that far (which only reads frame
+ *  headers); after that, seeking anywhere we've been before costs a couple
+ *  of MP3 frames' worth of decoding.
+ */
+static int MP3_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    drmp3 *dr = (drmp3 *) internal->decoder_private;
-    const float frames_per_ms = ((float) sample->actual.freq) / 1000.0f;
-    const drmp3_uint64 frame_offset = (drmp3_uint64) (frames_per_ms * ((float) ms));
-    return (drmp3_seek_to_pcm_frame(dr, frame_offset) == DRMP3_TRUE);
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    drmp3 *dr = &mp3->dr;
+
+    /* dr_mp3 counts the encoder delay a Xing header tells it to skip, we don't. */
+    const Uint64 raw = frame + dr->delayInPCMFrames;
+
+    if (frame == 0)
+        return (drmp3_seek_to_pcm_frame(dr, 0) == DRMP3_TRUE);
+
+    /* if the scan fails, the table we have is still good, just shorter. */
+    if (!mp3_scan(sample, mp3, raw))
+        BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_ERROR, ERR_IO_ERROR, 0);
+
+    /* the first seek point is the start of the stream, where dr_mp3 would
+       skip the delay again, so seek from there the way it does without one. */
+    if ((mp3->seek_point_count > 1) && (raw >= mp3->seek_points[1].pcmFrameIndex))
+        return (drmp3_seek_to_pcm_frame(dr, raw) == DRMP3_TRUE);
+    else if (drmp3_seek_to_pcm_frame(dr, 0) != DRMP3_TRUE)
+        return 0;
+    return (drmp3_read_pcm_frames_f32(dr, frame, NULL) == frame);
+} /* MP3_seek_frame */
+
+static int MP3_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return MP3_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* MP3_seek */
 
+/*
+ * The seek index is the whole stream's length in PCM frames, then the seek
+ *  table, all little endian:
+ *
+ *  Uint64 pcm_frames; Uint32 count;
+ *  count * { Uint64 byte_offset; Uint64 pcm_frame; Uint16 mp3_frames_to_discard; Uint16 pcm_frames_to_discard; }
+ */
+#define MP3_INDEX_HEADER_SIZE 12
+#define MP3_INDEX_POINT_SIZE 20
+
+static Uint32 MP3_save_index(Sound_Sample *sample, Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    Uint32 retval;
+    Uint32 i;
+
+    if (!mp3_scan(sample, mp3, DRMP3_UINT64_MAX))
+        return 0;
+
+    retval = MP3_INDEX_HEADER_SIZE + (mp3->seek_point_count * MP3_INDEX_POINT_SIZE);
+    if ((buf != NULL) && (len >= retval))
+    {
+        buf = __Sound_IndexPut64(buf, mp3->scan_pcm);
+        buf = __Sound_IndexPut32(buf, mp3->seek_point_count);
+        for (i = 0; i < mp3->seek_point_count; i++)
+        {
+            const drmp3_seek_point *point = &mp3->seek_points[i];
+            buf = __Sound_IndexPut64(buf, point->seekPosInBytes);
+            buf = __Sound_IndexPut64(buf, point->pcmFrameIndex);
+            buf = __Sound_IndexPut16(buf, point->mp3FramesToDiscard);
+            buf = __Sound_IndexPut16(buf, point->pcmFramesToDiscard);
+        } /* for */
+    } /* if */
+
+    return retval;
+} /* MP3_save_index */
+
+static int MP3_load_index(Sound_Sample *sample, const Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    MP3Data *mp3 = (MP3Data *) internal->decoder_private;
+    Sint64 end = (Sint64) mp3->dr.streamLength;
+    drmp3_seek_point *points;
+    Uint64 pcm_frames;
+    Uint32 count, i;
+
+    BAIL_IF_MACRO(len < MP3_INDEX_HEADER_SIZE, ERR_CORRUPT_SEEK_INDEX, 0);
+    pcm_frames = __Sound_IndexGet64(buf);
+    count = __Sound_IndexGet32(buf + 8);
+    buf += MP3_INDEX_HEADER_SIZE;
+    BAIL_IF_MACRO(count == 0, ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(count > ((len - MP3_INDEX_HEADER_SIZE) / MP3_INDEX_POINT_SIZE), ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(len != MP3_INDEX_HEADER_SIZE + (count * MP3_INDEX_POINT_SIZE), ERR_CORRUPT_SEEK_INDEX, 0);
+
+    if (mp3->dr.streamLength == DRMP3_UINT64_MAX)
+        end = SDL_GetIOSize(internal->io);
+
+    points = (drmp3_seek_point *) SDL_malloc(count * sizeof (drmp3_seek_point));
+    BAIL_IF_MACRO(!points, ERR_OUT_OF_MEMORY, 0);
+
+    for (i = 0; i < count; i++, buf += MP3_INDEX_POINT_SIZE)
+    {
+        drmp3_seek_point *point = &points[i];
+        point->seekPosInBytes = __Sound_IndexGet64(buf);
+        point->pcmFrameIndex = __Sound_IndexGet64(buf + 8);
+        point->mp3FramesToDiscard = __Sound_IndexGet16(buf + 16);
+        point->pcmFramesToDiscard = __Sound_IndexGet16(buf + 18);
+
+        /* a bad table would just make for bad seeks, but this is cheap to catch. */
+        if ( (point->seekPosInBytes < mp3->dr.streamStartOffset) ||
+             ((end >= 0) && (point->seekPosInBytes >= (Uint64) end)) ||
+             (point->pcmFrameIndex > pcm_frames) ||
+             (point->pcmFramesToDiscard > point->pcmFrameIndex) ||
+             (point->mp3FramesToDiscard > MP3_SCAN_LOOKBACK) ||
+             ((i > 0) && (point->pcmFrameIndex <= points[i-1].pcmFrameIndex)) )
+        {
+            SDL_free(points);
+            BAIL_MACRO(ERR_WRONG_SEEK_INDEX, 0);
+        } /* if */
+    } /* for */
+
+    SDL_free(mp3->seek_points);
+    mp3->seek_points = points;
+    mp3->seek_point_count = mp3->seek_point_capacity = count;
+    mp3->scan_pcm = pcm_frames;
+    mp3->scan_done = true;
+    drmp3_bind_seek_table(&mp3->dr, count, points);
+
+    if (internal->duration_estimated && (pcm_frames > 0))
+    {
+        internal->total_time = mp3_frames_to_ms(pcm_frames, mp3->dr.sampleRate);
+        internal->duration_estimated = false;
+    } /* if */
+
+    return 1;
+} /* MP3_load_index */
+
+/*
+ * MP3 has no real file header, so accept an ID3v2 tag, or anything that
+ *  looks like a valid MPEG audio frame sync somewhere in what we were given.
+ */
+static int MP3_probe(const Uint8 *header, Uint32 len)
+{
+    Uint32 i;
+
+    if ((len >= 3) && (SDL_memcmp(header, "ID3", 3) == 0))
+        return 1;
+
+    for (i = 0; (i + 3) < len; i++)
+    {
+        if ( (header[i] == 0xFF) &&
+             ((header[i+1] & 0xE0) == 0xE0) &&  /* 11 sync bits */
+             ((header[i+1] & 0x06) != 0x00) &&  /* layer isn't reserved */
+             ((header[i+2] & 0xF0) != 0xF0) &&  /* bitrate isn't invalid */
+             ((header[i+2] & 0x0C) != 0x0C) )   /* sample rate isn't reserved */
+            return 1;
+    } /* for */
+
+    return 0;
+} /* MP3_probe */
+
 /* dr_mp3 will play layer 1 and 2 files, too */
 static const char *extensions_mp3[] = { "MP3", "MP2", "MP1", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_MP3 =
@@ -184,7 +850,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_MP3 =
     MP3_close,      /*  close() method */
     MP3_read,       /*   read() method */
     MP3_rewind,     /* rewind() method */
-    MP3_seek        /*   seek() method */
+    MP3_seek,       /*   seek() method */
+    MP3_seek_frame, /* seek_frame() method */
+    MP3_probe,      /*  probe() method */
+    MP3_duration,   /* duration() method */
+    MP3_save_index, /* save_index() method */
+    MP3_load_index  /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_MP3 */
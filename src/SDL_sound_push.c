@@ -0,0 +1,236 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/**
+ * This file implements the stream behind push samples (see
+ *  Sound_NewPushSample()).
+ *
+ * The app hands us compressed data with Sound_PushData(), and it piles up
+ *  in a Sound_PushBuffer. Decoders read it back through an ordinary
+ *  SDL_IOStream, which reports SDL_IO_STATUS_NOT_READY when they catch up
+ *  with the app, and EOF once the app calls Sound_PushEnd() and they've
+ *  read the rest. Decoders that can stop and pick up again on a short read
+ *  turn that into SOUND_SAMPLEFLAG_EAGAIN.
+ *
+ * Until a decoder takes the stream, we hang on to everything, so each of
+ *  them can have a go at opening it from the start as more data comes in.
+ *  After that, what's been read is dropped as new data arrives, so the
+ *  buffer only ever holds what the decoder hasn't gotten to yet.
+ *
+ * Documentation is in SDL_sound.h ... It's verbose, honest.  :)
+ */
+
+#define __SDL_SOUND_INTERNAL__
+#include "SDL_sound_internal.h"
+
+/* the least we grow the buffer by, so lots of tiny pushes don't realloc every time. */
+#define PUSH_MIN_GROWTH (16 * 1024)
+
+struct Sound_PushBuffer
+{
+    Uint8 *data;
+    size_t len;  /* bytes in (data). */
+    size_t capacity;  /* bytes allocated for (data). */
+    size_t pos;  /* read position in (data). */
+    Uint64 base;  /* stream position of data[0]. */
+    bool keep;  /* hold on to what's been read; see __Sound_PushForget(). */
+    bool ended;  /* no more data is coming. */
+    bool starved;  /* a read or seek went past what we have. */
+};
+
+
+static Sint64 SDLCALL push_io_size(void *userdata)
+{
+    Sound_PushBuffer *pb = (Sound_PushBuffer *) userdata;
+    if (!pb->ended)
+    {
+        pb->starved = true;  /* a decoder that needs this has to wait for the end. */
+        BAIL_MACRO("Size of a push stream isn't known until it ends", -1);
+    } /* if */
+    return (Sint64) (pb->base + pb->len);
+} /* push_io_size */
+
+
+static Sint64 SDLCALL push_io_seek(void *userdata, Sint64 offset, SDL_IOWhence whence)
+{
+    Sound_PushBuffer *pb = (Sound_PushBuffer *) userdata;
+    const Sint64 end = (Sint64) (pb->base + pb->len);
+    Sint64 pos;
+
+    switch (whence)
+    {
+        case SDL_IO_SEEK_SET:
+            pos = offset;
+            break;
+        case SDL_IO_SEEK_CUR:
+            pos = ((Sint64) (pb->base + pb->pos)) + offset;
+            break;
+        case SDL_IO_SEEK_END:
+            if (!pb->ended)
+            {
+                pb->starved = true;
+                BAIL_MACRO("Push stream hasn't ended yet", -1);
+            } /* if */
+            pos = end + offset;
+            break;
+        default:
+            BAIL_MACRO(ERR_INVALID_ARGUMENT, -1);
+    } /* switch */
+
+    BAIL_IF_MACRO(pos < (Sint64) pb->base, "That part of the push stream is gone", -1);
+
+    if (pos > end)
+    {
+        if (!pb->ended)
+        {
+            pb->starved = true;
+            BAIL_MACRO("That part of the push stream hasn't arrived yet", -1);
+        } /* if */
+        pos = end;  /* like a memory stream, stop at the end. */
+    } /* if */
+
+    pb->pos = (size_t) (((Uint64) pos) - pb->base);
+    return pos;
+} /* push_io_seek */
+
+
+static size_t SDLCALL push_io_read(void *userdata, void *ptr, size_t size, SDL_IOStatus *status)
+{
+    Sound_PushBuffer *pb = (Sound_PushBuffer *) userdata;
+    const size_t avail = pb->len - pb->pos;
+
+    if (size > avail)
+    {
+        size = avail;
+        if (!pb->ended)
+        {
+            pb->starved = true;
+            *status = SDL_IO_STATUS_NOT_READY;
+        } /* if */
+        else if (size == 0)
+        {
+            *status = SDL_IO_STATUS_EOF;
+        } /* else if */
+    } /* if */
+
+    SDL_memcpy(ptr, pb->data + pb->pos, size);
+    pb->pos += size;
+    return size;
+} /* push_io_read */
+
+
+static size_t SDLCALL push_io_write(void *userdata, const void *ptr, size_t size, SDL_IOStatus *status)
+{
+    *status = SDL_IO_STATUS_READONLY;
+    return 0;
+} /* push_io_write */
+
+
+static bool SDLCALL push_io_close(void *userdata)
+{
+    Sound_PushBuffer *pb = (Sound_PushBuffer *) userdata;
+    SDL_free(pb->data);
+    SDL_free(pb);
+    return true;
+} /* push_io_close */
+
+
+SDL_IOStream *__Sound_PushOpenIO(Sound_PushBuffer **_pb)
+{
+    SDL_IOStreamInterface iface;
+    SDL_IOStream *retval;
+    Sound_PushBuffer *pb;
+
+    pb = (Sound_PushBuffer *) SDL_calloc(1, sizeof (Sound_PushBuffer));
+    BAIL_IF_MACRO(pb == NULL, ERR_OUT_OF_MEMORY, NULL);
+    pb->keep = true;
+
+    SDL_INIT_INTERFACE(&iface);
+    iface.size = push_io_size;
+    iface.seek = push_io_seek;
+    iface.read = push_io_read;
+    iface.write = push_io_write;
+    iface.close = push_io_close;
+
+    retval = SDL_OpenIO(&iface, pb);
+    if (retval == NULL)
+    {
+        push_io_close(pb);
+        BAIL_MACRO(SDL_GetError(), NULL);
+    } /* if */
+
+    *_pb = pb;
+    return retval;
+} /* __Sound_PushOpenIO */
+
+
+bool __Sound_PushAppend(Sound_PushBuffer *pb, const void *data, size_t len)
+{
+    /* make room by dropping what's been read, if we're allowed to. */
+    if ((!pb->keep) && (pb->pos > 0) && ((pb->capacity - pb->len) < len))
+    {
+        pb->len -= pb->pos;
+        SDL_memmove(pb->data, pb->data + pb->pos, pb->len);
+        pb->base += pb->pos;
+        pb->pos = 0;
+    } /* if */
+
+    if ((pb->capacity - pb->len) < len)
+    {
+        size_t newcap;
+        void *ptr;
+
+        BAIL_IF_MACRO(len > (SDL_SIZE_MAX - pb->len), ERR_OUT_OF_MEMORY, false);
+        newcap = pb->len + SDL_max(len, PUSH_MIN_GROWTH);
+        if ((newcap - pb->len) < pb->capacity)  /* double it, if that's more. */
+            newcap = (pb->capacity <= (SDL_SIZE_MAX / 2)) ? (pb->capacity * 2) : SDL_SIZE_MAX;
+
+        ptr = SDL_realloc(pb->data, newcap);
+        BAIL_IF_MACRO(ptr == NULL, ERR_OUT_OF_MEMORY, false);
+        pb->data = (Uint8 *) ptr;
+        pb->capacity = newcap;
+    } /* if */
+
+    SDL_memcpy(pb->data + pb->len, data, len);
+    pb->len += len;
+    return true;
+} /* __Sound_PushAppend */
+
+
+void __Sound_PushEnd(Sound_PushBuffer *pb)
+{
+    pb->ended = true;
+} /* __Sound_PushEnd */
+
+
+bool __Sound_PushEnded(const Sound_PushBuffer *pb)
+{
+    return pb->ended;
+} /* __Sound_PushEnded */
+
+
+Uint64 __Sound_PushTotal(const Sound_PushBuffer *pb)
+{
+    return pb->base + pb->len;
+} /* __Sound_PushTotal */
+
+
+bool __Sound_PushStarved(Sound_PushBuffer *pb)
+{
+    const bool retval = pb->starved;
+    pb->starved = false;
+    return retval;
+} /* __Sound_PushStarved */
+
+
+void __Sound_PushForget(Sound_PushBuffer *pb)
+{
+    pb->keep = false;
+} /* __Sound_PushForget */
+
+/* end of SDL_sound_push.c ... */
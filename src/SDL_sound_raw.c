@@ -103,11 +103,13 @@ static Uint32 RAW_read(Sound_Sample *sample)
          * We don't actually do any decoding, so we read the raw data
          *  directly into the internal buffer...
          */
-    retval = SDL_ReadIO(internal->io, internal->buffer,
-                        internal->buffer_size);
+    retval = __Sound_ReadPCM(sample, internal->buffer_size);
 
         /* Make sure the read went smoothly... */
-    if (retval == 0)
+    if ((retval == 0) && (SDL_GetIOStatus(internal->io) == SDL_IO_STATUS_NOT_READY))
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;  /* non-blocking stream; more is coming. */
+
+    else if (retval == 0)
         sample->flags |= SOUND_SAMPLEFLAG_EOF;
 
     else if (retval == -1) /** FIXME: this error check is broken **/
@@ -128,15 +130,26 @@ static int RAW_rewind(Sound_Sample *sample)
     return 1;
 } /* RAW_rewind */
 
-static int RAW_seek(Sound_Sample *sample, Uint32 ms)
+static int RAW_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    const Sint64 pos = __Sound_convertMsToBytePos(&sample->actual, ms);
+    const Sint64 pos = (Sint64) (frame * SDL_AUDIO_FRAMESIZE(sample->actual));
     const int err = (SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET) != pos);
     BAIL_IF_MACRO(err, ERR_IO_ERROR, 0);
     return 1;
+} /* RAW_seek_frame */
+
+static int RAW_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return RAW_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* RAW_seek */
 
+static int RAW_probe(const Uint8 *header, Uint32 len)
+{
+    return 0;  /* there's no header; we only take data by extension. */
+} /* RAW_probe */
+
+
 static const char *extensions_raw[] = { "RAW", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_RAW =
 {
@@ -153,7 +166,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_RAW =
     RAW_close,      /*  close() method */
     RAW_read,       /*   read() method */
     RAW_rewind,     /* rewind() method */
-    RAW_seek        /*   seek() method */
+    RAW_seek,       /*   seek() method */
+    RAW_seek_frame, /* seek_frame() method */
+    RAW_probe,      /*  probe() method */
+    NULL,           /* duration() method */
+    NULL,           /* save_index() method */
+    NULL            /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_RAW */
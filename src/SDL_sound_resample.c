@@ -0,0 +1,453 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/**
+ * This file implements SDL_sound's own resampler, used instead of
+ *  SDL_AudioStream when the app asks for a particular quality with
+ *  Sound_SetResampleQuality().
+ *
+ * It's a polyphase FIR filter: with the rates reduced to a ratio of
+ *  (in_rate : out_rate) == (M : L), every output frame falls at one of L
+ *  fixed positions between two input frames, so there's one precomputed
+ *  filter per position, and each output frame is a single dot product of
+ *  the filter against the input around it. The filters are Kaiser-windowed
+ *  sincs centered on the output frame, so they're linear phase with no
+ *  group delay; the price is that they need half their length in input
+ *  past the output frame before it can be made. The linear tier is the same
+ *  thing with two taps, worked out as it goes instead of from a table.
+ *
+ * Input is kept planar, one row per channel, so the dot products run over
+ *  contiguous memory; those have SSE2, AVX2 and NEON versions.
+ */
+
+#define __SDL_SOUND_INTERNAL__
+#include "SDL_sound_internal.h"
+
+/* tables bigger than this cost more to build and hold than they're worth. */
+#define RESAMPLE_MAX_PHASES 1024
+
+/* longest filter to stretch to when going down in rate; a multiple of 8. */
+#define RESAMPLE_MAX_TAPS 256
+
+/* input frames to make room for up front; more than any filter's lead-in. */
+#define RESAMPLE_MIN_HISTORY 256
+
+typedef float (*DotFunc)(const float *a, const float *b, Uint32 count);
+
+struct Sound_Resampler
+{
+    int channels;
+    Uint32 taps;  /* filter length; always even. */
+    Uint32 phases;  /* L: output positions between two input frames. */
+    Uint32 step;  /* whole input frames per output frame... */
+    Uint32 step_frac;  /* ...plus this many (phases)ths of one. */
+    float *filters;  /* (phases) rows of (taps) coefficients; NULL for linear. */
+    DotFunc dot;
+    float *history;  /* (channels) rows of (capacity) input frames. */
+    Uint32 capacity;
+    Uint32 frames;  /* input frames in each row. */
+    Uint32 pos;  /* next output frame is at row[pos]... */
+    Uint32 frac;  /* ...plus (frac / phases) of a frame. */
+    Uint32 end;  /* once flushed, output stops when (pos) gets here. */
+    bool flushed;
+};
+
+
+/* These add up in four lanes and then pairwise, the same as the SIMD ones. */
+static float dot_scalar(const float *a, const float *b, Uint32 count)
+{
+    float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    Uint32 i;
+    for (i = 0; i < count; i += 4)
+    {
+        sum[0] += a[i] * b[i];
+        sum[1] += a[i + 1] * b[i + 1];
+        sum[2] += a[i + 2] * b[i + 2];
+        sum[3] += a[i + 3] * b[i + 3];
+    } /* for */
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+} /* dot_scalar */
+
+#if defined(SDL_SSE2_INTRINSICS)
+static float SDL_TARGETING("sse2") dot_sse2(const float *a, const float *b, Uint32 count)
+{
+    __m128 sum = _mm_setzero_ps();
+    Uint32 i;
+    for (i = 0; i < count; i += 4)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum);
+} /* dot_sse2 */
+#endif
+
+#if defined(SDL_AVX2_INTRINSICS)
+static float SDL_TARGETING("avx2") dot_avx2(const float *a, const float *b, Uint32 count)
+{
+    __m256 sum = _mm256_setzero_ps();
+    __m128 half;
+    Uint32 i;
+    for (i = 0; i < count; i += 8)  /* the filters are multiples of 8 taps long. */
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(half);
+} /* dot_avx2 */
+#endif
+
+#if defined(SDL_NEON_INTRINSICS)
+static float dot_neon(const float *a, const float *b, Uint32 count)
+{
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    float32x2_t half;
+    Uint32 i;
+    for (i = 0; i < count; i += 4)
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+    half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+} /* dot_neon */
+#endif
+
+static DotFunc pick_dot(Uint32 taps)
+{
+#if defined(SDL_AVX2_INTRINSICS)
+    if (((taps % 8) == 0) && SDL_HasAVX2())
+        return dot_avx2;
+#endif
+#if defined(SDL_SSE2_INTRINSICS)
+    if (SDL_HasSSE2())
+        return dot_sse2;
+#endif
+#if defined(SDL_NEON_INTRINSICS)
+    if (SDL_HasNEON())
+        return dot_neon;
+#endif
+    return dot_scalar;
+} /* pick_dot */
+
+
+/* zeroth-order modified Bessel function of the first kind, for the window. */
+static double bessel_i0(double x)
+{
+    const double quarter_x2 = (x * x) / 4.0;
+    double term = 1.0;
+    double sum = 1.0;
+    int k;
+    for (k = 1; k < 50; k++)
+    {
+        term *= quarter_x2 / ((double) k * (double) k);
+        sum += term;
+        if (term < (sum * 1e-12))
+            break;
+    } /* for */
+    return sum;
+} /* bessel_i0 */
+
+
+/*
+ * Fill in one filter per phase. (cutoff) is relative to the input's Nyquist
+ *  rate, and already lowered for downsampling. Each filter is normalized so
+ *  it passes DC at unity gain, or its ripple would show up as a buzz at the
+ *  rate the phases repeat.
+ */
+static void build_filters(float *filters, Uint32 phases, Uint32 taps,
+                          double cutoff, double beta)
+{
+    const double half = (double) (taps / 2);
+    const double i0_beta = bessel_i0(beta);
+    Uint32 p, k;
+
+    for (p = 0; p < phases; p++)
+    {
+        const double phase = ((double) p) / ((double) phases);
+        float *filter = filters + (p * taps);
+        double total = 0.0;
+
+        for (k = 0; k < taps; k++)
+        {
+            /* how far this tap's input frame is from the output frame. */
+            const double x = ((double) k) - (half - 1.0) - phase;
+            const double t = x / half;
+            const double y = cutoff * x * SDL_PI_D;
+            const double sinc = (y == 0.0) ? 1.0 : (SDL_sin(y) / y);
+            const double window = (t >= 1.0) ? 0.0 : (bessel_i0(beta * SDL_sqrt(1.0 - (t * t))) / i0_beta);
+            const double coef = cutoff * sinc * window;
+            filter[k] = (float) coef;
+            total += coef;
+        } /* for */
+
+        for (k = 0; k < taps; k++)
+            filter[k] = (float) (((double) filter[k]) / total);
+    } /* for */
+} /* build_filters */
+
+
+static Uint32 gcd(Uint32 a, Uint32 b)
+{
+    while (b != 0)
+    {
+        const Uint32 r = a % b;
+        a = b;
+        b = r;
+    } /* while */
+    return a;
+} /* gcd */
+
+
+/* make room for (frames) more input frames in every row. */
+static bool reserve_history(Sound_Resampler *rs, Uint32 frames)
+{
+    const Uint32 needed = rs->frames + frames;
+    Uint32 capacity;
+    float *history;
+    int c;
+
+    if (needed <= rs->capacity)
+        return true;
+
+    capacity = SDL_max(needed, rs->capacity * 2);
+    capacity = SDL_max(capacity, RESAMPLE_MIN_HISTORY);
+    history = (float *) SDL_malloc(((size_t) capacity) * rs->channels * sizeof (float));
+    if (history == NULL)
+        return false;
+
+    for (c = 0; c < rs->channels; c++)
+        SDL_memcpy(history + (c * capacity), rs->history + (c * rs->capacity), rs->frames * sizeof (float));
+
+    SDL_free(rs->history);
+    rs->history = history;
+    rs->capacity = capacity;
+    return true;
+} /* reserve_history */
+
+
+static void append_silence(Sound_Resampler *rs, Uint32 frames)
+{
+    int c;
+    for (c = 0; c < rs->channels; c++)
+        SDL_memset(rs->history + (c * rs->capacity) + rs->frames, '\0', frames * sizeof (float));
+    rs->frames += frames;
+} /* append_silence */
+
+
+Sound_Resampler *__Sound_CreateResampler(Sound_ResampleQuality quality,
+                                         int channels, int in_rate, int out_rate)
+{
+    Sound_Resampler *rs;
+    Uint32 taps, divisor, phases;
+    double rolloff, beta, cutoff;
+
+    if ((channels <= 0) || (in_rate <= 0) || (out_rate <= 0))
+        return NULL;
+
+    switch (quality)
+    {
+        case SOUND_RESAMPLE_LINEAR: taps = 2; rolloff = 1.0; beta = 0.0; break;
+        case SOUND_RESAMPLE_SHORT_FIR: taps = 16; rolloff = 0.90; beta = 6.0; break;
+        case SOUND_RESAMPLE_LONG_FIR: taps = 64; rolloff = 0.95; beta = 9.0; break;
+        default: return NULL;
+    } /* switch */
+
+    /* going down, the cutoff drops by in_rate/out_rate, and the filter has
+       to get that much longer to keep the same transition band. The FIR
+       tiers start as multiples of 8 taps, and so stay that way, for
+       dot_avx2(). */
+    if ((quality != SOUND_RESAMPLE_LINEAR) && (out_rate < in_rate))
+    {
+        const Uint32 factor = (((Uint32) in_rate) + ((Uint32) out_rate) - 1) / ((Uint32) out_rate);
+        taps = (factor >= (RESAMPLE_MAX_TAPS / taps)) ? RESAMPLE_MAX_TAPS : (taps * factor);
+    } /* if */
+
+    divisor = gcd((Uint32) in_rate, (Uint32) out_rate);
+    phases = ((Uint32) out_rate) / divisor;
+    if ((quality != SOUND_RESAMPLE_LINEAR) && (phases > RESAMPLE_MAX_PHASES))
+        return NULL;
+
+    rs = (Sound_Resampler *) SDL_calloc(1, sizeof (Sound_Resampler));
+    if (rs == NULL)
+        return NULL;
+
+    rs->channels = channels;
+    rs->taps = taps;
+    rs->phases = phases;
+    rs->step = ((Uint32) in_rate) / ((Uint32) out_rate);
+    rs->step_frac = (((Uint32) in_rate) / divisor) % phases;
+    rs->dot = pick_dot(taps);
+
+    if (quality != SOUND_RESAMPLE_LINEAR)
+    {
+        rs->filters = (float *) SDL_malloc(((size_t) phases) * taps * sizeof (float));
+        if (rs->filters == NULL)
+        {
+            SDL_free(rs);
+            return NULL;
+        } /* if */
+
+        /* going down, the filter has to cut off below the new Nyquist rate. */
+        cutoff = rolloff;
+        if (out_rate < in_rate)
+            cutoff *= ((double) out_rate) / ((double) in_rate);
+        build_filters(rs->filters, phases, taps, cutoff, beta);
+    } /* if */
+
+    /* this is more than enough for __Sound_ResetResampler() to never fail. */
+    if (!reserve_history(rs, RESAMPLE_MIN_HISTORY))
+    {
+        __Sound_DestroyResampler(rs);
+        return NULL;
+    } /* if */
+
+    __Sound_ResetResampler(rs);
+    return rs;
+} /* __Sound_CreateResampler */
+
+
+void __Sound_DestroyResampler(Sound_Resampler *rs)
+{
+    if (rs != NULL)
+    {
+        SDL_free(rs->history);
+        SDL_free(rs->filters);
+        SDL_free(rs);
+    } /* if */
+} /* __Sound_DestroyResampler */
+
+
+void __Sound_ResetResampler(Sound_Resampler *rs)
+{
+    const Uint32 lead = (rs->taps / 2) - 1;
+
+    /* the first output frame lines up with the first input frame, with
+       silence before it for the filter's first half to run over. */
+    rs->frames = 0;
+    rs->frac = 0;
+    rs->end = 0;
+    rs->flushed = false;
+    append_silence(rs, lead);  /* always room; see __Sound_CreateResampler(). */
+    rs->pos = lead;
+} /* __Sound_ResetResampler */
+
+
+bool __Sound_PutResampler(Sound_Resampler *rs, const float *input, Uint32 frames)
+{
+    const int channels = rs->channels;
+    Uint32 i;
+    int c;
+
+    if (rs->flushed || (frames == 0))
+        return true;
+    else if (!reserve_history(rs, frames))
+        return false;
+
+    for (c = 0; c < channels; c++)
+    {
+        float *row = rs->history + (c * rs->capacity) + rs->frames;
+        const float *src = input + c;
+        for (i = 0; i < frames; i++, src += channels)
+            row[i] = *src;
+    } /* for */
+
+    rs->frames += frames;
+    return true;
+} /* __Sound_PutResampler */
+
+
+void __Sound_FlushResampler(Sound_Resampler *rs)
+{
+    if (!rs->flushed)
+    {
+        /* output stops at the last real frame; the filter runs over silence. */
+        rs->end = rs->frames;
+        if (reserve_history(rs, rs->taps / 2))
+            append_silence(rs, rs->taps / 2);
+        else
+            rs->end = (rs->frames > (rs->taps / 2)) ? (rs->frames - (rs->taps / 2)) : 0;
+        rs->flushed = true;
+    } /* if */
+} /* __Sound_FlushResampler */
+
+
+Uint32 __Sound_ResamplerInputNeeded(const Sound_Resampler *rs, Uint32 frames)
+{
+    Uint64 last, needed;
+
+    if (rs->flushed || (frames == 0))
+        return 0;
+
+    /* where the last of those output frames lands, and the input past it. */
+    last = ((Uint64) rs->pos) + (((Uint64) (frames - 1)) * rs->step) +
+           ((((Uint64) rs->frac) + (((Uint64) (frames - 1)) * rs->step_frac)) / rs->phases);
+    needed = last + (rs->taps / 2) + 1;
+    if (needed <= rs->frames)
+        return 0;
+    needed -= rs->frames;
+    return (Uint32) SDL_min(needed, (Uint64) 0x7FFFFFFF);
+} /* __Sound_ResamplerInputNeeded */
+
+
+Uint32 __Sound_GetResampled(Sound_Resampler *rs, float *output, Uint32 frames)
+{
+    const int channels = rs->channels;
+    const Uint32 half = rs->taps / 2;
+    const float scale = 1.0f / (float) rs->phases;
+    Uint32 discard;
+    Uint32 i;
+    int c;
+
+    for (i = 0; i < frames; i++, output += channels)
+    {
+        if ((rs->pos + half) >= rs->frames)
+            break;  /* need more input. */
+        else if (rs->flushed && (rs->pos >= rs->end))
+            break;  /* all done. */
+
+        if (rs->filters != NULL)
+        {
+            const float *filter = rs->filters + (rs->frac * rs->taps);
+            const float *in = rs->history + (rs->pos - (half - 1));
+            for (c = 0; c < channels; c++, in += rs->capacity)
+                output[c] = rs->dot(in, filter, rs->taps);
+        } /* if */
+        else
+        {
+            const float weight = ((float) rs->frac) * scale;
+            const float *in = rs->history + rs->pos;
+            for (c = 0; c < channels; c++, in += rs->capacity)
+                output[c] = in[0] + ((in[1] - in[0]) * weight);
+        } /* else */
+
+        rs->pos += rs->step;
+        rs->frac += rs->step_frac;
+        if (rs->frac >= rs->phases)
+        {
+            rs->frac -= rs->phases;
+            rs->pos++;
+        } /* if */
+    } /* for */
+
+    /* drop input that no output frame will need again. */
+    discard = (rs->pos > (half - 1)) ? SDL_min(rs->pos - (half - 1), rs->frames) : 0;
+    if (discard > 0)
+    {
+        for (c = 0; c < channels; c++)
+        {
+            float *row = rs->history + (c * rs->capacity);
+            SDL_memmove(row, row + discard, (rs->frames - discard) * sizeof (float));
+        } /* for */
+        rs->frames -= discard;
+        rs->pos -= discard;
+        if (rs->flushed)
+            rs->end -= SDL_min(discard, rs->end);
+    } /* if */
+
+    return i;
+} /* __Sound_GetResampled */
+
+/* end of SDL_sound_resample.c ... */
+
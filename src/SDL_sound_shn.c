@@ -35,6 +35,24 @@
 
 #define SHN_BUFSIZ  512
 
+/* a seek point about every 1.5 seconds of CD audio. */
+#define SHN_SEEK_POINT_INTERVAL  65536
+
+/*
+ * Everything it takes to pick up decoding at the start of a block: where
+ *  the bitstream is, and the block size and shift in effect. What the
+ *  predictors remember of earlier blocks goes in shn_t::seek_state.
+ */
+typedef struct
+{
+    Uint64 frame;
+    Sint64 pos;         /* stream offset of the next byte we haven't read. */
+    Uint32 gbuffer;
+    Sint32 nbitget;
+    Sint32 blocksize;
+    Sint32 bitshift;
+} shn_seek_point;
+
 typedef struct
 {
     Sint32 version;
@@ -58,6 +76,14 @@ typedef struct
     Uint32 backBufferSize;
     Uint32 backBufLeft;
     Sint64 start_pos;
+    Uint64 frame;               /* frames decoded, through the last block. */
+    Uint64 total_frames;        /* only valid once scan_done is set. */
+    shn_seek_point *seek_points;
+    Sint32 *seek_state;         /* (statesize) Sint32s per seek point. */
+    Uint32 statesize;
+    Uint32 seek_point_count;
+    Uint32 seek_point_capacity;
+    bool scan_done;             /* seek_points reaches the end of the stream. */
 } shn_t;
 
 
@@ -533,6 +559,55 @@ static SDL_INLINE int parse_riff_header(shn_t *shn, Sound_Sample *sample)
 } /* parse_riff_header */
 
 
+/*
+ * Remember how to restart decoding from right here, which has to be between
+ *  blocks (after the last channel's block, and before the next command).
+ */
+static int shn_add_seek_point(Sound_Sample *sample, shn_t *shn)
+{
+    SDL_IOStream *io = ((Sound_SampleInternal *) sample->opaque)->io;
+    const Sint64 pos = SDL_TellIO(io);
+    const Sint32 nmean = MAX_MACRO(1, shn->nmean);
+    shn_seek_point *point;
+    Sint32 *state;
+    int chan;
+
+    BAIL_IF_MACRO(pos < 0, ERR_IO_ERROR, 0);
+
+    if (shn->seek_point_count == shn->seek_point_capacity)
+    {
+        const Uint32 newcap = shn->seek_point_capacity ? (shn->seek_point_capacity * 2) : 64;
+        void *ptr = SDL_realloc(shn->seek_points, newcap * sizeof (shn_seek_point));
+        BAIL_IF_MACRO(ptr == NULL, ERR_OUT_OF_MEMORY, 0);
+        shn->seek_points = (shn_seek_point *) ptr;
+        ptr = SDL_realloc(shn->seek_state, newcap * shn->statesize * sizeof (Sint32));
+        BAIL_IF_MACRO(ptr == NULL, ERR_OUT_OF_MEMORY, 0);
+        shn->seek_state = (Sint32 *) ptr;
+        shn->seek_point_capacity = newcap;
+    } /* if */
+
+    point = &shn->seek_points[shn->seek_point_count];
+    point->frame = shn->frame;
+    point->pos = pos - shn->nbyteget;  /* the rest of getbuf is still to come. */
+    point->gbuffer = shn->gbuffer;
+    point->nbitget = shn->nbitget;
+    point->blocksize = shn->blocksize;
+    point->bitshift = shn->bitshift;
+
+    state = shn->seek_state + (shn->seek_point_count * shn->statesize);
+    for (chan = 0; chan < shn->nchan; chan++)
+    {
+        SDL_memcpy(state, shn->buffer[chan] - shn->nwrap, shn->nwrap * sizeof (Sint32));
+        state += shn->nwrap;
+        SDL_memcpy(state, shn->offset[chan], nmean * sizeof (Sint32));
+        state += nmean;
+    } /* for */
+
+    shn->seek_point_count++;
+    return 1;
+} /* shn_add_seek_point */
+
+
 static int SHN_open(Sound_Sample *sample, const char *ext)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
@@ -615,6 +690,11 @@ static int SHN_open(Sound_Sample *sample, const char *ext)
 
     shn->start_pos = SDL_TellIO(io);
 
+    /* the first seek point is the start, which is also how we rewind. */
+    shn->statesize = (Uint32) (shn->nchan * (shn->nwrap + MAX_MACRO(1, shn->nmean)));
+    if (!shn_add_seek_point(sample, shn))
+        goto shn_open_puke;
+
     shn = (shn_t *) SDL_malloc(sizeof (shn_t));
     if (shn == NULL)
     {
@@ -626,12 +706,16 @@ static int SHN_open(Sound_Sample *sample, const char *ext)
     internal->decoder_private = shn;
 
     SNDDBG(("SHN: Accepting data stream.\n"));
-    sample->flags = SOUND_SAMPLEFLAG_NONE;
+    sample->flags = SOUND_SAMPLEFLAG_CANSEEK;
     return 1; /* we'll handle this data. */
 
 shn_open_puke:
     if (_shn.getbuf)
         SDL_free(_shn.getbuf);
+    if (_shn.seek_points != NULL)
+        SDL_free(_shn.seek_points);
+    if (_shn.seek_state != NULL)
+        SDL_free(_shn.seek_state);
     if (_shn.buffer != NULL)
         SDL_free(_shn.buffer);
     if (_shn.offset != NULL)
@@ -695,6 +779,12 @@ static void SHN_close(Sound_Sample *sample)
     if (shn->getbuf != NULL)
         SDL_free(shn->getbuf);
 
+    if (shn->seek_points != NULL)
+        SDL_free(shn->seek_points);
+
+    if (shn->seek_state != NULL)
+        SDL_free(shn->seek_state);
+
     SDL_free(shn);
 } /* SHN_close */
 
@@ -812,7 +902,7 @@ static Uint8 Slinear2alaw(Sint32 linear)
 
 
 /* convert from signed ints to a given type and write */
-static Uint32 put_to_buffers(Sound_Sample *sample, Uint32 bw)
+static Uint32 put_to_buffers(Sound_Sample *sample, Uint8 *buf, Uint32 buflen, Uint32 bw)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     shn_t *shn = (shn_t *) internal->decoder_private;
@@ -1002,17 +1092,18 @@ static Uint32 put_to_buffers(Sound_Sample *sample, Uint32 bw)
         break;
     } /* switch */
 
-    i = MIN_MACRO(internal->buffer_size - bw, bsiz);
-    SDL_memcpy((char *)internal->buffer + bw, shn->backBuffer, i);
+    i = MIN_MACRO(buflen - bw, bsiz);
+    SDL_memcpy(buf + bw, shn->backBuffer, i);
     shn->backBufLeft = bsiz - i;
-    SDL_memcpy(shn->backBuffer, shn->backBuffer + i, shn->backBufLeft);
+    SDL_memmove(shn->backBuffer, shn->backBuffer + i, shn->backBufLeft);
     return i;
 } /* put_to_buffers */
 
 
 #define ROUNDEDSHIFTDOWN(x, n) (((n) == 0) ? (x) : ((x) >> ((n) - 1)) >> 1)
 
-static Uint32 SHN_read(Sound_Sample *sample)
+/* decode (len) bytes into (buf), or as many as there are before EOF. */
+static Uint32 shn_decode(Sound_Sample *sample, Uint8 *buf, Uint32 len)
 {
     Uint32 retval = 0;
     Sint32 chan = 0;
@@ -1024,16 +1115,16 @@ static Uint32 SHN_read(Sound_Sample *sample)
         /* see if there are leftovers to copy... */
     if (shn->backBufLeft > 0)
     {
-        retval = MIN_MACRO(shn->backBufLeft, internal->buffer_size);
-        SDL_memcpy(internal->buffer, shn->backBuffer, retval);
+        retval = MIN_MACRO(shn->backBufLeft, len);
+        SDL_memcpy(buf, shn->backBuffer, retval);
         shn->backBufLeft -= retval;
-        SDL_memcpy(shn->backBuffer, shn->backBuffer + retval, shn->backBufLeft);
+        SDL_memmove(shn->backBuffer, shn->backBuffer + retval, shn->backBufLeft);
     } /* if */
 
-    SDL_assert((shn->backBufLeft == 0) || (retval == internal->buffer_size));
+    SDL_assert((shn->backBufLeft == 0) || (retval == len));
 
     /* get commands from file and execute them */
-    while (retval < internal->buffer_size)
+    while (retval < len)
     {
         if (!uvar_get(SHN_FNSIZE, shn, io, &cmd))
         {
@@ -1043,6 +1134,9 @@ static Uint32 SHN_read(Sound_Sample *sample)
 
         if (cmd == SHN_FN_QUIT)
         {
+            /* we've decoded every block in order from a seek point to get here. */
+            shn->total_frames = shn->frame;
+            shn->scan_done = true;
             sample->flags |= SOUND_SAMPLEFLAG_EOF;
             return retval;
         } /* if */
@@ -1210,9 +1304,15 @@ static Uint32 SHN_read(Sound_Sample *sample)
 
                 if (chan == shn->nchan - 1)
                 {
-                    retval += put_to_buffers(sample, retval);
+                    retval += put_to_buffers(sample, buf, len, retval);
                     if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
                         return retval;
+
+                    /* past the last seek point? Note another. (If this fails, there's just a longer gap.) */
+                    shn->frame += shn->blocksize;
+                    if ( (!shn->scan_done) &&
+                         (shn->frame >= shn->seek_points[shn->seek_point_count - 1].frame + SHN_SEEK_POINT_INTERVAL) )
+                        shn_add_seek_point(sample, shn);
                 } /* if */
 
                 chan = (chan + 1) % shn->nchan;
@@ -1244,43 +1344,282 @@ static Uint32 SHN_read(Sound_Sample *sample)
     } /* while */
 
     return retval;
+} /* shn_decode */
+
+
+static Uint32 SHN_read(Sound_Sample *sample)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    return shn_decode(sample, (Uint8 *) internal->buffer, internal->buffer_size);
 } /* SHN_read */
 
 
+/* put the decoder back the way it was at seek point (idx). */
+static int shn_restore_seek_point(Sound_Sample *sample, shn_t *shn, Uint32 idx)
+{
+    SDL_IOStream *io = ((Sound_SampleInternal *) sample->opaque)->io;
+    const shn_seek_point *point = &shn->seek_points[idx];
+    const Sint32 *state = shn->seek_state + (idx * shn->statesize);
+    const Sint32 nmean = MAX_MACRO(1, shn->nmean);
+    int chan;
+
+    BAIL_IF_MACRO(SDL_SeekIO(io, point->pos, SDL_IO_SEEK_SET) != point->pos, ERR_IO_ERROR, 0);
+
+    shn->getbufp = shn->getbuf;
+    shn->nbyteget = 0;
+    shn->gbuffer = point->gbuffer;
+    shn->nbitget = point->nbitget;
+    shn->blocksize = point->blocksize;
+    shn->bitshift = point->bitshift;
+    shn->backBufLeft = 0;
+    shn->frame = point->frame;
+
+    for (chan = 0; chan < shn->nchan; chan++)
+    {
+        SDL_memcpy(shn->buffer[chan] - shn->nwrap, state, shn->nwrap * sizeof (Sint32));
+        state += shn->nwrap;
+        SDL_memcpy(shn->offset[chan], state, nmean * sizeof (Sint32));
+        state += nmean;
+    } /* for */
+
+    return 1;
+} /* shn_restore_seek_point */
+
+
+/*
+ * Go to (offset) bytes into the output: back up to the last seek point
+ *  before it, and decode the rest of the way. Past the last seek point
+ *  we know of, that decodes new ground, which notes more seek points.
+ */
+static int shn_seek_bytes(Sound_Sample *sample, shn_t *shn, Uint64 offset)
+{
+    const Uint32 framesize = SDL_AUDIO_FRAMESIZE(sample->actual);
+    Uint8 scratch[4096];
+    Uint32 lo = 0;
+    Uint32 hi = shn->seek_point_count;
+    Uint32 rc;
+
+    while ((hi - lo) > 1)
+    {
+        const Uint32 mid = lo + ((hi - lo) / 2);
+        if ((shn->seek_points[mid].frame * framesize) <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    } /* while */
+
+    BAIL_IF_MACRO(!shn_restore_seek_point(sample, shn, lo), NULL, 0);
+    offset -= shn->seek_points[lo].frame * framesize;
+
+    while (offset > 0)
+    {
+        const Uint32 len = (Uint32) SDL_min(offset, sizeof (scratch));
+        rc = shn_decode(sample, scratch, len);
+        if (rc < len)
+        {
+            BAIL_IF_MACRO(sample->flags & SOUND_SAMPLEFLAG_EOF, ERR_PAST_EOF, 0);
+            BAIL_MACRO(ERR_IO_ERROR, 0);
+        } /* if */
+        offset -= rc;
+    } /* while */
+
+    return 1;
+} /* shn_seek_bytes */
+
+
+/*
+ * Decode to the end of the stream, if we haven't yet, so there are seek
+ *  points all the way through, then go back to where we were.
+ */
+static int shn_scan(Sound_Sample *sample, shn_t *shn)
+{
+    const Uint32 framesize = SDL_AUDIO_FRAMESIZE(sample->actual);
+    const Uint64 here = (shn->frame * framesize) - shn->backBufLeft;
+    const Uint32 origflags = sample->flags;
+    Uint8 scratch[4096];
+    int retval = 1;
+
+    if (shn->scan_done)
+        return 1;
+
+    if (!shn_restore_seek_point(sample, shn, shn->seek_point_count - 1))
+        retval = 0;
+
+    while ((retval) && (!shn->scan_done))
+    {
+        shn_decode(sample, scratch, sizeof (scratch));
+        if ((sample->flags & SOUND_SAMPLEFLAG_ERROR) && (!shn->scan_done))
+        {
+            __Sound_SetError(ERR_IO_ERROR);
+            retval = 0;
+        } /* if */
+    } /* while */
+
+    sample->flags = origflags;
+    if (!shn_seek_bytes(sample, shn, here))
+    {
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        retval = 0;
+    } /* if */
+
+    return retval;
+} /* shn_scan */
+
+
 static int SHN_rewind(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-
-#if 0
     shn_t *shn = (shn_t *) internal->decoder_private;
-    Sint64 rc = SDL_SeekIO(internal->io, shn->start_pos, SDL_IO_SEEK_SET);
-    BAIL_IF_MACRO(rc != shn->start_pos, ERR_IO_ERROR, 0);
-    /* !!! FIXME: set state. */
-    return 1;
-#else
-    /*
-     * !!! FIXME: This is really unacceptable; state should be reset and
-     * !!! FIXME:  the SDL_IOStream should be pointed to the start of the data
-     * !!! FIXME:  to decode. The below kludge adds unneeded overhead and
-     * !!! FIXME:  risk of failure.
-     */
-    BAIL_IF_MACRO(SDL_SeekIO(internal->io, 0, SDL_IO_SEEK_SET) != 0, ERR_IO_ERROR, 0);
-    SHN_close(sample);
-    return SHN_open(sample, "SHN");
-#endif
+    return shn_restore_seek_point(sample, shn, 0);
 } /* SHN_rewind */
 
 
+static int SHN_seek_frame(Sound_Sample *sample, Uint64 frame)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    shn_t *shn = (shn_t *) internal->decoder_private;
+    return shn_seek_bytes(sample, shn, frame * SDL_AUDIO_FRAMESIZE(sample->actual));
+} /* SHN_seek_frame */
+
+
 static int SHN_seek(Sound_Sample *sample, Uint32 ms)
 {
-    /*
-     * (This CAN be done for SHNs that have a seek table at the end of the
-     *  stream, btw.)
-     */
-    BAIL_MACRO("SHN: Seeking not implemented", 0);
+    return SHN_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* SHN_seek */
 
 
+/*
+ * The seek index is the stream's length, then every seek point and the
+ *  predictor state that goes with it, all little endian:
+ *
+ *  Uint64 total_frames; Uint32 count; Uint32 statesize;
+ *  count * { Uint64 frame; Uint64 pos; Uint32 gbuffer; Uint32 nbitget;
+ *            Uint32 blocksize; Uint32 bitshift; Uint32 state[statesize]; }
+ */
+#define SHN_INDEX_HEADER_SIZE 16
+#define SHN_INDEX_POINT_SIZE 32
+
+static Uint32 SHN_save_index(Sound_Sample *sample, Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    shn_t *shn = (shn_t *) internal->decoder_private;
+    const Uint32 pointsize = SHN_INDEX_POINT_SIZE + (shn->statesize * 4);
+    Uint32 retval;
+    Uint32 i, j;
+
+    if (!shn_scan(sample, shn))
+        return 0;
+
+    BAIL_IF_MACRO(shn->seek_point_count > ((0xFFFFFFFF - SHN_INDEX_HEADER_SIZE) / pointsize), ERR_OUT_OF_MEMORY, 0);
+    retval = SHN_INDEX_HEADER_SIZE + (shn->seek_point_count * pointsize);
+    if ((buf != NULL) && (len >= retval))
+    {
+        const Sint32 *state = shn->seek_state;
+        buf = __Sound_IndexPut64(buf, shn->total_frames);
+        buf = __Sound_IndexPut32(buf, shn->seek_point_count);
+        buf = __Sound_IndexPut32(buf, shn->statesize);
+        for (i = 0; i < shn->seek_point_count; i++)
+        {
+            const shn_seek_point *point = &shn->seek_points[i];
+            buf = __Sound_IndexPut64(buf, point->frame);
+            buf = __Sound_IndexPut64(buf, (Uint64) point->pos);
+            buf = __Sound_IndexPut32(buf, point->gbuffer);
+            buf = __Sound_IndexPut32(buf, (Uint32) point->nbitget);
+            buf = __Sound_IndexPut32(buf, (Uint32) point->blocksize);
+            buf = __Sound_IndexPut32(buf, (Uint32) point->bitshift);
+            for (j = 0; j < shn->statesize; j++)
+                buf = __Sound_IndexPut32(buf, (Uint32) *(state++));
+        } /* for */
+    } /* if */
+
+    return retval;
+} /* SHN_save_index */
+
+
+static int SHN_load_index(Sound_Sample *sample, const Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    shn_t *shn = (shn_t *) internal->decoder_private;
+    const Uint32 pointsize = SHN_INDEX_POINT_SIZE + (shn->statesize * 4);
+    const Sint64 end = SDL_GetIOSize(internal->io);
+    shn_seek_point *points;
+    Sint32 *states;
+    Uint64 total_frames;
+    Uint32 count, i, j;
+
+    BAIL_IF_MACRO(len < SHN_INDEX_HEADER_SIZE, ERR_CORRUPT_SEEK_INDEX, 0);
+    total_frames = __Sound_IndexGet64(buf);
+    count = __Sound_IndexGet32(buf + 8);
+    BAIL_IF_MACRO(__Sound_IndexGet32(buf + 12) != shn->statesize, ERR_WRONG_SEEK_INDEX, 0);
+    buf += SHN_INDEX_HEADER_SIZE;
+    BAIL_IF_MACRO(count == 0, ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(count > ((len - SHN_INDEX_HEADER_SIZE) / pointsize), ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(len != SHN_INDEX_HEADER_SIZE + (count * pointsize), ERR_CORRUPT_SEEK_INDEX, 0);
+
+    points = (shn_seek_point *) SDL_malloc(count * sizeof (shn_seek_point));
+    BAIL_IF_MACRO(!points, ERR_OUT_OF_MEMORY, 0);
+    states = (Sint32 *) SDL_malloc(count * shn->statesize * sizeof (Sint32));
+    if (!states)
+    {
+        SDL_free(points);
+        BAIL_MACRO(ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    for (i = 0; i < count; i++)
+    {
+        shn_seek_point *point = &points[i];
+        Sint32 *state = states + (i * shn->statesize);
+        point->frame = __Sound_IndexGet64(buf);
+        point->pos = (Sint64) __Sound_IndexGet64(buf + 8);
+        point->gbuffer = __Sound_IndexGet32(buf + 16);
+        point->nbitget = (Sint32) __Sound_IndexGet32(buf + 20);
+        point->blocksize = (Sint32) __Sound_IndexGet32(buf + 24);
+        point->bitshift = (Sint32) __Sound_IndexGet32(buf + 28);
+        buf += SHN_INDEX_POINT_SIZE;
+        for (j = 0; j < shn->statesize; j++, buf += 4)
+            state[j] = (Sint32) __Sound_IndexGet32(buf);
+
+        /*
+         * The first point is where open() left off, which we know exactly.
+         *  The rest have to at least be in order, inside the stream, and
+         *  not overrun the buffers open() sized for the first block size.
+         */
+        if ( ((i == 0) && ( (SDL_memcmp(point, &shn->seek_points[0], sizeof (*point)) != 0) ||
+                            (SDL_memcmp(state, shn->seek_state, shn->statesize * sizeof (Sint32)) != 0) )) ||
+             ((i > 0) && ( (point->frame <= points[i-1].frame) || (point->pos < points[i-1].pos) )) ||
+             (point->frame > total_frames) ||
+             ((end >= 0) && (point->pos > end)) ||
+             (point->nbitget < 0) || (point->nbitget > 32) ||
+             (point->blocksize <= 0) || (point->blocksize > shn->seek_points[0].blocksize) ||
+             (point->bitshift < 0) || (point->bitshift >= (Sint32) SDL_arraysize(ulaw_outward)) )
+        {
+            SDL_free(points);
+            SDL_free(states);
+            BAIL_MACRO(ERR_WRONG_SEEK_INDEX, 0);
+        } /* if */
+    } /* for */
+
+    SDL_free(shn->seek_points);
+    SDL_free(shn->seek_state);
+    shn->seek_points = points;
+    shn->seek_state = states;
+    shn->seek_point_count = shn->seek_point_capacity = count;
+    shn->total_frames = total_frames;
+    shn->scan_done = true;
+    return 1;
+} /* SHN_load_index */
+
+
+/*
+ * Without an explicit "SHN" extension, open() only looks for the magic
+ *  number at the start of the stream, so that's all we check here, too.
+ */
+static int SHN_probe(const Uint8 *header, Uint32 len)
+{
+    return ((len >= 4) && (SDL_memcmp(header, "ajkg", 4) == 0));
+} /* SHN_probe */
+
+
 static const char *extensions_shn[] = { "SHN", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_SHN =
 {
@@ -1297,7 +1636,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_SHN =
     SHN_close,      /*  close() method */
     SHN_read,       /*   read() method */
     SHN_rewind,     /* rewind() method */
-    SHN_seek        /*   seek() method */
+    SHN_seek,       /*   seek() method */
+    SHN_seek_frame, /* seek_frame() method */
+    SHN_probe,      /*  probe() method */
+    NULL,           /* duration() method */
+    SHN_save_index, /* save_index() method */
+    SHN_load_index  /* load_index() method */
 };
 
 #endif  /* defined SOUND_SUPPORTS_SHN */
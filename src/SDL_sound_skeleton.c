@@ -107,7 +107,7 @@ static int FMT_rewind(Sound_Sample *sample)
 } /* FMT_rewind */
 
 
-static int FMT_seek(Sound_Sample *sample, Uint32 ms)
+static int FMT_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
 
@@ -117,9 +117,25 @@ static int FMT_seek(Sound_Sample *sample, Uint32 ms)
     // (set state as necessary.)
 
     return 1;  /* success. */
+} /* FMT_seek_frame */
+
+
+static int FMT_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return FMT_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* FMT_seek */
 
 
+static int FMT_probe(const Uint8 *header, Uint32 len)
+{
+    /*
+     * Return non-zero if (header) could plausibly be FMT data, without
+     *  reading from the stream. Return zero if it definitely isn't.
+     */
+    return ((len >= 4) && (SDL_memcmp(header, "FMT!", 4) == 0));
+} /* FMT_probe */
+
+
 static const char *extensions_fmt[] = { "FMT", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_FMT =
 {
@@ -136,7 +152,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_FMT =
     FMT_close,      /*  close() method */
     FMT_read,       /*   read() method */
     FMT_rewind,     /* rewind() method */
-    FMT_seek        /*   seek() method */
+    FMT_seek,       /*   seek() method */
+    FMT_seek_frame, /* seek_frame() method */
+    FMT_probe,      /*  probe() method */
+    NULL,           /* duration() method */
+    NULL,           /* save_index() method */
+    NULL            /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_FMT */
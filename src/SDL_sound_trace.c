@@ -0,0 +1,348 @@
+/**
+ * SDL_sound; An abstract sound format decoding API.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/**
+ * This file implements the tracing hooks, and the built-in sink that writes
+ *  them out in Chrome's trace event format (the JSON array flavor), which
+ *  Perfetto and chrome://tracing can both load.
+ *
+ * Documentation is in SDL_sound.h ... It's verbose, honest.  :)
+ */
+
+#define __SDL_SOUND_INTERNAL__
+#include "SDL_sound_internal.h"
+
+/* the app's callback. trace_enabled lets us skip the lock when it's NULL. */
+static SDL_AtomicInt trace_enabled;
+static SDL_SpinLock trace_lock = 0;
+static Sound_TraceCallback trace_callback = NULL;
+static void *trace_userdata = NULL;
+
+
+void Sound_SetTraceCallback(Sound_TraceCallback callback, void *userdata)
+{
+    SDL_LockSpinlock(&trace_lock);
+    trace_callback = callback;
+    trace_userdata = userdata;
+    SDL_UnlockSpinlock(&trace_lock);
+    SDL_SetAtomicInt(&trace_enabled, (callback != NULL) ? 1 : 0);
+} /* Sound_SetTraceCallback */
+
+
+void __Sound_Trace(Sound_TraceEvent event, bool begin, Sound_Sample *sample)
+{
+    Sound_TraceCallback callback;
+    void *userdata;
+
+    if (!SDL_GetAtomicInt(&trace_enabled))
+        return;  /* the usual case; nobody's listening. */
+
+    SDL_LockSpinlock(&trace_lock);
+    callback = trace_callback;
+    userdata = trace_userdata;
+    SDL_UnlockSpinlock(&trace_lock);
+
+    /* decode-ahead workers decode with a copy; report the app's sample. */
+    if ((sample != NULL) && (sample->opaque != NULL))
+        sample = ((Sound_SampleInternal *) sample->opaque)->owner;
+
+    if (callback != NULL)
+        callback(userdata, event, begin, sample, SDL_GetTicksNS());
+} /* __Sound_Trace */
+
+
+
+/*
+ * The Chrome trace sink. Events are formatted into a buffer, which is
+ *  written to the stream when it fills up, so most events don't touch the
+ *  disk. The buffer state is protected by chrome_lock; chrome_io is NULL
+ *  when there's no trace running.
+ *
+ * The write itself happens outside chrome_lock, so other threads don't spin
+ *  on it while the disk catches up: the thread that fills the buffer swaps
+ *  in the spare one and writes out the full one, holding chrome_write_lock.
+ *  Only one buffer is out being written at a time (chrome_spare is NULL
+ *  until it comes back), so the file stays in order; if the buffer fills
+ *  again before then, it just grows.
+ */
+
+#define CHROME_TRACE_BUFFER_SIZE (64 * 1024)
+
+static SDL_SpinLock chrome_lock = 0;
+static SDL_Mutex *chrome_write_lock = NULL;  /* held while writing to chrome_io. */
+static SDL_IOStream *chrome_io = NULL;
+static bool chrome_closeio = false;
+static bool chrome_failed = false;  /* a write went wrong at some point. */
+static bool chrome_first = true;  /* no comma before the first event. */
+static char *chrome_buffer = NULL;
+static size_t chrome_buflen = 0;
+static size_t chrome_bufcap = 0;
+static char *chrome_spare = NULL;  /* NULL while it's being written out. */
+static size_t chrome_sparecap = 0;
+
+
+static const char *trace_event_name(Sound_TraceEvent event)
+{
+    switch (event)
+    {
+        case SOUND_TRACE_NEWSAMPLE: return "Sound_NewSample";
+        case SOUND_TRACE_OPEN: return "open";
+        case SOUND_TRACE_READ: return "read";
+        case SOUND_TRACE_SEEK: return "seek";
+        case SOUND_TRACE_REWIND: return "rewind";
+        case SOUND_TRACE_STREAM_PUT: return "SDL_PutAudioStreamData";
+        case SOUND_TRACE_STREAM_GET: return "SDL_GetAudioStreamData";
+    } /* switch */
+
+    return "unknown";
+} /* trace_event_name */
+
+
+/*
+ * Make room for (len) more bytes in chrome_buffer. Call with chrome_lock
+ *  held. If it's time to write the buffer out, this swaps in the spare,
+ *  takes chrome_write_lock, and returns the full one in (*out), for the
+ *  caller to write with chrome_write_out() once it lets go of chrome_lock.
+ */
+static bool chrome_reserve(size_t len, char **out, size_t *outlen, size_t *outcap)
+{
+    if (chrome_buflen + len <= chrome_bufcap)
+        return true;
+
+    /* the spare is back and nobody is writing: send this one out. */
+    if ((chrome_spare != NULL) && (chrome_bufcap >= len) && SDL_TryLockMutex(chrome_write_lock))
+    {
+        *out = chrome_buffer;
+        *outlen = chrome_buflen;
+        *outcap = chrome_bufcap;
+        chrome_buffer = chrome_spare;
+        chrome_bufcap = chrome_sparecap;
+        chrome_buflen = 0;
+        chrome_spare = NULL;
+        chrome_sparecap = 0;
+        return true;
+    } /* if */
+
+    /* the other one is still out (or this is a huge event); grow. */
+    {
+        const size_t newcap = SDL_max(chrome_bufcap * 2, chrome_buflen + len);
+        char *ptr = (char *) SDL_realloc(chrome_buffer, newcap);
+        if (ptr == NULL)
+            return false;
+        chrome_buffer = ptr;
+        chrome_bufcap = newcap;
+    } /* block */
+
+    return true;
+} /* chrome_reserve */
+
+
+/* write out a buffer chrome_reserve() handed us, and give it back. */
+static void chrome_write_out(SDL_IOStream *io, SDL_Mutex *write_lock,
+                             char *buf, size_t buflen, size_t bufcap)
+{
+    const bool failed = (SDL_WriteIO(io, buf, buflen) != buflen);
+
+    /* put it back before letting go of the write lock, so a stop finds it. */
+    SDL_LockSpinlock(&chrome_lock);
+    if (failed)
+        chrome_failed = true;
+    chrome_spare = buf;
+    chrome_sparecap = bufcap;
+    SDL_UnlockSpinlock(&chrome_lock);
+
+    SDL_UnlockMutex(write_lock);  /* not chrome_write_lock; a stop clears that. */
+} /* chrome_write_out */
+
+
+static void SDLCALL chrome_trace_callback(void *userdata,
+                                          Sound_TraceEvent event,
+                                          bool begin,
+                                          Sound_Sample *sample,
+                                          Uint64 timestamp_ns)
+{
+    const char *decoder = "";
+    SDL_IOStream *io = NULL;
+    SDL_Mutex *write_lock = NULL;
+    char *out = NULL;
+    size_t outlen = 0;
+    size_t outcap = 0;
+    char line[256];
+    int len;
+
+    if ((sample != NULL) && (sample->decoder != NULL))
+        decoder = sample->decoder->extensions[0];  /* plain ASCII, no escaping needed. */
+
+    /* Durations are "B"egin and "E"nd pairs, matched up per thread. */
+    if (begin)
+    {
+        len = SDL_snprintf(line, sizeof (line),
+                "{\"name\":\"%s\",\"cat\":\"SDL_sound\",\"ph\":\"B\","
+                "\"ts\":%" SDL_PRIu64 ".%03u,\"pid\":1,\"tid\":%" SDL_PRIu64 ","
+                "\"args\":{\"decoder\":\"%s\",\"sample\":\"%p\"}}",
+                trace_event_name(event), timestamp_ns / 1000,
+                (unsigned int) (timestamp_ns % 1000),
+                (Uint64) SDL_GetCurrentThreadID(), decoder, (void *) sample);
+    } /* if */
+    else
+    {
+        len = SDL_snprintf(line, sizeof (line),
+                "{\"name\":\"%s\",\"cat\":\"SDL_sound\",\"ph\":\"E\","
+                "\"ts\":%" SDL_PRIu64 ".%03u,\"pid\":1,\"tid\":%" SDL_PRIu64 "}",
+                trace_event_name(event), timestamp_ns / 1000,
+                (unsigned int) (timestamp_ns % 1000),
+                (Uint64) SDL_GetCurrentThreadID());
+    } /* else */
+
+    if ((len <= 0) || (len >= (int) sizeof (line)))
+        return;  /* shouldn't happen. */
+
+    SDL_LockSpinlock(&chrome_lock);
+    if (chrome_io != NULL)  /* trace might have stopped while we got here. */
+    {
+        io = chrome_io;
+        write_lock = chrome_write_lock;
+        if (!chrome_reserve(len + 2, &out, &outlen, &outcap))
+            chrome_failed = true;  /* out of memory; lose this one. */
+        else
+        {
+            if (!chrome_first)
+            {
+                chrome_buffer[chrome_buflen++] = ',';
+                chrome_buffer[chrome_buflen++] = '\n';
+            } /* if */
+
+            SDL_memcpy(chrome_buffer + chrome_buflen, line, len);
+            chrome_buflen += len;
+            chrome_first = false;
+        } /* else */
+    } /* if */
+    SDL_UnlockSpinlock(&chrome_lock);
+
+    if (out != NULL)
+        chrome_write_out(io, write_lock, out, outlen, outcap);
+} /* chrome_trace_callback */
+
+
+int Sound_StartChromeTrace(SDL_IOStream *io, bool closeio)
+{
+    SDL_Mutex *write_lock;
+    char *buffer;
+    char *spare;
+
+    BAIL_IF_MACRO(io == NULL, ERR_INVALID_ARGUMENT, 0);
+
+    buffer = (char *) SDL_malloc(CHROME_TRACE_BUFFER_SIZE);
+    spare = (char *) SDL_malloc(CHROME_TRACE_BUFFER_SIZE);
+    write_lock = SDL_CreateMutex();
+    if (!buffer || !spare || !write_lock)
+    {
+        SDL_DestroyMutex(write_lock);
+        SDL_free(spare);
+        SDL_free(buffer);
+        if (closeio)
+            SDL_CloseIO(io);
+        BAIL_MACRO(ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    SDL_LockSpinlock(&chrome_lock);
+    if (chrome_io != NULL)
+    {
+        SDL_UnlockSpinlock(&chrome_lock);
+        SDL_DestroyMutex(write_lock);
+        SDL_free(spare);
+        SDL_free(buffer);
+        if (closeio)
+            SDL_CloseIO(io);
+        BAIL_MACRO(ERR_ALREADY_TRACING, 0);
+    } /* if */
+
+    chrome_io = io;
+    chrome_closeio = closeio;
+    chrome_failed = false;
+    chrome_first = true;
+    chrome_write_lock = write_lock;
+    chrome_buffer = buffer;
+    chrome_bufcap = CHROME_TRACE_BUFFER_SIZE;
+    chrome_buffer[0] = '[';
+    chrome_buffer[1] = '\n';
+    chrome_buflen = 2;
+    chrome_spare = spare;
+    chrome_sparecap = CHROME_TRACE_BUFFER_SIZE;
+    SDL_UnlockSpinlock(&chrome_lock);
+
+    Sound_SetTraceCallback(chrome_trace_callback, NULL);
+    return 1;
+} /* Sound_StartChromeTrace */
+
+
+int Sound_StopChromeTrace(void)
+{
+    static const char footer[] = "\n]\n";
+    SDL_Mutex *write_lock;
+    SDL_IOStream *io;
+    char *buffer;
+    size_t buflen;
+    bool closeio;
+    bool failed;
+
+    /* don't remove the app's callback if it replaced ours. */
+    SDL_LockSpinlock(&trace_lock);
+    if (trace_callback == chrome_trace_callback)
+    {
+        trace_callback = NULL;
+        trace_userdata = NULL;
+        SDL_SetAtomicInt(&trace_enabled, 0);
+    } /* if */
+    SDL_UnlockSpinlock(&trace_lock);
+
+    /* once chrome_io is NULL, the callback leaves the rest alone. */
+    SDL_LockSpinlock(&chrome_lock);
+    io = chrome_io;
+    write_lock = chrome_write_lock;
+    chrome_io = NULL;
+    chrome_write_lock = NULL;
+    SDL_UnlockSpinlock(&chrome_lock);
+
+    if (io == NULL)
+        return 1;  /* wasn't running; nothing to do. */
+
+    /* wait for a write that's already underway, if any. */
+    SDL_LockMutex(write_lock);
+    SDL_UnlockMutex(write_lock);
+    SDL_DestroyMutex(write_lock);
+
+    SDL_LockSpinlock(&chrome_lock);
+    buffer = chrome_buffer;
+    buflen = chrome_buflen;
+    failed = chrome_failed;
+    closeio = chrome_closeio;
+    SDL_free(chrome_spare);
+    chrome_buffer = chrome_spare = NULL;
+    chrome_buflen = chrome_bufcap = chrome_sparecap = 0;
+    SDL_UnlockSpinlock(&chrome_lock);
+
+    if ((buflen > 0) && (SDL_WriteIO(io, buffer, buflen) != buflen))
+        failed = true;
+    SDL_free(buffer);
+
+    if (SDL_WriteIO(io, footer, sizeof (footer) - 1) != sizeof (footer) - 1)
+        failed = true;
+
+    if (closeio)
+    {
+        if (!SDL_CloseIO(io))
+            failed = true;
+    } /* if */
+
+    BAIL_IF_MACRO(failed, ERR_IO_ERROR, 0);
+    return 1;
+} /* Sound_StopChromeTrace */
+
+/* end of SDL_sound_trace.c ... */
+
@@ -27,6 +27,13 @@
 
 #if SOUND_SUPPORTS_VOC
 
+/* Where a run of blocks starts, and how far into the output that is. */
+typedef struct
+{
+    Uint64  offset;         /* bytes of output before this point. */
+    Sint64  pos;            /* stream offset of the first block header. */
+} voc_seek_point;
+
 /* Private data for VOC file */
 typedef struct vocstuff {
     Uint32  rest;           /* bytes remaining in current block */
@@ -41,8 +48,14 @@ typedef struct vocstuff {
     Uint32  bufpos;         /* byte position in internal->buffer. */
     Sint64  start_pos;      /* offset to seek to in stream when rewinding. */
     int     error;          /* error condition (as opposed to EOF). */
+    voc_seek_point *seek_points;  /* filled in by voc_scan(). */
+    Uint32  seek_point_count;
+    bool    scan_done;      /* seek_points covers the whole stream. */
 } vs_t;
 
+/* a seek point every 64K of output, at the start of the block that has it. */
+#define VOC_SEEK_POINT_INTERVAL (64 * 1024)
+
 
 /* Size field */ 
 /* SJB: note that the 1st 3 are sometimes used as sizeof(type) */
@@ -146,9 +159,9 @@ static int voc_get_block(Sound_Sample *sample, vs_t *v)
     Uint32 bytes_per_second;
     int i;
 
-    v->silent = 0;
     while (v->rest == 0)
     {
+        v->silent = 0;  /* only once the last block is used up! */
         if (SDL_ReadIO(src, &block, sizeof (block)) != sizeof (block))
             return 1;  /* assume that's the end of the file. */
 
@@ -368,6 +381,7 @@ static int voc_read_waveform(Sound_Sample *sample, int fill_buf, Uint32 max)
 
         done = (Sint64) max;
         v->rest -= max;
+        v->bufpos += max;
     } /* if */
 
     else
@@ -444,7 +458,9 @@ static int VOC_open(Sound_Sample *sample, const char *ext)
 static void VOC_close(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    SDL_free(internal->decoder_private);
+    vs_t *v = (vs_t *) internal->decoder_private;
+    SDL_free(v->seek_points);
+    SDL_free(v);
 } /* VOC_close */
 
 
@@ -489,31 +505,170 @@ static int VOC_rewind(Sound_Sample *sample)
 } /* VOC_rewind */
 
 
-static int VOC_seek(Sound_Sample *sample, Uint32 ms)
+/*
+ * Walk every block header in the stream, without reading the waveforms, and
+ *  note where to start from to get to any point in the output. Like
+ *  duration(), this leaves the decoder and the stream just as it found them.
+ */
+static int voc_scan(Sound_Sample *sample, vs_t *v)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    SDL_IOStream *src = internal->io;
+    const Sint64 origpos = SDL_TellIO(src);
+    const SDL_AudioSpec origactual = sample->actual;
+    const Sint32 origtime = internal->total_time;
+    const vs_t origv = *v;   /* voc_get_block() scribbles all over this. */
+    voc_seek_point *points = NULL;
+    Uint32 count = 0;
+    Uint32 capacity = 0;
+    Uint64 offset = 0;
+    Uint64 last = 0;
+    Sint64 pos;
+    int retval = 1;
+
+    if (v->scan_done)
+        return 1;
+
+    BAIL_IF_MACRO(origpos < 0, ERR_IO_ERROR, 0);
+    BAIL_IF_MACRO(SDL_SeekIO(src, v->start_pos, SDL_IO_SEEK_SET) != v->start_pos, ERR_IO_ERROR, 0);
+
+    v->rest = 0;
+    v->extended = 0;
+    while (retval)
+    {
+        pos = SDL_TellIO(src);
+        if ((pos < 0) || (!voc_get_block(sample, v)))
+        {
+            __Sound_SetError(ERR_IO_ERROR);
+            retval = 0;
+        } /* if */
+        else if (v->rest == 0)
+            break;  /* that's the end of the data. */
+        else
+        {
+            if ((count == 0) || ((offset - last) >= VOC_SEEK_POINT_INTERVAL))
+            {
+                if (count == capacity)
+                {
+                    const Uint32 newcap = capacity ? (capacity * 2) : 16;
+                    void *ptr = SDL_realloc(points, newcap * sizeof (voc_seek_point));
+                    if (ptr == NULL)
+                    {
+                        __Sound_SetError(ERR_OUT_OF_MEMORY);
+                        retval = 0;
+                        break;
+                    } /* if */
+                    points = (voc_seek_point *) ptr;
+                    capacity = newcap;
+                } /* if */
+
+                points[count].offset = offset;
+                points[count].pos = pos;
+                count++;
+                last = offset;
+            } /* if */
+
+            offset += v->rest;
+            if ((!v->silent) && (SDL_SeekIO(src, v->rest, SDL_IO_SEEK_CUR) < 0))
+            {
+                __Sound_SetError(ERR_IO_ERROR);
+                retval = 0;
+            } /* if */
+            v->rest = 0;
+        } /* else */
+    } /* while */
+
+    *v = origv;
+    sample->actual = origactual;
+    internal->total_time = origtime;
+    if (SDL_SeekIO(src, origpos, SDL_IO_SEEK_SET) != origpos)
+    {
+        __Sound_SetError(ERR_IO_ERROR);
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        retval = 0;
+    } /* if */
+
+    if (retval && (count == 0))
+    {
+        __Sound_SetError("VOC: data had no sound!");
+        retval = 0;
+    } /* if */
+
+    if (!retval)
+    {
+        SDL_free(points);
+        return 0;
+    } /* if */
+
+    v->seek_points = points;
+    v->seek_point_count = count;
+    v->scan_done = true;
+    return 1;
+} /* voc_scan */
+
+
+static const voc_seek_point *voc_find_seek_point(const vs_t *v, Uint64 offset)
+{
+    Uint32 lo = 0;
+    Uint32 hi = v->seek_point_count;
+
+    if ((!v->scan_done) || (v->seek_point_count == 0))
+        return NULL;
+
+    /* find the last point at or before (offset); the first one is at zero. */
+    while ((hi - lo) > 1)
+    {
+        const Uint32 mid = lo + ((hi - lo) / 2);
+        if (v->seek_points[mid].offset <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    } /* while */
+
+    return &v->seek_points[lo];
+} /* voc_find_seek_point */
+
+
+static int VOC_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     /*
      * VOCs don't lend themselves well to seeking, since you have to
-     *  parse each section, which is an arbitrary size. The best we can do
-     *  is rewind, set a flag saying not to write the waveforms to a buffer,
-     *  and decode to the point that we want. Ugh. Fortunately, there's
-     *  really no such thing as a large VOC, due to the era and hardware that
-     *  spawned them, so even though this is inefficient, this is still a
-     *  relatively fast operation in most cases.
+     *  parse each section, which is an arbitrary size. So the first seek
+     *  walks all the block headers and notes where things are (see
+     *  voc_scan()); after that, we jump to the nearest block before the
+     *  spot we want, set a flag saying not to write the waveforms to a
+     *  buffer, and decode the rest of the way there. If the walk fails,
+     *  we go the long way around from the start.
      */
 
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     vs_t *v = (vs_t *) internal->decoder_private;
-    Uint32 offset = __Sound_convertMsToBytePos(&sample->actual, ms);
+    Uint64 offset = frame * SDL_AUDIO_FRAMESIZE(sample->actual);
     const Sint64 origpos = SDL_TellIO(internal->io);
     const Uint32 origrest = v->rest;
+    const voc_seek_point *point;
 
-    BAIL_IF_MACRO(!VOC_rewind(sample), NULL, 0);
+    voc_scan(sample, v);
+    point = voc_find_seek_point(v, offset);
+    if (point == NULL)
+    {
+        BAIL_IF_MACRO(!VOC_rewind(sample), NULL, 0);
+    } /* if */
+    else
+    {
+        const Sint64 rc = SDL_SeekIO(internal->io, point->pos, SDL_IO_SEEK_SET);
+        BAIL_IF_MACRO(rc != point->pos, ERR_IO_ERROR, 0);
+        v->rest = 0;
+        v->extended = 0;
+        offset -= point->offset;
+    } /* else */
 
     v->bufpos = 0;
 
     while (offset > 0)
     {
-        Uint32 rc = voc_read_waveform(sample, 0, offset);
+        const Uint32 max = (Uint32) SDL_min(offset, 0xFFFFFFFF);
+        Uint32 rc = voc_read_waveform(sample, 0, max);
         if ( (rc == 0) || (!voc_get_block(sample, v)) )
         {
             SDL_SeekIO(internal->io, origpos, SDL_IO_SEEK_SET);
@@ -525,9 +680,96 @@ static int VOC_seek(Sound_Sample *sample, Uint32 ms)
     } /* while */
 
     return 1;
+} /* VOC_seek_frame */
+
+
+static int VOC_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return VOC_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* VOC_seek */
 
 
+/*
+ * The seek index is just the seek points, all little endian:
+ *
+ *  Uint32 count; count * { Uint64 output_offset; Uint64 stream_offset; }
+ */
+#define VOC_INDEX_HEADER_SIZE 4
+#define VOC_INDEX_POINT_SIZE 16
+
+static Uint32 VOC_save_index(Sound_Sample *sample, Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    vs_t *v = (vs_t *) internal->decoder_private;
+    Uint32 retval;
+    Uint32 i;
+
+    if (!voc_scan(sample, v))
+        return 0;
+
+    retval = VOC_INDEX_HEADER_SIZE + (v->seek_point_count * VOC_INDEX_POINT_SIZE);
+    if ((buf != NULL) && (len >= retval))
+    {
+        buf = __Sound_IndexPut32(buf, v->seek_point_count);
+        for (i = 0; i < v->seek_point_count; i++)
+        {
+            buf = __Sound_IndexPut64(buf, v->seek_points[i].offset);
+            buf = __Sound_IndexPut64(buf, (Uint64) v->seek_points[i].pos);
+        } /* for */
+    } /* if */
+
+    return retval;
+} /* VOC_save_index */
+
+
+static int VOC_load_index(Sound_Sample *sample, const Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    vs_t *v = (vs_t *) internal->decoder_private;
+    const Sint64 end = SDL_GetIOSize(internal->io);
+    voc_seek_point *points;
+    Uint32 count, i;
+
+    BAIL_IF_MACRO(len < VOC_INDEX_HEADER_SIZE, ERR_CORRUPT_SEEK_INDEX, 0);
+    count = __Sound_IndexGet32(buf);
+    buf += VOC_INDEX_HEADER_SIZE;
+    BAIL_IF_MACRO(count == 0, ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(count > ((len - VOC_INDEX_HEADER_SIZE) / VOC_INDEX_POINT_SIZE), ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(len != VOC_INDEX_HEADER_SIZE + (count * VOC_INDEX_POINT_SIZE), ERR_CORRUPT_SEEK_INDEX, 0);
+
+    points = (voc_seek_point *) SDL_malloc(count * sizeof (voc_seek_point));
+    BAIL_IF_MACRO(!points, ERR_OUT_OF_MEMORY, 0);
+
+    for (i = 0; i < count; i++, buf += VOC_INDEX_POINT_SIZE)
+    {
+        points[i].offset = __Sound_IndexGet64(buf);
+        points[i].pos = (Sint64) __Sound_IndexGet64(buf + 8);
+
+        /* every point has to be a block header; the first is the first one. */
+        if ( ((i == 0) && ((points[i].offset != 0) || (points[i].pos != v->start_pos))) ||
+             ((i > 0) && ((points[i].offset <= points[i-1].offset) || (points[i].pos <= points[i-1].pos))) ||
+             ((end >= 0) && (points[i].pos >= end)) )
+        {
+            SDL_free(points);
+            BAIL_MACRO(ERR_WRONG_SEEK_INDEX, 0);
+        } /* if */
+    } /* for */
+
+    SDL_free(v->seek_points);
+    v->seek_points = points;
+    v->seek_point_count = count;
+    v->scan_done = true;
+    return 1;
+} /* VOC_load_index */
+
+
+static int VOC_probe(const Uint8 *header, Uint32 len)
+{
+    return ( (len >= 20) &&
+             (SDL_memcmp(header, "Creative Voice File\032", 20) == 0) );
+} /* VOC_probe */
+
+
 static const char *extensions_voc[] = { "VOC", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_VOC =
 {
@@ -544,7 +786,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_VOC =
     VOC_close,      /*  close() method */
     VOC_read,       /*   read() method */
     VOC_rewind,     /* rewind() method */
-    VOC_seek        /*   seek() method */
+    VOC_seek,       /*   seek() method */
+    VOC_seek_frame, /* seek_frame() method */
+    VOC_probe,      /*  probe() method */
+    NULL,           /* duration() method */
+    VOC_save_index, /* save_index() method */
+    VOC_load_index  /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_VOC */
@@ -14,6 +14,10 @@
  *  public domain C header file, it's just compiled into this source and
  *  needs no external dependencies.
  *
+ * Push samples (see Sound_NewPushSample()) use stb_vorbis's pushdata API
+ *  instead, handing it what's been pushed so far out of a Sound_IOBuffer,
+ *  so it can stop at the end of what's there and pick up again later.
+ *
  * stb_vorbis homepage: https://nothings.org/stb_vorbis/
  */
 
@@ -26,7 +30,6 @@
 #define STB_VORBIS_SDL 1 /* for SDL_sound-specific stuff. */
 #define STB_VORBIS_NO_STDIO 1
 #define STB_VORBIS_NO_CRT 1
-#define STB_VORBIS_NO_PUSHDATA_API 1
 #define STB_VORBIS_MAX_CHANNELS 8   /* For 7.1 surround sound */
 #define STB_VORBIS_NO_COMMENTS 1
 #define STB_FORCEINLINE SDL_FORCE_INLINE
@@ -92,6 +95,29 @@ static const char *vorbis_error_string(const int err)
     return "VORBIS: unknown error";
 } /* vorbis_error_string */
 
+/*
+ * stb_vorbis finds a seek target by bisecting the stream, reading a page
+ *  at each step. A seek index is a list of pages spaced about 32K apart
+ *  (see vorbis_scan()), which it uses to start with a small range around
+ *  the target instead; on a big file or a slow stream, that's most of
+ *  those reads gone.
+ */
+#define VORBIS_SEEK_POINT_INTERVAL (32 * 1024)
+#define VORBIS_SCAN_BUFFER_SIZE (64 * 1024)
+
+/* the least we ask a push sample for when stb_vorbis needs more data. */
+#define VORBIS_PUSH_READ_SIZE (4 * 1024)
+
+typedef struct
+{
+    stb_vorbis *stb;
+    ProbedPage *seek_points;  /* handed to stb->seek_index once complete. */
+    Uint32 seek_point_count;
+    bool push;  /* stb_vorbis is in pushdata mode, reading from (iobuf). */
+    Sound_IOBuffer iobuf;
+} VorbisData;
+
+
 static bool VORBIS_init(void)
 {
     return true; /* always succeeds. */
@@ -102,14 +128,82 @@ static void VORBIS_quit(void)
     /* it's a no-op. */
 } /* VORBIS_quit */
 
+/*
+ * Read more of a push sample into (iob), for stb_vorbis to look at. Returns
+ *  1 if there's more than the (avail) bytes it had, 0 if there isn't yet,
+ *  and -1 if there never will be.
+ */
+static int vorbis_push_more(Sound_IOBuffer *iob, SDL_IOStream *io, Uint32 avail)
+{
+    const bool ready = __Sound_IOBufferFill(iob, io, SDL_max(avail * 2, VORBIS_PUSH_READ_SIZE));
+    if ((iob->len - iob->pos) > avail)
+        return 1;
+    return ready ? -1 : 0;
+} /* vorbis_push_more */
+
+
+static int vorbis_open_push(Sound_Sample *sample, VorbisData *data)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_IOBuffer *iob = &data->iobuf;
+    int used = 0;
+    int err = VORBIS_need_more_data;
+
+    while (1)
+    {
+        const Uint32 avail = iob->len - iob->pos;
+        if (avail > 0)  /* stb_vorbis reads from the SDL_IOStream if it gets a NULL pointer. */
+        {
+            data->stb = stb_vorbis_open_pushdata(iob->data + iob->pos, (int) avail, &used, &err, NULL);
+            if (data->stb != NULL)
+                break;
+        } /* if */
+
+        /* if it's just short, Sound_PushData() tries again with more. */
+        BAIL_IF_MACRO(err != VORBIS_need_more_data, vorbis_error_string(err), 0);
+        BAIL_IF_MACRO(vorbis_push_more(iob, internal->io, avail) <= 0, vorbis_error_string(err), 0);
+    } /* while */
+
+    iob->pos += (Uint32) used;
+    return 1;
+} /* vorbis_open_push */
+
+
 static int VORBIS_open(Sound_Sample *sample, const char *ext)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     SDL_IOStream *src = internal->io;
     int err = 0;
-    stb_vorbis *stb = stb_vorbis_open_io(src, 0, &err, NULL);
+    stb_vorbis *stb;
+    VorbisData *data;
     unsigned int num_frames, rate;
 
+    if (internal->push != NULL)
+    {
+        data = (VorbisData *) SDL_calloc(1, sizeof (VorbisData));
+        BAIL_IF_MACRO(!data, ERR_OUT_OF_MEMORY, 0);
+        data->push = true;
+        data->iobuf.staging = true;
+        if (!vorbis_open_push(sample, data))
+        {
+            __Sound_IOBufferFree(&data->iobuf);
+            SDL_free(data);
+            return 0;
+        } /* if */
+
+        SNDDBG(("VORBIS: Accepting pushed data stream.\n"));
+
+        stb = data->stb;
+        internal->decoder_private = data;
+        sample->flags = 0;  /* no going back on a push sample. */
+        sample->actual.format = (sample->desired.format == SDL_AUDIO_S16) ? SDL_AUDIO_S16 : SDL_AUDIO_F32;
+        sample->actual.channels = stb->channels;
+        sample->actual.freq = stb->sample_rate;
+        internal->total_time = -1;  /* the length isn't known until the end. */
+        return 1;
+    } /* if */
+
+    stb = stb_vorbis_open_io(src, 0, &err, NULL);
     BAIL_IF_MACRO(!stb, vorbis_error_string(err), 0);
 
     num_frames = stb_vorbis_stream_length_in_samples(stb);
@@ -118,11 +212,19 @@ static int VORBIS_open(Sound_Sample *sample, const char *ext)
         BAIL_MACRO("VORBIS: No samples in ogg/vorbis stream.", 0);
     }
 
+    data = (VorbisData *) SDL_calloc(1, sizeof (VorbisData));
+    if (!data) {
+        stb_vorbis_close(stb);
+        BAIL_MACRO(ERR_OUT_OF_MEMORY, 0);
+    }
+
     SNDDBG(("VORBIS: Accepting data stream.\n"));
 
-    internal->decoder_private = stb;
+    data->stb = stb;
+    internal->decoder_private = data;
     sample->flags = SOUND_SAMPLEFLAG_CANSEEK;
-    sample->actual.format = SDL_AUDIO_F32;
+    /* stb_vorbis can interleave straight to Sint16, which saves a conversion. */
+    sample->actual.format = (sample->desired.format == SDL_AUDIO_S16) ? SDL_AUDIO_S16 : SDL_AUDIO_F32;
     sample->actual.channels = stb->channels;
     sample->actual.freq = stb->sample_rate;
     rate = stb->sample_rate;
@@ -136,11 +238,80 @@ static int VORBIS_open(Sound_Sample *sample, const char *ext)
 static void VORBIS_close(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    stb_vorbis *stb = (stb_vorbis *) internal->decoder_private;
-    stb_vorbis_close(stb);
+    VorbisData *data = (VorbisData *) internal->decoder_private;
+    stb_vorbis_close(data->stb);
+    SDL_free(data->seek_points);
+    __Sound_IOBufferFree(&data->iobuf);
+    SDL_free(data);
 } /* VORBIS_close */
 
 
+/*
+ * Pushdata mode decodes a packet at a time into stb_vorbis's own buffers,
+ *  and we interleave from there. stb_vorbis_get_samples_*_interleaved()
+ *  would do the same in pull mode, so as long as we never ask it for more
+ *  than is left from the last packet, it does the interleaving and never
+ *  tries to read the stream itself.
+ */
+static Uint32 vorbis_read_push(Sound_Sample *sample, VorbisData *data)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    Sound_IOBuffer *iob = &data->iobuf;
+    stb_vorbis *stb = data->stb;
+    const int channels = (int) sample->actual.channels;
+    const bool s16 = (sample->actual.format == SDL_AUDIO_S16);
+    const Uint32 framesize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+    const int want_frames = (int) (internal->buffer_size / framesize);
+    Uint8 *ptr = (Uint8 *) internal->buffer;
+    float **outputs = NULL;
+    int total = 0;
+    int samples = 0;
+    int used, rc;
+
+    while (total < want_frames)
+    {
+        const int left = stb->channel_buffer_end - stb->channel_buffer_start;
+        if (left > 0)
+        {
+            const int n = SDL_min(left, want_frames - total);
+            if (s16)
+                stb_vorbis_get_samples_short_interleaved(stb, channels, (short *) ptr, n * channels);
+            else
+                stb_vorbis_get_samples_float_interleaved(stb, channels, (float *) ptr, n * channels);
+            ptr += n * framesize;
+            total += n;
+            continue;
+        } /* if */
+
+        used = stb_vorbis_decode_frame_pushdata(stb, iob->data + iob->pos, (int) (iob->len - iob->pos), NULL, &outputs, &samples);
+        if ((used == 0) && (samples == 0))  /* needs the rest of a packet. */
+        {
+            rc = vorbis_push_more(iob, internal->io, iob->len - iob->pos);
+            if (rc == 0)
+            {
+                sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
+                break;
+            } /* if */
+            else if (rc < 0)
+            {
+                sample->flags |= SOUND_SAMPLEFLAG_EOF;
+                break;
+            } /* else if */
+            continue;
+        } /* if */
+
+        iob->pos += (Uint32) used;
+        if (samples > 0)
+        {
+            stb->channel_buffer_start = (int) (outputs[0] - stb->channel_buffers[0]);
+            stb->channel_buffer_end = stb->channel_buffer_start + samples;
+        } /* if */
+    } /* while */
+
+    return ((Uint32) total) * framesize;
+} /* vorbis_read_push */
+
+
 static Uint32 VORBIS_read(Sound_Sample *sample)
 {
     Uint32 retval;
@@ -148,18 +319,27 @@ static Uint32 VORBIS_read(Sound_Sample *sample)
     int err;
     int has_deferred;
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    stb_vorbis *stb = (stb_vorbis *) internal->decoder_private;
+    VorbisData *data = (VorbisData *) internal->decoder_private;
+    stb_vorbis *stb = data->stb;
     const int channels = (int) sample->actual.channels;
-    const int want_samples = (int) (internal->buffer_size / sizeof (float));
+    const bool s16 = (sample->actual.format == SDL_AUDIO_S16);
+    const Uint32 samplesize = (Uint32) SDL_AUDIO_BYTESIZE(sample->actual.format);
+    const int want_samples = (int) (internal->buffer_size / samplesize);
+
+    if (data->push)
+        return vorbis_read_push(sample, data);
 
     stb_vorbis_get_error(stb);  /* clear any error state */
 
     do {
         has_deferred = stb->discard_samples_deferred > 0;
-        rc = stb_vorbis_get_samples_float_interleaved(stb, channels, (float *) internal->buffer, want_samples);
+        if (s16)
+            rc = stb_vorbis_get_samples_short_interleaved(stb, channels, (short *) internal->buffer, want_samples);
+        else
+            rc = stb_vorbis_get_samples_float_interleaved(stb, channels, (float *) internal->buffer, want_samples);
     } while ((rc == 0) && has_deferred);  /* if it's still flushing out garbage at the start of the stream, keep trying. */
 
-    retval = (Uint32) (rc * channels * sizeof (float));  /* rc == number of sample frames read */
+    retval = (Uint32) (rc * channels * samplesize);  /* rc == number of sample frames read */
     err = stb_vorbis_get_error(stb);
 
     if (retval == 0)
@@ -183,24 +363,233 @@ static Uint32 VORBIS_read(Sound_Sample *sample)
 static int VORBIS_rewind(Sound_Sample *sample)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    stb_vorbis *stb = (stb_vorbis *) internal->decoder_private;
+    stb_vorbis *stb = ((VorbisData *) internal->decoder_private)->stb;
     BAIL_IF_MACRO(!stb_vorbis_seek_start(stb), vorbis_error_string(stb_vorbis_get_error(stb)), 0);
     return 1;
 } /* VORBIS_rewind */
 
 
-static int VORBIS_seek(Sound_Sample *sample, Uint32 ms)
+static int VORBIS_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
-    stb_vorbis *stb = (stb_vorbis *) internal->decoder_private;
-    const float frames_per_ms = ((float) sample->actual.freq) / 1000.0f;
-    const Uint32 frame_offset = (Uint32) (frames_per_ms * ((float) ms));
-    const unsigned int sampnum = (unsigned int) frame_offset;
-    BAIL_IF_MACRO(!stb_vorbis_seek(stb, sampnum), vorbis_error_string(stb_vorbis_get_error(stb)), 0);
+    stb_vorbis *stb = ((VorbisData *) internal->decoder_private)->stb;
+    BAIL_IF_MACRO(frame > 0xFFFFFFFF, ERR_PAST_EOF, 0);  /* stb_vorbis uses 32-bit positions. */
+    BAIL_IF_MACRO(!stb_vorbis_seek(stb, (unsigned int) frame), vorbis_error_string(stb_vorbis_get_error(stb)), 0);
     return 1;
+} /* VORBIS_seek_frame */
+
+
+static int VORBIS_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return VORBIS_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* VORBIS_seek */
 
 
+/*
+ * Walk the Ogg page headers from the first audio page to the end, noting a
+ *  page every VORBIS_SEEK_POINT_INTERVAL bytes or so. Positions are the
+ *  ones stb_vorbis uses, from the start of its section of the stream, and
+ *  only pages that finish a packet (so they have a granule position) count.
+ *  Leaves the stream where it was; stb_vorbis never notices.
+ */
+static int vorbis_scan(Sound_Sample *sample, VorbisData *data)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    SDL_IOStream *io = internal->io;
+    stb_vorbis *stb = data->stb;
+    const Sint64 origpos = SDL_TellIO(io);
+    ProbedPage *points = NULL;
+    Uint32 count = 0;
+    Uint32 capacity = 0;
+    Uint8 *buf = NULL;
+    Uint32 buflen = 0;    /* bytes in buf. */
+    Uint32 bufpos = 0;    /* stb_vorbis position of buf[0]. */
+    Uint32 pos = stb->first_audio_page_offset;
+    Uint32 i, payload;
+    int retval = 1;
+
+    if (data->seek_points != NULL)
+        return 1;  /* already have one. */
+
+    BAIL_IF_MACRO(origpos < 0, ERR_IO_ERROR, 0);
+    buf = (Uint8 *) SDL_malloc(VORBIS_SCAN_BUFFER_SIZE);
+    BAIL_IF_MACRO(!buf, ERR_OUT_OF_MEMORY, 0);
+
+    while (retval && (pos < stb->stream_len))
+    {
+        const Uint8 *hdr;
+
+        /* make sure the header and its segment table are in the buffer. */
+        if ((pos < bufpos) || ((pos - bufpos) + 27 + 255 > buflen))
+        {
+            const Uint32 want = SDL_min(VORBIS_SCAN_BUFFER_SIZE, stb->stream_len - pos);
+            const Sint64 iopos = ((Sint64) stb->io_start) + pos;
+            if (SDL_SeekIO(io, iopos, SDL_IO_SEEK_SET) != iopos)
+            {
+                __Sound_SetError(ERR_IO_ERROR);
+                retval = 0;
+                break;
+            } /* if */
+            buflen = (Uint32) SDL_ReadIO(io, buf, want);
+            bufpos = pos;
+            if (buflen < 27)
+                break;  /* not enough left for a page; call it the end. */
+        } /* if */
+
+        hdr = buf + (pos - bufpos);
+        if ( (SDL_memcmp(hdr, "OggS", 4) != 0) ||
+             ((pos - bufpos) + 27 + hdr[26] > buflen) )
+            break;  /* junk at the end, or a truncated page. Stop here. */
+
+        payload = 0;
+        for (i = 0; i < hdr[26]; i++)
+            payload += hdr[27 + i];
+
+        if ((hdr[6] & hdr[7] & hdr[8] & hdr[9]) != 0xFF)  /* granule of -1 means no packet ends here. */
+        {
+            if ((count == 0) || ((pos - points[count-1].page_start) >= VORBIS_SEEK_POINT_INTERVAL))
+            {
+                if (count == capacity)
+                {
+                    const Uint32 newcap = capacity ? (capacity * 2) : 256;
+                    void *ptr = SDL_realloc(points, newcap * sizeof (ProbedPage));
+                    if (!ptr)
+                    {
+                        __Sound_SetError(ERR_OUT_OF_MEMORY);
+                        retval = 0;
+                        break;
+                    } /* if */
+                    points = (ProbedPage *) ptr;
+                    capacity = newcap;
+                } /* if */
+
+                points[count].page_start = pos;
+                points[count].page_end = pos + 27 + hdr[26] + payload;
+                points[count].last_decoded_sample = ((Uint32) hdr[6]) | (((Uint32) hdr[7]) << 8) |
+                                                    (((Uint32) hdr[8]) << 16) | (((Uint32) hdr[9]) << 24);
+                count++;
+            } /* if */
+        } /* if */
+
+        pos += 27 + hdr[26] + payload;
+    } /* while */
+
+    SDL_free(buf);
+
+    if (SDL_SeekIO(io, origpos, SDL_IO_SEEK_SET) != origpos)
+    {
+        __Sound_SetError(ERR_IO_ERROR);
+        sample->flags |= SOUND_SAMPLEFLAG_ERROR;
+        retval = 0;
+    } /* if */
+
+    if (retval && (count == 0))
+    {
+        __Sound_SetError("VORBIS: No samples in ogg/vorbis stream.");
+        retval = 0;
+    } /* if */
+
+    if (!retval)
+    {
+        SDL_free(points);
+        return 0;
+    } /* if */
+
+    data->seek_points = points;
+    data->seek_point_count = count;
+    stb->seek_index = points;
+    stb->seek_index_count = (int) count;
+    return 1;
+} /* vorbis_scan */
+
+
+/*
+ * The seek index is just the pages vorbis_scan() picked, all little endian:
+ *
+ *  Uint32 count; count * { Uint32 page_start; Uint32 page_end; Uint32 granule; }
+ */
+#define VORBIS_INDEX_HEADER_SIZE 4
+#define VORBIS_INDEX_POINT_SIZE 12
+
+static Uint32 VORBIS_save_index(Sound_Sample *sample, Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    VorbisData *data = (VorbisData *) internal->decoder_private;
+    Uint32 retval;
+    Uint32 i;
+
+    if (!vorbis_scan(sample, data))
+        return 0;
+
+    retval = VORBIS_INDEX_HEADER_SIZE + (data->seek_point_count * VORBIS_INDEX_POINT_SIZE);
+    if ((buf != NULL) && (len >= retval))
+    {
+        buf = __Sound_IndexPut32(buf, data->seek_point_count);
+        for (i = 0; i < data->seek_point_count; i++)
+        {
+            const ProbedPage *page = &data->seek_points[i];
+            buf = __Sound_IndexPut32(buf, page->page_start);
+            buf = __Sound_IndexPut32(buf, page->page_end);
+            buf = __Sound_IndexPut32(buf, page->last_decoded_sample);
+        } /* for */
+    } /* if */
+
+    return retval;
+} /* VORBIS_save_index */
+
+
+static int VORBIS_load_index(Sound_Sample *sample, const Uint8 *buf, Uint32 len)
+{
+    Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
+    VorbisData *data = (VorbisData *) internal->decoder_private;
+    stb_vorbis *stb = data->stb;
+    ProbedPage *points;
+    Uint32 count, i;
+
+    BAIL_IF_MACRO(len < VORBIS_INDEX_HEADER_SIZE, ERR_CORRUPT_SEEK_INDEX, 0);
+    count = __Sound_IndexGet32(buf);
+    buf += VORBIS_INDEX_HEADER_SIZE;
+    BAIL_IF_MACRO(count == 0, ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(count > ((len - VORBIS_INDEX_HEADER_SIZE) / VORBIS_INDEX_POINT_SIZE), ERR_CORRUPT_SEEK_INDEX, 0);
+    BAIL_IF_MACRO(len != VORBIS_INDEX_HEADER_SIZE + (count * VORBIS_INDEX_POINT_SIZE), ERR_CORRUPT_SEEK_INDEX, 0);
+
+    points = (ProbedPage *) SDL_malloc(count * sizeof (ProbedPage));
+    BAIL_IF_MACRO(!points, ERR_OUT_OF_MEMORY, 0);
+
+    for (i = 0; i < count; i++, buf += VORBIS_INDEX_POINT_SIZE)
+    {
+        ProbedPage *page = &points[i];
+        page->page_start = __Sound_IndexGet32(buf);
+        page->page_end = __Sound_IndexGet32(buf + 4);
+        page->last_decoded_sample = __Sound_IndexGet32(buf + 8);
+
+        /* stb_vorbis checks each page before it trusts it, but keep the table sane. */
+        if ( (page->page_start < stb->first_audio_page_offset) ||
+             (page->page_end <= page->page_start) ||
+             (page->page_end > stb->stream_len) ||
+             ((i > 0) && (page->page_start < points[i-1].page_end)) ||
+             ((i > 0) && (page->last_decoded_sample < points[i-1].last_decoded_sample)) )
+        {
+            SDL_free(points);
+            BAIL_MACRO(ERR_WRONG_SEEK_INDEX, 0);
+        } /* if */
+    } /* for */
+
+    SDL_free(data->seek_points);
+    data->seek_points = points;
+    data->seek_point_count = count;
+    stb->seek_index = points;
+    stb->seek_index_count = (int) count;
+    return 1;
+} /* VORBIS_load_index */
+
+
+static int VORBIS_probe(const Uint8 *header, Uint32 len)
+{
+    return ((len >= 4) && (SDL_memcmp(header, "OggS", 4) == 0));
+} /* VORBIS_probe */
+
+
 static const char *extensions_vorbis[] = { "OGG", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_VORBIS =
 {
@@ -217,7 +606,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_VORBIS =
     VORBIS_close,      /*  close() method */
     VORBIS_read,       /*   read() method */
     VORBIS_rewind,     /* rewind() method */
-    VORBIS_seek        /*   seek() method */
+    VORBIS_seek,       /*   seek() method */
+    VORBIS_seek_frame, /* seek_frame() method */
+    VORBIS_probe,      /*  probe() method */
+    NULL,              /* duration() method */
+    VORBIS_save_index, /* save_index() method */
+    VORBIS_load_index  /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_VORBIS */
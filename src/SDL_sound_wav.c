@@ -109,7 +109,7 @@ typedef struct S_WAV_FMT_T
     void (*free)(struct S_WAV_FMT_T *fmt);
     Uint32 (*read_sample)(Sound_Sample *sample);
     int (*rewind_sample)(Sound_Sample *sample);
-    int (*seek_sample)(Sound_Sample *sample, Uint32 ms);
+    int (*seek_sample)(Sound_Sample *sample, Uint64 frame);
 
     union
     {
@@ -214,12 +214,16 @@ static Uint32 read_sample_fmt_normal(Sound_Sample *sample)
     Uint32 max = (internal->buffer_size < (Uint32) w->bytesLeft) ?
                   internal->buffer_size : (Uint32) w->bytesLeft;
 
-    /* We need to convert 24-bit PCM to an SDL-friendly SDL_AUDIO_S32 ... */
+    /*
+     * We convert 24-bit PCM ourselves, in place, to whatever WAV_open()
+     *  picked: 3 bytes grow to 4, or shrink to 2. Only read whole frames,
+     *  and only as many as there's room for on the bigger side of that.
+     */
     if (w->fmt->wBitsPerSample == 24) {
-        const Uint32 num_samples = max / 3;
-
-        /* we're going to expand by 25%...3 bytes to 4. Make sure the buffer has room to expand. */
-        max = (num_samples - (num_samples / 4)) * 3;
+        const Uint32 infrmsize = 3 * sample->actual.channels;
+        const Uint32 outfrmsize = (Uint32) SDL_AUDIO_FRAMESIZE(sample->actual);
+        max = (Uint32) SDL_min(internal->buffer_size / SDL_max(infrmsize, outfrmsize),
+                               ((Uint64) w->bytesLeft) / infrmsize) * infrmsize;
         if (max == 0) {
             sample->flags |= SOUND_SAMPLEFLAG_EOF;
             return 0;
@@ -232,48 +236,77 @@ static Uint32 read_sample_fmt_normal(Sound_Sample *sample)
          * We don't actually do any decoding, so we read the wav data
          *  directly into the internal buffer...
          */
-    retval = SDL_ReadIO(internal->io, internal->buffer, max);
+    if (w->fmt->wBitsPerSample == 24)
+        retval = (Uint32) __Sound_ReadFrames(internal->io, internal->buffer, max, 3 * sample->actual.channels);  /* converted below. */
+    else
+        retval = __Sound_ReadPCM(sample, max);
 
     w->bytesLeft -= retval;
 
         /* Make sure the read went smoothly... */
-    if ((retval == 0) || (w->bytesLeft == 0))
+    if ((retval == 0) && (SDL_GetIOStatus(internal->io) == SDL_IO_STATUS_NOT_READY))
+        sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;  /* non-blocking stream; more is coming. */
+
+    else if ((retval == 0) || (w->bytesLeft == 0))
         sample->flags |= SOUND_SAMPLEFLAG_EOF;
 
     else if (retval == -1) /** FIXME: this error check is broken **/
         sample->flags |= SOUND_SAMPLEFLAG_ERROR;
 
         /* (next call this EAGAIN may turn into an EOF or error.) */
-    else if (retval < internal->buffer_size)
+    else if (retval < max)
         sample->flags |= SOUND_SAMPLEFLAG_EAGAIN;
 
     /* deal with 24-bit PCM. */
     if ((retval > 0) && (w->fmt->wBitsPerSample == 24)) {
         const Uint32 total = retval / 3;
-        const Uint8 *src = ((Uint8 *)internal->buffer + retval) - 3;
-        Uint32 *dst = (Uint32 *) (((Uint8 *)internal->buffer + (total * 4)) - 4);
         Uint32 i;
-        for (i = 0; i < total; i++, dst--, src -= 3) {
-            const Uint32 smpl = ((Uint32) src[0]) | (((Uint32) src[1]) << 8) | (((Uint32) src[2]) << 16);
-            *dst = smpl << 8;   /* shift it up so the most significant bits cover the 32-bit space. */
+        if (sample->actual.format == SDL_AUDIO_S16) {
+            /* shrinking, so go front to back, and keep the top 16 bits. */
+            const Uint8 *src = (const Uint8 *) internal->buffer;
+            Sint16 *dst = (Sint16 *) internal->buffer;
+            for (i = 0; i < total; i++, dst++, src += 3) {
+                *dst = (Sint16) (((Uint16) src[1]) | (((Uint16) src[2]) << 8));
+            }
+            retval = total * 2;
+        } else if (sample->actual.format == SDL_AUDIO_F32) {
+            const Uint8 *src = ((Uint8 *)internal->buffer + retval) - 3;
+            float *dst = (float *) (((Uint8 *)internal->buffer + (total * 4)) - 4);
+            for (i = 0; i < total; i++, dst--, src -= 3) {
+                const Uint32 smpl = ((Uint32) src[0]) | (((Uint32) src[1]) << 8) | (((Uint32) src[2]) << 16);
+                *dst = ((float) ((Sint32) (smpl << 8))) * (1.0f / 2147483648.0f);
+            }
+            retval = total * 4;
+        } else {
+            const Uint8 *src = ((Uint8 *)internal->buffer + retval) - 3;
+            Uint32 *dst = (Uint32 *) (((Uint8 *)internal->buffer + (total * 4)) - 4);
+            for (i = 0; i < total; i++, dst--, src -= 3) {
+                const Uint32 smpl = ((Uint32) src[0]) | (((Uint32) src[1]) << 8) | (((Uint32) src[2]) << 16);
+                *dst = smpl << 8;   /* shift it up so the most significant bits cover the 32-bit space. */
+            }
+            retval = total * 4;
         }
-        retval = total * 4;
     }
 
     return retval;
 } /* read_sample_fmt_normal */
 
 
-static int seek_sample_fmt_normal(Sound_Sample *sample, Uint32 ms)
+static int seek_sample_fmt_normal(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     wav_t *w = (wav_t *) internal->decoder_private;
     fmt_t *fmt = w->fmt;
-    const Sint64 offset = __Sound_convertMsToBytePos(&sample->actual, ms);
-    const Sint64 pos = (fmt->data_starting_offset + offset);
-    const Sint64 rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
+    /* use the file's frame size; 24-bit data changes size once we convert it. */
+    const Uint64 offset = frame * fmt->wBlockAlign;
+    Sint64 pos;
+    Sint64 rc;
+
+    BAIL_IF_MACRO(offset > fmt->total_bytes, ERR_PAST_EOF, 0);
+    pos = (fmt->data_starting_offset + (Sint64) offset);
+    rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
     BAIL_IF_MACRO(rc != pos, ERR_IO_ERROR, 0);
-    w->bytesLeft = fmt->total_bytes - offset;
+    w->bytesLeft = fmt->total_bytes - (Sint64) offset;
     return 1;  /* success. */
 } /* seek_sample_fmt_normal */
 
@@ -511,46 +544,55 @@ static int rewind_sample_fmt_adpcm(Sound_Sample *sample)
 } /* rewind_sample_fmt_adpcm */
 
 
-static int seek_sample_fmt_adpcm(Sound_Sample *sample, Uint32 ms)
+static int seek_sample_fmt_adpcm(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     wav_t *w = (wav_t *) internal->decoder_private;
     fmt_t *fmt = w->fmt;
     const Uint32 origsampsleft = fmt->fmt.adpcm.samples_left_in_block;
     const Sint64 origpos = SDL_TellIO(internal->io);
-    const Sint64 offset = __Sound_convertMsToBytePos(&sample->actual, ms);
-    const Sint64 bpb = (fmt->fmt.adpcm.wSamplesPerBlock * fmt->sample_frame_size);
-    Sint64 skipsize = (offset / bpb) * fmt->wBlockAlign;
-    const Sint64 pos = skipsize + fmt->data_starting_offset;
-    Sint64 rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
+    const Sint64 origbytesleft = w->bytesLeft;
+    const Uint64 spb = fmt->fmt.adpcm.wSamplesPerBlock;
+    const Uint64 skipsize = (frame / spb) * fmt->wBlockAlign;
+    Uint64 frames_into_block = (frame % spb);
+    const Sint64 pos = ((Sint64) skipsize) + fmt->data_starting_offset;
+    Sint64 rc;
+
+    BAIL_IF_MACRO(skipsize > fmt->total_bytes, ERR_PAST_EOF, 0);
+    rc = SDL_SeekIO(internal->io, pos, SDL_IO_SEEK_SET);
     BAIL_IF_MACRO(rc != pos, ERR_IO_ERROR, 0);
+    w->bytesLeft = fmt->total_bytes - (Sint64) skipsize;
+
+    /* Right at the start of a block? Let the next read get its headers. */
+    if (frames_into_block == 0)
+    {
+        fmt->fmt.adpcm.samples_left_in_block = 0;
+        return 1;
+    } /* if */
 
     /* The offset we need is in this block, so we need to decode to there. */
-    skipsize += (offset % bpb);
-    rc = (offset % bpb);  /* bytes into this block we need to decode */
     if (!read_adpcm_block_headers(sample))
     {
         SDL_SeekIO(internal->io, origpos, SDL_IO_SEEK_SET); /* try to make sane. */
+        w->bytesLeft = origbytesleft;
         return 0;
     } /* if */
 
     /* first sample frame of block is a freebie. :) */
     fmt->fmt.adpcm.samples_left_in_block--;
-    rc -= fmt->sample_frame_size;
-    while (rc > 0)
+    while (--frames_into_block > 0)
     {
         if (!decode_adpcm_sample_frame(sample))
         {
             SDL_SeekIO(internal->io, origpos, SDL_IO_SEEK_SET);
             fmt->fmt.adpcm.samples_left_in_block = origsampsleft;
+            w->bytesLeft = origbytesleft;
             return 0;
         } /* if */
 
         fmt->fmt.adpcm.samples_left_in_block--;
-        rc -= fmt->sample_frame_size;
     } /* while */
 
-    w->bytesLeft = fmt->total_bytes - skipsize;
     return 1;  /* success. */
 } /* seek_sample_fmt_adpcm */
 
@@ -697,7 +739,12 @@ static int WAV_open_internal(Sound_Sample *sample, const char *ext, fmt_t *fmt)
             case 4: sample->actual.format = SDL_AUDIO_S16; break;
             case 8: sample->actual.format = SDL_AUDIO_U8; break;
             case 16: sample->actual.format = SDL_AUDIO_S16LE; break;
-            case 24: sample->actual.format = SDL_AUDIO_S32; break;
+            case 24:  /* we convert these ourselves, so pick what saves a conversion later. */
+                if ((sample->desired.format == SDL_AUDIO_S16) || (sample->desired.format == SDL_AUDIO_F32))
+                    sample->actual.format = sample->desired.format;
+                else
+                    sample->actual.format = SDL_AUDIO_S32;
+                break;
             case 32: sample->actual.format = SDL_AUDIO_S32LE; break;
             default:
                 SNDDBG(("WAV: %d bits per sample!?\n", (int) fmt->wBitsPerSample));
@@ -706,6 +753,11 @@ static int WAV_open_internal(Sound_Sample *sample, const char *ext, fmt_t *fmt)
     } /* else */
 
     BAIL_IF_MACRO(!read_fmt(io, fmt), NULL, 0);
+
+    /* ADPCM can't stop partway through a block, so a push sample waits for all of it. */
+    if ((internal->push != NULL) && (fmt->wFormatTag == FMT_ADPCM))
+        BAIL_IF_MACRO(SDL_GetIOSize(io) < 0, "WAV: ADPCM needs the whole stream", 0);
+
     SDL_SeekIO(io, fmt->next_chunk_offset, SDL_IO_SEEK_SET);
     BAIL_IF_MACRO(!find_chunk(io, dataID), "WAV: No data chunk.", 0);
     BAIL_IF_MACRO(!read_data_chunk(io, &d), "WAV: Can't read data chunk.", 0);
@@ -789,14 +841,27 @@ static int WAV_rewind(Sound_Sample *sample)
 } /* WAV_rewind */
 
 
-static int WAV_seek(Sound_Sample *sample, Uint32 ms)
+static int WAV_seek_frame(Sound_Sample *sample, Uint64 frame)
 {
     Sound_SampleInternal *internal = (Sound_SampleInternal *) sample->opaque;
     wav_t *w = (wav_t *) internal->decoder_private;
-    return w->fmt->seek_sample(sample, ms);
+    return w->fmt->seek_sample(sample, frame);
+} /* WAV_seek_frame */
+
+
+static int WAV_seek(Sound_Sample *sample, Uint32 ms)
+{
+    return WAV_seek_frame(sample, __Sound_convertMsToFrames(&sample->actual, ms));
 } /* WAV_seek */
 
 
+static int WAV_probe(const Uint8 *header, Uint32 len)
+{
+    return ( (len >= 12) && (SDL_memcmp(header, "RIFF", 4) == 0) &&
+             (SDL_memcmp(header + 8, "WAVE", 4) == 0) );
+} /* WAV_probe */
+
+
 static const char *extensions_wav[] = { "WAV", NULL };
 const Sound_DecoderFunctions __Sound_DecoderFunctions_WAV =
 {
@@ -813,7 +878,12 @@ const Sound_DecoderFunctions __Sound_DecoderFunctions_WAV =
     WAV_close,      /*  close() method */
     WAV_read,       /*   read() method */
     WAV_rewind,     /* rewind() method */
-    WAV_seek        /*   seek() method */
+    WAV_seek,       /*   seek() method */
+    WAV_seek_frame, /* seek_frame() method */
+    WAV_probe,      /*  probe() method */
+    NULL,           /* duration() method */
+    NULL,           /* save_index() method */
+    NULL            /* load_index() method */
 };
 
 #endif /* SOUND_SUPPORTS_WAV */
@@ -859,6 +859,10 @@ struct stb_vorbis
    uint32 io_buffer_fill;
    uint8 io_buffer[IO_BUFFER_SIZE];
    int close_on_free;
+   // pages the app already knows about, sorted by position; see
+   // seek_to_sample_coarse(). Borrowed, not freed.
+   const ProbedPage *seek_index;
+   int seek_index_count;
 #endif
 
    const uint8 *stream;
@@ -1413,8 +1417,10 @@ static int STBV_CDECL point_compare(const void *p, const void *q)
 /////////////////////// END LEAF SETUP FUNCTIONS //////////////////////////
 
 
-#ifdef STB_VORBIS_SDL
+#if defined(STB_VORBIS_SDL) && defined(STB_VORBIS_NO_PUSHDATA_API)
    #define USE_MEMORY(z)    FALSE
+#elif defined(STB_VORBIS_SDL)
+   #define USE_MEMORY(z)    ((z)->stream)  // pushdata reads from memory, the rest from the SDL_IOStream.
 #elif defined(STB_VORBIS_NO_STDIO)
    #define USE_MEMORY(z)    TRUE
 #else
@@ -1424,6 +1430,10 @@ static int STBV_CDECL point_compare(const void *p, const void *q)
 static uint8 get8(vorb *z)
 {
    #ifdef STB_VORBIS_SDL
+   if (USE_MEMORY(z)) {
+      if (z->stream >= z->stream_end) { z->eof = TRUE; return 0; }
+      return *z->stream++;
+   }
    if (z->io_buffer_pos >= z->io_buffer_fill) {
       z->io_buffer_fill = SDL_ReadIO(z->io, z->io_buffer, IO_BUFFER_SIZE);
       z->io_buffer_pos = 0;
@@ -1461,6 +1471,12 @@ static uint32 get32(vorb *f)
 static int getn(vorb *z, uint8 *data, int n)
 {
    #ifdef STB_VORBIS_SDL
+   if (USE_MEMORY(z)) {
+      if (z->stream+n > z->stream_end) { z->eof = 1; return 0; }
+      memcpy(data, z->stream, n);
+      z->stream += n;
+      return 1;
+   }
    while (n > 0) {
       int chunk;
 
@@ -1508,6 +1524,11 @@ static int set_file_offset(stb_vorbis *f, unsigned int loc);
 static void skip(vorb *z, int n)
 {
    #ifdef STB_VORBIS_SDL
+   if (USE_MEMORY(z)) {
+      z->stream += n;
+      if (z->stream >= z->stream_end) z->eof = 1;
+      return;
+   }
    set_file_offset(z, z->io_virtual_pos + n);
    #else
    if (USE_MEMORY(z)) {
@@ -4509,6 +4530,8 @@ static void vorbis_init(stb_vorbis *p, const stb_vorbis_alloc *z)
    p->io_virtual_pos = 0;
    p->io_buffer_pos = 0;
    p->io_buffer_fill = 0;
+   p->seek_index = NULL;
+   p->seek_index_count = 0;
    #endif
    #ifndef STB_VORBIS_NO_STDIO
    p->close_on_free = FALSE;
@@ -4978,6 +5001,33 @@ static int seek_to_sample_coarse(stb_vorbis *f, uint32 sample_number)
       return 0;
    }
 
+   #ifdef STB_VORBIS_SDL
+   // if we were given an index, start from the known pages on either side
+   // of the target instead of the ends of the stream, as long as they're
+   // still what the index says they are.
+   if (f->seek_index_count > 0) {
+      const ProbedPage *index = f->seek_index;
+      int lo = 0, hi = f->seek_index_count;
+      while (hi - lo > 1) {
+         int m = lo + (hi - lo) / 2;
+         if (index[m].last_decoded_sample <= last_sample_limit)
+            lo = m;
+         else
+            hi = m;
+      }
+      if (index[lo].last_decoded_sample <= last_sample_limit && index[lo].page_start > left.page_start && index[lo].page_end <= right.page_start) {
+         set_file_offset(f, index[lo].page_start);
+         if (get_seek_page_info(f, &mid) && mid.page_end == index[lo].page_end && mid.last_decoded_sample == index[lo].last_decoded_sample)
+            left = mid;
+      }
+      if (hi < f->seek_index_count && index[hi].last_decoded_sample > last_sample_limit && index[hi].page_start >= left.page_end && index[hi].page_start < right.page_start) {
+         set_file_offset(f, index[hi].page_start);
+         if (get_seek_page_info(f, &mid) && mid.page_end == index[hi].page_end && mid.last_decoded_sample == index[hi].last_decoded_sample)
+            right = mid;
+      }
+   }
+   #endif
+
    while (left.page_end != right.page_start) {
       assert(left.page_end < right.page_start);
       // search range in bytes